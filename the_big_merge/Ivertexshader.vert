@@ -0,0 +1,60 @@
+#version 430 core
+
+// Shared with every program, see uniformblocks.h
+layout(std140, binding = 0) uniform FrameBlock
+{
+    mat4 view;
+    mat4 projection;
+    vec4 light_pos;     // xyz
+};
+
+// Dequantization range of the unorm16 positions, shared by all instances
+layout(std140, binding = 2) uniform ObjectBlock
+{
+    vec4 pos_offset;    // xyz
+    vec4 pos_scale;
+};
+
+// Per-instance data, indexed by gl_InstanceID
+struct InstanceData
+{
+    mat4 model;
+    vec4 tint;          // multiplied with the vertex color
+};
+
+layout(std430, binding = 1) readonly buffer InstanceBuffer
+{
+    InstanceData instances[];
+};
+
+in vec3 position;   // unorm16, relative to the mesh bounds
+in vec3 color;      // unorm8
+in vec4 normal;     // snorm 10_10_10_2
+
+out vec3 vColor;
+
+out VS_OUT
+{
+   vec3 N;
+   vec3 L;
+   vec3 V;
+} vs_out;
+
+void main()
+{
+    mat4 mv = view * instances[gl_InstanceID].model;
+    vec4 P = mv * vec4(pos_offset.xyz + position * pos_scale.xyz, 1.0);
+
+    // Calculate normal in view-space
+    vs_out.N = mat3(mv) * normal.xyz;
+
+    // Calculate light vector
+    vs_out.L = light_pos.xyz - P.xyz;
+
+    // Calculate view vector;
+    vs_out.V = -P.xyz;
+
+    gl_Position = projection * P;
+
+    vColor = color * instances[gl_InstanceID].tint.rgb;
+}
@@ -8,14 +8,21 @@ in VS_OUT
     vec3 V;
 } fs_in;
 
-//textures
+//textures, all in the layers of one atlas
 in vec2 UV;
-uniform sampler2D texsampler;
+flat in vec4 atlas_rect;
+flat in float atlas_layer;
+uniform sampler2DArray texsampler;
 
 
-// Material properties
-uniform vec3 mat_ambient;
-uniform vec3 mat_diffuse;
+// Material properties, see uniformblocks.h
+layout(std140, binding = 1) uniform MaterialBlock
+{
+    vec4 mat_ambient;   // rgb
+    vec4 mat_diffuse;   // rgb
+};
+
+out vec4 frag_color;
 
 void main()
 {
@@ -30,11 +37,16 @@ void main()
     // Compute the diffuse and specular components for each fragment
     // vec3 diffuse = max(dot(N, L), 0.0) * mat_diffuse;
     // vec3 specular = pow(max(dot(R, V), 0.0), mat_power) * mat_specular;
-    vec3 diffuse = max(dot(N, L), 0.0) * texture2D(texsampler, UV).rgb;
+    // Repeat inside the texture's rectangle of the page; the gradients of
+    // the unwrapped UV keep the mip level steady across the wrap
+    vec2 page_uv = atlas_rect.xy + fract(UV) * atlas_rect.zw;
+    vec3 texel = textureGrad(texsampler, vec3(page_uv, atlas_layer),
+        dFdx(UV) * atlas_rect.zw, dFdy(UV) * atlas_rect.zw).rgb;
+    vec3 diffuse = max(dot(N, L), 0.0) * texel;
 
     // Write final color to the framebuffer
     //gl_FragColor = vec4(mat_ambient + diffuse + specular, 1.0);
-    gl_FragColor = vec4(mat_ambient + diffuse, 1.0);
+    frag_color = vec4(mat_ambient.rgb + diffuse, 1.0);
 
 
 }
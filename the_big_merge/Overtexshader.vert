@@ -1,16 +1,37 @@
 #version 430 core
 
-// Uniform matrices
-uniform mat4 mv;
-uniform mat4 projection;
-uniform vec3 light_pos;
+// Shared with every program, see uniformblocks.h
+layout(std140, binding = 0) uniform FrameBlock
+{
+    mat4 view;
+    mat4 projection;
+    vec4 light_pos;     // xyz
+};
+
+// Per-draw data, indexed by draw_id (base_instance of the draw)
+struct DrawData
+{
+    mat4 mv;
+    vec4 pos_offset;    // dequantization range of the unorm16 positions, w atlas layer
+    vec4 pos_scale;
+    vec4 uv_range;      // uv offset in xy, uv scale in zw
+    vec4 atlas_rect;    // texture's place in its atlas page, offset in xy, scale in zw
+};
+
+layout(std430, binding = 0) buffer DrawBuffer
+{
+    DrawData draws[];
+};
 
 // Per-vertex inputs
-in vec3 position;
-in vec3 normal;
-in vec2 uv;
+in vec3 position;   // unorm16, relative to the mesh bounds
+in vec2 normal;     // octahedral snorm16
+in vec2 uv;         // unorm16, relative to the uv bounds
+in uint draw_id;    // per instance
 
 out vec2 UV;
+flat out vec4 atlas_rect;
+flat out float atlas_layer;
 
 out VS_OUT
 {
@@ -19,16 +40,25 @@ out VS_OUT
    vec3 V;
 } vs_out;
 
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(e.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
 void main()
 {
     // Calculate view-space coordinate
-    vec4 P = mv * vec4(position, 1.0);
+    mat4 mv = draws[draw_id].mv;
+    vec4 P = mv * vec4(draws[draw_id].pos_offset.xyz + position * draws[draw_id].pos_scale.xyz, 1.0);
 
     // Calculate normal in view-space
-    vs_out.N = mat3(mv) * normal;
+    vs_out.N = mat3(mv) * octDecode(normal);
 
     // Calculate light vector
-    vs_out.L = light_pos - P.xyz;
+    vs_out.L = light_pos.xyz - P.xyz;
 
     // Calculate view vector;
     vs_out.V = -P.xyz;
@@ -36,5 +66,7 @@ void main()
     // Calculate the clip-space position of each vertex
     gl_Position = projection * P;
 
-    UV = uv;
+    UV = draws[draw_id].uv_range.xy + uv * draws[draw_id].uv_range.zw;
+    atlas_rect = draws[draw_id].atlas_rect;
+    atlas_layer = draws[draw_id].pos_offset.w;
 }
@@ -8,9 +8,14 @@ in VS_OUT
     vec3 V;
 } fs_in;
 
-// Material properties
-uniform vec3 mat_ambient;
-uniform vec3 mat_diffuse;
+// Material properties, see uniformblocks.h
+layout(std140, binding = 1) uniform MaterialBlock
+{
+    vec4 mat_ambient;   // rgb
+    vec4 mat_diffuse;   // rgb
+};
+
+out vec4 frag_color;
 
 void main()
 {
@@ -27,5 +32,5 @@ void main()
     vec3 diffuse = max(dot(N, L), 0.0) * vColor;
 
     //gl_FragColor = vec4(vColor, 1.0);
-    gl_FragColor = vec4(mat_ambient + diffuse, 1.0);
+    frag_color = vec4(mat_ambient.rgb + diffuse, 1.0);
 }
@@ -1,12 +1,32 @@
 #version 430 core
 
-uniform mat4 mv;
-uniform mat4 projection;
-uniform vec3 light_pos;
+// Shared with every program, see uniformblocks.h
+layout(std140, binding = 0) uniform FrameBlock
+{
+    mat4 view;
+    mat4 projection;
+    vec4 light_pos;     // xyz
+};
+
+// Per-draw data, indexed by draw_id (base_instance of the draw)
+struct DrawData
+{
+    mat4 mv;
+    vec4 pos_offset;    // dequantization range of the unorm16 positions, w atlas layer
+    vec4 pos_scale;
+    vec4 uv_range;      // uv offset in xy, uv scale in zw
+    vec4 atlas_rect;    // texture's place in its atlas page, offset in xy, scale in zw
+};
+
+layout(std430, binding = 0) buffer DrawBuffer
+{
+    DrawData draws[];
+};
 
-in vec3 position;
-in vec3 color;
-in vec3 normal;
+in vec3 position;   // unorm16, relative to the mesh bounds
+in vec3 color;      // unorm8
+in vec4 normal;     // snorm 10_10_10_2
+in uint draw_id;    // per instance
 
 out vec3 vColor;
 
@@ -19,13 +39,14 @@ out VS_OUT
 
 void main()
 {
-    vec4 P = mv * vec4(position, 1.0);
+    mat4 mv = draws[draw_id].mv;
+    vec4 P = mv * vec4(draws[draw_id].pos_offset.xyz + position * draws[draw_id].pos_scale.xyz, 1.0);
 
     // Calculate normal in view-space
-    vs_out.N = mat3(mv) * normal;
+    vs_out.N = mat3(mv) * normal.xyz;
 
     // Calculate light vector
-    vs_out.L = light_pos - P.xyz;
+    vs_out.L = light_pos.xyz - P.xyz;
 
     // Calculate view vector;
     vs_out.V = -P.xyz;
@@ -0,0 +1,434 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "assetmanager.h"
+#include "blockcompress.h"
+#include "mesh.h"
+#include "meshcache.h"
+#include "meshopt.h"
+#include "mipmap.h"
+#include "objloader.h"
+
+namespace {
+
+double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Packs an indexed mesh the way the textured arena stores it
+void packMesh(const IndexedMesh & mesh, MeshData & out)
+{
+    const MeshVertex * vertices = &mesh.vertices[0];
+    size_t vertex_count = mesh.vertices.size();
+    out.quantization = computeQuantizationRange(vertices, vertex_count);
+    packTexturedVertices(vertices, vertex_count, out.quantization, out.vertices);
+    computeBounds(&vertices[0].position.x, vertex_count, sizeof(MeshVertex) / sizeof(float),
+        out.bounds_min, out.bounds_max);
+
+    out.index_count = (unsigned int)mesh.indices.size();
+    if (fitsIn16Bit(mesh)) {
+        std::vector<unsigned short> narrow;
+        packIndices16(mesh.indices, narrow);
+        out.index_type = GL_UNSIGNED_SHORT;
+        out.indices.resize(narrow.size() * sizeof(unsigned short));
+        memcpy(&out.indices[0], &narrow[0], out.indices.size());
+    }
+    else {
+        out.index_type = GL_UNSIGNED_INT;
+        out.indices.resize(mesh.indices.size() * sizeof(unsigned int));
+        memcpy(&out.indices[0], &mesh.indices[0], out.indices.size());
+    }
+}
+
+// Same steps as loading at startup used to take: the mesh cache when it
+// is up to date, otherwise parse, optimize, build lods and write the cache.
+// hash is the content hash of the OBJ file.
+bool decodeMesh(const char * path, MeshData & out, unsigned long long & hash)
+{
+    std::string cache_path = meshCachePath(path);
+    CachedMesh cached;
+    if (cached.open(cache_path.c_str(), path)) {
+        const MeshCacheHeader & header = cached.header();
+        hash = header.source_hash;
+        out.vertices.assign(cached.vertices(), cached.vertices() + header.vertex_count);
+        const unsigned char * indices = (const unsigned char *)cached.indices();
+        out.indices.assign(indices, indices + (size_t)header.index_count * header.index_size);
+        out.index_type = header.index_size == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        out.index_count = header.index_count;
+        out.lods.assign(cached.lods(), cached.lods() + header.lod_count);
+        out.quantization = cached.quantization();
+        out.bounds_min = glm::vec3(header.bounds_min[0], header.bounds_min[1], header.bounds_min[2]);
+        out.bounds_max = glm::vec3(header.bounds_max[0], header.bounds_max[1], header.bounds_max[2]);
+        return true;
+    }
+
+    IndexedMesh mesh;
+    if (!loadOBJIndexed(path, mesh, 1) || mesh.vertices.empty() || !hashFile(path, hash))
+        return false;
+    optimizeMesh(mesh, path);
+    buildLodChain(mesh.indices, &mesh.vertices[0].position.x, mesh.vertices.size(),
+        sizeof(MeshVertex) / sizeof(float), out.lods, path);
+    writeMeshCache(cache_path.c_str(), path, mesh, out.lods);
+    packMesh(mesh, out);
+    reportTexturedFootprint(path, &mesh.vertices[0], mesh.vertices.size(), out.quantization, out.vertices);
+    return true;
+}
+
+// Unit box with a face per side, drawn until a mesh has loaded
+void makeBoxMesh(IndexedMesh & mesh)
+{
+    for (int axis = 0; axis < 3; axis++) {
+        for (int side = -1; side <= 1; side += 2) {
+            glm::vec3 normal(0.0f);
+            normal[axis] = (float)side;
+            glm::vec3 u(0.0f), v(0.0f);
+            u[(axis + 1) % 3] = 1.0f;
+            v[(axis + 2) % 3] = (float)side;
+            unsigned int first = (unsigned int)mesh.vertices.size();
+            for (int corner = 0; corner < 4; corner++) {
+                float s = (corner & 1) ? 1.0f : -1.0f, t = (corner & 2) ? 1.0f : -1.0f;
+                MeshVertex vertex;
+                vertex.position = normal + u * s + v * t;
+                vertex.normal = normal;
+                vertex.uv = glm::vec2(s * 0.5f + 0.5f, t * 0.5f + 0.5f);
+                mesh.vertices.push_back(vertex);
+            }
+            unsigned int quad[6] = { 0, 1, 3, 0, 3, 2 };
+            for (int i = 0; i < 6; i++)
+                mesh.indices.push_back(first + quad[i]);
+        }
+    }
+}
+
+} // namespace
+
+AssetManager::AssetManager()
+    : arena_(NULL), cache_(NULL), compress_(false), placeholder_texture_(0), quit_(false), pending_(0)
+{
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+AssetManager::~AssetManager()
+{
+    // GL objects need the context, destroy() releases them; the threads
+    // must not outlive the queues either way
+    stopLoaders();
+}
+
+bool AssetManager::create(BufferArena & arena, ResourceCache & cache, size_t staging_bytes,
+    unsigned int loader_threads)
+{
+    arena_ = &arena;
+    cache_ = &cache;
+    compress_ = GLEW_EXT_texture_compression_s3tc != 0;
+    if (!staging_.create(staging_bytes))
+        return false;
+
+    IndexedMesh box;
+    makeBoxMesh(box);
+    MeshData box_data;
+    packMesh(box, box_data);
+    MeshAsset & placeholder = placeholder_mesh_;
+    if (!arena.allocate(box_data.vertices.size(), box_data.index_count, box_data.index_type, placeholder.range))
+        return false;
+    arena.upload(placeholder.range, &box_data.vertices[0], &box_data.indices[0]);
+    MeshLod full = { 0, box_data.index_count, 0.0f };
+    placeholder.lods.assign(1, full);
+    placeholder.quantization = box_data.quantization;
+    placeholder.bounds_min = box_data.bounds_min;
+    placeholder.bounds_max = box_data.bounds_max;
+
+    ImageData checker;
+    makeCheckerImage(checker);
+    placeholder_texture_ = uploadImage(checker);
+
+    quit_ = false;
+    for (unsigned int i = 0; i < std::max(loader_threads, 1u); i++)
+        loaders_.push_back(std::thread(&AssetManager::loaderLoop, this));
+    printf("asset manager: %u loader threads, %u KB %s staging\n", (unsigned int)loaders_.size(),
+        (unsigned int)(staging_bytes >> 10), staging_.persistent() ? "persistent mapped" : "glBufferSubData");
+    return true;
+}
+
+void AssetManager::destroy()
+{
+    stopLoaders();
+    requests_.clear();
+    ready_.clear();
+    in_flight_.clear();
+    pending_ = 0;
+    staging_.destroy();
+    if (placeholder_texture_)
+        glDeleteTextures(1, &placeholder_texture_);
+    placeholder_texture_ = 0;
+    if (arena_ && placeholder_mesh_.lods.size())
+        arena_->free(placeholder_mesh_.range);
+    placeholder_mesh_.lods.clear();
+    arena_ = NULL;
+    cache_ = NULL;
+}
+
+void AssetManager::stopLoaders()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+    }
+    wake_.notify_all();
+    for (size_t i = 0; i < loaders_.size(); i++)
+        loaders_[i].join();
+    loaders_.clear();
+}
+
+void AssetManager::loadMesh(const char * path, const ResourceReadyFunction & ready)
+{
+    load(RESOURCE_MESH, path, ready);
+}
+
+void AssetManager::loadTexture(const char * path, const ResourceReadyFunction & ready)
+{
+    load(RESOURCE_TEXTURE, path, ready);
+}
+
+void AssetManager::load(ResourceType type, const char * path, const ResourceReadyFunction & ready)
+{
+    stats_.requested++;
+    ResourceHandle handle = cache_->findPath(type, path);
+    if (handle) {
+        ready(handle);
+        return;
+    }
+
+    // Loaded once, however many objects ask for it meanwhile
+    std::pair<ResourceType, std::string> key(type, path);
+    std::map<std::pair<ResourceType, std::string>, Request *>::iterator joined = in_flight_.find(key);
+    if (joined != in_flight_.end()) {
+        stats_.coalesced++;
+        joined->second->ready.push_back(ready);
+        return;
+    }
+
+    std::unique_ptr<Request> request(new Request());
+    request->type = type;
+    request->path = path;
+    request->ready.push_back(ready);
+    request->requested = std::chrono::steady_clock::now();
+    request->decoded = false;
+    request->decode_ms = 0.0;
+    request->hash = 0;
+    request->bytes = 0;
+    in_flight_[key] = request.get();
+    pending_++;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        requests_.push_back(std::move(request));
+    }
+    wake_.notify_one();
+}
+
+void AssetManager::loaderLoop()
+{
+    for (;;) {
+        std::unique_ptr<Request> request;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this]() { return quit_ || !requests_.empty(); });
+            if (quit_)
+                return;
+            request = std::move(requests_.front());
+            requests_.pop_front();
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        const char * path = request->path.c_str();
+        if (request->type == RESOURCE_MESH) {
+            request->decoded = decodeMesh(path, request->mesh, request->hash);
+            request->bytes = request->mesh.vertices.size() * sizeof(PackedTexturedVertex)
+                + request->mesh.indices.size();
+        }
+        else {
+            size_t length = request->path.size();
+            bool dds = length >= 4 && (request->path.compare(length - 4, 4, ".dds") == 0
+                || request->path.compare(length - 4, 4, ".DDS") == 0);
+            // BMPs are stored as BC1, from the DDS cached next to them
+            // once compressed
+            if (dds)
+                request->decoded = decodeDDS(path, request->image);
+            else if (compress_)
+                request->decoded = decodeBMPCompressed(path, BLOCK_BC1, request->image);
+            else
+                request->decoded = decodeBMP(path, request->image);
+            request->decoded = request->decoded && hashFile(path, request->hash);
+            if (request->decoded)
+                generateMipmaps(request->image);
+            request->bytes = imageBytes(request->image);
+        }
+        request->decode_ms = millisecondsSince(start);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        ready_.push_back(std::move(request));
+    }
+}
+
+unsigned int AssetManager::update(size_t byte_budget, double ms_budget)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    unsigned int finished = 0;
+    size_t bytes = 0;
+    for (;;) {
+        std::unique_ptr<Request> request;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (ready_.empty())
+                break;
+            if (finished > 0 && (bytes + ready_.front()->bytes > byte_budget || millisecondsSince(start) >= ms_budget))
+                break;
+            request = std::move(ready_.front());
+            ready_.pop_front();
+        }
+
+        // Same content under another path is uploaded already
+        ResourceHandle handle;
+        if (request->decoded)
+            handle = cache_->find(request->type, request->hash, request->path.c_str());
+        if (request->decoded && !handle) {
+            UploadResult uploaded = request->type == RESOURCE_MESH ? uploadMesh(*request, handle)
+                : uploadTexture(*request, handle);
+            if (uploaded == UPLOAD_PUT_OFF) {
+                // The ring is still busy with earlier frames, retry next frame
+                stats_.staging_stalls++;
+                std::lock_guard<std::mutex> lock(mutex_);
+                ready_.push_front(std::move(request));
+                break;
+            }
+            if (uploaded == UPLOAD_DONE)
+                bytes += request->bytes;
+        }
+        finish(*request, handle);
+        finished++;
+    }
+    staging_.endFrame();
+
+    if (bytes) {
+        double ms = millisecondsSince(start);
+        stats_.bytes_uploaded += bytes;
+        stats_.upload_frames++;
+        stats_.upload_ms_max = std::max(stats_.upload_ms_max, ms);
+        if (ms > ms_budget)
+            stats_.over_budget++;
+    }
+    return finished;
+}
+
+AssetManager::UploadResult AssetManager::uploadMesh(Request & request, ResourceHandle & handle)
+{
+    MeshData & data = request.mesh;
+    Resource resource;
+    MeshAsset & mesh = resource.mesh;
+    if (!arena_->allocate(data.vertices.size(), data.index_count, data.index_type, mesh.range))
+        return UPLOAD_FAILED;
+
+    size_t vertex_bytes = data.vertices.size() * sizeof(PackedTexturedVertex);
+    if (vertex_bytes + data.indices.size() + 32 > staging_.capacity()) {
+        // Bigger than the whole ring, only a direct upload can take it
+        arena_->upload(mesh.range, &data.vertices[0], &data.indices[0]);
+    }
+    else {
+        size_t vertex_offset, index_offset;
+        if (!staging_.write(&data.vertices[0], vertex_bytes, 16, vertex_offset)
+            || !staging_.write(&data.indices[0], data.indices.size(), 16, index_offset)) {
+            arena_->free(mesh.range);
+            return UPLOAD_PUT_OFF;
+        }
+        arena_->copyFrom(mesh.range, staging_.buffer(), vertex_offset, index_offset);
+    }
+
+    mesh.lods = data.lods;
+    if (mesh.lods.empty()) {
+        MeshLod full = { 0, data.index_count, 0.0f };
+        mesh.lods.assign(1, full);
+    }
+    mesh.quantization = data.quantization;
+    mesh.bounds_min = data.bounds_min;
+    mesh.bounds_max = data.bounds_max;
+
+    resource.type = RESOURCE_MESH;
+    resource.hash = request.hash;
+    resource.path = request.path;
+    resource.name = 0;
+    resource.arena = arena_;
+    resource.cpu_bytes = sizeof(Resource) + mesh.lods.size() * sizeof(MeshLod);
+    resource.gpu_bytes = request.bytes;
+    handle = cache_->insert(resource, request.path.c_str());
+    return UPLOAD_DONE;
+}
+
+AssetManager::UploadResult AssetManager::uploadTexture(Request & request, ResourceHandle & handle)
+{
+    ImageData & image = request.image;
+    size_t offset = 0;
+    // Mapped DDS levels go from the file straight into the staging ring
+    bool staged = imageBytes(image) <= staging_.capacity();
+    if (staged && !staging_.write(imagePixels(image), imageBytes(image), 16, offset))
+        return UPLOAD_PUT_OFF;
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    if (staged) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging_.buffer());
+        uploadImageLevels(image, (const unsigned char *)offset);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    else {
+        uploadImageLevels(image, imagePixels(image));
+    }
+    setImageSampling(image);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    Resource resource;
+    resource.type = RESOURCE_TEXTURE;
+    resource.hash = request.hash;
+    resource.path = request.path;
+    resource.name = texture;
+    resource.arena = NULL;
+    resource.cpu_bytes = sizeof(Resource);
+    resource.gpu_bytes = request.bytes;
+    handle = cache_->insert(resource, request.path.c_str());
+    return UPLOAD_DONE;
+}
+
+void AssetManager::finish(Request & request, const ResourceHandle & handle)
+{
+    in_flight_.erase(std::make_pair(request.type, request.path));
+    double latency = millisecondsSince(request.requested);
+    if (handle) {
+        stats_.loaded++;
+        stats_.decode_ms_total += request.decode_ms;
+        stats_.decode_ms_max = std::max(stats_.decode_ms_max, request.decode_ms);
+        stats_.latency_ms_total += latency;
+        stats_.latency_ms_max = std::max(stats_.latency_ms_max, latency);
+        printf("%s: streamed in %.2f ms (%.2f ms decoding)\n", request.path.c_str(), latency, request.decode_ms);
+        for (size_t i = 0; i < request.ready.size(); i++)
+            request.ready[i](handle);
+    }
+    else {
+        stats_.failed++;
+        printf("%s: failed to load, keeping the placeholder\n", request.path.c_str());
+    }
+    pending_--;
+}
+
+void AssetManager::report() const
+{
+    const AssetStats & s = stats_;
+    unsigned int loaded = std::max(s.loaded, 1u);
+    printf("assets: %u requested, %u loaded, %u joined in flight, %u failed, %u pending; decode mean %.2f ms max %.2f ms, "
+        "latency mean %.2f ms max %.2f ms\n", s.requested, s.loaded, s.coalesced, s.failed, (unsigned int)pending_,
+        s.decode_ms_total / loaded, s.decode_ms_max, s.latency_ms_total / loaded, s.latency_ms_max);
+    printf("asset uploads: %u KB over %u frames, slowest frame %.2f ms, %u over budget, %u staging stalls\n",
+        (unsigned int)(s.bytes_uploaded >> 10), s.upload_frames, s.upload_ms_max, s.over_budget, s.staging_stalls);
+}
@@ -0,0 +1,149 @@
+#ifndef ASSETMANAGER_H
+#define ASSETMANAGER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "bufferarena.h"
+#include "resourcecache.h"
+#include "simplify.h"
+#include "stagingbuffer.h"
+#include "texture.h"
+#include "vertexformat.h"
+
+// A decoded mesh, packed for the textured arena
+struct MeshData
+{
+	std::vector<PackedTexturedVertex> vertices;
+	std::vector<unsigned char> indices;
+	GLenum index_type;
+	unsigned int index_count;
+	std::vector<MeshLod> lods;
+	QuantizationRange quantization;
+	glm::vec3 bounds_min, bounds_max;
+};
+
+typedef std::function<void(const ResourceHandle &)> ResourceReadyFunction;
+
+struct AssetStats
+{
+	unsigned int requested;
+	unsigned int loaded;
+	unsigned int failed;
+	unsigned int coalesced;                     // requests joined to one in flight
+	double decode_ms_total, decode_ms_max;      // file to CPU data, loader threads
+	double latency_ms_total, latency_ms_max;    // request to upload
+	size_t bytes_uploaded;
+	unsigned int upload_frames;                 // frames that uploaded something
+	double upload_ms_max;
+	unsigned int over_budget;                   // upload frames longer than the time budget
+	unsigned int staging_stalls;                // uploads put off because the ring was full
+};
+
+// Loads meshes (OBJ, through the mesh cache) and textures (BMP, DDS) on
+// background threads. Decoded data waits in a queue until update(),
+// called on the GL thread every frame, copies it through a staging ring
+// into the arena or a new texture within a byte and time budget, adds it
+// to the resource cache and calls the request's ready functions with a
+// handle. Until then users draw the placeholders. Failed loads just keep
+// the placeholder.
+//
+// Files already in the cache are handed out right away, before load
+// returns; requests for a path in flight join it, and decoded data whose
+// content hash is resident under another path is not uploaded again.
+class AssetManager
+{
+public:
+	AssetManager();
+	~AssetManager();
+
+	// BMP textures are block compressed when the GL has S3TC, each on the
+	// loader thread that decodes it. Not on the job system: a loader is
+	// not one of its workers, so its jobs would land in the queue the GL
+	// thread drains while it waits and stall the frame.
+	bool create(BufferArena & arena, ResourceCache & cache, size_t staging_bytes,
+		unsigned int loader_threads = 1);
+	void destroy();
+
+	void loadMesh(const char * path, const ResourceReadyFunction & ready);
+	void loadTexture(const char * path, const ResourceReadyFunction & ready);
+
+	// Uploads decoded assets, at least one and then as many as fit in
+	// both budgets. Returns the number of requests finished, failed
+	// ones included.
+	unsigned int update(size_t byte_budget, double ms_budget);
+
+	// Requests not finished yet
+	size_t pending() const { return pending_; }
+
+	const MeshAsset & placeholderMesh() const { return placeholder_mesh_; }
+	GLuint placeholderTexture() const { return placeholder_texture_; }
+
+	const AssetStats & stats() const { return stats_; }
+	void report() const;
+
+private:
+	AssetManager(const AssetManager &);
+	AssetManager & operator=(const AssetManager &);
+
+	struct Request
+	{
+		ResourceType type;
+		std::string path;
+		std::vector<ResourceReadyFunction> ready;   // GL thread only
+		std::chrono::steady_clock::time_point requested;
+		double decode_ms;
+		bool decoded;
+		unsigned long long hash;                    // of the file
+		size_t bytes;
+		MeshData mesh;
+		ImageData image;
+	};
+
+	// Put off means the staging ring is full and the request is retried
+	// next frame, failed that it never will fit and keeps its placeholder
+	enum UploadResult
+	{
+		UPLOAD_DONE,
+		UPLOAD_PUT_OFF,
+		UPLOAD_FAILED
+	};
+
+	void load(ResourceType type, const char * path, const ResourceReadyFunction & ready);
+	void loaderLoop();
+	void stopLoaders();
+	UploadResult uploadMesh(Request & request, ResourceHandle & handle);
+	UploadResult uploadTexture(Request & request, ResourceHandle & handle);
+	void finish(Request & request, const ResourceHandle & handle);
+
+	BufferArena * arena_;
+	ResourceCache * cache_;
+	bool compress_;
+	StagingBuffer staging_;
+	MeshAsset placeholder_mesh_;
+	GLuint placeholder_texture_;
+	AssetStats stats_;
+
+	std::vector<std::thread> loaders_;
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	bool quit_;
+	std::deque<std::unique_ptr<Request> > requests_;    // waiting for a loader
+	std::deque<std::unique_ptr<Request> > ready_;       // decoded, waiting for update()
+	std::atomic<size_t> pending_;
+	std::map<std::pair<ResourceType, std::string>, Request *> in_flight_;
+};
+
+#endif
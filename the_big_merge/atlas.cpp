@@ -0,0 +1,364 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "atlas.h"
+#include "blockcompress.h"
+#include "mipmap.h"
+#include "texture.h"
+
+SkylinePacker::SkylinePacker()
+    : width_(0), height_(0), used_area_(0)
+{
+}
+
+void SkylinePacker::create(unsigned int width, unsigned int height)
+{
+    width_ = width;
+    height_ = height;
+    used_area_ = 0;
+    Segment floor = { 0, 0, width };
+    skyline_.assign(1, floor);
+}
+
+bool SkylinePacker::fit(size_t i, unsigned int width, unsigned int height, unsigned int & y) const
+{
+    unsigned int x = skyline_[i].x;
+    if (x + width > width_)
+        return false;
+    y = 0;
+    for (; i < skyline_.size() && skyline_[i].x < x + width; i++) {
+        y = std::max(y, skyline_[i].y);
+        if (y + height > height_)
+            return false;
+    }
+    return true;
+}
+
+bool SkylinePacker::insert(unsigned int width, unsigned int height, unsigned int & x, unsigned int & y)
+{
+    size_t best = skyline_.size();
+    unsigned int best_top = ~0u, best_width = ~0u;
+    for (size_t i = 0; i < skyline_.size(); i++) {
+        unsigned int top;
+        if (!fit(i, width, height, top))
+            continue;
+        top += height;
+        if (top < best_top || (top == best_top && skyline_[i].width < best_width)) {
+            best = i;
+            best_top = top;
+            best_width = skyline_[i].width;
+        }
+    }
+    if (best == skyline_.size())
+        return false;
+
+    x = skyline_[best].x;
+    y = best_top - height;
+    used_area_ += (size_t)width * height;
+
+    // The new segment replaces what it covers, a partly covered one is
+    // cut from the left, and neighbours at the same height are merged
+    Segment placed = { x, best_top, width };
+    skyline_.insert(skyline_.begin() + best, placed);
+    size_t next = best + 1;
+    while (next < skyline_.size() && skyline_[next].x < x + width) {
+        unsigned int end = skyline_[next].x + skyline_[next].width;
+        if (end <= x + width) {
+            skyline_.erase(skyline_.begin() + next);
+            continue;
+        }
+        skyline_[next].width = end - (x + width);
+        skyline_[next].x = x + width;
+        break;
+    }
+    for (size_t i = 0; i + 1 < skyline_.size();) {
+        if (skyline_[i].y == skyline_[i + 1].y) {
+            skyline_[i].width += skyline_[i + 1].width;
+            skyline_.erase(skyline_.begin() + i + 1);
+        }
+        else {
+            i++;
+        }
+    }
+    return true;
+}
+
+namespace {
+
+inline unsigned int alignUp(unsigned int value, unsigned int alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Packs the padded rectangles in order onto pages of size, false if more
+// than max_pages are needed
+bool packPages(const std::vector<glm::uvec2> & padded, const std::vector<unsigned int> & order,
+    unsigned int size, unsigned int max_pages, std::vector<AtlasEntry> & entries, unsigned int & pages)
+{
+    std::vector<SkylinePacker> packers;
+    for (size_t n = 0; n < order.size(); n++) {
+        unsigned int i = order[n];
+        AtlasEntry & entry = entries[i];
+        bool placed = false;
+        for (size_t page = 0; page < packers.size() && !placed; page++) {
+            placed = packers[page].insert(padded[i].x, padded[i].y, entry.x, entry.y);
+            entry.layer = (unsigned int)page;
+        }
+        if (!placed) {
+            if (packers.size() == max_pages)
+                return false;
+            packers.push_back(SkylinePacker());
+            packers.back().create(size, size);
+            packers.back().insert(padded[i].x, padded[i].y, entry.x, entry.y);
+            entry.layer = (unsigned int)packers.size() - 1;
+        }
+    }
+    pages = (unsigned int)packers.size();
+    return true;
+}
+
+// Copies an image into the padded rectangle at x, y of a page, repeating
+// it into the border and alignment slack
+void blitWrapped(const ImageData & image, const AtlasEntry & entry, unsigned int padded_width,
+    unsigned int padded_height, unsigned int padding, unsigned int channels, size_t page_row, unsigned char * page)
+{
+    unsigned int source_channels = image.format == GL_BGRA ? 4 : 3;
+    size_t source_row = ((size_t)image.width * source_channels + 3) & ~(size_t)3;
+    const unsigned char * pixels = imagePixels(image);
+    std::vector<unsigned int> columns(padded_width);
+    for (unsigned int px = 0; px < padded_width; px++)
+        columns[px] = (px + image.width - padding % image.width) % image.width * source_channels;
+
+    unsigned int x0 = entry.x - padding, y0 = entry.y - padding;
+    for (unsigned int py = 0; py < padded_height; py++) {
+        const unsigned char * source = pixels + source_row * ((py + image.height - padding % image.height) % image.height);
+        unsigned char * dest = page + page_row * (y0 + py) + (size_t)x0 * channels;
+        for (unsigned int px = 0; px < padded_width; px++, dest += channels) {
+            const unsigned char * texel = source + columns[px];
+            dest[0] = texel[0];
+            dest[1] = texel[1];
+            dest[2] = texel[2];
+            if (channels == 4)
+                dest[3] = source_channels == 4 ? texel[3] : 255;
+        }
+    }
+}
+
+} // namespace
+
+bool packAtlas(const std::vector<glm::uvec2> & sizes, unsigned int max_page_size, unsigned int levels,
+    unsigned int max_texture_size, AtlasLayout & layout)
+{
+    levels = std::max(levels, 1u);
+    unsigned int padding = 1u << (levels - 1);
+    layout.padding = padding;
+    layout.entries.assign(sizes.size(), AtlasEntry());
+    layout.pages = 0;
+
+    // Padded to the alignment on both sides, tallest first
+    std::vector<glm::uvec2> padded(sizes.size());
+    std::vector<unsigned int> order(sizes.size());
+    unsigned int largest = 1;
+    size_t padded_area = 0, image_area = 0;
+    for (size_t i = 0; i < sizes.size(); i++) {
+        padded[i] = glm::uvec2(alignUp(sizes[i].x + 2 * padding, padding), alignUp(sizes[i].y + 2 * padding, padding));
+        largest = std::max(largest, std::max(padded[i].x, padded[i].y));
+        padded_area += (size_t)padded[i].x * padded[i].y;
+        image_area += (size_t)sizes[i].x * sizes[i].y;
+        order[i] = (unsigned int)i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&padded](unsigned int a, unsigned int b) {
+        return padded[a].y > padded[b].y || (padded[a].y == padded[b].y && padded[a].x > padded[b].x);
+    });
+
+    unsigned int size = 1;
+    while (size < largest)
+        size *= 2;
+    if (size > max_texture_size)
+        return false;
+
+    // Grow the page while everything could still fit on one, then take
+    // as many pages of the largest size as needed
+    unsigned int limit = std::max(size, std::min(max_page_size, max_texture_size));
+    for (;; size *= 2) {
+        bool last = size >= limit;
+        if (!last && padded_area > (size_t)size * size)
+            continue;
+        if (packPages(padded, order, size, last ? ~0u : 1, layout.entries, layout.pages))
+            break;
+    }
+
+    // Positions and padded sizes are multiples of the padding, so is the
+    // used extent and every kept level of the page divides evenly
+    layout.page_width = layout.page_height = padding;
+    for (size_t i = 0; i < sizes.size(); i++) {
+        layout.page_width = std::max(layout.page_width, layout.entries[i].x + padded[i].x);
+        layout.page_height = std::max(layout.page_height, layout.entries[i].y + padded[i].y);
+    }
+    glm::vec4 scale(1.0f / layout.page_width, 1.0f / layout.page_height, 1.0f / layout.page_width, 1.0f / layout.page_height);
+    for (size_t i = 0; i < sizes.size(); i++) {
+        AtlasEntry & entry = layout.entries[i];
+        entry.x += padding;
+        entry.y += padding;
+        entry.width = sizes[i].x;
+        entry.height = sizes[i].y;
+        entry.rect = glm::vec4(entry.x * scale.x, entry.y * scale.y, entry.width * scale.z, entry.height * scale.w);
+    }
+    layout.efficiency = layout.pages
+        ? (double)image_area / ((double)layout.page_width * layout.page_height * layout.pages) : 0.0;
+    return true;
+}
+
+TextureAtlas::TextureAtlas()
+    : texture_(0), format_(0), gpu_bytes_(0), build_ms_(0.0)
+{
+    layout_.page_width = layout_.page_height = layout_.pages = layout_.padding = 0;
+    layout_.efficiency = 0.0;
+}
+
+TextureAtlas::~TextureAtlas()
+{
+}
+
+bool TextureAtlas::create(const std::vector<std::string> & paths, const AtlasSettings & settings,
+    JobSystem * jobs)
+{
+    destroy();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::vector<ImageData> images(paths.size());
+    RangeFunction decode = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+            if (!decodeBMP(paths[i].c_str(), images[i]))
+                makeCheckerImage(images[i]);
+    };
+    if (jobs)
+        jobs->parallelFor(images.size(), 1, decode);
+    else
+        decode(0, images.size());
+
+    std::vector<glm::uvec2> sizes(images.size());
+    bool alpha = false;
+    for (size_t i = 0; i < images.size(); i++) {
+        sizes[i] = glm::uvec2(images[i].width, images[i].height);
+        alpha = alpha || images[i].format == GL_BGRA;
+    }
+    GLint max_size = 0, max_layers = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+    if (!packAtlas(sizes, settings.max_page_size, settings.levels, (unsigned int)max_size, layout_)) {
+        printf("texture atlas: an image does not fit in %d texels\n", max_size);
+        return false;
+    }
+    if (layout_.pages > (unsigned int)max_layers) {
+        printf("texture atlas: %u pages, only %d layers allowed\n", layout_.pages, max_layers);
+        return false;
+    }
+
+    unsigned int page_width = layout_.page_width, page_height = layout_.page_height;
+    unsigned int levels = std::max(settings.levels, 1u);
+    unsigned int channels = alpha ? 4 : 3;
+    bool compress = settings.compress && GLEW_EXT_texture_compression_s3tc;
+    BlockFormat block_format = alpha ? BLOCK_BC3 : BLOCK_BC1;
+    if (compress)
+        format_ = alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+    else
+        format_ = alpha ? GL_RGBA8 : GL_RGB8;
+
+    glGenTextures(1, &texture_);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    bool storage = GLEW_ARB_texture_storage != 0;
+    if (storage)
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, format_, page_width, page_height, layout_.pages);
+
+    ImageData page;
+    for (unsigned int layer = 0; layer < layout_.pages; layer++) {
+        // Compose the page, each image into its own rectangle
+        size_t page_row = ((size_t)page_width * channels + 3) & ~(size_t)3;
+        page.width = page_width;
+        page.height = page_height;
+        page.format = alpha ? GL_BGRA : GL_BGR;
+        page.compressed = false;
+        page.file.reset();
+        page.pixels.assign(page_row * page_height, 0);
+        page.levels.assign(1, ImageLevel());
+        page.levels[0].offset = 0;
+        page.levels[0].size = page.pixels.size();
+        std::vector<size_t> on_page;
+        for (size_t i = 0; i < images.size(); i++)
+            if (layout_.entries[i].layer == layer)
+                on_page.push_back(i);
+        RangeFunction blit = [&](size_t begin, size_t end) {
+            for (size_t n = begin; n < end; n++) {
+                size_t i = on_page[n];
+                const AtlasEntry & entry = layout_.entries[i];
+                unsigned int padding = layout_.padding;
+                unsigned int padded_width = alignUp(entry.width + 2 * padding, padding);
+                unsigned int padded_height = alignUp(entry.height + 2 * padding, padding);
+                blitWrapped(images[i], entry, padded_width, padded_height, padding, channels, page_row, &page.pixels[0]);
+            }
+        };
+        if (jobs)
+            jobs->parallelFor(on_page.size(), 4, blit);
+        else
+            blit(0, on_page.size());
+
+        // Mips of the whole page, cut at the levels the padding covers
+        generateMipmaps(page);
+        page.levels.resize(levels);
+        page.pixels.resize(imageBytes(page));
+
+        ImageData compressed;
+        const ImageData & upload = compress && compressImage(page, block_format, compressed, jobs) ? compressed : page;
+        unsigned int width = page_width, height = page_height;
+        for (unsigned int level = 0; level < levels; level++) {
+            const unsigned char * data = imagePixels(upload) + upload.levels[level].offset;
+            GLsizei bytes = (GLsizei)upload.levels[level].size;
+            if (!storage && layer == 0 && upload.compressed)
+                glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, format_, width, height, layout_.pages, 0,
+                    bytes * layout_.pages, NULL);
+            else if (!storage && layer == 0)
+                glTexImage3D(GL_TEXTURE_2D_ARRAY, level, format_, width, height, layout_.pages, 0,
+                    page.format, GL_UNSIGNED_BYTE, NULL);
+            if (upload.compressed)
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, height, 1, format_, bytes, data);
+            else
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, height, 1, page.format,
+                    GL_UNSIGNED_BYTE, data);
+            width = std::max(width / 2, 1u);
+            height = std::max(height / 2, 1u);
+        }
+        gpu_bytes_ += imageBytes(upload);
+    }
+
+    // The borders do the wrapping, clamping keeps lookups in the page
+    setImageSampling(page, GL_TEXTURE_2D_ARRAY);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    build_ms_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+void TextureAtlas::destroy()
+{
+    if (texture_)
+        glDeleteTextures(1, &texture_);
+    texture_ = 0;
+    layout_.entries.clear();
+    layout_.pages = 0;
+    gpu_bytes_ = 0;
+}
+
+void TextureAtlas::report() const
+{
+    printf("texture atlas: %u images on %u %ux%u pages, %s, %u texel borders, %.1f%% packed, %u KB, built in %.1f ms\n",
+        (unsigned int)layout_.entries.size(), layout_.pages, layout_.page_width, layout_.page_height,
+        format_ == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT ? "BC1" : format_ == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT ? "BC3" : "uncompressed",
+        layout_.padding, layout_.efficiency * 100.0, (unsigned int)(gpu_bytes_ >> 10), build_ms_);
+}
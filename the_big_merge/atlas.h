@@ -0,0 +1,121 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "jobsystem.h"
+
+// Bottom-left skyline packer: the top edge of everything placed so far is
+// kept as a list of horizontal segments, and a rectangle goes where its
+// top ends lowest, on the narrowest segment when that ties.
+class SkylinePacker
+{
+public:
+	SkylinePacker();
+
+	void create(unsigned int width, unsigned int height);
+
+	// Position of a width x height rectangle, false if it doesn't fit
+	bool insert(unsigned int width, unsigned int height, unsigned int & x, unsigned int & y);
+
+	size_t usedArea() const { return used_area_; }
+
+private:
+	struct Segment
+	{
+		unsigned int x, y, width;
+	};
+
+	// Lowest y a rectangle starting at segment i can sit at, false if it
+	// runs past the right or top edge
+	bool fit(size_t i, unsigned int width, unsigned int height, unsigned int & y) const;
+
+	unsigned int width_, height_;
+	std::vector<Segment> skyline_;      // left to right, covering the width
+	size_t used_area_;
+};
+
+struct AtlasSettings
+{
+	unsigned int max_page_size;     // pages grow past it only for a bigger image
+	unsigned int levels;            // mip levels kept, they decide the padding
+	bool compress;                  // BC1 pages when the GL has S3TC
+};
+
+// Where an image ended up. rect is the image inside its page in texture
+// coordinates, offset in xy and scale in zw: page_uv = xy + uv * zw.
+struct AtlasEntry
+{
+	unsigned int layer;
+	unsigned int x, y;              // of the image in the page, in texels
+	unsigned int width, height;
+	glm::vec4 rect;
+};
+
+struct AtlasLayout
+{
+	unsigned int page_width, page_height;
+	unsigned int pages;
+	unsigned int padding;           // texels of wrapped border on every side
+	std::vector<AtlasEntry> entries;
+	double efficiency;              // image texels over page texels
+};
+
+// Packs images of the given sizes onto pages for an array texture. Every
+// image gets a border of 2^(levels - 1) texels and starts on a multiple of
+// that, so down to the last kept level its texels only ever average with
+// its own. Packing is tried on square pages of the smallest power of two
+// that holds everything on one, up to max_page_size, past which more
+// pages are used; the pages are then cut down to what is used. False if
+// an image is bigger than max_texture_size allows.
+bool packAtlas(const std::vector<glm::uvec2> & sizes, unsigned int max_page_size, unsigned int levels,
+	unsigned int max_texture_size, AtlasLayout & layout);
+
+// BMPs packed into the layers of one GL_TEXTURE_2D_ARRAY, so objects with
+// different textures draw with one bind. Borders repeat the image, the
+// shader wraps uvs with fract() into the entry's rect and samples with
+// the gradients of the unwrapped uvs. Mips are built on the CPU per page
+// and stop at settings.levels.
+class TextureAtlas
+{
+public:
+	TextureAtlas();
+	~TextureAtlas();
+
+	// Decodes the images on jobs if given and uploads the pages. Images
+	// that fail to load get the checker placeholder.
+	//
+	// Synchronous on the GL thread: every image must be decoded before
+	// packing, and the build is meant for startup, where the blits and
+	// compression spread over jobs and report() shows what it cost. Built
+	// at run time it would stall the frame for as long; pages would then
+	// have to be composed on the asset loaders and uploaded through the
+	// staging ring instead.
+	bool create(const std::vector<std::string> & paths, const AtlasSettings & settings,
+		JobSystem * jobs = NULL);
+	void destroy();
+
+	GLuint texture() const { return texture_; }
+
+	// Same order as the paths given to create
+	const AtlasEntry & entry(size_t i) const { return layout_.entries[i]; }
+	const AtlasLayout & layout() const { return layout_; }
+
+	void report() const;
+
+private:
+	TextureAtlas(const TextureAtlas &);
+	TextureAtlas & operator=(const TextureAtlas &);
+
+	GLuint texture_;
+	GLenum format_;
+	AtlasLayout layout_;
+	size_t gpu_bytes_;
+	double build_ms_;
+};
+
+#endif
@@ -0,0 +1,532 @@
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <immintrin.h>
+#include <chrono>
+#include <vector>
+
+#include "blockcompress.h"
+#include "meshcache.h"
+#include "mipmap.h"
+
+namespace {
+
+const unsigned int FOURCC_DXT1 = 0x31545844;
+const unsigned int FOURCC_DXT5 = 0x35545844;
+const unsigned int DDS_STAMP_MAGIC = 0x504d5453;    // "STMP", in the reserved header words
+
+const size_t BLOCK_ROW_GRAIN = 4;       // block rows per job
+
+// 16 texels of a block, structure of arrays for the SIMD kernels
+struct Block
+{
+    int r[16], g[16], b[16], a[16];
+};
+
+inline size_t rowBytes(unsigned int width, unsigned int channels)
+{
+    return (width * channels + 3) & ~(size_t)3;
+}
+
+inline unsigned int blockBytes(BlockFormat format)
+{
+    return format == BLOCK_BC1 ? 8 : 16;
+}
+
+// Texels past the edge of small or odd levels repeat the last row/column
+void loadBlock(const unsigned char * pixels, unsigned int width, unsigned int height,
+    unsigned int channels, unsigned int bx, unsigned int by, Block & block)
+{
+    size_t row_bytes = rowBytes(width, channels);
+    for (unsigned int y = 0; y < 4; y++) {
+        unsigned int sy = by * 4 + y < height ? by * 4 + y : height - 1;
+        for (unsigned int x = 0; x < 4; x++) {
+            unsigned int sx = bx * 4 + x < width ? bx * 4 + x : width - 1;
+            const unsigned char * p = pixels + row_bytes * sy + sx * channels;
+            int i = y * 4 + x;
+            block.b[i] = p[0];
+            block.g[i] = p[1];
+            block.r[i] = p[2];
+            block.a[i] = channels == 4 ? p[3] : 255;
+        }
+    }
+}
+
+inline unsigned short pack565(int r, int g, int b)
+{
+    return (unsigned short)((((r * 31 + 127) / 255) << 11) | (((g * 63 + 127) / 255) << 5) | ((b * 31 + 127) / 255));
+}
+
+inline void unpack565(unsigned short c, int rgb[3])
+{
+    int r = c >> 11, g = (c >> 5) & 63, b = c & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+// For every texel, how many of the three midpoints between the palette
+// stops 0, 1/3, 2/3, 1 along base -> base + length it lies past: the
+// projection is scaled by 6 so the midpoints are length, 3 length and
+// 5 length
+void selectStepsScalar(const Block & block, const int dir[3], int base, int length, int * steps)
+{
+    for (int i = 0; i < 16; i++) {
+        int t = (block.r[i] * dir[0] + block.g[i] * dir[1] + block.b[i] * dir[2] - base) * 6;
+        steps[i] = (t > length) + (t > 3 * length) + (t > 5 * length);
+    }
+}
+
+SIMD_TARGET_SSE41
+void selectStepsSse(const Block & block, const int dir[3], int base, int length, int * steps)
+{
+    __m128i dr = _mm_set1_epi32(dir[0]), dg = _mm_set1_epi32(dir[1]), db = _mm_set1_epi32(dir[2]);
+    __m128i b = _mm_set1_epi32(base), six = _mm_set1_epi32(6);
+    __m128i l1 = _mm_set1_epi32(length), l3 = _mm_set1_epi32(3 * length), l5 = _mm_set1_epi32(5 * length);
+    for (int i = 0; i < 16; i += 4) {
+        __m128i d = _mm_mullo_epi32(_mm_loadu_si128((const __m128i *)(block.r + i)), dr);
+        d = _mm_add_epi32(d, _mm_mullo_epi32(_mm_loadu_si128((const __m128i *)(block.g + i)), dg));
+        d = _mm_add_epi32(d, _mm_mullo_epi32(_mm_loadu_si128((const __m128i *)(block.b + i)), db));
+        __m128i t = _mm_mullo_epi32(_mm_sub_epi32(d, b), six);
+        // compares give -1 per midpoint passed
+        __m128i count = _mm_add_epi32(_mm_add_epi32(_mm_cmpgt_epi32(t, l1), _mm_cmpgt_epi32(t, l3)),
+            _mm_cmpgt_epi32(t, l5));
+        _mm_storeu_si128((__m128i *)(steps + i), _mm_sub_epi32(_mm_setzero_si128(), count));
+    }
+}
+
+SIMD_TARGET_AVX2
+void selectStepsAvx2(const Block & block, const int dir[3], int base, int length, int * steps)
+{
+    __m256i dr = _mm256_set1_epi32(dir[0]), dg = _mm256_set1_epi32(dir[1]), db = _mm256_set1_epi32(dir[2]);
+    __m256i b = _mm256_set1_epi32(base), six = _mm256_set1_epi32(6);
+    __m256i l1 = _mm256_set1_epi32(length), l3 = _mm256_set1_epi32(3 * length), l5 = _mm256_set1_epi32(5 * length);
+    for (int i = 0; i < 16; i += 8) {
+        __m256i d = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i *)(block.r + i)), dr);
+        d = _mm256_add_epi32(d, _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i *)(block.g + i)), dg));
+        d = _mm256_add_epi32(d, _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i *)(block.b + i)), db));
+        __m256i t = _mm256_mullo_epi32(_mm256_sub_epi32(d, b), six);
+        __m256i count = _mm256_add_epi32(_mm256_add_epi32(_mm256_cmpgt_epi32(t, l1), _mm256_cmpgt_epi32(t, l3)),
+            _mm256_cmpgt_epi32(t, l5));
+        _mm256_storeu_si256((__m256i *)(steps + i), _mm256_sub_epi32(_mm256_setzero_si256(), count));
+    }
+}
+
+typedef void (*SelectStepsFunction)(const Block & block, const int dir[3], int base, int length, int * steps);
+
+SelectStepsFunction selectStepsFunction(SimdLevel level)
+{
+    // 16 texels fill an AVX2 register pair, AVX-512 has nothing to add
+    if (level >= SIMD_AVX2)
+        return selectStepsAvx2;
+    if (level >= SIMD_SSE)
+        return selectStepsSse;
+    return selectStepsScalar;
+}
+
+// Indices of a block for two 565 endpoints in 4 color mode, and their
+// squared error
+unsigned int fitIndices(const Block & block, unsigned short c0, unsigned short c1,
+    SelectStepsFunction selectSteps, unsigned int & indices)
+{
+    static const unsigned int STEP_CODE[4] = { 0, 2, 3, 1 };
+    int p[4][3];
+    unpack565(c0, p[0]);
+    unpack565(c1, p[1]);
+    for (int c = 0; c < 3; c++) {
+        p[2][c] = (2 * p[0][c] + p[1][c]) / 3;
+        p[3][c] = (p[0][c] + 2 * p[1][c]) / 3;
+    }
+
+    int steps[16];
+    int dir[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+    int base = p[0][0] * dir[0] + p[0][1] * dir[1] + p[0][2] * dir[2];
+    int length = dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2];
+    if (length == 0)
+        memset(steps, 0, sizeof(steps));
+    else
+        selectSteps(block, dir, base, length, steps);
+
+    indices = 0;
+    unsigned int error = 0;
+    for (int i = 0; i < 16; i++) {
+        unsigned int code = STEP_CODE[steps[i]];
+        indices |= code << (i * 2);
+        int er = block.r[i] - p[code][0], eg = block.g[i] - p[code][1], eb = block.b[i] - p[code][2];
+        error += er * er + eg * eg + eb * eb;
+    }
+    return error;
+}
+
+inline int clampByte(float v)
+{
+    return v < 0.0f ? 0 : v > 255.0f ? 255 : (int)(v + 0.5f);
+}
+
+void encodeColorBlock(const Block & block, SelectStepsFunction selectSteps, unsigned char * out)
+{
+    // Principal axis of the colors by power iteration on their covariance
+    float mean[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; i++) {
+        mean[0] += block.r[i];
+        mean[1] += block.g[i];
+        mean[2] += block.b[i];
+    }
+    for (int c = 0; c < 3; c++)
+        mean[c] /= 16.0f;
+    float cov[6] = { 0, 0, 0, 0, 0, 0 };
+    for (int i = 0; i < 16; i++) {
+        float r = block.r[i] - mean[0], g = block.g[i] - mean[1], b = block.b[i] - mean[2];
+        cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+        cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+    }
+    float axis[3] = { 1.0f, 1.0f, 1.0f };
+    for (int iteration = 0; iteration < 4; iteration++) {
+        float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+        float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+        float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+        float scale = fabsf(x) > fabsf(y) ? fabsf(x) : fabsf(y);
+        scale = fabsf(z) > scale ? fabsf(z) : scale;
+        if (scale == 0.0f)
+            break;
+        axis[0] = x / scale;
+        axis[1] = y / scale;
+        axis[2] = z / scale;
+    }
+
+    // The texels furthest along it are the first endpoints
+    int lo = 0, hi = 0;
+    float lo_t = 1e30f, hi_t = -1e30f;
+    for (int i = 0; i < 16; i++) {
+        float t = block.r[i] * axis[0] + block.g[i] * axis[1] + block.b[i] * axis[2];
+        if (t < lo_t) { lo_t = t; lo = i; }
+        if (t > hi_t) { hi_t = t; hi = i; }
+    }
+    unsigned short c0 = pack565(block.r[hi], block.g[hi], block.b[hi]);
+    unsigned short c1 = pack565(block.r[lo], block.g[lo], block.b[lo]);
+    unsigned int indices;
+    unsigned int error = fitIndices(block, c0, c1, selectSteps, indices);
+
+    // One least squares pass for the endpoints that best fit those indices
+    static const float WEIGHT[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+    float aa = 0, ab = 0, bb = 0, ax[3] = { 0, 0, 0 }, bx[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; i++) {
+        float a = WEIGHT[(indices >> (i * 2)) & 3], b = 1.0f - a;
+        aa += a * a; ab += a * b; bb += b * b;
+        ax[0] += a * block.r[i]; ax[1] += a * block.g[i]; ax[2] += a * block.b[i];
+        bx[0] += b * block.r[i]; bx[1] += b * block.g[i]; bx[2] += b * block.b[i];
+    }
+    float det = aa * bb - ab * ab;
+    if (fabsf(det) > 1e-6f) {
+        int e0[3], e1[3];
+        for (int c = 0; c < 3; c++) {
+            e0[c] = clampByte((ax[c] * bb - bx[c] * ab) / det);
+            e1[c] = clampByte((bx[c] * aa - ax[c] * ab) / det);
+        }
+        unsigned short r0 = pack565(e0[0], e0[1], e0[2]), r1 = pack565(e1[0], e1[1], e1[2]);
+        unsigned int refined_indices;
+        unsigned int refined = fitIndices(block, r0, r1, selectSteps, refined_indices);
+        if (refined < error) {
+            c0 = r0;
+            c1 = r1;
+            indices = refined_indices;
+        }
+    }
+
+    // 4 color mode needs c0 > c1; swapping the endpoints swaps codes 0/1
+    // and 2/3. Equal endpoints decode index 0 the same in either mode.
+    if (c0 < c1) {
+        unsigned short t = c0;
+        c0 = c1;
+        c1 = t;
+        indices ^= 0x55555555;
+    }
+    else if (c0 == c1) {
+        indices = 0;
+    }
+    memcpy(out, &c0, 2);
+    memcpy(out + 2, &c1, 2);
+    memcpy(out + 4, &indices, 4);
+}
+
+// 8 interpolated alpha values between the block's extremes
+void encodeAlphaBlock(const Block & block, unsigned char * out)
+{
+    int a0 = 0, a1 = 255;
+    for (int i = 0; i < 16; i++) {
+        a0 = block.a[i] > a0 ? block.a[i] : a0;
+        a1 = block.a[i] < a1 ? block.a[i] : a1;
+    }
+    unsigned long long indices = 0;
+    if (a0 > a1) {
+        int values[8] = { a0, a1 };
+        for (int i = 1; i < 7; i++)
+            values[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+        for (int i = 0; i < 16; i++) {
+            int best = 0, best_error = 256;
+            for (int v = 0; v < 8; v++) {
+                int e = block.a[i] > values[v] ? block.a[i] - values[v] : values[v] - block.a[i];
+                if (e < best_error) { best_error = e; best = v; }
+            }
+            indices |= (unsigned long long)best << (i * 3);
+        }
+    }
+    out[0] = (unsigned char)a0;
+    out[1] = (unsigned char)a1;
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (unsigned char)(indices >> (i * 8));
+}
+
+void decodeColorBlock(const unsigned char * in, unsigned char rgb[16][3])
+{
+    unsigned short c0, c1;
+    unsigned int indices;
+    memcpy(&c0, in, 2);
+    memcpy(&c1, in + 2, 2);
+    memcpy(&indices, in + 4, 4);
+    int p[4][3];
+    unpack565(c0, p[0]);
+    unpack565(c1, p[1]);
+    for (int c = 0; c < 3; c++) {
+        if (c0 > c1) {
+            p[2][c] = (2 * p[0][c] + p[1][c]) / 3;
+            p[3][c] = (p[0][c] + 2 * p[1][c]) / 3;
+        }
+        else {
+            p[2][c] = (p[0][c] + p[1][c]) / 2;
+            p[3][c] = 0;
+        }
+    }
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++)
+            rgb[i][c] = (unsigned char)p[(indices >> (i * 2)) & 3][c];
+}
+
+struct DDSStamp
+{
+    unsigned int magic;
+    unsigned int size_low, size_high;
+    unsigned int mtime_low, mtime_high;
+    unsigned int hash_low, hash_high;
+};
+
+bool readDDSStamp(const char * path, DDSStamp & stamp)
+{
+    unsigned char header[128];
+    FILE * file = fopen(path, "rb");
+    if (!file)
+        return false;
+    bool read = fread(header, 1, 128, file) == 128;
+    fclose(file);
+    if (!read || memcmp(header, "DDS ", 4) != 0)
+        return false;
+    memcpy(&stamp, header + 4 + 28, sizeof(stamp));
+    return stamp.magic == DDS_STAMP_MAGIC;
+}
+
+bool stampMatches(const char * cache_path, const char * source_path)
+{
+    // Same check as the mesh cache: size and mtime, hash when mtime moved
+    DDSStamp stamp;
+    unsigned long long size;
+    long long mtime;
+    if (!readDDSStamp(cache_path, stamp) || !statFile(source_path, size, mtime))
+        return false;
+    if (size != ((unsigned long long)stamp.size_high << 32 | stamp.size_low))
+        return false;
+    if ((unsigned long long)mtime == ((unsigned long long)stamp.mtime_high << 32 | stamp.mtime_low))
+        return true;
+    unsigned long long hash;
+    if (!hashFile(source_path, hash) || hash != ((unsigned long long)stamp.hash_high << 32 | stamp.hash_low))
+        return false;
+    // Same content, new mtime: store it so the next start doesn't hash again
+    stamp.mtime_low = (unsigned int)mtime;
+    stamp.mtime_high = (unsigned int)((unsigned long long)mtime >> 32);
+    patchFile(cache_path, 4 + 28 + offsetof(DDSStamp, mtime_low), &stamp.mtime_low, 2 * sizeof(unsigned int));
+    return true;
+}
+
+} // namespace
+
+bool compressImage(const ImageData & source, BlockFormat format, ImageData & out,
+    JobSystem * jobs, SimdLevel level)
+{
+    if (source.compressed || (source.format != GL_BGR && source.format != GL_BGRA) || source.levels.empty())
+        return false;
+    unsigned int channels = source.format == GL_BGRA ? 4 : 3;
+    unsigned int block_bytes = blockBytes(format);
+
+    // Every block row of every level is one item of work
+    struct BlockRow
+    {
+        unsigned int level, row;
+    };
+    std::vector<BlockRow> rows;
+    out.width = source.width;
+    out.height = source.height;
+    out.format = format == BLOCK_BC1 ? GL_COMPRESSED_RGBA_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    out.compressed = true;
+    out.levels.clear();
+    size_t total = 0;
+    unsigned int width = source.width, height = source.height;
+    for (unsigned int l = 0; l < source.levels.size(); l++) {
+        ImageLevel level_range;
+        level_range.offset = total;
+        level_range.size = (size_t)((width + 3) / 4) * ((height + 3) / 4) * block_bytes;
+        out.levels.push_back(level_range);
+        total += level_range.size;
+        for (unsigned int row = 0; row < (height + 3) / 4; row++) {
+            BlockRow r = { l, row };
+            rows.push_back(r);
+        }
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    out.pixels.resize(total);
+    out.file.reset();
+    out.mapped = NULL;
+
+    SelectStepsFunction selectSteps = selectStepsFunction(level);
+    RangeFunction encodeRows = [&](size_t begin, size_t end) {
+        Block block;
+        for (size_t i = begin; i < end; i++) {
+            unsigned int l = rows[i].level;
+            unsigned int w = source.width >> l ? source.width >> l : 1;
+            unsigned int h = source.height >> l ? source.height >> l : 1;
+            const unsigned char * pixels = imagePixels(source) + source.levels[l].offset;
+            unsigned int blocks_wide = (w + 3) / 4;
+            unsigned char * dest = &out.pixels[out.levels[l].offset + (size_t)rows[i].row * blocks_wide * block_bytes];
+            for (unsigned int bx = 0; bx < blocks_wide; bx++, dest += block_bytes) {
+                loadBlock(pixels, w, h, channels, bx, rows[i].row, block);
+                if (format == BLOCK_BC3) {
+                    encodeAlphaBlock(block, dest);
+                    encodeColorBlock(block, selectSteps, dest + 8);
+                }
+                else {
+                    encodeColorBlock(block, selectSteps, dest);
+                }
+            }
+        }
+    };
+    if (jobs)
+        jobs->parallelFor(rows.size(), BLOCK_ROW_GRAIN, encodeRows);
+    else
+        encodeRows(0, rows.size());
+    return true;
+}
+
+double compressionPsnr(const ImageData & source, const ImageData & compressed)
+{
+    unsigned int channels = source.format == GL_BGRA ? 4 : 3;
+    unsigned int block_bytes = compressed.format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT ? 8 : 16;
+    unsigned int color_offset = block_bytes - 8;
+    unsigned int width = source.width, height = source.height;
+    const unsigned char * pixels = imagePixels(source) + source.levels[0].offset;
+    const unsigned char * blocks = imagePixels(compressed) + compressed.levels[0].offset;
+    double error = 0.0;
+    unsigned char rgb[16][3];
+    for (unsigned int by = 0; by < (height + 3) / 4; by++) {
+        for (unsigned int bx = 0; bx < (width + 3) / 4; bx++, blocks += block_bytes) {
+            decodeColorBlock(blocks + color_offset, rgb);
+            for (unsigned int y = 0; y < 4 && by * 4 + y < height; y++) {
+                for (unsigned int x = 0; x < 4 && bx * 4 + x < width; x++) {
+                    const unsigned char * p = pixels + rowBytes(width, channels) * (by * 4 + y) + (bx * 4 + x) * channels;
+                    // source is b, g, r
+                    for (int c = 0; c < 3; c++) {
+                        double d = (double)p[2 - c] - rgb[y * 4 + x][c];
+                        error += d * d;
+                    }
+                }
+            }
+        }
+    }
+    double mse = error / ((double)width * height * 3);
+    return mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+bool writeDDS(const char * path, const ImageData & image, const char * source_path)
+{
+    if (!image.compressed || image.levels.empty())
+        return false;
+
+    unsigned int header[31];
+    memset(header, 0, sizeof(header));
+    header[0] = 124;                                // size
+    header[1] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000;  // caps, height, width, pixel format, mip count, linear size
+    header[2] = image.height;
+    header[3] = image.width;
+    header[4] = (unsigned int)image.levels[0].size;
+    header[6] = (unsigned int)image.levels.size();
+
+    DDSStamp stamp;
+    unsigned long long size, hash;
+    long long mtime;
+    if (!statFile(source_path, size, mtime) || !hashFile(source_path, hash))
+        return false;
+    stamp.magic = DDS_STAMP_MAGIC;
+    stamp.size_low = (unsigned int)size;
+    stamp.size_high = (unsigned int)(size >> 32);
+    stamp.mtime_low = (unsigned int)mtime;
+    stamp.mtime_high = (unsigned int)((unsigned long long)mtime >> 32);
+    stamp.hash_low = (unsigned int)hash;
+    stamp.hash_high = (unsigned int)(hash >> 32);
+    memcpy(&header[7], &stamp, sizeof(stamp));
+
+    header[18] = 32;                                // pixel format size
+    header[19] = 0x4;                               // fourCC
+    header[20] = image.format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT ? FOURCC_DXT1 : FOURCC_DXT5;
+    header[26] = 0x1000 | 0x8 | 0x400000;           // texture, complex, mipmap
+
+    // Through a temporary file, so a crash or a second writer never leaves
+    // a half written cache with a valid stamp behind
+    std::string temp_path = tempPath(path);
+    FILE * file = fopen(temp_path.c_str(), "wb");
+    if (!file) {
+        printf("%s could not be written\n", path);
+        return false;
+    }
+    bool written = fwrite("DDS ", 1, 4, file) == 4
+        && fwrite(header, sizeof(header), 1, file) == 1
+        && fwrite(imagePixels(image), 1, imageBytes(image), file) == imageBytes(image);
+    written = fclose(file) == 0 && written;
+
+    written = written && replaceFile(temp_path.c_str(), path);
+    if (!written) {
+        remove(temp_path.c_str());
+        printf("%s could not be written\n", path);
+    }
+    return written;
+}
+
+bool decodeBMPCompressed(const char * path, BlockFormat format, ImageData & image, JobSystem * jobs)
+{
+    std::string cache_path = textureCachePath(path);
+    if (stampMatches(cache_path.c_str(), path) && decodeDDS(cache_path.c_str(), image))
+        return true;
+
+    ImageData source;
+    if (!decodeBMP(path, source))
+        return false;
+    generateMipmaps(source);
+    if (source.format == GL_BGRA)
+        format = BLOCK_BC3;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (!compressImage(source, format, image, jobs))
+        return false;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%s: %s, %u levels, %.1f MB/s on %u threads, PSNR %.2f dB, %u KB -> %u KB\n", path,
+        format == BLOCK_BC1 ? "BC1" : "BC3", (unsigned int)image.levels.size(),
+        imageBytes(source) / seconds / 1e6, jobs ? jobs->threadCount() : 1,
+        compressionPsnr(source, image), (unsigned int)(imageBytes(source) >> 10),
+        (unsigned int)(imageBytes(image) >> 10));
+    writeDDS(cache_path.c_str(), image, path);
+    return true;
+}
+
+std::string textureCachePath(const char * source_path)
+{
+    return std::string(source_path) + ".dds";
+}
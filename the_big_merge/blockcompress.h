@@ -0,0 +1,44 @@
+#ifndef BLOCKCOMPRESS_H
+#define BLOCKCOMPRESS_H
+
+#include <string>
+
+#include "cpufeatures.h"
+#include "jobsystem.h"
+#include "texture.h"
+
+enum BlockFormat
+{
+	BLOCK_BC1,      // DXT1, 4 bpp, opaque
+	BLOCK_BC3       // DXT5, 8 bpp, BC1 colors plus interpolated alpha
+};
+
+// Compresses every level of an uncompressed GL_BGR or GL_BGRA image into
+// 4x4 blocks. Endpoints come from the principal axis of each block and
+// are refined once by least squares; indices are picked with the SIMD
+// level given. Block rows are spread over jobs when given. BGR sources
+// get opaque alpha in BC3. Rows keep their order, so a BMP compresses to
+// bottom-up blocks and needs no flipped UVs.
+bool compressImage(const ImageData & source, BlockFormat format, ImageData & out,
+	JobSystem * jobs = NULL, SimdLevel level = simdLevel());
+
+// PSNR in dB of the color channels of level 0 of a compressed image
+// against the uncompressed source
+double compressionPsnr(const ImageData & source, const ImageData & compressed);
+
+// Writes a DDS file, stamped with the size, mtime and content hash of
+// source_path so it can be used as a cache of it
+bool writeDDS(const char * path, const ImageData & image, const char * source_path);
+
+// Compressed copy of a BMP, with mips, cached next to it in a DDS file.
+// The cache is used while its stamp matches the BMP, otherwise the BMP
+// is decoded, mipmapped, compressed and the cache rewritten; prints the
+// encode rate and PSNR when it does. BMPs with alpha are always BC3.
+// jobs only from a thread that works for it, its owner or a worker.
+bool decodeBMPCompressed(const char * path, BlockFormat format, ImageData & image,
+	JobSystem * jobs = NULL);
+
+// Cache file used for a source image
+std::string textureCachePath(const char * source_path);
+
+#endif
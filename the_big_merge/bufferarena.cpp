@@ -0,0 +1,211 @@
+#include <stdio.h>
+
+#include <algorithm>
+
+#include "bufferarena.h"
+
+namespace {
+
+// Replaces buffer by one of new_bytes holding the first old_bytes of it
+GLuint resizeBuffer(GLuint buffer, size_t old_bytes, size_t new_bytes)
+{
+    GLuint resized;
+    glGenBuffers(1, &resized);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, resized);
+    glBufferData(GL_COPY_WRITE_BUFFER, new_bytes, NULL, GL_STATIC_DRAW);
+    if (buffer != 0 && old_bytes > 0) {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, old_bytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    if (buffer != 0)
+        glDeleteBuffers(1, &buffer);
+    return resized;
+}
+
+} // namespace
+
+size_t indexTypeSize(GLenum index_type)
+{
+    switch (index_type) {
+    case GL_UNSIGNED_BYTE: return 1;
+    case GL_UNSIGNED_SHORT: return 2;
+    default: return 4;
+    }
+}
+
+BufferArena::BufferArena()
+    : layout_(NULL), program_id_(0), vao_(0), vertex_buffer_(0), index_buffer_(0)
+{
+}
+
+bool BufferArena::create(const VertexLayout & layout, GLuint program_id,
+    size_t vertex_capacity, size_t index_capacity)
+{
+    destroy();
+    layout_ = &layout;
+    program_id_ = program_id;
+    vertex_capacity = std::max(vertex_capacity, (size_t)1);
+    index_capacity = std::max(index_capacity, (size_t)4);
+
+    vertex_buffer_ = resizeBuffer(0, 0, vertex_capacity * layout.stride);
+    index_buffer_ = resizeBuffer(0, 0, index_capacity);
+    vertices_.reset(vertex_capacity);
+    indices_.reset(index_capacity);
+
+    glGenVertexArrays(1, &vao_);
+    bindVao(vao_, program_id_);
+    return vao_ != 0 && vertex_buffer_ != 0 && index_buffer_ != 0;
+}
+
+void BufferArena::destroy()
+{
+    if (vao_)
+        glDeleteVertexArrays(1, &vao_);
+    if (!extra_vaos_.empty())
+        glDeleteVertexArrays((GLsizei)extra_vaos_.size(), &extra_vaos_[0]);
+    extra_vaos_.clear();
+    extra_programs_.clear();
+    if (vertex_buffer_)
+        glDeleteBuffers(1, &vertex_buffer_);
+    if (index_buffer_)
+        glDeleteBuffers(1, &index_buffer_);
+    vao_ = vertex_buffer_ = index_buffer_ = 0;
+    vertices_.reset(0);
+    indices_.reset(0);
+}
+
+bool BufferArena::allocate(size_t vertex_count, size_t index_count, GLenum index_type, ArenaRange & range)
+{
+    size_t index_size = indexTypeSize(index_type);
+    size_t index_bytes = index_count * index_size;
+
+    size_t base_vertex = vertices_.allocate(vertex_count);
+    if (base_vertex == OffsetAllocator::invalid_offset) {
+        if (!growVertices(vertex_count))
+            return false;
+        base_vertex = vertices_.allocate(vertex_count);
+    }
+    size_t index_offset = indices_.allocate(index_bytes, index_size);
+    if (index_offset == OffsetAllocator::invalid_offset) {
+        if (growIndices(index_bytes + index_size))
+            index_offset = indices_.allocate(index_bytes, index_size);
+    }
+    if (base_vertex == OffsetAllocator::invalid_offset || index_offset == OffsetAllocator::invalid_offset) {
+        if (base_vertex != OffsetAllocator::invalid_offset)
+            vertices_.free(base_vertex);
+        printf("buffer arena: out of memory for %u vertices, %u indices\n",
+            (unsigned int)vertex_count, (unsigned int)index_count);
+        return false;
+    }
+
+    range.base_vertex = (unsigned int)base_vertex;
+    range.vertex_count = (unsigned int)vertex_count;
+    range.index_offset = index_offset;
+    range.index_count = (unsigned int)index_count;
+    range.index_type = index_type;
+    return true;
+}
+
+void BufferArena::free(const ArenaRange & range)
+{
+    vertices_.free(range.base_vertex);
+    indices_.free(range.index_offset);
+}
+
+void BufferArena::upload(const ArenaRange & range, const void * vertices, const void * indices)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+    glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)range.base_vertex * layout_->stride,
+        (GLsizeiptr)range.vertex_count * layout_->stride, vertices);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // Through the copy target so the element binding of whatever vao is
+    // bound stays untouched
+    glBindBuffer(GL_COPY_WRITE_BUFFER, index_buffer_);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)range.index_offset,
+        (GLsizeiptr)(range.index_count * indexTypeSize(range.index_type)), indices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void BufferArena::copyFrom(const ArenaRange & range, GLuint source, size_t vertex_offset, size_t index_offset)
+{
+    glBindBuffer(GL_COPY_READ_BUFFER, source);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vertex_buffer_);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)vertex_offset,
+        (GLintptr)range.base_vertex * layout_->stride, (GLsizeiptr)range.vertex_count * layout_->stride);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, index_buffer_);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)index_offset,
+        (GLintptr)range.index_offset, (GLsizeiptr)(range.index_count * indexTypeSize(range.index_type)));
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+const void * BufferArena::indexPointer(const ArenaRange & range, unsigned int first_index) const
+{
+    return (const void *)(range.index_offset + first_index * indexTypeSize(range.index_type));
+}
+
+void BufferArena::report(const char * name) const
+{
+    OffsetAllocatorStats v = vertices_.stats();
+    OffsetAllocatorStats i = indices_.stats();
+    printf("%s arena: %u meshes, vertices %u/%u (%u free blocks, %.1f%% fragmented), "
+        "index bytes %u/%u (%u free blocks, %.1f%% fragmented)\n", name,
+        (unsigned int)v.allocations, (unsigned int)v.used, (unsigned int)v.capacity,
+        (unsigned int)v.free_blocks, v.fragmentation * 100.0f,
+        (unsigned int)i.used, (unsigned int)i.capacity,
+        (unsigned int)i.free_blocks, i.fragmentation * 100.0f);
+}
+
+bool BufferArena::growVertices(size_t needed)
+{
+    size_t capacity = vertices_.capacity();
+    size_t grown = std::max(capacity * 2, capacity + needed);
+    vertex_buffer_ = resizeBuffer(vertex_buffer_, capacity * layout_->stride, grown * layout_->stride);
+    if (vertex_buffer_ == 0)
+        return false;
+    vertices_.grow(grown);
+    bindVaos();
+    return true;
+}
+
+bool BufferArena::growIndices(size_t needed)
+{
+    size_t capacity = indices_.capacity();
+    size_t grown = std::max(capacity * 2, capacity + needed);
+    index_buffer_ = resizeBuffer(index_buffer_, capacity, grown);
+    if (index_buffer_ == 0)
+        return false;
+    indices_.grow(grown);
+    bindVaos();
+    return true;
+}
+
+GLuint BufferArena::addVao(GLuint program_id)
+{
+    GLuint vao;
+    glGenVertexArrays(1, &vao);
+    bindVao(vao, program_id);
+    extra_vaos_.push_back(vao);
+    extra_programs_.push_back(program_id);
+    return vao;
+}
+
+void BufferArena::bindVaos()
+{
+    bindVao(vao_, program_id_);
+    for (size_t i = 0; i < extra_vaos_.size(); i++)
+        bindVao(extra_vaos_[i], extra_programs_[i]);
+}
+
+void BufferArena::bindVao(GLuint vao, GLuint program_id)
+{
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+    bindVertexLayout(*layout_, program_id);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+    glBindVertexArray(0);
+}
@@ -0,0 +1,88 @@
+#ifndef BUFFERARENA_H
+#define BUFFERARENA_H
+
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "offsetallocator.h"
+#include "vertexformat.h"
+
+// Where a mesh lives inside a BufferArena. Indices are relative to
+// base_vertex, so 16 and 32 bit index ranges can share one index buffer.
+struct ArenaRange
+{
+	unsigned int base_vertex;
+	unsigned int vertex_count;
+	size_t index_offset;        // in bytes
+	unsigned int index_count;
+	GLenum index_type;
+};
+
+// One vertex buffer and one index buffer shared by all meshes of a vertex
+// layout, with a single vao. Meshes are sub-allocated with OffsetAllocators
+// (vertices in units of the layout stride, indices in bytes) and drawn with
+// glDrawElementsBaseVertex, so switching meshes needs no rebinding.
+// The buffers double in size when an allocation doesn't fit.
+class BufferArena
+{
+public:
+	BufferArena();
+
+	bool create(const VertexLayout & layout, GLuint program_id,
+		size_t vertex_capacity, size_t index_capacity);
+	void destroy();
+
+	bool allocate(size_t vertex_count, size_t index_count, GLenum index_type, ArenaRange & range);
+	void free(const ArenaRange & range);
+
+	// Copies a mesh into its range; vertices are packed in the layout,
+	// indices of range.index_type
+	void upload(const ArenaRange & range, const void * vertices, const void * indices);
+
+	// Same, but copied on the GPU from another buffer, e.g. a staging
+	// buffer, at the given byte offsets
+	void copyFrom(const ArenaRange & range, GLuint source, size_t vertex_offset, size_t index_offset);
+
+	GLuint vao() const { return vao_; }
+
+	// Another vao over the same buffers, with the attribute locations of
+	// a different program. Kept valid when the buffers grow.
+	GLuint addVao(GLuint program_id);
+
+	GLuint vertexBuffer() const { return vertex_buffer_; }
+	GLuint indexBuffer() const { return index_buffer_; }
+	const VertexLayout & layout() const { return *layout_; }
+
+	// Offset argument of glDrawElementsBaseVertex for first_index of a range
+	const void * indexPointer(const ArenaRange & range, unsigned int first_index) const;
+
+	OffsetAllocatorStats vertexStats() const { return vertices_.stats(); }
+	OffsetAllocatorStats indexStats() const { return indices_.stats(); }
+
+	// Prints usage and fragmentation of both buffers
+	void report(const char * name) const;
+
+private:
+	BufferArena(const BufferArena &);
+	BufferArena & operator=(const BufferArena &);
+
+	bool growVertices(size_t needed);
+	bool growIndices(size_t needed);
+	void bindVaos();
+	void bindVao(GLuint vao, GLuint program_id);
+
+	const VertexLayout * layout_;
+	GLuint program_id_;
+	GLuint vao_;
+	std::vector<GLuint> extra_vaos_;
+	std::vector<GLuint> extra_programs_;
+	GLuint vertex_buffer_;
+	GLuint index_buffer_;
+	OffsetAllocator vertices_;
+	OffsetAllocator indices_;
+};
+
+size_t indexTypeSize(GLenum index_type);
+
+#endif
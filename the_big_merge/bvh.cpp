@@ -0,0 +1,384 @@
+#include <math.h>
+
+#include <algorithm>
+
+#include "bvh.h"
+
+namespace {
+
+// Traversal stacks hold max_depth * 2 nodes; subtrees below that are
+// finished by testing their objects one by one. BVH_MAX_DEPTH is only set
+// by the tests, to reach that path with small trees.
+#ifndef BVH_MAX_DEPTH
+#define BVH_MAX_DEPTH 64
+#endif
+
+const unsigned int bin_count = 16;
+const unsigned int max_depth = BVH_MAX_DEPTH;
+
+// Half the surface area of a box, enough for the heuristic's ratios
+inline float halfArea(const glm::vec3 & bounds_min, const glm::vec3 & bounds_max)
+{
+    glm::vec3 d = glm::max(bounds_max - bounds_min, glm::vec3(0.0f));
+    return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+struct Bin
+{
+    glm::vec3 bounds_min, bounds_max;
+    unsigned int count;
+};
+
+// -1 outside, 0 intersecting, 1 inside
+inline int classifyBox(const Frustum & frustum, const glm::vec3 & bounds_min, const glm::vec3 & bounds_max)
+{
+    glm::vec3 center = (bounds_min + bounds_max) * 0.5f;
+    glm::vec3 extents = (bounds_max - bounds_min) * 0.5f;
+    int result = 1;
+    for (int p = 0; p < 6; p++) {
+        const float * plane = frustum.planes[p];
+        float distance = plane[0] * center.x + plane[1] * center.y + plane[2] * center.z + plane[3];
+        float radius = fabsf(plane[0]) * extents.x + fabsf(plane[1]) * extents.y + fabsf(plane[2]) * extents.z;
+        if (distance < -radius)
+            return -1;
+        if (distance < radius)
+            result = 0;
+    }
+    return result;
+}
+
+// Slab test, returns the entry distance or a negative value on a miss
+inline float intersectBox(const glm::vec3 & origin, const glm::vec3 & inverse_direction, float max_distance,
+    const glm::vec3 & bounds_min, const glm::vec3 & bounds_max)
+{
+    float near_t = 0.0f, far_t = max_distance;
+    for (int axis = 0; axis < 3; axis++) {
+        float t0 = (bounds_min[axis] - origin[axis]) * inverse_direction[axis];
+        float t1 = (bounds_max[axis] - origin[axis]) * inverse_direction[axis];
+        if (t0 > t1)
+            std::swap(t0, t1);
+        near_t = std::max(near_t, t0);
+        far_t = std::min(far_t, t1);
+    }
+    return near_t <= far_t ? near_t : -1.0f;
+}
+
+} // namespace
+
+struct Bvh::BuildObject
+{
+    glm::vec3 bounds_min, bounds_max;
+    glm::vec3 centroid;
+    unsigned int index;
+};
+
+void Bvh::build(const CullTable & bounds)
+{
+    size_t count = bounds.size();
+    std::vector<BuildObject> objects(count);
+    for (size_t i = 0; i < count; i++) {
+        glm::vec3 center(bounds.x[i], bounds.y[i], bounds.z[i]);
+        glm::vec3 extents(bounds.ex[i], bounds.ey[i], bounds.ez[i]);
+        objects[i].bounds_min = center - extents;
+        objects[i].bounds_max = center + extents;
+        objects[i].centroid = center;
+        objects[i].index = (unsigned int)i;
+    }
+
+    nodes_.clear();
+    nodes_.reserve(count * 2);
+    BvhNode root;
+    root.left = 0;
+    root.first = 0;
+    root.count = (unsigned int)count;
+    root.bounds_min = glm::vec3(INFINITY);
+    root.bounds_max = glm::vec3(-INFINITY);
+    for (size_t i = 0; i < count; i++) {
+        root.bounds_min = glm::min(root.bounds_min, objects[i].bounds_min);
+        root.bounds_max = glm::max(root.bounds_max, objects[i].bounds_max);
+    }
+    nodes_.push_back(root);
+
+    // Children always come after their parent, refit relies on that
+    std::vector<unsigned int> stack(1, 0);
+    while (!stack.empty()) {
+        unsigned int node = stack.back();
+        stack.pop_back();
+        unsigned int left = split(node, objects);
+        if (left) {
+            stack.push_back(left);
+            stack.push_back(left + 1);
+        }
+    }
+
+    objects_.resize(count);
+    object_min_.resize(count);
+    object_max_.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        objects_[i] = objects[i].index;
+        object_min_[i] = objects[i].bounds_min;
+        object_max_[i] = objects[i].bounds_max;
+    }
+    built_cost_ = sahCost();
+}
+
+unsigned int Bvh::split(unsigned int node, std::vector<BuildObject> & objects)
+{
+    unsigned int first = nodes_[node].first, count = nodes_[node].count;
+    if (count <= 1)
+        return 0;
+
+    glm::vec3 centroid_min = objects[first].centroid, centroid_max = centroid_min;
+    for (unsigned int i = first; i < first + count; i++) {
+        centroid_min = glm::min(centroid_min, objects[i].centroid);
+        centroid_max = glm::max(centroid_max, objects[i].centroid);
+    }
+
+    // Binned SAH over all three axes
+    float best_cost = INFINITY;
+    int best_axis = -1;
+    unsigned int best_split = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        float extent = centroid_max[axis] - centroid_min[axis];
+        if (extent <= 0.0f)
+            continue;
+        float scale = bin_count / extent;
+
+        Bin bins[bin_count];
+        for (unsigned int b = 0; b < bin_count; b++) {
+            bins[b].bounds_min = glm::vec3(INFINITY);
+            bins[b].bounds_max = glm::vec3(-INFINITY);
+            bins[b].count = 0;
+        }
+        for (unsigned int i = first; i < first + count; i++) {
+            const BuildObject & object = objects[i];
+            unsigned int b = std::min((unsigned int)((object.centroid[axis] - centroid_min[axis]) * scale), bin_count - 1);
+            bins[b].bounds_min = glm::min(bins[b].bounds_min, object.bounds_min);
+            bins[b].bounds_max = glm::max(bins[b].bounds_max, object.bounds_max);
+            bins[b].count++;
+        }
+
+        // Sweep from the right to get the cost of each right side
+        float right_area[bin_count];
+        unsigned int right_count[bin_count];
+        glm::vec3 sweep_min(INFINITY), sweep_max(-INFINITY);
+        unsigned int sweep_count = 0;
+        for (unsigned int b = bin_count - 1; b > 0; b--) {
+            sweep_min = glm::min(sweep_min, bins[b].bounds_min);
+            sweep_max = glm::max(sweep_max, bins[b].bounds_max);
+            sweep_count += bins[b].count;
+            right_area[b] = halfArea(sweep_min, sweep_max);
+            right_count[b] = sweep_count;
+        }
+        sweep_min = glm::vec3(INFINITY);
+        sweep_max = glm::vec3(-INFINITY);
+        sweep_count = 0;
+        for (unsigned int b = 1; b < bin_count; b++) {
+            sweep_min = glm::min(sweep_min, bins[b - 1].bounds_min);
+            sweep_max = glm::max(sweep_max, bins[b - 1].bounds_max);
+            sweep_count += bins[b - 1].count;
+            if (sweep_count == 0 || right_count[b] == 0)
+                continue;
+            float cost = halfArea(sweep_min, sweep_max) * sweep_count + right_area[b] * right_count[b];
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_split = b;
+            }
+        }
+    }
+
+    // Stay a leaf when splitting doesn't pay for the extra node visit
+    float area = halfArea(nodes_[node].bounds_min, nodes_[node].bounds_max);
+    float leaf_cost = area * count;
+    if (count <= max_leaf_size && (best_axis < 0 || area + best_cost >= leaf_cost))
+        return 0;
+
+    unsigned int middle;
+    if (best_axis >= 0) {
+        float scale = bin_count / (centroid_max[best_axis] - centroid_min[best_axis]);
+        float offset = centroid_min[best_axis];
+        BuildObject * split_point = std::partition(&objects[first], &objects[first] + count,
+            [&](const BuildObject & object) {
+                unsigned int b = std::min((unsigned int)((object.centroid[best_axis] - offset) * scale), bin_count - 1);
+                return b < best_split;
+            });
+        middle = (unsigned int)(split_point - &objects[0]);
+    }
+    else {
+        // All centroids coincide, split the range in half
+        middle = first + count / 2;
+    }
+    if (middle == first || middle == first + count)
+        middle = first + count / 2;
+
+    unsigned int left = (unsigned int)nodes_.size();
+    BvhNode child;
+    child.left = 0;
+    child.first = first;
+    child.count = middle - first;
+    nodes_.push_back(child);
+    child.first = middle;
+    child.count = first + count - middle;
+    nodes_.push_back(child);
+    nodes_[node].left = left;
+    for (unsigned int c = left; c < left + 2; c++) {
+        BvhNode & n = nodes_[c];
+        n.bounds_min = glm::vec3(INFINITY);
+        n.bounds_max = glm::vec3(-INFINITY);
+        for (unsigned int i = n.first; i < n.first + n.count; i++) {
+            n.bounds_min = glm::min(n.bounds_min, objects[i].bounds_min);
+            n.bounds_max = glm::max(n.bounds_max, objects[i].bounds_max);
+        }
+    }
+    return left;
+}
+
+void Bvh::updateBounds(unsigned int node)
+{
+    BvhNode & n = nodes_[node];
+    if (n.left) {
+        n.bounds_min = glm::min(nodes_[n.left].bounds_min, nodes_[n.left + 1].bounds_min);
+        n.bounds_max = glm::max(nodes_[n.left].bounds_max, nodes_[n.left + 1].bounds_max);
+        return;
+    }
+    n.bounds_min = glm::vec3(INFINITY);
+    n.bounds_max = glm::vec3(-INFINITY);
+    for (unsigned int i = n.first; i < n.first + n.count; i++) {
+        n.bounds_min = glm::min(n.bounds_min, object_min_[i]);
+        n.bounds_max = glm::max(n.bounds_max, object_max_[i]);
+    }
+}
+
+void Bvh::refit(const CullTable & bounds)
+{
+    if (bounds.size() != object_min_.size()) {
+        build(bounds);
+        return;
+    }
+    for (size_t i = 0; i < objects_.size(); i++) {
+        unsigned int object = objects_[i];
+        glm::vec3 center(bounds.x[object], bounds.y[object], bounds.z[object]);
+        glm::vec3 extents(bounds.ex[object], bounds.ey[object], bounds.ez[object]);
+        object_min_[i] = center - extents;
+        object_max_[i] = center + extents;
+    }
+    for (size_t node = nodes_.size(); node > 0; node--)
+        updateBounds((unsigned int)node - 1);
+}
+
+float Bvh::sahCost() const
+{
+    if (nodes_.empty())
+        return 0.0f;
+    float root_area = halfArea(nodes_[0].bounds_min, nodes_[0].bounds_max);
+    if (root_area <= 0.0f)
+        return 0.0f;
+    float cost = 0.0f;
+    for (size_t i = 0; i < nodes_.size(); i++) {
+        float area = halfArea(nodes_[i].bounds_min, nodes_[i].bounds_max);
+        cost += nodes_[i].left ? area : area * nodes_[i].count;
+    }
+    return cost / root_area;
+}
+
+bool Bvh::needsRebuild() const
+{
+    return sahCost() > built_cost_ * 1.5f;
+}
+
+size_t Bvh::cullFrustum(const Frustum & frustum, std::vector<unsigned int> & visible) const
+{
+    visible.clear();
+    if (objects_.empty())
+        return 0;
+
+    unsigned int stack[max_depth * 2];
+    unsigned int size = 0;
+    stack[size++] = 0;
+    while (size) {
+        const BvhNode & node = nodes_[stack[--size]];
+        int side = classifyBox(frustum, node.bounds_min, node.bounds_max);
+        if (side < 0)
+            continue;
+        if (side > 0) {
+            visible.insert(visible.end(), &objects_[node.first], &objects_[node.first] + node.count);
+            continue;
+        }
+        if (node.left && size + 2 <= max_depth * 2) {
+            stack[size++] = node.left;
+            stack[size++] = node.left + 1;
+            continue;
+        }
+        for (unsigned int i = node.first; i < node.first + node.count; i++) {
+            if (classifyBox(frustum, object_min_[i], object_max_[i]) >= 0)
+                visible.push_back(objects_[i]);
+        }
+    }
+    return visible.size();
+}
+
+int Bvh::raycast(const glm::vec3 & origin, const glm::vec3 & direction,
+    float max_distance, float & distance) const
+{
+    if (objects_.empty())
+        return -1;
+
+    glm::vec3 inverse_direction(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+    int best = -1;
+    float best_t = max_distance;
+
+    unsigned int stack[max_depth * 2];
+    unsigned int size = 0;
+    stack[size++] = 0;
+    while (size) {
+        const BvhNode & node = nodes_[stack[--size]];
+        if (intersectBox(origin, inverse_direction, best_t, node.bounds_min, node.bounds_max) < 0.0f)
+            continue;
+        if (node.left && size + 2 <= max_depth * 2) {
+            // Nearer child on top so it shrinks best_t first
+            float t0 = intersectBox(origin, inverse_direction, best_t,
+                nodes_[node.left].bounds_min, nodes_[node.left].bounds_max);
+            float t1 = intersectBox(origin, inverse_direction, best_t,
+                nodes_[node.left + 1].bounds_min, nodes_[node.left + 1].bounds_max);
+            bool left_first = t0 >= 0.0f && (t1 < 0.0f || t0 <= t1);
+            stack[size++] = left_first ? node.left + 1 : node.left;
+            stack[size++] = left_first ? node.left : node.left + 1;
+            continue;
+        }
+        for (unsigned int i = node.first; i < node.first + node.count; i++) {
+            float t = intersectBox(origin, inverse_direction, best_t, object_min_[i], object_max_[i]);
+            if (t >= 0.0f && t <= best_t) {
+                best_t = t;
+                best = (int)objects_[i];
+            }
+        }
+    }
+    if (best >= 0)
+        distance = best_t;
+    return best;
+}
+
+BvhStats Bvh::stats() const
+{
+    BvhStats s;
+    s.nodes = (unsigned int)nodes_.size();
+    s.leaves = 0;
+    s.depth = 0;
+    s.sah_cost = sahCost();
+    if (nodes_.empty())
+        return s;
+
+    std::vector<unsigned int> depth(nodes_.size(), 0);
+    depth[0] = 1;
+    for (size_t i = 0; i < nodes_.size(); i++) {
+        if (nodes_[i].left) {
+            depth[nodes_[i].left] = depth[nodes_[i].left + 1] = depth[i] + 1;
+        }
+        else {
+            s.leaves++;
+        }
+        s.depth = std::max(s.depth, depth[i]);
+    }
+    return s;
+}
@@ -0,0 +1,74 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "cull.h"
+
+// Node of a Bvh. Every node covers the objects [first, first + count) of
+// the tree's object order; leaves have no children (left == 0, the root
+// is never a child), inner nodes have theirs at left and left + 1.
+struct BvhNode
+{
+	glm::vec3 bounds_min;
+	unsigned int left;
+	glm::vec3 bounds_max;
+	unsigned int first;
+	unsigned int count;
+};
+
+struct BvhStats
+{
+	unsigned int nodes;
+	unsigned int leaves;
+	unsigned int depth;
+	float sah_cost;             // expected cost of a random ray, in node visits
+};
+
+// Bounding volume hierarchy over the world space boxes of a CullTable.
+// Built with a binned surface area heuristic; when objects move, refit()
+// recomputes the boxes bottom up without changing the topology, which is
+// cheaper but lets the tree quality drift, see needsRebuild().
+class Bvh
+{
+public:
+	static const unsigned int max_leaf_size = 4;
+
+	Bvh() : built_cost_(0.0f) {}
+
+	void build(const CullTable & bounds);
+	void refit(const CullTable & bounds);
+
+	// True once refitting made the tree noticeably worse than a rebuild
+	bool needsRebuild() const;
+
+	// Appends the objects intersecting the frustum to visible (cleared
+	// first). Subtrees completely inside are accepted without further tests.
+	size_t cullFrustum(const Frustum & frustum, std::vector<unsigned int> & visible) const;
+
+	// Nearest object whose box the ray hits within max_distance, or -1.
+	// direction needn't be normalized, distance is in units of it.
+	int raycast(const glm::vec3 & origin, const glm::vec3 & direction,
+		float max_distance, float & distance) const;
+
+	BvhStats stats() const;
+	size_t size() const { return objects_.size(); }
+
+private:
+	struct BuildObject;
+
+	unsigned int split(unsigned int node, std::vector<BuildObject> & objects);
+	void updateBounds(unsigned int node);
+	float sahCost() const;
+
+	// Object data is kept in tree order so leaves read it sequentially
+	std::vector<BvhNode> nodes_;
+	std::vector<unsigned int> objects_;     // object indices
+	std::vector<glm::vec3> object_min_;
+	std::vector<glm::vec3> object_max_;
+	float built_cost_;
+};
+
+#endif
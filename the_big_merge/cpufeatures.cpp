@@ -0,0 +1,82 @@
+#include "cpufeatures.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+namespace {
+
+void cpuid(int leaf, int subleaf, unsigned int regs[4])
+{
+#ifdef _MSC_VER
+    int r[4];
+    __cpuidex(r, leaf, subleaf);
+    for (int i = 0; i < 4; i++)
+        regs[i] = (unsigned int)r[i];
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// XCR0, which state the OS saves on context switches
+unsigned long long xgetbv0()
+{
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((unsigned long long)edx << 32) | eax;
+#endif
+}
+
+SimdLevel detect()
+{
+    unsigned int regs[4];
+    cpuid(0, 0, regs);
+    unsigned int max_leaf = regs[0];
+    if (max_leaf < 1)
+        return SIMD_SCALAR;
+
+    cpuid(1, 0, regs);
+    bool sse41 = (regs[2] & (1u << 19)) != 0;
+    bool fma = (regs[2] & (1u << 12)) != 0;
+    bool osxsave = (regs[2] & (1u << 27)) != 0;
+    bool avx = (regs[2] & (1u << 28)) != 0;
+    if (!sse41)
+        return SIMD_SCALAR;
+
+    // AVX needs the OS to save the ymm registers (XCR0 bits 1 and 2)
+    if (!avx || !fma || !osxsave || (xgetbv0() & 6) != 6 || max_leaf < 7)
+        return SIMD_SSE;
+    cpuid(7, 0, regs);
+    bool avx2 = (regs[1] & (1u << 5)) != 0;
+    bool avx512f = (regs[1] & (1u << 16)) != 0;
+    if (!avx2)
+        return SIMD_SSE;
+
+    // AVX-512 also needs the opmask and zmm state (XCR0 bits 5 to 7)
+    if (!avx512f || (xgetbv0() & 0xe6) != 0xe6)
+        return SIMD_AVX2;
+    return SIMD_AVX512;
+}
+
+} // namespace
+
+SimdLevel simdLevel()
+{
+    static const SimdLevel level = detect();
+    return level;
+}
+
+const char * simdLevelName(SimdLevel level)
+{
+    switch (level) {
+    case SIMD_AVX512: return "avx512";
+    case SIMD_AVX2: return "avx2";
+    case SIMD_SSE: return "sse4.1";
+    default: return "scalar";
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef CPUFEATURES_H
+#define CPUFEATURES_H
+
+// Runtime SIMD dispatch. Kernels are compiled for every level and the
+// best one the CPU (and OS, for the AVX state) supports is picked at run
+// time, so the binary still runs on machines without AVX2.
+
+enum SimdLevel
+{
+	SIMD_SCALAR,
+	SIMD_SSE,       // SSE4.1
+	SIMD_AVX2,      // AVX2 + FMA
+	SIMD_AVX512     // AVX-512F on top of AVX2
+};
+
+// Levels are ordered, a kernel for level L runs on any machine >= L
+
+// Best level this machine supports, detected once
+SimdLevel simdLevel();
+
+const char * simdLevelName(SimdLevel level);
+
+// MSVC compiles any intrinsic without extra flags, gcc and clang need the
+// target enabled per function
+#if defined(__GNUC__) || defined(__clang__)
+#define SIMD_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define SIMD_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma")))
+#else
+#define SIMD_TARGET_SSE41
+#define SIMD_TARGET_AVX2
+#define SIMD_TARGET_AVX512
+#endif
+
+#endif
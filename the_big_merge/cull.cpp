@@ -0,0 +1,202 @@
+#include <math.h>
+
+#include <limits>
+
+#include <immintrin.h>
+
+#include "cull.h"
+
+namespace {
+
+// Padding entries have a NaN center, every comparison with it fails
+const float never_visible = std::numeric_limits<float>::quiet_NaN();
+
+inline unsigned int countTrailingZeros(unsigned int mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (unsigned int)index;
+#else
+    return (unsigned int)__builtin_ctz(mask);
+#endif
+}
+
+// Appends first + bit for every set bit of mask
+inline unsigned int * appendMask(unsigned int * out, unsigned int mask, unsigned int first)
+{
+    while (mask) {
+        *out++ = first + countTrailingZeros(mask);
+        mask &= mask - 1;
+    }
+    return out;
+}
+
+unsigned int * cullScalar(const CullTable & t, const Frustum & f, CullShape shape,
+    size_t count, unsigned int * out)
+{
+    for (size_t i = 0; i < count; i++) {
+        bool inside = true;
+        for (int p = 0; p < 6 && inside; p++) {
+            const float * plane = f.planes[p];
+            float distance = plane[0] * t.x[i] + plane[1] * t.y[i] + plane[2] * t.z[i] + plane[3];
+            float extent = shape == CULL_SPHERE ? t.radius[i]
+                : fabsf(plane[0]) * t.ex[i] + fabsf(plane[1]) * t.ey[i] + fabsf(plane[2]) * t.ez[i];
+            inside = distance >= -extent;
+        }
+        if (inside)
+            *out++ = (unsigned int)i;
+    }
+    return out;
+}
+
+SIMD_TARGET_SSE41
+unsigned int * cullSse(const CullTable & t, const Frustum & f, CullShape shape,
+    size_t count, unsigned int * out)
+{
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    for (size_t i = 0; i < count; i += 4) {
+        __m128 x = _mm_loadu_ps(&t.x[i]);
+        __m128 y = _mm_loadu_ps(&t.y[i]);
+        __m128 z = _mm_loadu_ps(&t.z[i]);
+        __m128 radius = _mm_loadu_ps(&t.radius[i]);
+        __m128 ex = _mm_loadu_ps(&t.ex[i]);
+        __m128 ey = _mm_loadu_ps(&t.ey[i]);
+        __m128 ez = _mm_loadu_ps(&t.ez[i]);
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            const float * plane = f.planes[p];
+            __m128 a = _mm_set1_ps(plane[0]), b = _mm_set1_ps(plane[1]), c = _mm_set1_ps(plane[2]);
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, x), _mm_mul_ps(b, y)),
+                _mm_add_ps(_mm_mul_ps(c, z), _mm_set1_ps(plane[3])));
+            __m128 extent = radius;
+            if (shape == CULL_BOX)
+                extent = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(sign, a), ex),
+                    _mm_mul_ps(_mm_andnot_ps(sign, b), ey)), _mm_mul_ps(_mm_andnot_ps(sign, c), ez));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_xor_ps(extent, sign)));
+        }
+        out = appendMask(out, (unsigned int)_mm_movemask_ps(inside), (unsigned int)i);
+    }
+    return out;
+}
+
+SIMD_TARGET_AVX2
+unsigned int * cullAvx2(const CullTable & t, const Frustum & f, CullShape shape,
+    size_t count, unsigned int * out)
+{
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    for (size_t i = 0; i < count; i += 8) {
+        __m256 x = _mm256_loadu_ps(&t.x[i]);
+        __m256 y = _mm256_loadu_ps(&t.y[i]);
+        __m256 z = _mm256_loadu_ps(&t.z[i]);
+        __m256 radius = _mm256_loadu_ps(&t.radius[i]);
+        __m256 ex = _mm256_loadu_ps(&t.ex[i]);
+        __m256 ey = _mm256_loadu_ps(&t.ey[i]);
+        __m256 ez = _mm256_loadu_ps(&t.ez[i]);
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            const float * plane = f.planes[p];
+            __m256 a = _mm256_set1_ps(plane[0]), b = _mm256_set1_ps(plane[1]), c = _mm256_set1_ps(plane[2]);
+            __m256 distance = _mm256_fmadd_ps(a, x,
+                _mm256_fmadd_ps(b, y, _mm256_fmadd_ps(c, z, _mm256_set1_ps(plane[3]))));
+            __m256 extent = radius;
+            if (shape == CULL_BOX)
+                extent = _mm256_fmadd_ps(_mm256_andnot_ps(sign, a), ex,
+                    _mm256_fmadd_ps(_mm256_andnot_ps(sign, b), ey, _mm256_mul_ps(_mm256_andnot_ps(sign, c), ez)));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, _mm256_xor_ps(extent, sign), _CMP_GE_OQ));
+        }
+        out = appendMask(out, (unsigned int)_mm256_movemask_ps(inside), (unsigned int)i);
+    }
+    return out;
+}
+
+} // namespace
+
+Frustum extractFrustum(const glm::mat4 & m)
+{
+    // Rows of the matrix; glm is column major, m[column][row]
+    glm::vec4 rows[4];
+    for (int r = 0; r < 4; r++)
+        rows[r] = glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]);
+
+    glm::vec4 planes[6] = {
+        rows[3] + rows[0], rows[3] - rows[0],  // left, right
+        rows[3] + rows[1], rows[3] - rows[1],  // bottom, top
+        rows[3] + rows[2], rows[3] - rows[2]   // near, far
+    };
+
+    Frustum f;
+    for (int p = 0; p < 6; p++) {
+        float length = glm::length(glm::vec3(planes[p]));
+        for (int c = 0; c < 4; c++)
+            f.planes[p][c] = length > 0.0f ? planes[p][c] / length : planes[p][c];
+    }
+    return f;
+}
+
+void CullTable::resize(size_t count)
+{
+    size_t padded = (count + 7) & ~(size_t)7;
+    count_ = count;
+    x.resize(padded, 0.0f);
+    y.resize(padded, 0.0f);
+    z.resize(padded, 0.0f);
+    radius.resize(padded, 0.0f);
+    ex.resize(padded, 0.0f);
+    ey.resize(padded, 0.0f);
+    ez.resize(padded, 0.0f);
+    for (size_t i = count; i < padded; i++)
+        x[i] = never_visible;
+}
+
+void CullTable::set(size_t index, const glm::vec3 & center, float r, const glm::vec3 & extents)
+{
+    x[index] = center.x;
+    y[index] = center.y;
+    z[index] = center.z;
+    radius[index] = r;
+    ex[index] = extents.x;
+    ey[index] = extents.y;
+    ez[index] = extents.z;
+}
+
+void CullTable::setTransformed(size_t index, const glm::mat4 & model,
+    const glm::vec3 & center, float r, const glm::vec3 & extents)
+{
+    glm::vec3 world_center(model * glm::vec4(center, 1.0f));
+
+    // Box: extents of the rotated box projected on the world axes
+    glm::vec3 world_extents;
+    for (int axis = 0; axis < 3; axis++)
+        world_extents[axis] = fabsf(model[0][axis]) * extents.x + fabsf(model[1][axis]) * extents.y
+            + fabsf(model[2][axis]) * extents.z;
+
+    float scale = glm::max(glm::length(glm::vec3(model[0])),
+        glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    set(index, world_center, r * scale, world_extents);
+}
+
+size_t cullObjects(const CullTable & table, const Frustum & frustum, CullShape shape,
+    std::vector<unsigned int> & visible, SimdLevel level)
+{
+    size_t count = table.size();
+    visible.resize(table.x.size());
+    if (count == 0) {
+        visible.clear();
+        return 0;
+    }
+
+    // The padding never passes, so the vector kernels run over whole groups
+    unsigned int * first = &visible[0];
+    unsigned int * end;
+    if (level >= SIMD_AVX2)
+        end = cullAvx2(table, frustum, shape, table.x.size(), first);
+    else if (level >= SIMD_SSE)
+        end = cullSse(table, frustum, shape, table.x.size(), first);
+    else
+        end = cullScalar(table, frustum, shape, count, first);
+    visible.resize(end - first);
+    return visible.size();
+}
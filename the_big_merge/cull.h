@@ -0,0 +1,57 @@
+#ifndef CULL_H
+#define CULL_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "cpufeatures.h"
+
+// Six planes (left, right, bottom, top, near, far) as a * x + b * y +
+// c * z + d, normalized, positive inside
+struct Frustum
+{
+	float planes[6][4];
+};
+
+// Gribb/Hartmann plane extraction from projection * view
+Frustum extractFrustum(const glm::mat4 & view_projection);
+
+// World space bounding volumes of a set of objects, structure of arrays
+// so the culling kernels can load 4 or 8 objects per instruction. The
+// arrays are padded to a multiple of 8 with entries that never pass.
+class CullTable
+{
+public:
+	CullTable() : count_(0) {}
+
+	void resize(size_t count);
+	size_t size() const { return count_; }
+
+	// Bounding sphere and axis aligned box share the center
+	void set(size_t index, const glm::vec3 & center, float radius, const glm::vec3 & extents);
+
+	// World bounds of an object space box transformed by model
+	void setTransformed(size_t index, const glm::mat4 & model,
+		const glm::vec3 & center, float radius, const glm::vec3 & extents);
+
+	std::vector<float> x, y, z;
+	std::vector<float> radius;
+	std::vector<float> ex, ey, ez;
+
+private:
+	size_t count_;
+};
+
+enum CullShape
+{
+	CULL_SPHERE,
+	CULL_BOX
+};
+
+// Fills visible with the indices of the objects whose sphere or box
+// intersects the frustum, in increasing order. Returns their number.
+size_t cullObjects(const CullTable & table, const Frustum & frustum, CullShape shape,
+	std::vector<unsigned int> & visible, SimdLevel level = simdLevel());
+
+#endif
@@ -0,0 +1,178 @@
+#include <stdio.h>
+
+#include <algorithm>
+
+#include "drawbatch.h"
+#include "renderqueue.h"
+
+DrawData makeDrawData(const glm::mat4 & mv, const QuantizationRange & range,
+    const glm::vec4 & atlas_rect, unsigned int atlas_layer)
+{
+    DrawData data;
+    data.mv = mv;
+    data.pos_offset = glm::vec4(range.position_offset, (float)atlas_layer);
+    data.pos_scale = glm::vec4(range.position_scale, 0.0f);
+    data.uv_range = glm::vec4(range.uv_offset.x, range.uv_offset.y, range.uv_scale.x, range.uv_scale.y);
+    data.atlas_rect = atlas_rect;
+    return data;
+}
+
+DrawBatch::DrawBatch()
+    : arena_(NULL), draw_buffer_(0), indirect_buffer_(0), draw_id_buffer_(0), capacity_(0)
+{
+}
+
+bool DrawBatch::create(BufferArena & arena, GLuint program_id)
+{
+    destroy();
+    arena_ = &arena;
+    glGenBuffers(1, &draw_buffer_);
+    glGenBuffers(1, &indirect_buffer_);
+    glGenBuffers(1, &draw_id_buffer_);
+    reserve(64);
+
+    GLint location = glGetAttribLocation(program_id, "draw_id");
+    if (location < 0) {
+        printf("draw batch: program %u has no draw_id attribute\n", program_id);
+        return false;
+    }
+
+    // One id per instance; base_instance picks the draw's id
+    glBindVertexArray(arena.vao());
+    glBindBuffer(GL_ARRAY_BUFFER, draw_id_buffer_);
+    glVertexAttribIPointer(location, 1, GL_UNSIGNED_INT, 0, (void *)0);
+    glVertexAttribDivisor(location, 1);
+    glEnableVertexAttribArray(location);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    return true;
+}
+
+void DrawBatch::destroy()
+{
+    if (draw_buffer_)
+        glDeleteBuffers(1, &draw_buffer_);
+    if (indirect_buffer_)
+        glDeleteBuffers(1, &indirect_buffer_);
+    if (draw_id_buffer_)
+        glDeleteBuffers(1, &draw_id_buffer_);
+    draw_buffer_ = indirect_buffer_ = draw_id_buffer_ = 0;
+    capacity_ = 0;
+    clear();
+}
+
+void DrawBatch::clear()
+{
+    draws_.clear();
+    data_.clear();
+}
+
+void DrawBatch::add(const ArenaRange & range, const MeshLod & lod, const DrawData & data, unsigned int key)
+{
+    Draw draw;
+    draw.key = key;
+    draw.index_type = range.index_type;
+    draw.command.count = lod.index_count;
+    draw.command.instance_count = 1;
+    draw.command.first_index = (GLuint)(range.index_offset / indexTypeSize(range.index_type)) + lod.first_index;
+    draw.command.base_vertex = (GLint)range.base_vertex;
+    draw.command.base_instance = 0;
+    draws_.push_back(draw);
+    data_.push_back(data);
+}
+
+void DrawBatch::reserve(size_t count)
+{
+    if (count <= capacity_)
+        return;
+    size_t capacity = std::max(count, capacity_ * 2);
+
+    // Same buffer names, so the vao's draw_id binding stays valid
+    std::vector<GLuint> ids(capacity);
+    for (size_t i = 0; i < capacity; i++)
+        ids[i] = (GLuint)i;
+    glBindBuffer(GL_ARRAY_BUFFER, draw_id_buffer_);
+    glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(GLuint), &ids[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, draw_buffer_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(DrawData), NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer_);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, capacity * sizeof(DrawElementsIndirectCommand), NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    capacity_ = capacity;
+}
+
+void DrawBatch::upload()
+{
+    size_t count = draws_.size();
+    reserve(count);
+
+    // Stable sort keeps the submission order within a run
+    order_.resize(count);
+    for (size_t i = 0; i < count; i++)
+        order_[i] = (unsigned int)i;
+    const std::vector<Draw> & draws = draws_;
+    std::stable_sort(order_.begin(), order_.end(), [&draws](unsigned int a, unsigned int b) {
+        if (draws[a].key != draws[b].key)
+            return draws[a].key < draws[b].key;
+        return draws[a].index_type < draws[b].index_type;
+    });
+
+    commands_.resize(count);
+    sorted_data_.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        commands_[i] = draws_[order_[i]].command;
+        commands_[i].base_instance = (GLuint)i;
+        sorted_data_[i] = data_[order_[i]];
+    }
+
+    if (count == 0)
+        return;
+
+    // Orphan and refill, the previous frame may still be reading them
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, draw_buffer_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, capacity_ * sizeof(DrawData), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(DrawData), &sorted_data_[0]);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer_);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, capacity_ * sizeof(DrawElementsIndirectCommand), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, count * sizeof(DrawElementsIndirectCommand), &commands_[0]);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void DrawBatch::record(RenderQueue & queue, GLuint program, GLenum texture_target)
+{
+    upload();
+
+    size_t count = draws_.size();
+    for (size_t start = 0; start < count;) {
+        const Draw & first = draws_[order_[start]];
+        size_t end = start + 1;
+        while (end < count && draws_[order_[end]].key == first.key
+            && draws_[order_[end]].index_type == first.index_type)
+            end++;
+
+        RenderCommand command;
+        command.type = RENDER_MULTI_DRAW;
+        command.program = program;
+        command.vao = arena_->vao();
+        if (texture_target) {
+            command.texture_target = texture_target;
+            command.texture = first.key;
+        }
+        command.storage_binding = DRAW_DATA_BINDING;
+        command.storage_buffer = draw_buffer_;
+        command.index_type = first.index_type;
+        command.indirect_buffer = indirect_buffer_;
+        command.commands = &commands_[0];
+        command.first = start;
+        command.count = (GLsizei)(end - start);
+        queue.record(command);
+        start = end;
+    }
+}
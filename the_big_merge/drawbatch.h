@@ -0,0 +1,97 @@
+#ifndef DRAWBATCH_H
+#define DRAWBATCH_H
+
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "bufferarena.h"
+#include "simplify.h"
+
+// Per-draw data as the shaders see it, std430 layout of
+// "buffer DrawBuffer { DrawData draws[]; }" at binding DRAW_DATA_BINDING
+struct DrawData
+{
+	glm::mat4 mv;
+	glm::vec4 pos_offset;   // xyz, w atlas layer
+	glm::vec4 pos_scale;    // xyz, w unused
+	glm::vec4 uv_range;     // uv offset in xy, uv scale in zw
+	glm::vec4 atlas_rect;   // texture's place in its atlas page, see AtlasEntry
+};
+
+// Layout glMultiDrawElementsIndirect reads
+struct DrawElementsIndirectCommand
+{
+	GLuint count;
+	GLuint instance_count;
+	GLuint first_index;
+	GLint base_vertex;
+	GLuint base_instance;
+};
+
+const GLuint DRAW_DATA_BINDING = 0;
+
+class RenderQueue;
+
+// Collects the draws of one program over one BufferArena for a frame and
+// records them into a RenderQueue as one glMultiDrawElementsIndirect per
+// (state key, index type) run. GLSL 4.30 has no gl_DrawID, so the draw number comes from a
+// per-instance "draw_id" attribute: every command draws one instance with
+// base_instance set to its draw number, and the shader indexes the
+// DrawData buffer with it.
+class DrawBatch
+{
+public:
+	DrawBatch();
+
+	// Creates the buffers and adds the draw_id attribute to the arena's vao
+	bool create(BufferArena & arena, GLuint program_id);
+	void destroy();
+
+	void clear();
+
+	// Queues lod of the mesh at range. Draws with different keys, e.g.
+	// textures, are submitted separately.
+	void add(const ArenaRange & range, const MeshLod & lod, const DrawData & data, unsigned int key = 0);
+
+	// Uploads the frame's draws and records a multi-draw command per run.
+	// With a texture target the run's key is the texture bound for it.
+	void record(RenderQueue & queue, GLuint program, GLenum texture_target = 0);
+
+	size_t drawCount() const { return draws_.size(); }
+
+private:
+	DrawBatch(const DrawBatch &);
+	DrawBatch & operator=(const DrawBatch &);
+
+	struct Draw
+	{
+		unsigned int key;
+		GLenum index_type;
+		DrawElementsIndirectCommand command;
+	};
+
+	// Sorts by key and index type and uploads commands and draw data
+	void upload();
+	void reserve(size_t count);
+
+	BufferArena * arena_;
+	GLuint draw_buffer_;
+	GLuint indirect_buffer_;
+	GLuint draw_id_buffer_;
+	size_t capacity_;
+
+	std::vector<Draw> draws_;
+	std::vector<DrawData> data_;
+	std::vector<unsigned int> order_;
+	std::vector<DrawElementsIndirectCommand> commands_;
+	std::vector<DrawData> sorted_data_;
+};
+
+// Fills a DrawData from a model-view matrix, a quantization range and
+// where the texture is in the atlas
+DrawData makeDrawData(const glm::mat4 & mv, const QuantizationRange & range,
+	const glm::vec4 & atlas_rect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f), unsigned int atlas_layer = 0);
+
+#endif
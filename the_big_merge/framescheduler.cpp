@@ -0,0 +1,138 @@
+#include <string.h>
+
+#include <chrono>
+
+#include "framescheduler.h"
+
+const double FramePacingStats::bucket_ms = 0.5;
+
+double SteadyClock::now()
+{
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+double FramePacingStats::percentile(double p) const
+{
+    if (frames == 0)
+        return 0.0;
+    double wanted = p * frames;
+    double before = 0.0;
+    for (unsigned int b = 0; b < bucket_count; b++) {
+        if (histogram[b] && before + histogram[b] >= wanted)
+            return (b + (wanted - before) / histogram[b]) * bucket_ms;
+        before += histogram[b];
+    }
+    return max_ms;
+}
+
+FrameScheduler::FrameScheduler(FrameClock & clock, double tick_seconds, unsigned int max_ticks_per_frame)
+    : clock_(clock), tick_(tick_seconds), max_ticks_(max_ticks_per_frame),
+    pacing_(PACE_UNCAPPED), interval_(0.0), last_frame_(-1.0), next_frame_(0.0),
+    accumulator_(0.0), simulation_time_(0.0)
+{
+    resetStats();
+}
+
+void FrameScheduler::setPacing(FramePacing pacing, double target_fps)
+{
+    pacing_ = pacing;
+    interval_ = pacing == PACE_UNCAPPED || target_fps <= 0.0 ? 0.0 : 1.0 / target_fps;
+    next_frame_ = clock_.now();
+}
+
+unsigned int FrameScheduler::beginFrame()
+{
+    double now = clock_.now();
+    if (last_frame_ < 0.0) {
+        // Nothing to simulate or measure before the first frame
+        last_frame_ = now;
+        next_frame_ = now + interval_;
+        return 0;
+    }
+    double elapsed = now - last_frame_;
+    last_frame_ = now;
+    recordFrame(elapsed);
+
+    // Run the ticks that fit in the real time passed, keep the remainder
+    // for the next frame. After a long stall only max_ticks_ are run, the
+    // rest is dropped rather than making every following frame slower.
+    accumulator_ += elapsed;
+    unsigned int ticks = (unsigned int)(accumulator_ / tick_);
+    if (ticks > max_ticks_) {
+        stats_.dropped_ticks += ticks - max_ticks_;
+        accumulator_ -= (ticks - max_ticks_) * tick_;
+        ticks = max_ticks_;
+    }
+    accumulator_ -= ticks * tick_;
+    simulation_time_ += ticks * tick_;
+    stats_.ticks += ticks;
+
+    // Capped frames are due at a steady rate; after falling behind by a
+    // whole interval, start over from now instead of rushing to catch up
+    if (pacing_ == PACE_CAPPED) {
+        next_frame_ += interval_;
+        if (next_frame_ <= now)
+            next_frame_ = now + interval_;
+    }
+    return ticks;
+}
+
+double FrameScheduler::timeUntilNextFrame()
+{
+    if (pacing_ != PACE_CAPPED)
+        return 0.0;
+    double wait = next_frame_ - clock_.now();
+    return wait > 0.0 ? wait : 0.0;
+}
+
+void FrameScheduler::resetStats()
+{
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+void FrameScheduler::recordFrame(double seconds)
+{
+    double ms = seconds * 1000.0;
+    unsigned int bucket = (unsigned int)(ms / FramePacingStats::bucket_ms);
+    if (bucket > FramePacingStats::bucket_count)
+        bucket = FramePacingStats::bucket_count;
+    stats_.histogram[bucket]++;
+    stats_.frames++;
+    stats_.total_ms += ms;
+    if (ms > stats_.max_ms)
+        stats_.max_ms = ms;
+    if (interval_ > 0.0 && seconds > interval_ * 1.5)
+        stats_.missed++;
+}
+
+void FrameScheduler::report(FILE * out) const
+{
+    static const char * names[] = { "vsync", "capped", "uncapped" };
+    const FramePacingStats & s = stats_;
+    fprintf(out, "frame pacing (%s", names[pacing_]);
+    if (interval_ > 0.0)
+        fprintf(out, ", %.1f fps target", 1.0 / interval_);
+    fprintf(out, "): %u frames, mean %.2f ms, p50 %.2f ms, p99 %.2f ms, max %.2f ms, %u missed, "
+        "%u ticks of %.1f ms, %u dropped\n", s.frames, s.mean(), s.percentile(0.5),
+        s.percentile(0.99), s.max_ms, s.missed, s.ticks, tick_ * 1000.0, s.dropped_ticks);
+
+    // One row per non-empty bucket, bars scaled to the largest
+    unsigned int largest = 0;
+    for (unsigned int b = 0; b <= FramePacingStats::bucket_count; b++)
+        if (s.histogram[b] > largest)
+            largest = s.histogram[b];
+    for (unsigned int b = 0; b <= FramePacingStats::bucket_count; b++) {
+        if (s.histogram[b] == 0)
+            continue;
+        if (b == FramePacingStats::bucket_count)
+            fprintf(out, "  >= %5.1f ms %6u ", b * FramePacingStats::bucket_ms, s.histogram[b]);
+        else
+            fprintf(out, "  %5.1f-%5.1f %6u ", b * FramePacingStats::bucket_ms,
+                (b + 1) * FramePacingStats::bucket_ms, s.histogram[b]);
+        unsigned int bar = (s.histogram[b] * 40 + largest - 1) / largest;
+        for (unsigned int i = 0; i < bar; i++)
+            fputc('#', out);
+        fputc('\n', out);
+    }
+}
@@ -0,0 +1,108 @@
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+#include <stdio.h>
+
+// Time source in seconds; the scheduler only ever asks it for the time,
+// so tests can drive it with a FakeClock
+class FrameClock
+{
+public:
+	virtual ~FrameClock() {}
+	virtual double now() = 0;
+};
+
+// std::chrono::steady_clock, seconds since the first call
+class SteadyClock : public FrameClock
+{
+public:
+	double now();
+};
+
+class FakeClock : public FrameClock
+{
+public:
+	FakeClock() : time_(0.0) {}
+	double now() { return time_; }
+	void advance(double seconds) { time_ += seconds; }
+
+private:
+	double time_;
+};
+
+enum FramePacing
+{
+	PACE_VSYNC,     // swap waits for the display, frames follow its refresh
+	PACE_CAPPED,    // frames are started no faster than the target rate
+	PACE_UNCAPPED   // next frame as soon as the last one is done
+};
+
+struct FramePacingStats
+{
+	static const unsigned int bucket_count = 200;
+	static const double bucket_ms;          // histogram resolution
+
+	unsigned int frames;
+	unsigned int missed;        // frames longer than 1.5 target intervals
+	unsigned int ticks;
+	unsigned int dropped_ticks; // simulation time thrown away when too far behind
+	double total_ms;
+	double max_ms;
+	unsigned int histogram[bucket_count + 1];   // last bucket is everything longer
+
+	double mean() const { return frames ? total_ms / frames : 0.0; }
+
+	// Frame time below which the fraction p of the frames are, from the
+	// histogram, so accurate to bucket_ms
+	double percentile(double p) const;
+};
+
+// Fixed timestep simulation decoupled from rendering. Every frame asks
+// beginFrame() how many simulation ticks of tick() seconds to run, then
+// renders with alpha() to interpolate between the last two ticks, so
+// animation speed no longer depends on the frame rate. Also measures the
+// frame times and paces frames in PACE_CAPPED mode.
+class FrameScheduler
+{
+public:
+	FrameScheduler(FrameClock & clock, double tick_seconds, unsigned int max_ticks_per_frame = 8);
+
+	void setPacing(FramePacing pacing, double target_fps);
+	FramePacing pacing() const { return pacing_; }
+	double targetInterval() const { return interval_; }
+
+	// Starts a frame, returns the number of simulation ticks to run
+	unsigned int beginFrame();
+
+	// How far the frame is between the previous and the last tick, [0, 1)
+	double alpha() const { return accumulator_ / tick_; }
+	double tick() const { return tick_; }
+
+	// Simulated time after the ticks of this frame
+	double simulationTime() const { return simulation_time_; }
+
+	// Seconds to wait before starting the next frame, 0 unless capped
+	double timeUntilNextFrame();
+
+	const FramePacingStats & stats() const { return stats_; }
+	void resetStats();
+
+	// Text dump of the stats and the non-empty histogram buckets
+	void report(FILE * out) const;
+
+private:
+	void recordFrame(double seconds);
+
+	FrameClock & clock_;
+	double tick_;
+	unsigned int max_ticks_;
+	FramePacing pacing_;
+	double interval_;           // target frame time, 0 when uncapped
+	double last_frame_;         // time beginFrame() was last called, < 0 before the first
+	double next_frame_;         // when the next capped frame is due
+	double accumulator_;        // real time not yet simulated
+	double simulation_time_;
+	FramePacingStats stats_;
+};
+
+#endif
@@ -0,0 +1,144 @@
+#include <stdio.h>
+
+#include <algorithm>
+
+#include <GL/glew.h>
+
+#include "glcallcounter.h"
+
+// GLEW entry points the renderer calls, by name without the gl prefix
+#define COUNTED_GL_FUNCTIONS(X) \
+    X(ActiveTexture) \
+    X(BindBuffer) \
+    X(BindBufferBase) \
+    X(BindBufferRange) \
+    X(BindVertexArray) \
+    X(BufferData) \
+    X(BufferSubData) \
+    X(ClientWaitSync) \
+    X(CompressedTexSubImage2D) \
+    X(CompressedTexSubImage3D) \
+    X(DeleteSync) \
+    X(DrawElementsBaseVertex) \
+    X(DrawElementsInstancedBaseVertex) \
+    X(DrawElementsInstancedBaseVertexBaseInstance) \
+    X(FenceSync) \
+    X(FlushMappedBufferRange) \
+    X(GetAttribLocation) \
+    X(GetProgramiv) \
+    X(GetUniformBlockIndex) \
+    X(GetUniformLocation) \
+    X(MapBufferRange) \
+    X(MultiDrawElementsIndirect) \
+    X(TexSubImage3D) \
+    X(Uniform1i) \
+    X(Uniform3fv) \
+    X(Uniform4fv) \
+    X(UniformBlockBinding) \
+    X(UniformMatrix4fv) \
+    X(UnmapBuffer) \
+    X(UseProgram)
+
+namespace {
+
+enum CountedFunction
+{
+#define X(name) COUNTED_##name,
+    COUNTED_GL_FUNCTIONS(X)
+#undef X
+    COUNTED_FUNCTIONS
+};
+
+GLCallCount counts[COUNTED_FUNCTIONS] = {
+#define X(name) { "gl" #name, 0 },
+    COUNTED_GL_FUNCTIONS(X)
+#undef X
+};
+
+// A wrapper per function: counts, then calls what GLEW had loaded
+template <int Id, typename Function>
+struct CountingHook;
+
+template <int Id, typename Result, typename... Args>
+struct CountingHook<Id, Result (GLAPIENTRY *)(Args...)>
+{
+    typedef Result (GLAPIENTRY * Function)(Args...);
+    static Function real;
+
+    static Result GLAPIENTRY call(Args... args)
+    {
+        counts[Id].calls++;
+        return real(args...);
+    }
+
+    static void install(Function & pointer)
+    {
+        if (!pointer || pointer == call)
+            return;
+        real = pointer;
+        pointer = call;
+    }
+
+    static void remove(Function & pointer)
+    {
+        if (pointer == call)
+            pointer = real;
+    }
+};
+
+template <int Id, typename Result, typename... Args>
+typename CountingHook<Id, Result (GLAPIENTRY *)(Args...)>::Function
+    CountingHook<Id, Result (GLAPIENTRY *)(Args...)>::real = NULL;
+
+} // namespace
+
+void installGLCallCounter()
+{
+#define X(name) CountingHook<COUNTED_##name, decltype(__glew##name)>::install(__glew##name);
+    COUNTED_GL_FUNCTIONS(X)
+#undef X
+}
+
+void removeGLCallCounter()
+{
+#define X(name) CountingHook<COUNTED_##name, decltype(__glew##name)>::remove(__glew##name);
+    COUNTED_GL_FUNCTIONS(X)
+#undef X
+}
+
+void resetGLCallCounts()
+{
+    for (int i = 0; i < COUNTED_FUNCTIONS; i++)
+        counts[i].calls = 0;
+}
+
+unsigned long long glCallTotal()
+{
+    unsigned long long total = 0;
+    for (int i = 0; i < COUNTED_FUNCTIONS; i++)
+        total += counts[i].calls;
+    return total;
+}
+
+std::vector<GLCallCount> glCallCounts()
+{
+    std::vector<GLCallCount> called;
+    for (int i = 0; i < COUNTED_FUNCTIONS; i++)
+        if (counts[i].calls)
+            called.push_back(counts[i]);
+    std::stable_sort(called.begin(), called.end(), [](const GLCallCount & a, const GLCallCount & b) {
+        return a.calls > b.calls;
+    });
+    return called;
+}
+
+void reportGLCalls(unsigned int frames)
+{
+    if (frames == 0)
+        return;
+    std::vector<GLCallCount> called = glCallCounts();
+    printf("gl calls: %.1f/frame", (double)glCallTotal() / frames);
+    for (size_t i = 0; i < called.size(); i++)
+        printf("%s %s %.1f", i ? "," : ":", called[i].name, (double)called[i].calls / frames);
+    printf("\n");
+}
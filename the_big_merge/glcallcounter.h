@@ -0,0 +1,29 @@
+#ifndef GLCALLCOUNTER_H
+#define GLCALLCOUNTER_H
+
+#include <vector>
+
+struct GLCallCount
+{
+	const char * name;
+	unsigned long long calls;
+};
+
+// Counts calls to the GL functions the renderer uses by swapping counting
+// wrappers into GLEW's function pointers; install after glewInit. GL 1.1
+// functions (glClear, glBindTexture, glDrawElements, ...) are exported by
+// the GL library itself rather than loaded by GLEW and are not counted.
+// Counters are plain integers, GL thread only.
+void installGLCallCounter();
+void removeGLCallCounter();
+
+void resetGLCallCounts();
+unsigned long long glCallTotal();
+
+// Functions called since the last reset, most called first
+std::vector<GLCallCount> glCallCounts();
+
+// Calls per frame over the given number of frames, total and by function
+void reportGLCalls(unsigned int frames);
+
+#endif
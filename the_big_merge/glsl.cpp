@@ -1,25 +1,31 @@
+#include <stdio.h>
+#include <string.h>
+
 #include "glsl.h"
 
 char* glsl::contents;
 
 char* glsl::readFile(const char* filename)
 {
-    // Open the file
-    FILE* fp = fopen(filename, "r");
+    // Open the file, binary so the length matches what is read
+    FILE* fp = fopen(filename, "rb");
+    if (!fp) {
+        printf("%s: could not open shader source\n", filename);
+        return NULL;
+    }
     // Move the file pointer to the end of the file and determing the length
     fseek(fp, 0, SEEK_END);
     long file_length = ftell(fp);
     fseek(fp, 0, SEEK_SET);
-    char* contents = new char[file_length + 1];
-    // zero out memory
-    for (int i = 0; i < file_length + 1; i++) 
-    {
-        contents[i] = 0;
+    if (file_length < 0) {
+        fclose(fp);
+        return NULL;
     }
+    char* contents = new char[file_length + 1];
     // Here's the actual read
-    fread(contents, 1, file_length, fp);
+    size_t read = fread(contents, 1, file_length, fp);
     // This is how you denote the end of a string in C
-    contents[file_length + 1] = '\0';
+    contents[read] = '\0';
     fclose(fp);
     return contents;
 }
@@ -34,45 +40,88 @@ bool glsl::compiledStatus(GLint shaderID)
     else {
         GLint logLength;
         glGetShaderiv(shaderID, GL_INFO_LOG_LENGTH, &logLength);
-        char* msgBuffer = new char[logLength];
-        glGetShaderInfoLog(shaderID, logLength, NULL, msgBuffer);
+        char* msgBuffer = new char[logLength + 1];
+        msgBuffer[0] = '\0';
+        glGetShaderInfoLog(shaderID, logLength + 1, NULL, msgBuffer);
         printf("%s\n", msgBuffer);
-        delete (msgBuffer);
+        delete[] msgBuffer;
         return false;
     }
 }
 
-GLuint glsl::makeVertexShader(const char* shaderSource)
+bool glsl::linkedStatus(GLuint programID)
 {
-    GLuint vertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShaderID, 1, (const GLchar**)&shaderSource, NULL);
-    glCompileShader(vertexShaderID);
-    bool compiledCorrectly = compiledStatus(vertexShaderID);
-    if (compiledCorrectly)
+    GLint linked = 0;
+    glGetProgramiv(programID, GL_LINK_STATUS, &linked);
+    if (linked) {
+        return true;
+    }
+    GLint logLength = 0;
+    glGetProgramiv(programID, GL_INFO_LOG_LENGTH, &logLength);
+    char* msgBuffer = new char[logLength + 1];
+    msgBuffer[0] = '\0';
+    glGetProgramInfoLog(programID, logLength + 1, NULL, msgBuffer);
+    printf("%s\n", msgBuffer);
+    delete[] msgBuffer;
+    return false;
+}
+
+GLuint glsl::makeShader(GLenum type, const char* shaderSource, const char* defines)
+{
+    if (!shaderSource)
+        return 0;
+    // Defines go after the #version line, which must come first
+    const char* sources[3] = { "", defines ? defines : "", shaderSource };
+    GLint lengths[3] = { 0, -1, -1 };
+    const char* version = strstr(shaderSource, "#version");
+    if (version) {
+        const char* line_end = strchr(version, '\n');
+        const char* body = line_end ? line_end + 1 : version + strlen(version);
+        sources[0] = shaderSource;
+        lengths[0] = (GLint)(body - shaderSource);
+        sources[2] = body;
+    }
+    GLuint shaderID = glCreateShader(type);
+    glShaderSource(shaderID, 3, sources, lengths);
+    glCompileShader(shaderID);
+    return shaderID;
+}
+
+GLuint glsl::makeVertexShader(const char* shaderSource, const char* defines)
+{
+    GLuint vertexShaderID = makeShader(GL_VERTEX_SHADER, shaderSource, defines);
+    if (vertexShaderID && compiledStatus(vertexShaderID))
     {
         return vertexShaderID;
     }
-    return -1;
+    glDeleteShader(vertexShaderID);
+    return 0;
 }
 
-GLuint glsl::makeFragmentShader(const char* shaderSource)
+GLuint glsl::makeFragmentShader(const char* shaderSource, const char* defines)
 {
-    GLuint fragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShaderID, 1, (const GLchar**)&shaderSource, NULL);
-    glCompileShader(fragmentShaderID);
-    //delete[] source;
-    bool compiledCorrectly = compiledStatus(fragmentShaderID);
-    if (compiledCorrectly) {
+    GLuint fragmentShaderID = makeShader(GL_FRAGMENT_SHADER, shaderSource, defines);
+    if (fragmentShaderID && compiledStatus(fragmentShaderID)) {
         return fragmentShaderID;
     }
-    return -1;
+    glDeleteShader(fragmentShaderID);
+    return 0;
 }
 
 GLuint glsl::makeShaderProgram(GLuint vertexShaderID, GLuint fragmentShaderID)
 {
+    if (!vertexShaderID || !fragmentShaderID)
+        return 0;
     GLuint shaderID = glCreateProgram();
     glAttachShader(shaderID, vertexShaderID);
     glAttachShader(shaderID, fragmentShaderID);
     glLinkProgram(shaderID);
+    if (!linkedStatus(shaderID)) {
+        glDeleteProgram(shaderID);
+        return 0;
+    }
+    // The program keeps what it needs, the shaders can go
+    glDetachShader(shaderID, vertexShaderID);
+    glDetachShader(shaderID, fragmentShaderID);
     return shaderID;
-}
\ No newline at end of file
+}
@@ -13,10 +13,15 @@ private:
 public:
 	glsl();
 	~glsl();
+	// Whole file, NUL terminated, for delete[]; NULL if it can't be read
 	static char* readFile(const char* filename);
 	static bool compiledStatus(GLint shaderID);
-	static GLuint makeVertexShader(const char* shaderSource);
-	static GLuint makeFragmentShader(const char* shaderSource);
+	static bool linkedStatus(GLuint programID);
+	// Compile is started, not checked; defines are inserted after #version
+	static GLuint makeShader(GLenum type, const char* shaderSource, const char* defines = "");
+	// 0 on a compile or link error, the log is printed
+	static GLuint makeVertexShader(const char* shaderSource, const char* defines = "");
+	static GLuint makeFragmentShader(const char* shaderSource, const char* defines = "");
 	static GLuint makeShaderProgram(GLuint vertexShaderID, GLuint fragmentShaderID);
 };
 
@@ -0,0 +1,105 @@
+#include <algorithm>
+
+#include "instancebuffer.h"
+
+InstanceBuffer::InstanceBuffer()
+    : any_dirty_(false), buffer_(0), capacity_(0), max_scale_(0.0f)
+{
+}
+
+void InstanceBuffer::destroy()
+{
+    if (buffer_)
+        glDeleteBuffers(1, &buffer_);
+    buffer_ = 0;
+    capacity_ = 0;
+}
+
+size_t InstanceBuffer::add(const glm::mat4 & model, const glm::vec4 & tint)
+{
+    InstanceData instance;
+    instance.model = model;
+    instance.tint = tint;
+    size_t index = instances_.size();
+    instances_.push_back(instance);
+    dirty_.resize((instances_.size() + block_size - 1) / block_size, 0);
+
+    if (index == 0)
+        bounds_min_ = bounds_max_ = glm::vec3(model[3]);
+    grow(model);
+    markDirty(index);
+    return index;
+}
+
+void InstanceBuffer::setModel(size_t index, const glm::mat4 & model)
+{
+    instances_[index].model = model;
+    grow(model);
+    markDirty(index);
+}
+
+void InstanceBuffer::setTint(size_t index, const glm::vec4 & tint)
+{
+    instances_[index].tint = tint;
+    markDirty(index);
+}
+
+size_t InstanceBuffer::update()
+{
+    if (instances_.empty())
+        return 0;
+
+    if (instances_.size() > capacity_) {
+        // Reallocate with headroom and upload everything
+        capacity_ = std::max(instances_.size(), capacity_ * 2);
+        if (!buffer_)
+            glGenBuffers(1, &buffer_);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer_);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, capacity_ * sizeof(InstanceData), NULL, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, instances_.size() * sizeof(InstanceData), &instances_[0]);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        std::fill(dirty_.begin(), dirty_.end(), 0);
+        any_dirty_ = false;
+        return instances_.size() * sizeof(InstanceData);
+    }
+    if (!any_dirty_)
+        return 0;
+
+    // Upload runs of dirty blocks with one call each
+    size_t uploaded = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer_);
+    for (size_t block = 0; block < dirty_.size();) {
+        if (!dirty_[block]) {
+            block++;
+            continue;
+        }
+        size_t end = block;
+        while (end < dirty_.size() && dirty_[end])
+            dirty_[end++] = 0;
+        size_t first = block * block_size;
+        size_t count = std::min(end * block_size, instances_.size()) - first;
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, first * sizeof(InstanceData),
+            count * sizeof(InstanceData), &instances_[first]);
+        uploaded += count * sizeof(InstanceData);
+        block = end;
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    any_dirty_ = false;
+    return uploaded;
+}
+
+void InstanceBuffer::markDirty(size_t index)
+{
+    dirty_[index / block_size] = 1;
+    any_dirty_ = true;
+}
+
+void InstanceBuffer::grow(const glm::mat4 & model)
+{
+    glm::vec3 origin(model[3]);
+    bounds_min_ = glm::min(bounds_min_, origin);
+    bounds_max_ = glm::max(bounds_max_, origin);
+    float scale = std::max(glm::length(glm::vec3(model[0])),
+        std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    max_scale_ = std::max(max_scale_, scale);
+}
@@ -0,0 +1,69 @@
+#ifndef INSTANCEBUFFER_H
+#define INSTANCEBUFFER_H
+
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// Per-instance data as the instanced shader sees it, std430 layout of
+// "buffer InstanceBuffer { InstanceData instances[]; }"
+struct InstanceData
+{
+	glm::mat4 model;
+	glm::vec4 tint;         // multiplied with the vertex color
+};
+
+const GLuint INSTANCE_DATA_BINDING = 1;
+
+// CPU copy of an instance stream plus the shader storage buffer it is
+// drawn from. Changes are tracked per block of instances, and update()
+// only uploads the blocks touched since the last update, merged into
+// contiguous ranges.
+//
+// Plain value type: the GL buffer is released by destroy(), not the
+// destructor, so objects holding one can live in vectors.
+class InstanceBuffer
+{
+public:
+	static const size_t block_size = 256;
+
+	InstanceBuffer();
+
+	void destroy();
+
+	// Appends an instance, returns its index
+	size_t add(const glm::mat4 & model, const glm::vec4 & tint = glm::vec4(1.0f));
+
+	void setModel(size_t index, const glm::mat4 & model);
+	void setTint(size_t index, const glm::vec4 & tint);
+
+	const InstanceData & operator[](size_t index) const { return instances_[index]; }
+	size_t size() const { return instances_.size(); }
+
+	// Uploads the dirty blocks, (re)creating the GL buffer when it is too
+	// small. Returns the number of bytes uploaded.
+	size_t update();
+
+	GLuint buffer() const { return buffer_; }
+
+	// Bounding sphere of the instance origins, grown as instances move,
+	// plus the largest axis scale of any instance
+	glm::vec3 center() const { return (bounds_min_ + bounds_max_) * 0.5f; }
+	float radius() const { return glm::length(bounds_max_ - center()); }
+	float maxScale() const { return max_scale_; }
+
+private:
+	void markDirty(size_t index);
+	void grow(const glm::mat4 & model);
+
+	std::vector<InstanceData> instances_;
+	std::vector<unsigned char> dirty_;      // one flag per block
+	bool any_dirty_;
+	GLuint buffer_;
+	size_t capacity_;                       // instances the GL buffer holds
+	glm::vec3 bounds_min_, bounds_max_;
+	float max_scale_;
+};
+
+#endif
@@ -0,0 +1,193 @@
+#include "jobsystem.h"
+
+namespace {
+
+// Queue of the current thread in the system it works for; threads that
+// are not workers use queue 0
+thread_local const JobSystem * current_system = NULL;
+thread_local unsigned int current_queue = 0;
+
+// Empty fetches wait() spins through before it sleeps; the job waited
+// for is often a short one another thread is about to finish
+const int wait_spins = 64;
+
+} // namespace
+
+JobSystem::JobSystem(unsigned int worker_count)
+    : queued_(0), waiting_(0), quit_(false)
+{
+    if (worker_count == 0) {
+        unsigned int cores = std::thread::hardware_concurrency();
+        worker_count = cores > 1 ? cores - 1 : 0;
+    }
+    for (unsigned int i = 0; i <= worker_count; i++)
+        queues_.push_back(std::unique_ptr<Queue>(new Queue));
+    for (unsigned int i = 1; i <= worker_count; i++)
+        workers_.push_back(std::thread(&JobSystem::workerLoop, this, i));
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        quit_ = true;
+    }
+    wake_.notify_all();
+    for (size_t i = 0; i < workers_.size(); i++)
+        workers_[i].join();
+}
+
+JobHandle JobSystem::create(const JobFunction & function, const JobHandle & parent)
+{
+    JobHandle job = std::make_shared<Job>();
+    job->function = function;
+    job->parent = parent;
+    job->unfinished = 1;
+    if (parent)
+        parent->unfinished++;
+    return job;
+}
+
+void JobSystem::run(const JobHandle & job)
+{
+    Queue & queue = *queues_[queueIndex()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(job);
+    }
+
+    // Taking the sleep mutex between the increment and the notify makes
+    // sure a worker checking queued_ either sees the job or gets woken
+    queued_++;
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+    }
+    wake_.notify_one();
+}
+
+void JobSystem::wait(const JobHandle & job)
+{
+    unsigned int index = queueIndex();
+    int spins = 0;
+    while (!finished(job)) {
+        JobHandle other = fetch(index);
+        if (other) {
+            execute(other);
+            spins = 0;
+            continue;
+        }
+        if (++spins < wait_spins) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // Nothing to help with: sleep until the job finishes or more work
+        // is queued. waiting_ goes up before the check, so a finish() that
+        // misses it has already made the check pass.
+        spins = 0;
+        waiting_++;
+        {
+            std::unique_lock<std::mutex> lock(sleep_mutex_);
+            wake_.wait(lock, [this, &job]() { return finished(job) || queued_ > 0 || quit_; });
+        }
+        waiting_--;
+    }
+}
+
+void JobSystem::parallelFor(size_t count, size_t grain, const RangeFunction & function)
+{
+    if (count == 0)
+        return;
+    if (grain == 0)
+        grain = 1;
+    if (count <= grain) {
+        function(0, count);
+        return;
+    }
+
+    // The root does nothing itself, it finishes with the last chunk
+    JobHandle root = create(JobFunction());
+    for (size_t begin = 0; begin < count; begin += grain) {
+        size_t end = begin + grain < count ? begin + grain : count;
+        run(create([&function, begin, end]() { function(begin, end); }, root));
+    }
+    run(root);
+    wait(root);
+}
+
+void JobSystem::workerLoop(unsigned int index)
+{
+    current_system = this;
+    current_queue = index;
+    while (!quit_) {
+        JobHandle job = fetch(index);
+        if (job) {
+            execute(job);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        wake_.wait(lock, [this]() { return quit_ || queued_ > 0; });
+    }
+}
+
+JobHandle JobSystem::fetch(unsigned int index)
+{
+    if (queued_ == 0)
+        return JobHandle();
+
+    // Newest of our own first, it is the most likely to be in cache
+    {
+        Queue & own = *queues_[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.jobs.empty()) {
+            JobHandle job = own.jobs.back();
+            own.jobs.pop_back();
+            queued_--;
+            return job;
+        }
+    }
+
+    // Then the oldest of someone else's, usually the biggest piece left
+    size_t count = queues_.size();
+    for (size_t i = 1; i < count; i++) {
+        Queue & victim = *queues_[(index + i) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.jobs.empty()) {
+            JobHandle job = victim.jobs.front();
+            victim.jobs.pop_front();
+            queued_--;
+            return job;
+        }
+    }
+    return JobHandle();
+}
+
+void JobSystem::execute(const JobHandle & job)
+{
+    if (job->function)
+        job->function();
+    finish(job.get());
+}
+
+void JobSystem::finish(Job * job)
+{
+    // The last of a job and its children to finish finishes the parent
+    bool done = false;
+    while (job && --job->unfinished == 0) {
+        job = job->parent.get();
+        done = true;
+    }
+
+    // Same handshake as in run() for the threads sleeping in wait()
+    if (done && waiting_ > 0) {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+        }
+        wake_.notify_all();
+    }
+}
+
+unsigned int JobSystem::queueIndex() const
+{
+    return current_system == this ? current_queue : 0;
+}
@@ -0,0 +1,75 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef std::function<void()> JobFunction;
+typedef std::function<void(size_t begin, size_t end)> RangeFunction;
+
+// A unit of work. A job counts as finished once its function has run
+// and all of its children have finished.
+struct Job
+{
+	JobFunction function;
+	std::shared_ptr<Job> parent;
+	std::atomic<int> unfinished;    // itself plus unfinished children
+};
+
+typedef std::shared_ptr<Job> JobHandle;
+
+// Work-stealing job system. Every thread has its own deque: the owner
+// pushes and pops at the back, idle threads steal from the front of the
+// others. The thread that created the system takes part as queue 0
+// whenever it waits, so with no workers everything runs inline in wait().
+class JobSystem
+{
+public:
+	// worker_count 0 picks one worker per core besides the calling thread
+	explicit JobSystem(unsigned int worker_count = 0);
+	~JobSystem();
+
+	// Children must be created before their parent is run
+	JobHandle create(const JobFunction & function, const JobHandle & parent = JobHandle());
+	void run(const JobHandle & job);
+
+	// Runs other jobs until job has finished, sleeps when there are none
+	void wait(const JobHandle & job);
+	static bool finished(const JobHandle & job) { return job->unfinished.load() == 0; }
+
+	// Calls function on chunks of [0, count) of at most grain elements,
+	// in parallel, and returns when all are done
+	void parallelFor(size_t count, size_t grain, const RangeFunction & function);
+
+	// Threads taking jobs, workers plus the calling thread
+	unsigned int threadCount() const { return (unsigned int)queues_.size(); }
+
+private:
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<JobHandle> jobs;
+	};
+
+	void workerLoop(unsigned int index);
+	JobHandle fetch(unsigned int index);
+	void execute(const JobHandle & job);
+	void finish(Job * job);
+	unsigned int queueIndex() const;
+
+	std::vector<std::unique_ptr<Queue> > queues_;
+	std::vector<std::thread> workers_;
+	std::atomic<int> queued_;           // jobs in all queues
+	std::atomic<int> waiting_;          // threads asleep in wait()
+	std::atomic<bool> quit_;
+	std::mutex sleep_mutex_;
+	std::condition_variable wake_;      // workers and waiters sleep on it
+};
+
+#endif
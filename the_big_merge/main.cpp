@@ -4,7 +4,14 @@
 #include <string>
 #include <math.h>
 #include <cstdlib>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
 #include <GL/glew.h>
+#ifdef _WIN32
+#include <GL/wglew.h>
+#endif
 #include <GL/freeglut.h>
 
 #include <glm/glm.hpp>
@@ -12,7 +19,25 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "objloader.h"
+#include "meshopt.h"
+#include "simplify.h"
+#include "vertexformat.h"
+#include "bufferarena.h"
+#include "drawbatch.h"
+#include "instancebuffer.h"
+#include "cull.h"
+#include "bvh.h"
+#include "transform.h"
+#include "framescheduler.h"
+#include "jobsystem.h"
+#include "assetmanager.h"
+#include "atlas.h"
+#include "shadermanager.h"
 #include "texture.h"
+#include "uniformblocks.h"
+#include "glcallcounter.h"
+#include "renderqueue.h"
+#include "statecache.h"
 
 
 #include "glsl.h"
@@ -26,6 +51,7 @@ using namespace glm;
 //--------------------------------------------------------------------------------
 
 const int WIDTH = 800, HEIGHT = 600;
+const float FAR_PLANE = 20.0f;
 
 const char* Pfragshader_name = "Pfragmentshader.frag";
 const char* Pvertexshader_name = "Pvertexshader.vert";
@@ -33,12 +59,16 @@ const char* Pvertexshader_name = "Pvertexshader.vert";
 const char* Ofragshader_name = "Ofragmentshader.frag";
 const char* Overtexshader_name = "Overtexshader.vert";
 
+const char* Ivertexshader_name = "Ivertexshader.vert";
+
 
 vec3 light_position = vec3(4, 4, 4),
     ambient_color = vec3(0.25, 0.25, .25),
     diffuse_color = vec3(.75, .75, .75);
 
-unsigned const int DELTA_TIME = 10;
+unsigned const int DELTA_TIME = 10;     // simulation tick in ms
+const double TARGET_FPS = 60.0;         // vsync and capped frame rate
+const float SPIN_SPEED = 1.0f;          // rad/s, the old 0.01 per 10 ms frame
 
 
 //--------------------------------------------------------------------------------
@@ -46,9 +76,84 @@ unsigned const int DELTA_TIME = 10;
 //--------------------------------------------------------------------------------
 
 // ID's
-GLuint P_program_id, O_program_id;
+GLuint P_program_id, O_program_id, I_program_id;
+GLuint instanced_vao;   // primitive_arena's buffers with I_program_id's attributes
 //GLuint vao;
 
+// Shared vertex/index buffers, one per vertex format
+BufferArena primitive_arena, textured_arena;
+
+// World space bounds for frustum culling and the objects that passed
+CullTable primitive_bounds, textured_bounds;
+vector<unsigned int> primitive_visible, textured_visible;
+
+// Hierarchies over the same bounds, for culling and picking
+Bvh primitive_bvh, textured_bvh;
+
+// World and mv matrices of every object, recomputed only when they change
+TransformHierarchy transforms;
+
+// Per frame draw lists, submitted with multi-draw-indirect
+DrawBatch primitive_batch, textured_batch;
+bool use_multi_draw = true;
+
+// All of a frame's draws, sorted by state and submitted through a cache
+// of the GL bindings that drops the ones already made
+RenderQueue render_queue;
+GLStateCache gl_state;
+
+// Submission stats, printed every STATS_FRAMES frames
+const unsigned int STATS_FRAMES = 256;
+unsigned int stats_frames = 0, stats_draw_calls = 0, stats_visible = 0;
+double stats_cpu_ms = 0;
+
+// GL calls by function and state changes by kind, added to the stats
+// while G has them on. The counting wrappers are only installed then.
+bool gl_call_stats = false;
+unsigned int gl_call_frames = 0;
+
+// Fixed timestep simulation, rendered interpolated between the last two
+// ticks at whatever rate frames come
+SteadyClock frame_clock;
+FrameScheduler scheduler(frame_clock, DELTA_TIME / 1000.0);
+bool frame_timer_armed = false;
+float spin_angle = 0, previous_spin_angle = 0;
+
+// Frame preparation runs on the job system, GL calls stay on this thread
+unique_ptr<JobSystem> jobs;
+const size_t PREPARE_GRAIN = 256;       // objects per job
+
+// Meshes and textures shared by content and kept while used; unused
+// ones stay cached until the budgets push them out
+GLResourceBackend resource_backend;
+ResourceCache resources;
+const size_t RESOURCE_CPU_BUDGET = 16 << 20;
+const size_t RESOURCE_GPU_BUDGET = 256 << 20;
+
+// Programs start from stored binaries and are rebuilt when their shader
+// files are edited; names stay the same, uniforms must be sent again
+ShaderManager shaders;
+
+// Camera, light and material reach every program through shared uniform
+// blocks; per-object blocks of instanced draws go through a ring
+UniformBlocks uniform_blocks;
+ProgramInterface P_interface, O_interface, I_interface;
+unsigned int default_material;
+const size_t UNIFORM_RING_BYTES = 1 << 20;
+
+// Meshes and textures stream in on loader threads; uploads are spread
+// over frames so a big asset never costs more than a couple of ms
+AssetManager assets;
+const size_t ASSET_STAGING_BYTES = 16 << 20;
+const size_t ASSET_UPLOAD_BYTES = 4 << 20;      // per frame
+const double ASSET_UPLOAD_MS = 2.0;             // per frame
+
+// Textures of textured objects share the layers of one array texture, so
+// all of them draw with a single bind
+TextureAtlas texture_atlas;
+const unsigned int ATLAS_PAGE_SIZE = 2048;
+const unsigned int ATLAS_LEVELS = 4;            // mips kept, 8 texel borders
+
 // Matrices
 mat4 view, projection;
 
@@ -72,15 +177,19 @@ mat4 view, projection;
 
 struct primitive_object
 {
-    GLuint vao;
+    ArenaRange range;       // where the mesh lives in primitive_arena
 
     vector<GLfloat> vertices;
     vector<GLfloat> normals;
     vector<GLfloat> colors;
     vector<GLushort> elements;
-    mat4 model;
-    mat4 mv;
-    GLuint uniform_mvp;
+    vector<MeshLod> lods;   // ranges of elements, lods[0] is the full mesh
+    vec3 center;            // bounding sphere and box in object space
+    float radius;
+    vec3 extents;
+    QuantizationRange quantization;
+    mat4 model;             // local transform, relative to the parent
+    TransformId transform;  // node in transforms, world and mv live there
     GLchar type;
     primitive_object() {
         vector<GLfloat> fl;
@@ -91,8 +200,8 @@ struct primitive_object
         colors = fl;
         elements = sh;
         model = mat4();
-        mv = mat4();
-        uniform_mvp = NULL;
+        transform = NO_TRANSFORM;
+        radius = 0;
         type = GL_TRIANGLES;
     }
     primitive_object(vector<GLfloat> v,
@@ -104,44 +213,58 @@ struct primitive_object
         normals = n;
         colors = c;
         elements = e;
+        MeshLod full = { 0, (unsigned int)e.size(), 0.0f };
+        lods.assign(1, full);
+        vec3 bounds_min, bounds_max;
+        computeBounds(&v[0], v.size() / 3, 3, bounds_min, bounds_max);
+        center = (bounds_min + bounds_max) * 0.5f;
+        radius = length(bounds_max - center);
+        extents = bounds_max - center;
         model = mat4();
-        uniform_mvp = NULL;
+        transform = NO_TRANSFORM;
         type = t;
     }
 };
 
 vector<primitive_object> primitive_objects;
 
+// Many copies of one primitive mesh, drawn with a single instanced draw
+struct instanced_object
+{
+    primitive_object mesh;      // shared by all instances, uploaded once
+    InstanceBuffer instances;   // model matrix and tint per instance
+    instanced_object() {
+    }
+    instanced_object(const primitive_object& m) {
+        mesh = m;
+    }
+};
+
+vector<instanced_object> instanced_objects;
+
 struct textured_object
 {
-    GLuint vao;
-
-    vector<vec3> vertices;
-    vector<vec3> normals;
-    vector<vec2> uvs;
-    mat4 model;
-    mat4 mv;
-    GLuint uniform_mv;
+    ArenaRange range;       // where the mesh lives in textured_arena
+
+    string mesh_path;       // streamed in by assets, placeholders until then
+    string texture_path;    // packed into texture_atlas at load
+    ResourceHandle mesh_resource;       // keeps the loaded one resident
+    AtlasEntry atlas;       // where the texture is in texture_atlas
+    vector<MeshLod> lods;   // ranges of the index buffer, lods[0] is the full mesh
+    vec3 center;            // bounding sphere and box in object space
+    float radius;
+    vec3 extents;
+    QuantizationRange quantization;
+    mat4 model;             // local transform, relative to the parent
+    TransformId transform;  // node in transforms, world and mv live there
     GLuint texture_id;
     textured_object() {
-        vector<vec3> v;
-        vector<vec3> n;
-        vector<vec2> u;
-        vertices = v;
-        normals = n;
-        uvs = u;
+        radius = 0;
         model = mat4();
+        transform = NO_TRANSFORM;
         texture_id = NULL;
-    }
-    textured_object(vector<vec3> v,
-        vector<vec2> u,
-        vector<vec3> n,
-        GLuint id) {
-        vertices = v;
-        normals = n;
-        uvs = u;
-        texture_id = id;
-        model = mat4();
+        atlas.layer = atlas.x = atlas.y = atlas.width = atlas.height = 0;
+        atlas.rect = vec4(0, 0, 1, 1);
     }
 };
 
@@ -151,6 +274,22 @@ vec3 playerPosition = vec3(2.0, 2.0, -10.0);
 vec3 lookVector = vec3();
 vec2 th_ph = vec2(0, 0);
 
+//------------------------------------------------------------
+// void set_pacing(FramePacing pacing)
+// Switches the frame pacing mode, vsync through the swap interval
+//------------------------------------------------------------
+
+void set_pacing(FramePacing pacing)
+{
+    scheduler.setPacing(pacing, TARGET_FPS);
+#ifdef _WIN32
+    if (WGLEW_EXT_swap_control)
+        wglSwapIntervalEXT(pacing == PACE_VSYNC ? 1 : 0);
+#endif
+    static const char* names[] = { "vsync", "capped", "uncapped" };
+    printf("frame pacing: %s\n", names[pacing]);
+}
+
 //--------------------------------------------------------------------------------
 // Keyboard handling
 //--------------------------------------------------------------------------------
@@ -187,6 +326,46 @@ void keyboardHandler(unsigned char key, int a, int b)
     //if (key == 109) // M
         //useMouse = true;
 
+    if (key == 98) {  //B
+        use_multi_draw = !use_multi_draw;
+        printf("multi-draw-indirect %s\n", use_multi_draw ? "on" : "off");
+    }
+
+    if (key == 118) {  //V
+        // Cycle vsync -> capped -> uncapped
+        set_pacing((FramePacing)((scheduler.pacing() + 1) % 3));
+    }
+
+    if (key == 102)    //F
+        scheduler.report(stdout);
+
+    if (key == 103) {  //G
+        gl_call_stats = !gl_call_stats;
+        if (gl_call_stats) {
+            resetGLCallCounts();
+            gl_call_frames = 0;
+            installGLCallCounter();
+        }
+        else {
+            removeGLCallCounter();
+        }
+        printf("gl call stats %s\n", gl_call_stats ? "on" : "off");
+    }
+
+    if (key == 112) {  //P
+        // Pick along the view direction, nearest box of either kind
+        vec3 direction = lookVector - playerPosition;
+        float primitive_distance, textured_distance;
+        int primitive_hit = primitive_bvh.raycast(playerPosition, direction, 1000.0f, primitive_distance);
+        int textured_hit = textured_bvh.raycast(playerPosition, direction, 1000.0f, textured_distance);
+        if (primitive_hit >= 0 && (textured_hit < 0 || primitive_distance <= textured_distance))
+            printf("picked primitive object %d at %.2f\n", primitive_hit, primitive_distance);
+        else if (textured_hit >= 0)
+            printf("picked textured object %d at %.2f\n", textured_hit, textured_distance);
+        else
+            printf("picked nothing\n");
+    }
+
     //overflow protection
     th_ph.x -= radians(360.0f) * (th_ph.x >= radians(360.0f));
     th_ph.x += radians(360.0f) * (th_ph.x < 0);
@@ -211,62 +390,314 @@ void keyboardHandler(unsigned char key, int a, int b)
 // Rendering
 //--------------------------------------------------------------------------------
 
+//------------------------------------------------------------
+// unsigned int lod_for(...)
+// Picks a level of detail from the projected size of its error
+//------------------------------------------------------------
+
+unsigned int lod_for(const vector<MeshLod>& lods, const mat4& mv, vec3 center, float radius)
+{
+    vec4 c = mv * vec4(center, 1.0);
+    float scale = std::max(length(vec3(mv[0])), std::max(length(vec3(mv[1])), length(vec3(mv[2]))));
+    float distance = -c.z - radius * scale;
+    float pixels_per_unit = projection[1][1] * HEIGHT * 0.5f;
+    return selectLod(lods, distance, scale, pixels_per_unit);
+}
+
+//------------------------------------------------------------
+// void update_bvh(...)
+// Refits the hierarchy to this frame's bounds, rebuilding it when
+// objects were added or removed or refitting degraded it too much
+//------------------------------------------------------------
+
+void update_bvh(Bvh& bvh, const CullTable& bounds)
+{
+    if (bvh.size() != bounds.size())
+        bvh.build(bounds);
+    else {
+        bvh.refit(bounds);
+        if (bvh.needsRebuild())
+            bvh.build(bounds);
+    }
+}
+
+// Draws with the same key share a batch: one per texture for textured
+// objects, which the atlas makes a single one, and one for primitives
+unsigned int batch_key(const primitive_object&)
+{
+    return 0;
+}
+
+unsigned int batch_key(const textured_object& obj)
+{
+    return obj.texture_id;
+}
+
+// What the shaders get for a visible object
+DrawData draw_data(const primitive_object& obj, const mat4& mv)
+{
+    return makeDrawData(mv, obj.quantization);
+}
+
+DrawData draw_data(const textured_object& obj, const mat4& mv)
+{
+    return makeDrawData(mv, obj.quantization, obj.atlas.rect, obj.atlas.layer);
+}
+
+//------------------------------------------------------------
+// void prepare_objects(...)
+// Brings bounds and hierarchy up to date, culls and fills the draw
+// batch of one kind of object. No GL calls, runs as a job.
+//------------------------------------------------------------
+
+template <typename Object>
+void prepare_objects(vector<Object>& objects, CullTable& bounds, Bvh& bvh, const Frustum& frustum,
+    vector<unsigned int>& visible, DrawBatch& batch)
+{
+    // Bounds only move with their object's world matrix
+    bool resized = bounds.size() != objects.size();
+    atomic<bool> moved(resized);
+    bounds.resize(objects.size());
+    jobs->parallelFor(objects.size(), PREPARE_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            Object* obj = &objects[i];
+            if (!resized && !transforms.changed((*obj).transform))
+                continue;
+            bounds.setTransformed(i, transforms.world((*obj).transform),
+                (*obj).center, (*obj).radius, (*obj).extents);
+            moved = true;
+        }
+    });
+
+    // Only objects whose world box touches the frustum are drawn; the
+    // hierarchy skips whole groups, sorting keeps the draw order stable
+    if (moved)
+        update_bvh(bvh, bounds);
+    bvh.cullFrustum(frustum, visible);
+    sort(visible.begin(), visible.end());
+
+    // Lod selection in parallel, then queue mv, dequantization range and
+    // the lod's range of the arena, in batches of the same key
+    vector<const MeshLod*> lods(visible.size());
+    jobs->parallelFor(visible.size(), PREPARE_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; v++) {
+            Object* obj = &objects[visible[v]];
+            const mat4& mv = transforms.mv((*obj).transform);
+            lods[v] = &(*obj).lods[lod_for((*obj).lods, mv, (*obj).center, (*obj).radius)];
+        }
+    });
+    batch.clear();
+    for (size_t v = 0; v < visible.size(); v++) {
+        Object* obj = &objects[visible[v]];
+        batch.add((*obj).range, *lods[v], draw_data(*obj, transforms.mv((*obj).transform)), batch_key(*obj));
+    }
+}
+
+//------------------------------------------------------------
+// void Simulate(double dt)
+// Advances the animation by one fixed tick
+//------------------------------------------------------------
+
+void Simulate(double dt)
+{
+    previous_spin_angle = spin_angle;
+    spin_angle += SPIN_SPEED * (float)dt;
+}
+
+//------------------------------------------------------------
+// void ScheduleFrame()
+// Asks GLUT for the next frame when the scheduler wants it
+//------------------------------------------------------------
+
+void Render(int n);
+void InitUniforms();
+
+void ScheduleFrame()
+{
+    double wait = scheduler.timeUntilNextFrame();
+    if (wait <= 0.0)
+        glutPostRedisplay();
+    else if (!frame_timer_armed) {
+        frame_timer_armed = true;
+        glutTimerFunc((unsigned int)(wait * 1000.0), Render, 0);
+    }
+}
+
 void Render()
 {
+    // Reloaded programs have lost their loose uniforms, blocks stay bound
+    if (shaders.update())
+        InitUniforms();
+
+    // Finished loads swap their placeholders before anything is prepared
+    if (assets.update(ASSET_UPLOAD_BYTES, ASSET_UPLOAD_MS) && assets.pending() == 0) {
+        assets.report();
+        resources.report();
+    }
+
+    unsigned int ticks = scheduler.beginFrame();
+    for (unsigned int i = 0; i < ticks; i++)
+        Simulate(scheduler.tick());
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    unsigned int draw_calls = 0;
+
     glClearColor(0.0, 0.0, 0.0, 1.0);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    // Attach to program_id
-    glUseProgram(P_program_id);
-
+    Frustum frustum = extractFrustum(projection * view);
+
+    // Camera and light for every program, one block per frame
+    FrameUniforms frame;
+    frame.view = view;
+    frame.projection = projection;
+    frame.light_pos = vec4(light_position, 1.0f);
+    uniform_blocks.beginFrame(frame);
+    uniform_blocks.bindMaterial(default_material);
+
+    // Same rotation for every root, interpolated between the last two
+    // ticks and built once. Children keep their local matrix and spin with
+    // their parent, spinning them too would turn them twice.
+    float angle = previous_spin_angle + (spin_angle - previous_spin_angle) * (float)scheduler.alpha();
+    const mat4 spin = rotate(mat4(), angle, vec3(0.0f, 1.0f, 0.0f));
     for (unsigned int i = 0; i < primitive_objects.size(); i++)
     {
         primitive_object* obj = &primitive_objects[i];
+        if (transforms.parent((*obj).transform) != NO_TRANSFORM)
+            continue;
         // Do transformation
-        (*obj).model = rotate((*obj).model, 0.01f, vec3(0.0f, 1.0f, 0.0f));
-        (*obj).mv = view * (*obj).model;
+        transforms.setLocal((*obj).transform, (*obj).model * spin);
+    }
 
-        // Send mvp
-        glUniformMatrix4fv((*obj).uniform_mvp, 1, GL_FALSE, value_ptr((*obj).mv));
+    // World matrices of changed subtrees, mv of those or of all after a
+    // camera move
+    transforms.update(view, jobs.get());
+
+    // Both kinds are culled and batched at the same time
+    JobHandle prepare = jobs->create(JobFunction());
+    jobs->run(jobs->create([&frustum]() {
+        prepare_objects(primitive_objects, primitive_bounds, primitive_bvh, frustum,
+            primitive_visible, primitive_batch);
+    }, prepare));
+    jobs->run(jobs->create([&frustum]() {
+        prepare_objects(textured_objects, textured_bounds, textured_bvh, frustum,
+            textured_visible, textured_batch);
+    }, prepare));
+    jobs->run(prepare);
+    jobs->wait(prepare);
+    stats_visible += (unsigned int)(primitive_visible.size() + textured_visible.size());
+
+    // Every draw of the frame goes through the queue, sorted by state
+    render_queue.clear();
+    primitive_batch.record(render_queue, P_program_id);
+    for (unsigned int i = 0; i < instanced_objects.size(); i++)
+    {
+        instanced_object* obj = &instanced_objects[i];
+        if ((*obj).instances.size() == 0)
+            continue;
+
+        // Only the blocks changed since the last frame are uploaded
+        (*obj).instances.update();
+        RenderCommand command;
+        command.program = I_program_id;
+        command.vao = instanced_vao;
+        command.storage_binding = INSTANCE_DATA_BINDING;
+        command.storage_buffer = (*obj).instances.buffer();
+
+        // A full ring leaves the last object block bound, see UniformBlocks
+        ObjectUniforms object;
+        object.pos_offset = vec4((*obj).mesh.quantization.position_offset, 0.0f);
+        object.pos_scale = vec4((*obj).mesh.quantization.position_scale, 0.0f);
+        if (uniform_blocks.writeObject(object, command.uniform_offset)) {
+            command.uniform_binding = OBJECT_BLOCK_BINDING;
+            command.uniform_buffer = uniform_blocks.ringBuffer();
+            command.uniform_size = sizeof(ObjectUniforms);
+        }
 
-        // Send vao
-        glBindVertexArray((*obj).vao);
-        glDrawElements(GL_TRIANGLES, (*obj).elements.size(),
-            GL_UNSIGNED_SHORT, 0);
-        glBindVertexArray(0);
+        // One lod for all instances, picked for the nearest edge of their bounds
+        float radius = (*obj).instances.radius()
+            + (length((*obj).mesh.center) + (*obj).mesh.radius) * (*obj).instances.maxScale();
+        const MeshLod& lod = (*obj).mesh.lods[lod_for((*obj).mesh.lods, view, (*obj).instances.center(), radius)];
+        command.index_type = (*obj).mesh.range.index_type;
+        command.index_count = lod.index_count;
+        command.index_offset = (size_t)primitive_arena.indexPointer((*obj).mesh.range, lod.first_index);
+        command.instance_count = (GLsizei)(*obj).instances.size();
+        command.base_vertex = (*obj).mesh.range.base_vertex;
+
+        // Front to back by the center of the instances
+        float depth = -(view * vec4((*obj).instances.center(), 1.0f)).z / FAR_PLANE;
+        render_queue.record(command, depth);
     }
+    textured_batch.record(render_queue, O_program_id, GL_TEXTURE_2D_ARRAY);
 
-    glUseProgram(O_program_id);
+    draw_calls += render_queue.submit(gl_state, use_multi_draw);
 
-    for (unsigned int i = 0; i < textured_objects.size(); i++) {
-        textured_object *obj = &textured_objects[i];
-        (*obj).mv = view * (*obj).model;
-
-        // Send mv
-        glUniformMatrix4fv((*obj).uniform_mv, 1, GL_FALSE, value_ptr((*obj).mv));
+    uniform_blocks.endFrame();
+    glutSwapBuffers();
 
-        // Send vao
-        glBindVertexArray((*obj).vao);
-        glDrawArrays(GL_TRIANGLES, 0, (*obj).vertices.size());
-        glBindVertexArray(0);
+    // CPU time from clear to swap, which includes driver work on software
+    // renderers like llvmpipe
+    stats_cpu_ms += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    stats_draw_calls += draw_calls;
+    gl_call_frames += gl_call_stats;
+    if (++stats_frames == STATS_FRAMES) {
+        const FramePacingStats& pacing = scheduler.stats();
+        printf("%s: %u objects, %.1f visible, %.1f draw calls/frame, %.1f texture binds/frame, "
+            "%.3f ms cpu/frame, frame time p50 %.2f ms p99 %.2f ms, %u missed\n",
+            use_multi_draw ? "multi-draw-indirect" : "direct",
+            (unsigned int)(primitive_objects.size() + textured_objects.size()),
+            (double)stats_visible / STATS_FRAMES, (double)stats_draw_calls / STATS_FRAMES,
+            (double)gl_state.stats().issued[STATE_TEXTURE] / STATS_FRAMES,
+            stats_cpu_ms / STATS_FRAMES, pacing.percentile(0.5), pacing.percentile(0.99), pacing.missed);
+        if (gl_call_stats) {
+            gl_state.report(STATS_FRAMES);
+            reportGLCalls(gl_call_frames);
+            resetGLCallCounts();
+            gl_call_frames = 0;
+        }
+        gl_state.resetStats();
+        stats_frames = stats_draw_calls = stats_visible = 0;
+        stats_cpu_ms = 0;
+        scheduler.resetStats();
     }
 
-    glutSwapBuffers();
+    ScheduleFrame();
 }
 
 
 //------------------------------------------------------------
 // void Render(int n)
-// Render method that is called by the timer function
+// Timer callback for capped frames, the frame itself is drawn by the
+// display function
 //------------------------------------------------------------
 
 void Render(int n)
 {
-    Render();
-    glutTimerFunc(DELTA_TIME, Render, 0);
+    frame_timer_armed = false;
+    glutPostRedisplay();
 }
 
 
+//------------------------------------------------------------
+// void Shutdown()
+// Frees what the resource cache and the asset manager hold while the
+// context is still there
+//------------------------------------------------------------
+
+void Shutdown()
+{
+    for (unsigned int i = 0; i < textured_objects.size(); i++) {
+        textured_objects[i].mesh_resource.reset();
+    }
+    texture_atlas.destroy();
+    uniform_blocks.destroy();
+    shaders.report();
+    shaders.destroy();
+    resources.report();
+    assets.destroy();
+    resources.clear();
+}
+
 //------------------------------------------------------------
 // void InitGlutGlew(int argc, char **argv)
 // Initializes Glut and Glew
@@ -280,9 +711,10 @@ void InitGlutGlew(int argc, char** argv)
     glutCreateWindow("Hello OpenGL");
     glutDisplayFunc(Render);
     glutKeyboardFunc(keyboardHandler);
-    glutTimerFunc(DELTA_TIME, Render, 0);
+    glutCloseFunc(Shutdown);
 
     glewInit();
+    resources.create(resource_backend, RESOURCE_CPU_BUDGET, RESOURCE_GPU_BUDGET);
 }
 
 
@@ -293,25 +725,36 @@ void InitGlutGlew(int argc, char** argv)
 
 void InitShaders()
 {
+    shaders.create();
+
     //  PRIMITIVE
-    char* Pvertexshader = glsl::readFile(Pvertexshader_name);
-    GLuint Pvsh_id = glsl::makeVertexShader(Pvertexshader);
+    P_program_id = shaders.load(Pvertexshader_name, Pfragshader_name);
 
-    char* Pfragshader = glsl::readFile(Pfragshader_name);
-    GLuint Pfsh_id = glsl::makeFragmentShader(Pfragshader);
+    //  LOADED
+    O_program_id = shaders.load(Overtexshader_name, Ofragshader_name);
 
-    P_program_id = glsl::makeShaderProgram(Pvsh_id, Pfsh_id);
+    //  INSTANCED, shares the primitive fragment shader
+    I_program_id = shaders.load(Ivertexshader_name, Pfragshader_name);
 
-    ///////////////////////////////////////////////////////
+    shaders.report();
+}
 
-    //  LOADED
-    char* Overtexshader = glsl::readFile(Overtexshader_name);
-    GLuint Ovsh_id = glsl::makeVertexShader(Overtexshader);
 
-    char* Ofragshader = glsl::readFile(Ofragshader_name);
-    GLuint Ofsh_id = glsl::makeFragmentShader(Ofragshader);
+//------------------------------------------------------------
+// void InitUniforms()
+// Checks the programs against the shared uniform blocks and sets what
+// is outside them; again whenever a shader was reloaded
+//------------------------------------------------------------
+
+void InitUniforms()
+{
+    P_interface.reflect(P_program_id);
+    O_interface.reflect(O_program_id);
+    I_interface.reflect(I_program_id);
 
-    O_program_id = glsl::makeShaderProgram(Ovsh_id, Ofsh_id);
+    // The atlas is bound to unit 0
+    glUseProgram(O_program_id);
+    glUniform1i(O_interface.location("texsampler"), 0);
 }
 
 
@@ -332,14 +775,7 @@ void InitMatrices()
     projection = perspective(
         radians(45.0f),
         1.0f * WIDTH / HEIGHT, 0.1f,
-        20.0f);
-    for (unsigned int i = 0; i < primitive_objects.size(); i++){
-        primitive_objects[i].mv = view * primitive_objects[i].model;
-    }
-    for (unsigned int i = 0; i < textured_objects.size(); i++) {
-        textured_objects[i].mv = view * textured_objects[i].model;
-    }
-    
+        FAR_PLANE);
 }
 
 primitive_object merge_prim(primitive_object p1, primitive_object p2) {
@@ -362,15 +798,80 @@ primitive_object merge_prim(primitive_object p1, primitive_object p2) {
     return primitive_object();
 }
 
+//------------------------------------------------------------
+// void optimize_prim(primitive_object& obj, const char* name)
+// Reorders triangles and vertices of a generated mesh for the
+// post-transform cache and vertex fetch, and builds its LOD chain
+//------------------------------------------------------------
+
+void optimize_prim(primitive_object& obj, const char* name)
+{
+    size_t vertex_count = obj.vertices.size() / 3;
+    vector<unsigned int> indices(obj.elements.begin(), obj.elements.end());
+    VertexCacheStats before = analyzeVertexCache(indices, vertex_count);
+
+    optimizeVertexCache(indices, vertex_count);
+    optimizeOverdraw(indices, &obj.vertices[0], vertex_count, 3);
+
+    vector<unsigned int> remap;
+    size_t used = optimizeVertexFetchRemap(remap, indices, vertex_count);
+    remapIndexBuffer(indices, remap);
+    remapVertexStream(obj.vertices, 3, remap, used);
+    remapVertexStream(obj.normals, 3, remap, used);
+    remapVertexStream(obj.colors, 3, remap, used);
+
+    VertexCacheStats after = analyzeVertexCache(indices, used);
+    printf("%s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", name,
+        before.acmr, after.acmr, before.atvr, after.atvr);
+
+    // Coarser levels are appended to the same element buffer
+    buildLodChain(indices, &obj.vertices[0], used, 3, obj.lods, name);
+    obj.elements.assign(indices.begin(), indices.end());
+}
+
 textured_object make_OBJ(const char* text, const char* obj) {
-    vector<vec3> tmp_v, tmp_n;
-    vector<vec2> tmp_u;
-    bool res = loadOBJ(obj, tmp_v, tmp_u, tmp_n);
-    textured_object out(tmp_v, tmp_u, tmp_n, loadBMP(text));
+    // Only remembers the files, InitBuffers requests them from assets
+    textured_object out;
+    out.mesh_path = obj;
+    out.texture_path = text;
     return (out);
 
 }
 
+//------------------------------------------------------------
+// void set_mesh(textured_object& obj, const MeshAsset& mesh)
+// Points an object at a mesh in textured_arena
+//------------------------------------------------------------
+
+void set_mesh(textured_object& obj, const MeshAsset& mesh)
+{
+    obj.range = mesh.range;
+    obj.lods = mesh.lods;
+    obj.quantization = mesh.quantization;
+    obj.center = (mesh.bounds_min + mesh.bounds_max) * 0.5f;
+    obj.radius = length(mesh.bounds_max - obj.center);
+    obj.extents = mesh.bounds_max - obj.center;
+}
+
+//------------------------------------------------------------
+// instanced_object make_instanced_grid(...)
+// Places count copies of mesh on a square grid in the xz plane,
+// tinted by their position in it
+//------------------------------------------------------------
+
+instanced_object make_instanced_grid(const primitive_object& mesh, unsigned int count, float spacing)
+{
+    instanced_object out(mesh);
+    unsigned int side = (unsigned int)ceilf(sqrtf((float)count));
+    for (unsigned int i = 0; i < count; i++) {
+        unsigned int x = i % side, z = i / side;
+        mat4 model = translate(mat4(), vec3((x - side * 0.5f) * spacing, 0, (z - side * 0.5f) * spacing));
+        vec4 tint((float)x / side, 1.0f, (float)z / side, 1.0f);
+        out.instances.add(model, tint);
+    }
+    return out;
+}
+
 void InitObjects()
 {
     //make primitive cube
@@ -602,7 +1103,7 @@ void InitObjects()
 
         GLchar cone_ch = GL_TRIANGLES;
         cone_obj  = primitive_object(cone_vec, cone_norm, cone_col, cone_el, cone_ch);
-        cone_obj.model = translate(mat4(), vec3(2, 1, 0));
+        cone_obj.model = translate(mat4(), vec3(0, 1, 0));  // on top of the cilinder
     }
 
     //make primitive cilinder
@@ -688,21 +1189,75 @@ void InitObjects()
         cilinder_obj.model = translate(mat4(), vec3(2, 0, 0));
     }
 
+    optimize_prim(cube_obj, "cube");
+    optimize_prim(skybox_obj, "skybox");
+    optimize_prim(plane_obj, "plane");
+    optimize_prim(circle_obj, "circle");
+    optimize_prim(cone_obj, "cone");
+    optimize_prim(cilinder_obj, "cilinder");
+
+    // The cone sits on the cilinder and follows it. Their nodes go in
+    // together with the objects, a node nobody draws is still updated
+    // every frame.
+    //cilinder_obj.transform = transforms.add(cilinder_obj.model);
+    //cone_obj.transform = transforms.add(cone_obj.model, cilinder_obj.transform);
+
     //primitive_objects.push_back(skybox_obj);
     //primitive_objects.push_back(cube_obj);
     //primitive_objects.push_back(plane_obj);
     //primitive_objects.push_back(circle_obj);
     //primitive_objects.push_back(cone_obj);
     //primitive_objects.push_back(cilinder_obj);
+
+    //instanced_objects.push_back(make_instanced_grid(cube_obj, 100000, 3.0f));
     
     ////////////////////////////////////////////////////
     
     textured_object box = make_OBJ("Textures/uvtemplate.bmp", "objects/box.obj");
     box.model = translate(mat4(), vec3(0, 1, 0));
     textured_objects.push_back(box);
+
+    // Everything without a parent is a root of the hierarchy
+    for (unsigned int i = 0; i < primitive_objects.size(); i++)
+        if (primitive_objects[i].transform == NO_TRANSFORM)
+            primitive_objects[i].transform = transforms.add(primitive_objects[i].model);
+    for (unsigned int i = 0; i < textured_objects.size(); i++)
+        if (textured_objects[i].transform == NO_TRANSFORM)
+            textured_objects[i].transform = transforms.add(textured_objects[i].model);
 }
 
 
+//------------------------------------------------------------
+// void InitAtlas()
+// Packs the textures of all textured objects into texture_atlas, each
+// file once, and points the objects at their place in it. Blocks on the
+// GL thread until every page is built, once, before the first frame.
+//------------------------------------------------------------
+
+void InitAtlas()
+{
+    vector<string> paths;
+    vector<size_t> entries(textured_objects.size());
+    for (unsigned int i = 0; i < textured_objects.size(); i++) {
+        const string& path = textured_objects[i].texture_path;
+        entries[i] = find(paths.begin(), paths.end(), path) - paths.begin();
+        if (entries[i] == paths.size())
+            paths.push_back(path);
+    }
+
+    AtlasSettings settings;
+    settings.max_page_size = ATLAS_PAGE_SIZE;
+    settings.levels = ATLAS_LEVELS;
+    settings.compress = true;
+    if (!texture_atlas.create(paths, settings, jobs.get()))
+        return;
+    texture_atlas.report();
+    for (unsigned int i = 0; i < textured_objects.size(); i++) {
+        textured_objects[i].atlas = texture_atlas.entry(entries[i]);
+        textured_objects[i].texture_id = texture_atlas.texture();
+    }
+}
+
 //------------------------------------------------------------
 // void InitBuffers()
 // Allocates and fills buffers
@@ -710,187 +1265,88 @@ void InitObjects()
 
 void InitBuffers()
 {
+    // Size the arenas for everything known so far, they grow if more
+    // meshes are added later. Textured meshes are still loading, so that
+    // arena starts at a guess.
+    size_t textured_vertices = 64 * 1024, textured_index_bytes = 256 * 1024;
+    size_t primitive_vertices = 0, primitive_index_bytes = 0;
+    for (unsigned int i = 0; i < primitive_objects.size(); i++) {
+        primitive_vertices += primitive_objects[i].vertices.size() / 3;
+        primitive_index_bytes += primitive_objects[i].elements.size() * sizeof(GLushort) + sizeof(GLuint);
+    }
+    for (unsigned int i = 0; i < instanced_objects.size(); i++) {
+        primitive_vertices += instanced_objects[i].mesh.vertices.size() / 3;
+        primitive_index_bytes += instanced_objects[i].mesh.elements.size() * sizeof(GLushort) + sizeof(GLuint);
+    }
+    textured_arena.create(textured_vertex_layout, O_program_id, textured_vertices, textured_index_bytes);
+    primitive_arena.create(primitive_vertex_layout, P_program_id, primitive_vertices, primitive_index_bytes);
+    textured_batch.create(textured_arena, O_program_id);
+    primitive_batch.create(primitive_arena, P_program_id);
+    instanced_vao = primitive_arena.addVao(I_program_id);
+    uniform_blocks.create(UNIFORM_RING_BYTES);
+    MaterialUniforms material;
+    material.mat_ambient = vec4(ambient_color, 1.0f);
+    material.mat_diffuse = vec4(diffuse_color, 1.0f);
+    default_material = uniform_blocks.addMaterial(material);
+    assets.create(textured_arena, resources, ASSET_STAGING_BYTES, 1);
+    InitAtlas();
+
     //text obj
     for (unsigned int i = 0; i < textured_objects.size(); i++) {
-        GLuint position_id, normal_id;
-        GLuint vbo_vertices, vbo_normals, vbo_uvs;
-
         textured_object* obj = &textured_objects[i];
 
-        glGenBuffers(1, &vbo_vertices);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo_vertices);
-        glBufferData(GL_ARRAY_BUFFER,
-            (*obj).vertices.size() * sizeof(vec3), &((*obj).vertices[0]),
-            GL_STATIC_DRAW);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-        // vbo for normals
-        glGenBuffers(1, &vbo_normals);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo_normals);
-        glBufferData(GL_ARRAY_BUFFER,
-            (*obj).normals.size() * sizeof(vec3),
-            &(*obj).normals[0], GL_STATIC_DRAW);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-        // vbo for uvs
-        glGenBuffers(1, &vbo_uvs);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo_uvs);
-        glBufferData(GL_ARRAY_BUFFER, (*obj).uvs.size() * sizeof(vec2),
-            &(*obj).uvs[0], GL_STATIC_DRAW);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-
-        // Get vertex attributes
-        position_id = glGetAttribLocation(O_program_id, "position");
-        normal_id = glGetAttribLocation(O_program_id, "normal");
-        GLuint uv_id = glGetAttribLocation(O_program_id, "uv");
-
-
-        // Allocate memory for vao
-        glGenVertexArrays(1, &(*obj).vao);
-
-        // Bind to vao
-        glBindVertexArray((*obj).vao);
-
-        // Bind vertices to vao
-        glBindBuffer(GL_ARRAY_BUFFER, vbo_vertices);
-        glVertexAttribPointer(position_id, 3, GL_FLOAT, GL_FALSE, 0, 0);
-        glEnableVertexAttribArray(position_id);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-        //normal
-        glBindBuffer(GL_ARRAY_BUFFER, vbo_normals);
-        glVertexAttribPointer(normal_id, 3, GL_FLOAT, GL_FALSE, 0, 0);
-        glEnableVertexAttribArray(normal_id);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-        //textures
-        glBindBuffer(GL_ARRAY_BUFFER, vbo_uvs);
-        glVertexAttribPointer(uv_id, 2, GL_FLOAT, GL_FALSE, 0, 0);
-        glEnableVertexAttribArray(uv_id);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-
-        // Stop bind to vao
-        glBindVertexArray(0);
-
-
-        // Make uniform vars
-        //uniform_mvp = glGetUniformLocation(program_id, "mvp");
-
-        textured_objects[i].uniform_mv = glGetUniformLocation(O_program_id, "mv");
-        GLuint uniform_proj = glGetUniformLocation(O_program_id, "projection");
-        GLuint uniform_light_pos = glGetUniformLocation(O_program_id, "light_pos");
-        GLuint uniform_material_ambient = glGetUniformLocation(O_program_id,
-            "mat_ambient");
-        GLuint uniform_material_diffuse = glGetUniformLocation(O_program_id,
-            "mat_diffuse");
-
-
-
-
-        // Define model
-        (*obj).mv = view * (*obj).model;
-
-        // Send mv
-        glUseProgram(O_program_id);
-        glUniformMatrix4fv((*obj).uniform_mv, 1, GL_FALSE, value_ptr((*obj).mv));
-        glUniformMatrix4fv(uniform_proj, 1, GL_FALSE, value_ptr(projection));
-        glUniform3fv(uniform_light_pos, 1, value_ptr(light_position));
-        glUniform3fv(uniform_material_ambient, 1, value_ptr(ambient_color));
-        glUniform3fv(uniform_material_diffuse, 1, value_ptr(diffuse_color));
+        // The placeholder mesh is drawn until the real one is uploaded;
+        // objects are found again by index, the vector may move
+        set_mesh(*obj, assets.placeholderMesh());
+        assets.loadMesh((*obj).mesh_path.c_str(), [i](const ResourceHandle& mesh) {
+            textured_objects[i].mesh_resource = mesh;
+            set_mesh(textured_objects[i], (*mesh).mesh);
+            // marks the node changed so its bounds are recomputed
+            transforms.setLocal(textured_objects[i].transform, textured_objects[i].model);
+        });
     }
     //prim
     for (unsigned int i = 0; i < primitive_objects.size(); i++)
     {
-        GLuint position_id, color_id, normal_id;
-        GLuint vbo_vertices, vbo_colors, vbo_normal;
-        GLuint ibo_elements;
-
         primitive_object *obj = &primitive_objects[i];
+        size_t vertex_count = (*obj).vertices.size() / 3;
+
+        // interleaved, quantized vertices for position, normal and color
+        vector<PackedPrimitiveVertex> packed;
+        (*obj).quantization = packPrimitiveVertices(&(*obj).vertices[0], &(*obj).normals[0],
+            &(*obj).colors[0], vertex_count, packed);
+        reportPrimitiveFootprint("primitive object", &(*obj).vertices[0], &(*obj).normals[0],
+            vertex_count, (*obj).quantization, packed);
 
-        // vbo for vertices
-        glGenBuffers(1, &vbo_vertices);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo_vertices);
-        glBufferData(GL_ARRAY_BUFFER, (*obj).vertices.size() * sizeof(GLfloat), &(*obj).vertices[0], GL_STATIC_DRAW);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-        // vbo for colors
-        glGenBuffers(1, &vbo_colors);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo_colors);
-        glBufferData(GL_ARRAY_BUFFER, (*obj).colors.size() * sizeof(GLfloat), &(*obj).colors[0], GL_STATIC_DRAW);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-        // vbo for colors
-        glGenBuffers(1, &vbo_normal);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo_normal);
-        glBufferData(GL_ARRAY_BUFFER, (*obj).normals.size() * sizeof(vec3), &(*obj).normals[0], GL_STATIC_DRAW);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-        // vbo for elements
-        glGenBuffers(1, &ibo_elements);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_elements);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (*obj).elements.size() * sizeof(GLshort),
-            &(*obj).elements[0], GL_STATIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-
-        // Get vertex attributes
-        position_id = glGetAttribLocation(P_program_id, "position");
-        color_id = glGetAttribLocation(P_program_id, "color");
-        normal_id = glGetAttribLocation(P_program_id, "normal");
-
-        // Allocate memory for vao
-        glGenVertexArrays(1, &(*obj).vao);
-
-        // Bind to vao
-        glBindVertexArray((*obj).vao);
-
-        // Bind vertices to vao
-        glBindBuffer(GL_ARRAY_BUFFER, vbo_vertices);
-        glVertexAttribPointer(position_id, 3, GL_FLOAT, GL_FALSE, 0, 0);
-        glEnableVertexAttribArray(position_id);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-        // Bind colors to vao
-        glBindBuffer(GL_ARRAY_BUFFER, vbo_colors);
-        glVertexAttribPointer(color_id, 3, GL_FLOAT, GL_FALSE, 0, 0);
-        glEnableVertexAttribArray(color_id);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-        // Bind normals to vao
-        glBindBuffer(GL_ARRAY_BUFFER, vbo_normal);
-        glVertexAttribPointer(normal_id, 3, GL_FLOAT, GL_FALSE, 0, 0);
-        glEnableVertexAttribArray(normal_id);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-        // Bind elements to vao
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_elements);
-
-        // Stop bind to vao
-        glBindVertexArray(0);
-
-        // Make uniform vars
-        (*obj).uniform_mvp = glGetUniformLocation(P_program_id, "mv");
-        GLuint uniform_proj = glGetUniformLocation(P_program_id, "projection");
-        GLuint uniform_light_pos = glGetUniformLocation(P_program_id, "light_pos");
-        GLuint uniform_material_ambient = glGetUniformLocation(P_program_id,
-            "mat_ambient");
-        GLuint uniform_material_diffuse = glGetUniformLocation(P_program_id,
-            "mat_diffuse");
-
-        // Define model
-        (*obj).mv = view * (*obj).model;
-
-        // Send mv
-        glUseProgram(P_program_id);
-        glUniformMatrix4fv((*obj).uniform_mvp, 1, GL_FALSE, value_ptr((*obj).mv));
-        glUniformMatrix4fv(uniform_proj, 1, GL_FALSE, value_ptr(projection));
-        glUniform3fv(uniform_light_pos, 1, value_ptr(light_position));
-        glUniform3fv(uniform_material_ambient, 1, value_ptr(ambient_color));
-        glUniform3fv(uniform_material_diffuse, 1, value_ptr(diffuse_color));
+        if (primitive_arena.allocate(vertex_count, (*obj).elements.size(), GL_UNSIGNED_SHORT, (*obj).range))
+            primitive_arena.upload((*obj).range, &packed[0], &(*obj).elements[0]);
     }
-}
 
+    //instanced
+    for (unsigned int i = 0; i < instanced_objects.size(); i++)
+    {
+        instanced_object* obj = &instanced_objects[i];
+        primitive_object* mesh = &(*obj).mesh;
+        size_t vertex_count = (*mesh).vertices.size() / 3;
+
+        // the shared mesh goes into the primitive arena like any primitive
+        vector<PackedPrimitiveVertex> packed;
+        (*mesh).quantization = packPrimitiveVertices(&(*mesh).vertices[0], &(*mesh).normals[0],
+            &(*mesh).colors[0], vertex_count, packed);
+        if (primitive_arena.allocate(vertex_count, (*mesh).elements.size(), GL_UNSIGNED_SHORT, (*mesh).range))
+            primitive_arena.upload((*mesh).range, &packed[0], &(*mesh).elements[0]);
+
+        // Instance stream
+        size_t bytes = (*obj).instances.update();
+        printf("instanced object: %u instances, %u bytes of instance data\n",
+            (unsigned int)(*obj).instances.size(), (unsigned int)bytes);
+    }
+    InitUniforms();
+
+    textured_arena.report("textured");
+    primitive_arena.report("primitive");
+    printf("frustum culling: %s\n", simdLevelName(simdLevel()));
+}
 
 int main(int argc, char** argv)
 {
@@ -898,16 +1354,23 @@ int main(int argc, char** argv)
     InitShaders();
     InitMatrices();
     InitObjects();
+
+    jobs.reset(new JobSystem());
+    printf("job system: %u threads\n", jobs->threadCount());
+
     InitBuffers();
 
     glEnable(GL_DEPTH_TEST);
     glDisable(GL_CULL_FACE);
 
+    set_pacing(PACE_VSYNC);
+
     // Hide console window
     HWND hWnd = GetConsoleWindow();
     ShowWindow(hWnd, SW_HIDE);
 
-    // Main loop
+    // Main loop, GL calls are counted from its first frame
+    resetGLCallCounts();
     glutMainLoop();
 
     return 0;
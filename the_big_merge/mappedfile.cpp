@@ -0,0 +1,111 @@
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mappedfile.h"
+
+MappedFile::MappedFile()
+    : data_(NULL), size_(0), opened_(false)
+#ifdef _WIN32
+    , file_(INVALID_HANDLE_VALUE), mapping_(NULL)
+#else
+    , fd_(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const char * path)
+{
+    close();
+
+#ifdef _WIN32
+    file_ = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file_ == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file_, &file_size)) {
+        close();
+        return false;
+    }
+    size_ = (size_t)file_size.QuadPart;
+    opened_ = true;
+
+    // An empty file can't be mapped, but it is still a valid (empty) file
+    if (size_ == 0)
+        return true;
+
+    mapping_ = CreateFileMappingA(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping_ == NULL) {
+        close();
+        return false;
+    }
+    data_ = (const char *)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+    if (data_ == NULL) {
+        close();
+        return false;
+    }
+#else
+    fd_ = ::open(path, O_RDONLY);
+    if (fd_ < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd_, &st) != 0) {
+        close();
+        return false;
+    }
+    size_ = (size_t)st.st_size;
+    opened_ = true;
+
+    if (size_ == 0)
+        return true;
+
+    void * ptr = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (ptr == MAP_FAILED) {
+        close();
+        return false;
+    }
+    // The parsers walk the file front to back
+    madvise(ptr, size_, MADV_SEQUENTIAL);
+    data_ = (const char *)ptr;
+#endif
+
+    return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if (data_ != NULL)
+        UnmapViewOfFile(data_);
+    if (mapping_ != NULL)
+        CloseHandle(mapping_);
+    if (file_ != INVALID_HANDLE_VALUE)
+        CloseHandle(file_);
+    mapping_ = NULL;
+    file_ = INVALID_HANDLE_VALUE;
+#else
+    if (data_ != NULL)
+        munmap((void *)data_, size_);
+    if (fd_ >= 0)
+        ::close(fd_);
+    fd_ = -1;
+#endif
+    data_ = NULL;
+    size_ = 0;
+    opened_ = false;
+}
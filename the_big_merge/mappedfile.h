@@ -0,0 +1,36 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+
+// Read-only memory mapping of a whole file.
+// The mapping is released when the object goes out of scope.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool open(const char * path);
+	void close();
+
+	bool isOpen() const { return opened_; }
+	const char * data() const { return data_; }
+	size_t size() const { return size_; }
+
+private:
+	MappedFile(const MappedFile &);
+	MappedFile & operator=(const MappedFile &);
+
+	const char * data_;
+	size_t size_;
+	bool opened_;
+#ifdef _WIN32
+	void * file_;
+	void * mapping_;
+#else
+	int fd_;
+#endif
+};
+
+#endif
@@ -0,0 +1,129 @@
+#include <immintrin.h>
+
+#include "matbatch.h"
+
+namespace {
+
+// The kernels work on column major float[16]; a stride of 0 repeats the
+// same matrix for every product. Every output column only depends on the
+// same column of b, and all of a is loaded before anything is stored, so
+// out may alias either input.
+
+void multiplyScalar(const float * a, size_t a_stride, const float * b, size_t b_stride,
+    float * out, size_t count)
+{
+    for (size_t i = 0; i < count; i++, a += a_stride, b += b_stride, out += 16) {
+        float r[16];
+        for (int column = 0; column < 4; column++)
+            for (int row = 0; row < 4; row++)
+                r[column * 4 + row] = a[row] * b[column * 4] + a[4 + row] * b[column * 4 + 1]
+                    + a[8 + row] * b[column * 4 + 2] + a[12 + row] * b[column * 4 + 3];
+        for (int e = 0; e < 16; e++)
+            out[e] = r[e];
+    }
+}
+
+SIMD_TARGET_SSE41
+void multiplySse(const float * a, size_t a_stride, const float * b, size_t b_stride,
+    float * out, size_t count)
+{
+    for (size_t i = 0; i < count; i++, a += a_stride, b += b_stride, out += 16) {
+        __m128 a0 = _mm_loadu_ps(a), a1 = _mm_loadu_ps(a + 4);
+        __m128 a2 = _mm_loadu_ps(a + 8), a3 = _mm_loadu_ps(a + 12);
+        __m128 b_columns[4];
+        for (int column = 0; column < 4; column++)
+            b_columns[column] = _mm_loadu_ps(b + column * 4);
+        for (int column = 0; column < 4; column++) {
+            __m128 c = b_columns[column];
+            __m128 r = _mm_mul_ps(a0, _mm_shuffle_ps(c, c, 0x00));
+            r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_shuffle_ps(c, c, 0x55)));
+            r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_shuffle_ps(c, c, 0xaa)));
+            r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_shuffle_ps(c, c, 0xff)));
+            _mm_storeu_ps(out + column * 4, r);
+        }
+    }
+}
+
+// Two columns per register: a's columns repeated in both halves, b's
+// elements broadcast within each half
+SIMD_TARGET_AVX2
+void multiplyAvx2(const float * a, size_t a_stride, const float * b, size_t b_stride,
+    float * out, size_t count)
+{
+    for (size_t i = 0; i < count; i++, a += a_stride, b += b_stride, out += 16) {
+        __m256 a0 = _mm256_broadcast_ps((const __m128 *)a);
+        __m256 a1 = _mm256_broadcast_ps((const __m128 *)(a + 4));
+        __m256 a2 = _mm256_broadcast_ps((const __m128 *)(a + 8));
+        __m256 a3 = _mm256_broadcast_ps((const __m128 *)(a + 12));
+        __m256 b01 = _mm256_loadu_ps(b), b23 = _mm256_loadu_ps(b + 8);
+
+        __m256 r01 = _mm256_mul_ps(a0, _mm256_permute_ps(b01, 0x00));
+        __m256 r23 = _mm256_mul_ps(a0, _mm256_permute_ps(b23, 0x00));
+        r01 = _mm256_fmadd_ps(a1, _mm256_permute_ps(b01, 0x55), r01);
+        r23 = _mm256_fmadd_ps(a1, _mm256_permute_ps(b23, 0x55), r23);
+        r01 = _mm256_fmadd_ps(a2, _mm256_permute_ps(b01, 0xaa), r01);
+        r23 = _mm256_fmadd_ps(a2, _mm256_permute_ps(b23, 0xaa), r23);
+        r01 = _mm256_fmadd_ps(a3, _mm256_permute_ps(b01, 0xff), r01);
+        r23 = _mm256_fmadd_ps(a3, _mm256_permute_ps(b23, 0xff), r23);
+        _mm256_storeu_ps(out, r01);
+        _mm256_storeu_ps(out + 8, r23);
+    }
+}
+
+// The whole matrix in one register, same scheme as the AVX2 kernel
+SIMD_TARGET_AVX512
+void multiplyAvx512(const float * a, size_t a_stride, const float * b, size_t b_stride,
+    float * out, size_t count)
+{
+    for (size_t i = 0; i < count; i++, a += a_stride, b += b_stride, out += 16) {
+        __m512 a0 = _mm512_broadcast_f32x4(_mm_loadu_ps(a));
+        __m512 a1 = _mm512_broadcast_f32x4(_mm_loadu_ps(a + 4));
+        __m512 a2 = _mm512_broadcast_f32x4(_mm_loadu_ps(a + 8));
+        __m512 a3 = _mm512_broadcast_f32x4(_mm_loadu_ps(a + 12));
+        __m512 m = _mm512_loadu_ps(b);
+
+        __m512 r = _mm512_mul_ps(a0, _mm512_permute_ps(m, 0x00));
+        r = _mm512_fmadd_ps(a1, _mm512_permute_ps(m, 0x55), r);
+        r = _mm512_fmadd_ps(a2, _mm512_permute_ps(m, 0xaa), r);
+        r = _mm512_fmadd_ps(a3, _mm512_permute_ps(m, 0xff), r);
+        _mm512_storeu_ps(out, r);
+    }
+}
+
+void multiply(const glm::mat4 * a, size_t a_stride, const glm::mat4 * b, size_t b_stride,
+    glm::mat4 * out, size_t count, SimdLevel level)
+{
+    if (count == 0)
+        return;
+    const float * fa = &(*a)[0][0];
+    const float * fb = &(*b)[0][0];
+    float * fout = &(*out)[0][0];
+    if (level >= SIMD_AVX512)
+        multiplyAvx512(fa, a_stride, fb, b_stride, fout, count);
+    else if (level >= SIMD_AVX2)
+        multiplyAvx2(fa, a_stride, fb, b_stride, fout, count);
+    else if (level >= SIMD_SSE)
+        multiplySse(fa, a_stride, fb, b_stride, fout, count);
+    else
+        multiplyScalar(fa, a_stride, fb, b_stride, fout, count);
+}
+
+} // namespace
+
+void multiplyMatrices(const glm::mat4 * left, const glm::mat4 * right, glm::mat4 * out,
+    size_t count, SimdLevel level)
+{
+    multiply(left, 16, right, 16, out, count, level);
+}
+
+void multiplyMatrices(const glm::mat4 & left, const glm::mat4 * right, glm::mat4 * out,
+    size_t count, SimdLevel level)
+{
+    multiply(&left, 0, right, 16, out, count, level);
+}
+
+void multiplyMatrices(const glm::mat4 * left, const glm::mat4 & right, glm::mat4 * out,
+    size_t count, SimdLevel level)
+{
+    multiply(left, 16, &right, 0, out, count, level);
+}
@@ -0,0 +1,26 @@
+#ifndef MATBATCH_H
+#define MATBATCH_H
+
+#include <stddef.h>
+
+#include <glm/glm.hpp>
+
+#include "cpufeatures.h"
+
+// Batched 4x4 matrix products over contiguous glm::mat4 arrays, with
+// kernels for every SIMD level picked at run time. No alignment is
+// required; out may be the same array as either input.
+
+// out[i] = left[i] * right[i]
+void multiplyMatrices(const glm::mat4 * left, const glm::mat4 * right, glm::mat4 * out,
+	size_t count, SimdLevel level = simdLevel());
+
+// out[i] = left * right[i], e.g. view * model for every object
+void multiplyMatrices(const glm::mat4 & left, const glm::mat4 * right, glm::mat4 * out,
+	size_t count, SimdLevel level = simdLevel());
+
+// out[i] = left[i] * right, e.g. the same incremental rotation for every model
+void multiplyMatrices(const glm::mat4 * left, const glm::mat4 & right, glm::mat4 * out,
+	size_t count, SimdLevel level = simdLevel());
+
+#endif
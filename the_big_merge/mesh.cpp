@@ -0,0 +1,83 @@
+#include <string.h>
+
+#include "mesh.h"
+
+namespace {
+
+// Hash of the raw vertex bits; equal bits <=> same vertex
+inline unsigned int hashVertex(const MeshVertex & v)
+{
+    unsigned int words[sizeof(MeshVertex) / 4];
+    memcpy(words, &v, sizeof(MeshVertex));
+    unsigned int h = 2166136261u;
+    for (unsigned int i = 0; i < sizeof(MeshVertex) / 4; i++) {
+        h ^= words[i];
+        h *= 16777619u;
+        h ^= h >> 15;
+    }
+    return h;
+}
+
+const unsigned int empty_slot = 0xffffffffu;
+
+} // namespace
+
+void buildIndexedMesh(
+    const std::vector<glm::vec3> & positions,
+    const std::vector<glm::vec2> & uvs,
+    const std::vector<glm::vec3> & normals,
+    IndexedMesh & out
+){
+    size_t count = positions.size();
+    out.vertices.clear();
+    out.indices.resize(count);
+
+    // Open addressing table of vertex numbers, kept at most half full
+    size_t table_size = 16;
+    while (table_size < count * 2)
+        table_size *= 2;
+    std::vector<unsigned int> table(table_size, empty_slot);
+    size_t mask = table_size - 1;
+
+    for (size_t i = 0; i < count; i++) {
+        MeshVertex v;
+        v.position = positions[i];
+        v.normal = i < normals.size() ? normals[i] : glm::vec3();
+        v.uv = i < uvs.size() ? uvs[i] : glm::vec2();
+
+        size_t slot = hashVertex(v) & mask;
+        while (table[slot] != empty_slot
+            && memcmp(&out.vertices[table[slot]], &v, sizeof(MeshVertex)) != 0)
+            slot = (slot + 1) & mask;
+
+        if (table[slot] == empty_slot) {
+            table[slot] = (unsigned int)out.vertices.size();
+            out.vertices.push_back(v);
+        }
+        out.indices[i] = table[slot];
+    }
+}
+
+void computeBounds(const float * positions, size_t vertex_count, size_t position_stride,
+    glm::vec3 & bounds_min, glm::vec3 & bounds_max)
+{
+    bounds_min = bounds_max = glm::vec3(0.0f);
+    for (size_t i = 0; i < vertex_count; i++) {
+        glm::vec3 p(positions[i * position_stride], positions[i * position_stride + 1],
+            positions[i * position_stride + 2]);
+        bounds_min = i ? glm::min(bounds_min, p) : p;
+        bounds_max = i ? glm::max(bounds_max, p) : p;
+    }
+}
+
+bool fitsIn16Bit(const IndexedMesh & mesh)
+{
+    return mesh.vertices.size() <= 0x10000;
+}
+
+void packIndices16(const std::vector<unsigned int> & indices, std::vector<unsigned short> & out)
+{
+    out.resize(indices.size());
+    for (size_t i = 0; i < indices.size(); i++)
+        out[i] = (unsigned short)indices[i];
+}
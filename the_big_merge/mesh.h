@@ -0,0 +1,43 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Interleaved vertex as uploaded to the GPU
+struct MeshVertex
+{
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec2 uv;
+};
+
+// Triangle list over a table of unique vertices
+struct IndexedMesh
+{
+	std::vector<MeshVertex> vertices;
+	std::vector<unsigned int> indices;
+};
+
+// Builds an indexed mesh from un-indexed triangle corners (the loadOBJ
+// output) by merging corners with bit-identical position, uv and normal.
+void buildIndexedMesh(
+	const std::vector<glm::vec3> & positions,
+	const std::vector<glm::vec2> & uvs,
+	const std::vector<glm::vec3> & normals,
+	IndexedMesh & out
+);
+
+// Axis aligned bounds of a float position array with a stride of
+// position_stride floats
+void computeBounds(const float * positions, size_t vertex_count, size_t position_stride,
+	glm::vec3 & bounds_min, glm::vec3 & bounds_max);
+
+// True when all indices fit in an unsigned short index buffer
+bool fitsIn16Bit(const IndexedMesh & mesh);
+
+// Narrows the indices for a GL_UNSIGNED_SHORT index buffer
+void packIndices16(const std::vector<unsigned int> & indices, std::vector<unsigned short> & out);
+
+#endif
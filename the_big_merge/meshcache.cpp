@@ -0,0 +1,294 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "meshcache.h"
+
+#ifdef _WIN32
+#define stat_struct _stat64
+#define stat_function _stat64
+#else
+#define stat_struct stat
+#define stat_function stat
+#endif
+
+bool statFile(const char * path, unsigned long long & size, long long & mtime)
+{
+    struct stat_struct st;
+    if (stat_function(path, &st) != 0)
+        return false;
+    size = (unsigned long long)st.st_size;
+    mtime = (long long)st.st_mtime;
+    return true;
+}
+
+bool hashFile(const char * path, unsigned long long & hash)
+{
+    MappedFile file;
+    if (!file.open(path))
+        return false;
+    hash = hashBytes(file.data(), file.size());
+    return true;
+}
+
+bool patchFile(const char * path, long offset, const void * data, size_t size)
+{
+    FILE * file = fopen(path, "r+b");
+    if (!file)
+        return false;
+    bool written = fseek(file, offset, SEEK_SET) == 0 && fwrite(data, 1, size, file) == size;
+    return fclose(file) == 0 && written;
+}
+
+std::string tempPath(const char * path)
+{
+#ifdef _WIN32
+    unsigned long process = GetCurrentProcessId();
+#else
+    unsigned long process = (unsigned long)getpid();
+#endif
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), ".%lu.%zx.tmp", process, std::hash<std::thread::id>()(std::this_thread::get_id()));
+    return std::string(path) + suffix;
+}
+
+bool replaceFile(const char * temp_path, const char * path)
+{
+    // rename replaces atomically on POSIX, Windows' needs MoveFileEx for that
+#ifdef _WIN32
+    return MoveFileExA(temp_path, path, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(temp_path, path) == 0;
+#endif
+}
+
+namespace {
+
+inline unsigned long long alignUp(unsigned long long value, unsigned long long alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+unsigned long long hashBytes(const void * data, size_t size)
+{
+    // FNV-1a style mixing over 8 byte words, then the tail byte by byte
+    const unsigned char * p = (const unsigned char *)data;
+    unsigned long long h = 14695981039346656037ull ^ size;
+    size_t words = size / 8;
+    for (size_t i = 0; i < words; i++) {
+        unsigned long long w;
+        memcpy(&w, p + i * 8, 8);
+        h = (h ^ w) * 1099511628211ull;
+        h ^= h >> 29;
+    }
+    for (size_t i = words * 8; i < size; i++)
+        h = (h ^ p[i]) * 1099511628211ull;
+    return h;
+}
+
+std::string meshCachePath(const char * source_path)
+{
+    return std::string(source_path) + ".meshcache";
+}
+
+CachedMesh::CachedMesh()
+    : header_(NULL)
+{
+}
+
+bool CachedMesh::open(const char * cache_path, const char * source_path)
+{
+    return open(cache_path, source_path, true);
+}
+
+bool CachedMesh::open(const char * cache_path, const char * source_path, bool restamp)
+{
+    header_ = NULL;
+    if (!file_.open(cache_path))
+        return false;
+
+    if (file_.size() < sizeof(MeshCacheHeader)) {
+        file_.close();
+        return false;
+    }
+    const MeshCacheHeader * header = (const MeshCacheHeader *)file_.data();
+    if (header->magic != MESH_CACHE_MAGIC || header->version != MESH_CACHE_VERSION
+        || header->vertex_stride != sizeof(PackedTexturedVertex)
+        || (header->index_size != 2 && header->index_size != 4)) {
+        printf("%s: not a mesh cache of this version\n", cache_path);
+        file_.close();
+        return false;
+    }
+
+    unsigned long long vertex_end = header->vertex_offset
+        + (unsigned long long)header->vertex_count * header->vertex_stride;
+    unsigned long long index_end = header->index_offset
+        + (unsigned long long)header->index_count * header->index_size;
+    unsigned long long lod_end = header->lod_offset
+        + (unsigned long long)header->lod_count * sizeof(MeshLod);
+    if (header->vertex_offset < sizeof(MeshCacheHeader) || vertex_end > header->index_offset
+        || index_end > header->lod_offset || lod_end > file_.size() || header->lod_count == 0) {
+        printf("%s: truncated mesh cache\n", cache_path);
+        file_.close();
+        return false;
+    }
+
+    // Every level is drawn straight from the index section
+    const MeshLod * lods = (const MeshLod *)(file_.data() + header->lod_offset);
+    for (unsigned int i = 0; i < header->lod_count; i++) {
+        if (lods[i].first_index > header->index_count
+            || lods[i].index_count > header->index_count - lods[i].first_index) {
+            printf("%s: lod %u is outside the indices\n", cache_path, i);
+            file_.close();
+            return false;
+        }
+    }
+
+    // Stale check: size and mtime first, content hash only when they differ
+    unsigned long long source_size;
+    long long source_mtime;
+    if (!statFile(source_path, source_size, source_mtime)) {
+        // No source to compare against, trust the cache
+        header_ = header;
+        return true;
+    }
+    if (source_size != header->source_size) {
+        file_.close();
+        return false;
+    }
+    if (source_mtime != header->source_mtime) {
+        unsigned long long hash;
+        if (!hashFile(source_path, hash) || hash != header->source_hash) {
+            file_.close();
+            return false;
+        }
+        // Same content under a new mtime (a checkout, a copy): store the
+        // mtime so the next start doesn't hash again. Windows won't write a
+        // mapped file, so the mapping is dropped and taken again after.
+        if (restamp) {
+            file_.close();
+            patchFile(cache_path, offsetof(MeshCacheHeader, source_mtime), &source_mtime, sizeof(source_mtime));
+            return open(cache_path, source_path, false);
+        }
+    }
+
+    header_ = header;
+    return true;
+}
+
+const PackedTexturedVertex * CachedMesh::vertices() const
+{
+    return (const PackedTexturedVertex *)(file_.data() + header_->vertex_offset);
+}
+
+QuantizationRange CachedMesh::quantization() const
+{
+    QuantizationRange range;
+    for (int i = 0; i < 3; i++) {
+        range.position_offset[i] = header_->bounds_min[i];
+        range.position_scale[i] = header_->bounds_max[i] - header_->bounds_min[i];
+    }
+    range.uv_offset = glm::vec2(header_->uv_offset[0], header_->uv_offset[1]);
+    range.uv_scale = glm::vec2(header_->uv_scale[0], header_->uv_scale[1]);
+    return range;
+}
+
+const void * CachedMesh::indices() const
+{
+    return file_.data() + header_->index_offset;
+}
+
+const MeshLod * CachedMesh::lods() const
+{
+    return (const MeshLod *)(file_.data() + header_->lod_offset);
+}
+
+bool writeMeshCache(const char * cache_path, const char * source_path,
+    const IndexedMesh & mesh, const std::vector<MeshLod> & lods)
+{
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = MESH_CACHE_MAGIC;
+    header.version = MESH_CACHE_VERSION;
+    header.vertex_count = (unsigned int)mesh.vertices.size();
+    header.vertex_stride = sizeof(PackedTexturedVertex);
+    header.index_count = (unsigned int)mesh.indices.size();
+    header.index_size = fitsIn16Bit(mesh) ? 2 : 4;
+    header.lod_count = (unsigned int)lods.size();
+
+    const MeshVertex * vertices = mesh.vertices.empty() ? NULL : &mesh.vertices[0];
+    QuantizationRange range = computeQuantizationRange(vertices, mesh.vertices.size());
+    std::vector<PackedTexturedVertex> packed;
+    packTexturedVertices(vertices, mesh.vertices.size(), range, packed);
+    for (int i = 0; i < 3; i++) {
+        header.bounds_min[i] = range.position_offset[i];
+        header.bounds_max[i] = range.position_offset[i] + range.position_scale[i];
+    }
+    for (int i = 0; i < 2; i++) {
+        header.uv_offset[i] = range.uv_offset[i];
+        header.uv_scale[i] = range.uv_scale[i];
+    }
+
+    if (!statFile(source_path, header.source_size, header.source_mtime)
+        || !hashFile(source_path, header.source_hash)) {
+        printf("%s: can't stamp mesh cache, source unreadable\n", cache_path);
+        return false;
+    }
+
+    header.vertex_offset = alignUp(sizeof(MeshCacheHeader), 64);
+    header.index_offset = alignUp(header.vertex_offset
+        + (unsigned long long)header.vertex_count * header.vertex_stride, 64);
+    header.lod_offset = alignUp(header.index_offset
+        + (unsigned long long)header.index_count * header.index_size, 64);
+
+    // Write to a temporary file first so a crash never leaves a half
+    // written cache behind
+    std::string temp_path = tempPath(cache_path);
+    FILE * file = fopen(temp_path.c_str(), "wb");
+    if (!file) {
+        printf("%s: can't write mesh cache\n", cache_path);
+        return false;
+    }
+
+    static const char padding[64] = { 0 };
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && fwrite(padding, 1, header.vertex_offset - sizeof(header), file) == header.vertex_offset - sizeof(header);
+    if (ok && !packed.empty())
+        ok = fwrite(&packed[0], sizeof(PackedTexturedVertex), packed.size(), file) == packed.size();
+    size_t vertex_end = header.vertex_offset + packed.size() * sizeof(PackedTexturedVertex);
+    ok = ok && fwrite(padding, 1, header.index_offset - vertex_end, file) == header.index_offset - vertex_end;
+    if (ok && !mesh.indices.empty()) {
+        if (header.index_size == 2) {
+            std::vector<unsigned short> indices;
+            packIndices16(mesh.indices, indices);
+            ok = fwrite(&indices[0], 2, indices.size(), file) == indices.size();
+        } else {
+            ok = fwrite(&mesh.indices[0], 4, mesh.indices.size(), file) == mesh.indices.size();
+        }
+    }
+    size_t index_end = header.index_offset + mesh.indices.size() * header.index_size;
+    ok = ok && fwrite(padding, 1, header.lod_offset - index_end, file) == header.lod_offset - index_end;
+    if (ok && !lods.empty())
+        ok = fwrite(&lods[0], sizeof(MeshLod), lods.size(), file) == lods.size();
+    ok = fclose(file) == 0 && ok;
+
+    ok = ok && replaceFile(temp_path.c_str(), cache_path);
+    if (!ok) {
+        remove(temp_path.c_str());
+        printf("%s: can't write mesh cache\n", cache_path);
+    }
+    return ok;
+}
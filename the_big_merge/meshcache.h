@@ -0,0 +1,95 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <string>
+
+#include "mappedfile.h"
+#include "mesh.h"
+#include "simplify.h"
+#include "vertexformat.h"
+
+// Binary mesh container written next to the source OBJ.
+//
+// Layout: MeshCacheHeader, then the PackedTexturedVertex array, the
+// index array (16 or 32 bit, all LOD levels back to back) and the MeshLod
+// table, each starting at a 64 byte aligned offset.
+// Everything is stored exactly as it is uploaded, so a loaded cache is
+// mapped and handed to glBufferData without any parsing. The position
+// quantization range is the bounds, the uv range is stored separately.
+
+const unsigned int MESH_CACHE_MAGIC = 0x4348534d; // "MSHC"
+const unsigned int MESH_CACHE_VERSION = 4;  // 2: cache/fetch optimized, 3: LOD chain, 4: packed vertices
+
+struct MeshCacheHeader
+{
+	unsigned int magic;
+	unsigned int version;
+	unsigned int vertex_count;
+	unsigned int vertex_stride;
+	unsigned int index_count;
+	unsigned int index_size;
+	unsigned int lod_count;
+	unsigned int reserved;
+	float bounds_min[3];
+	float bounds_max[3];
+	float uv_offset[2];
+	float uv_scale[2];
+	unsigned long long source_size;
+	long long source_mtime;
+	unsigned long long source_hash;
+	unsigned long long vertex_offset;
+	unsigned long long index_offset;
+	unsigned long long lod_offset;
+};
+
+// A mapped cache file. The pointers stay valid while the object lives.
+class CachedMesh
+{
+public:
+	CachedMesh();
+
+	// Maps cache_path and checks it against source_path. Fails when the
+	// cache is missing, corrupt, from another version, or stale.
+	bool open(const char * cache_path, const char * source_path);
+
+	const MeshCacheHeader & header() const { return *header_; }
+	const PackedTexturedVertex * vertices() const;
+	QuantizationRange quantization() const;
+	const void * indices() const;
+	const MeshLod * lods() const;
+
+private:
+	bool open(const char * cache_path, const char * source_path, bool restamp);
+
+	MappedFile file_;
+	const MeshCacheHeader * header_;
+};
+
+// Packs mesh and writes it with its LOD table to cache_path, stamped with
+// the size, mtime and content hash of source_path.
+bool writeMeshCache(const char * cache_path, const char * source_path,
+	const IndexedMesh & mesh, const std::vector<MeshLod> & lods);
+
+// Cache file used for a source file
+std::string meshCachePath(const char * source_path);
+
+// 64-bit content hash used to detect stale caches
+unsigned long long hashBytes(const void * data, size_t size);
+
+// Overwrites size bytes at offset of an existing file
+bool patchFile(const char * path, long offset, const void * data, size_t size);
+
+// Name next to path for writing it through: unique to the process and
+// thread, so concurrent writers never share one
+std::string tempPath(const char * path);
+
+// Moves temp_path over path in one step, path is never missing in between
+bool replaceFile(const char * temp_path, const char * path);
+
+// Size and modification time of a file, false if it can't be read
+bool statFile(const char * path, unsigned long long & size, long long & mtime);
+
+// hashBytes of a whole file
+bool hashFile(const char * path, unsigned long long & hash);
+
+#endif
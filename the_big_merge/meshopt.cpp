@@ -0,0 +1,294 @@
+#include <stdio.h>
+#include <math.h>
+
+#include <algorithm>
+
+#include "meshopt.h"
+
+namespace {
+
+// Forsyth scoring parameters, tuned for a 32 entry LRU model cache
+const int forsyth_cache_size = 32;
+const float cache_decay_power = 1.5f;
+const float last_triangle_score = 0.75f;
+const float valence_boost_scale = 2.0f;
+const float valence_boost_power = 0.5f;
+
+float vertexScore(int cache_position, unsigned int live_triangles)
+{
+    if (live_triangles == 0)
+        return -1.0f;
+
+    float score = 0.0f;
+    if (cache_position >= 0) {
+        if (cache_position < 3) {
+            // The last triangle's vertices get a fixed score so they are
+            // not reused right away (that would favour strips)
+            score = last_triangle_score;
+        } else {
+            float scale = 1.0f / (forsyth_cache_size - 3);
+            score = powf(1.0f - (cache_position - 3) * scale, cache_decay_power);
+        }
+    }
+    // Bonus for vertices with few triangles left, to finish them off
+    score += valence_boost_scale * powf((float)live_triangles, -valence_boost_power);
+    return score;
+}
+
+} // namespace
+
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int> & indices,
+    size_t vertex_count, unsigned int cache_size)
+{
+    VertexCacheStats stats = { 0, 0.0, 0.0 };
+    if (indices.empty())
+        return stats;
+
+    // FIFO: a vertex is cached if it entered less than cache_size misses ago
+    std::vector<unsigned int> entered(vertex_count, 0);
+    std::vector<bool> used(vertex_count, false);
+    unsigned int time = cache_size + 1;
+    unsigned int unique = 0;
+
+    for (size_t i = 0; i < indices.size(); i++) {
+        unsigned int v = indices[i];
+        if (time - entered[v] > cache_size) {
+            entered[v] = time++;
+            stats.transformed++;
+        }
+        if (!used[v]) {
+            used[v] = true;
+            unique++;
+        }
+    }
+
+    stats.acmr = (double)stats.transformed / (indices.size() / 3);
+    stats.atvr = (double)stats.transformed / unique;
+    return stats;
+}
+
+void optimizeVertexCache(std::vector<unsigned int> & indices, size_t vertex_count)
+{
+    size_t triangle_count = indices.size() / 3;
+    if (triangle_count == 0)
+        return;
+
+    // Vertex -> triangle adjacency
+    std::vector<unsigned int> live(vertex_count, 0);
+    for (size_t i = 0; i < indices.size(); i++)
+        live[indices[i]]++;
+
+    std::vector<unsigned int> offsets(vertex_count + 1, 0);
+    for (size_t v = 0; v < vertex_count; v++)
+        offsets[v + 1] = offsets[v] + live[v];
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t t = 0; t < triangle_count; t++)
+        for (int k = 0; k < 3; k++)
+            adjacency[fill[indices[t * 3 + k]]++] = (unsigned int)t;
+
+    std::vector<int> cache_position(vertex_count, -1);
+    std::vector<float> vertex_score(vertex_count);
+    for (size_t v = 0; v < vertex_count; v++)
+        vertex_score[v] = vertexScore(-1, live[v]);
+
+    std::vector<float> triangle_score(triangle_count);
+    std::vector<bool> emitted(triangle_count, false);
+    for (size_t t = 0; t < triangle_count; t++)
+        triangle_score[t] = vertex_score[indices[t * 3]] + vertex_score[indices[t * 3 + 1]]
+            + vertex_score[indices[t * 3 + 2]];
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+
+    // Cache holds a few extra entries for the vertices being pushed out
+    std::vector<unsigned int> cache, new_cache;
+    cache.reserve(forsyth_cache_size + 3);
+    new_cache.reserve(forsyth_cache_size + 3);
+
+    size_t cursor = 0;
+    long long best = -1;
+
+    while (result.size() < indices.size()) {
+        if (best < 0) {
+            // Nothing in the cache is connected, start from the next
+            // unused triangle in input order
+            while (emitted[cursor])
+                cursor++;
+            best = (long long)cursor;
+        }
+
+        unsigned int triangle[3] = {
+            indices[best * 3], indices[best * 3 + 1], indices[best * 3 + 2]
+        };
+        emitted[best] = true;
+        result.insert(result.end(), triangle, triangle + 3);
+
+        // Move the triangle's vertices to the front of the cache
+        new_cache.clear();
+        new_cache.insert(new_cache.end(), triangle, triangle + 3);
+        for (size_t i = 0; i < cache.size(); i++)
+            if (cache[i] != triangle[0] && cache[i] != triangle[1] && cache[i] != triangle[2])
+                new_cache.push_back(cache[i]);
+
+        // Remove the triangle from its vertices' adjacency lists
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = triangle[k];
+            unsigned int * begin = &adjacency[offsets[v]];
+            unsigned int * end = begin + live[v];
+            unsigned int * it = std::find(begin, end, (unsigned int)best);
+            if (it != end) {
+                *it = *(end - 1);
+                live[v]--;
+            }
+        }
+
+        // Rescore everything in the cache (and what just fell out of it)
+        for (size_t i = 0; i < new_cache.size(); i++) {
+            unsigned int v = new_cache[i];
+            int position = i < (size_t)forsyth_cache_size ? (int)i : -1;
+            cache_position[v] = position;
+            float score = vertexScore(position, live[v]);
+            float delta = score - vertex_score[v];
+            vertex_score[v] = score;
+            for (unsigned int a = 0; a < live[v]; a++)
+                triangle_score[adjacency[offsets[v] + a]] += delta;
+        }
+        if (new_cache.size() > (size_t)forsyth_cache_size)
+            new_cache.resize(forsyth_cache_size);
+        cache.swap(new_cache);
+
+        // Best triangle touching the cache
+        best = -1;
+        float best_score = -1.0f;
+        for (size_t i = 0; i < cache.size(); i++) {
+            unsigned int v = cache[i];
+            for (unsigned int a = 0; a < live[v]; a++) {
+                unsigned int t = adjacency[offsets[v] + a];
+                if (triangle_score[t] > best_score) {
+                    best_score = triangle_score[t];
+                    best = t;
+                }
+            }
+        }
+    }
+
+    indices.swap(result);
+}
+
+void optimizeOverdraw(std::vector<unsigned int> & indices,
+    const float * positions, size_t vertex_count, size_t position_stride)
+{
+    size_t triangle_count = indices.size() / 3;
+    if (triangle_count < 2)
+        return;
+
+    // Hard cluster boundaries: triangles where all three vertices miss the
+    // cache. Reordering whole clusters doesn't change the cache behaviour
+    // inside them.
+    const unsigned int cache_size = 16;
+    std::vector<unsigned int> entered(vertex_count, 0);
+    unsigned int time = cache_size + 1;
+    std::vector<size_t> clusters;
+    for (size_t t = 0; t < triangle_count; t++) {
+        int misses = 0;
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = indices[t * 3 + k];
+            if (time - entered[v] > cache_size) {
+                entered[v] = time++;
+                misses++;
+            }
+        }
+        if (t == 0 || misses == 3)
+            clusters.push_back(t);
+    }
+    if (clusters.size() < 2)
+        return;
+    clusters.push_back(triangle_count);
+
+    // Mesh centroid
+    double center[3] = { 0, 0, 0 };
+    for (size_t i = 0; i < indices.size(); i++)
+        for (int c = 0; c < 3; c++)
+            center[c] += positions[indices[i] * position_stride + c];
+    for (int c = 0; c < 3; c++)
+        center[c] /= indices.size();
+
+    // Sort key per cluster: how much the cluster faces away from the centre.
+    // Clusters on the outside of the mesh occlude the rest, draw them first.
+    std::vector<std::pair<float, size_t> > order(clusters.size() - 1);
+    for (size_t c = 0; c + 1 < clusters.size(); c++) {
+        double normal[3] = { 0, 0, 0 }, centroid[3] = { 0, 0, 0 }, area = 0;
+        for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+            const float * a = positions + indices[t * 3] * position_stride;
+            const float * b = positions + indices[t * 3 + 1] * position_stride;
+            const float * d = positions + indices[t * 3 + 2] * position_stride;
+            double e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            double e2[3] = { d[0] - a[0], d[1] - a[1], d[2] - a[2] };
+            double n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            double w = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (int k = 0; k < 3; k++) {
+                normal[k] += n[k];
+                centroid[k] += (a[k] + b[k] + d[k]) / 3.0 * w;
+            }
+            area += w;
+        }
+        float key = 0.0f;
+        double length = sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        if (area > 0 && length > 0) {
+            for (int k = 0; k < 3; k++)
+                key += (float)((centroid[k] / area - center[k]) * normal[k] / length);
+        }
+        order[c] = std::make_pair(-key, c);
+    }
+    std::stable_sort(order.begin(), order.end());
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        size_t c = order[i].second;
+        result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+    }
+    indices.swap(result);
+}
+
+size_t optimizeVertexFetchRemap(std::vector<unsigned int> & remap,
+    const std::vector<unsigned int> & indices, size_t vertex_count)
+{
+    remap.assign(vertex_count, ~0u);
+    unsigned int next = 0;
+    for (size_t i = 0; i < indices.size(); i++) {
+        unsigned int v = indices[i];
+        if (remap[v] == ~0u)
+            remap[v] = next++;
+    }
+    return next;
+}
+
+void remapIndexBuffer(std::vector<unsigned int> & indices, const std::vector<unsigned int> & remap)
+{
+    for (size_t i = 0; i < indices.size(); i++)
+        indices[i] = remap[indices[i]];
+}
+
+void optimizeMesh(IndexedMesh & mesh, const char * name)
+{
+    size_t vertex_count = mesh.vertices.size();
+    if (vertex_count == 0 || mesh.indices.empty())
+        return;
+
+    VertexCacheStats before = analyzeVertexCache(mesh.indices, vertex_count);
+
+    optimizeVertexCache(mesh.indices, vertex_count);
+    optimizeOverdraw(mesh.indices, &mesh.vertices[0].position.x, vertex_count,
+        sizeof(MeshVertex) / sizeof(float));
+
+    std::vector<unsigned int> remap;
+    size_t used = optimizeVertexFetchRemap(remap, mesh.indices, vertex_count);
+    remapIndexBuffer(mesh.indices, remap);
+    remapVertexStream(mesh.vertices, 1, remap, used);
+
+    VertexCacheStats after = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+    printf("%s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", name,
+        before.acmr, after.acmr, before.atvr, after.atvr);
+}
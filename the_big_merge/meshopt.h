@@ -0,0 +1,57 @@
+#ifndef MESHOPT_H
+#define MESHOPT_H
+
+#include <vector>
+
+#include "mesh.h"
+
+// Post-transform cache statistics from a FIFO cache simulation
+struct VertexCacheStats
+{
+	unsigned int transformed;  // vertices shaded, i.e. cache misses
+	double acmr;               // transformed / triangles, 0.5 is ideal
+	double atvr;               // transformed / unique vertices, 1.0 is ideal
+};
+
+// Simulates a FIFO post-transform cache of cache_size entries
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int> & indices,
+	size_t vertex_count, unsigned int cache_size = 16);
+
+// Reorders triangles for the post-transform cache (Forsyth's algorithm)
+void optimizeVertexCache(std::vector<unsigned int> & indices, size_t vertex_count);
+
+// Splits the (cache optimized) triangle order into clusters where the
+// cache starts over, and sorts those clusters so outward facing clusters
+// are drawn first. positions is a float array with a stride of
+// position_stride floats. Keeps the cache behaviour within the clusters.
+void optimizeOverdraw(std::vector<unsigned int> & indices,
+	const float * positions, size_t vertex_count, size_t position_stride);
+
+// Builds a remap table that orders vertices by first use in indices.
+// Unused vertices are dropped. Returns the number of vertices kept.
+size_t optimizeVertexFetchRemap(std::vector<unsigned int> & remap,
+	const std::vector<unsigned int> & indices, size_t vertex_count);
+
+// Applies a remap table to an index buffer
+void remapIndexBuffer(std::vector<unsigned int> & indices, const std::vector<unsigned int> & remap);
+
+// Applies a remap table to a vertex stream of components values per vertex
+template <typename T>
+void remapVertexStream(std::vector<T> & stream, size_t components,
+	const std::vector<unsigned int> & remap, size_t new_vertex_count)
+{
+	std::vector<T> result(new_vertex_count * components);
+	for (size_t i = 0; i < remap.size(); i++) {
+		if (remap[i] == ~0u)
+			continue;
+		for (size_t c = 0; c < components; c++)
+			result[remap[i] * components + c] = stream[i * components + c];
+	}
+	stream.swap(result);
+}
+
+// Runs the whole pipeline (cache, overdraw, fetch) on a mesh and prints
+// the ACMR/ATVR before and after. name is only used for the report.
+void optimizeMesh(IndexedMesh & mesh, const char * name);
+
+#endif
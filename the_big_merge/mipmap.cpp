@@ -0,0 +1,217 @@
+#include <math.h>
+
+#include <immintrin.h>
+#include <vector>
+
+#include "mipmap.h"
+
+namespace {
+
+// Linear light texels are 4 floats, b g r and alpha or unused, so one
+// texel is one SSE register. Every kernel averages as ((a + b) + (c + d))
+// * 0.25 without fma, so all levels give bit identical results.
+
+const unsigned int ENCODE_STEPS = 16384;    // linear to sRGB table size, < 0.25 LSB error
+
+struct SrgbTables
+{
+    float decode[256];
+    float alpha[256];           // alpha is linear already
+    unsigned char encode[ENCODE_STEPS];
+
+    SrgbTables()
+    {
+        for (int i = 0; i < 256; i++) {
+            double c = i / 255.0;
+            decode[i] = (float)(c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4));
+            alpha[i] = (float)c;
+        }
+        for (unsigned int i = 0; i < ENCODE_STEPS; i++) {
+            double l = (double)i / (ENCODE_STEPS - 1);
+            double c = l <= 0.0031308 ? l * 12.92 : 1.055 * pow(l, 1.0 / 2.4) - 0.055;
+            encode[i] = (unsigned char)(c * 255.0 + 0.5);
+        }
+    }
+};
+
+const SrgbTables & srgbTables()
+{
+    static SrgbTables tables;
+    return tables;
+}
+
+// out[x] is the average of texels 2x and 2x + 1 of both rows
+void downsampleScalar(const float * row0, const float * row1, float * out, unsigned int count)
+{
+    for (unsigned int x = 0; x < count; x++, row0 += 8, row1 += 8, out += 4)
+        for (int c = 0; c < 4; c++)
+            out[c] = ((row0[c] + row0[4 + c]) + (row1[c] + row1[4 + c])) * 0.25f;
+}
+
+SIMD_TARGET_SSE41
+void downsampleSse(const float * row0, const float * row1, float * out, unsigned int count)
+{
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    for (unsigned int x = 0; x < count; x++, row0 += 8, row1 += 8, out += 4) {
+        __m128 top = _mm_add_ps(_mm_loadu_ps(row0), _mm_loadu_ps(row0 + 4));
+        __m128 bottom = _mm_add_ps(_mm_loadu_ps(row1), _mm_loadu_ps(row1 + 4));
+        _mm_storeu_ps(out, _mm_mul_ps(_mm_add_ps(top, bottom), quarter));
+    }
+}
+
+// Two output texels per register: the lanes of texels 2x, 2x + 1 and
+// 2x + 2, 2x + 3 are regrouped into evens and odds before adding
+SIMD_TARGET_AVX2
+void downsampleAvx2(const float * row0, const float * row1, float * out, unsigned int count)
+{
+    const __m256 quarter = _mm256_set1_ps(0.25f);
+    unsigned int x = 0;
+    for (; x + 2 <= count; x += 2, row0 += 16, row1 += 16, out += 8) {
+        __m256 a = _mm256_loadu_ps(row0), b = _mm256_loadu_ps(row0 + 8);
+        __m256 c = _mm256_loadu_ps(row1), d = _mm256_loadu_ps(row1 + 8);
+        __m256 top = _mm256_add_ps(_mm256_permute2f128_ps(a, b, 0x20), _mm256_permute2f128_ps(a, b, 0x31));
+        __m256 bottom = _mm256_add_ps(_mm256_permute2f128_ps(c, d, 0x20), _mm256_permute2f128_ps(c, d, 0x31));
+        _mm256_storeu_ps(out, _mm256_mul_ps(_mm256_add_ps(top, bottom), quarter));
+    }
+    downsampleScalar(row0, row1, out, count - x);
+}
+
+// Four output texels per register, same scheme with 128 bit lane shuffles
+SIMD_TARGET_AVX512
+void downsampleAvx512(const float * row0, const float * row1, float * out, unsigned int count)
+{
+    const __m512 quarter = _mm512_set1_ps(0.25f);
+    unsigned int x = 0;
+    for (; x + 4 <= count; x += 4, row0 += 32, row1 += 32, out += 16) {
+        __m512 a = _mm512_loadu_ps(row0), b = _mm512_loadu_ps(row0 + 16);
+        __m512 c = _mm512_loadu_ps(row1), d = _mm512_loadu_ps(row1 + 16);
+        __m512 top = _mm512_add_ps(_mm512_shuffle_f32x4(a, b, 0x88), _mm512_shuffle_f32x4(a, b, 0xdd));
+        __m512 bottom = _mm512_add_ps(_mm512_shuffle_f32x4(c, d, 0x88), _mm512_shuffle_f32x4(c, d, 0xdd));
+        _mm512_storeu_ps(out, _mm512_mul_ps(_mm512_add_ps(top, bottom), quarter));
+    }
+    downsampleScalar(row0, row1, out, count - x);
+}
+
+typedef void (*DownsampleFunction)(const float * row0, const float * row1, float * out, unsigned int count);
+
+DownsampleFunction downsampleFunction(SimdLevel level)
+{
+    if (level >= SIMD_AVX512)
+        return downsampleAvx512;
+    if (level >= SIMD_AVX2)
+        return downsampleAvx2;
+    if (level >= SIMD_SSE)
+        return downsampleSse;
+    return downsampleScalar;
+}
+
+inline size_t rowBytes(unsigned int width, unsigned int channels)
+{
+    return (width * channels + 3) & ~(size_t)3;
+}
+
+// One row of the next level from two rows of width texels. A 1 texel
+// wide level averages each texel with itself.
+void downsampleRows(DownsampleFunction downsample, const float * row0, const float * row1,
+    unsigned int width, float * out)
+{
+    if (width > 1) {
+        downsample(row0, row1, out, width / 2);
+        return;
+    }
+    for (int c = 0; c < 4; c++)
+        out[c] = ((row0[c] + row0[c]) + (row1[c] + row1[c])) * 0.25f;
+}
+
+void decodeRow(const unsigned char * texel, unsigned int width, unsigned int channels, float * linear)
+{
+    const SrgbTables & tables = srgbTables();
+    for (unsigned int x = 0; x < width; x++, texel += channels, linear += 4) {
+        linear[0] = tables.decode[texel[0]];
+        linear[1] = tables.decode[texel[1]];
+        linear[2] = tables.decode[texel[2]];
+        linear[3] = channels == 4 ? tables.alpha[texel[3]] : 0.0f;
+    }
+}
+
+void encodeLevel(const float * linear, unsigned int width, unsigned int height, unsigned int channels,
+    unsigned char * out)
+{
+    const unsigned char * encode = srgbTables().encode;
+    const float scale = (float)(ENCODE_STEPS - 1);
+    for (unsigned int y = 0; y < height; y++, out += rowBytes(width, channels)) {
+        unsigned char * texel = out;
+        for (unsigned int x = 0; x < width; x++, linear += 4, texel += channels) {
+            texel[0] = encode[(unsigned int)(linear[0] * scale + 0.5f)];
+            texel[1] = encode[(unsigned int)(linear[1] * scale + 0.5f)];
+            texel[2] = encode[(unsigned int)(linear[2] * scale + 0.5f)];
+            if (channels == 4)
+                texel[3] = (unsigned char)(linear[3] * 255.0f + 0.5f);
+        }
+    }
+}
+
+} // namespace
+
+void generateMipmaps(ImageData & image, SimdLevel level)
+{
+    if (image.compressed || (image.format != GL_BGR && image.format != GL_BGRA)
+        || image.levels.size() != 1 || image.width == 0 || image.height == 0)
+        return;
+
+    unsigned int channels = image.format == GL_BGRA ? 4 : 3;
+    unsigned int width = image.width, height = image.height;
+    size_t total = image.levels[0].offset + image.levels[0].size;
+    unsigned int level_count = 1;
+    while (width > 1 || height > 1) {
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+        total += rowBytes(width, channels) * height;
+        level_count++;
+    }
+    // A level 0 still in the file is copied once, into room for the chain
+    detachImage(image, total);
+    image.pixels.resize(total);
+
+    DownsampleFunction downsample = downsampleFunction(level);
+    size_t offset = image.levels[0].offset + image.levels[0].size;
+    width = image.width;
+    height = image.height;
+    std::vector<float> current, next, rows((size_t)width * 8);
+    for (unsigned int l = 1; l < level_count; l++) {
+        unsigned int next_width = width > 1 ? width / 2 : 1;
+        unsigned int next_height = height > 1 ? height / 2 : 1;
+        next.resize((size_t)next_width * next_height * 4);
+
+        for (unsigned int y = 0; y < next_height; y++) {
+            unsigned int y0 = height > 1 ? y * 2 : 0, y1 = height > 1 ? y * 2 + 1 : 0;
+            const float * row0, * row1;
+            if (l == 1) {
+                // Level 0 is decoded two rows at a time, a linear copy of
+                // all of it would cost more than the filtering
+                const unsigned char * texels = &image.pixels[image.levels[0].offset];
+                decodeRow(texels + rowBytes(width, channels) * y0, width, channels, &rows[0]);
+                decodeRow(texels + rowBytes(width, channels) * y1, width, channels, &rows[(size_t)width * 4]);
+                row0 = &rows[0];
+                row1 = &rows[(size_t)width * 4];
+            }
+            else {
+                row0 = &current[(size_t)y0 * width * 4];
+                row1 = &current[(size_t)y1 * width * 4];
+            }
+            downsampleRows(downsample, row0, row1, width, &next[(size_t)y * next_width * 4]);
+        }
+
+        ImageLevel level_range;
+        level_range.offset = offset;
+        level_range.size = rowBytes(next_width, channels) * next_height;
+        encodeLevel(&next[0], next_width, next_height, channels, &image.pixels[offset]);
+        image.levels.push_back(level_range);
+        offset += level_range.size;
+
+        // Levels only shrink, after level 2 the buffers are reused
+        current.swap(next);
+        width = next_width;
+        height = next_height;
+    }
+}
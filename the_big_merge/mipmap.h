@@ -0,0 +1,18 @@
+#ifndef MIPMAP_H
+#define MIPMAP_H
+
+#include "cpufeatures.h"
+#include "texture.h"
+
+// Appends the full mip chain, down to 1x1, to an uncompressed 8 bit BGR
+// or BGRA image with a single level. Colors are treated as sRGB: every
+// level is box filtered from the one above in linear light and encoded
+// back, so mips keep the brightness of the original instead of
+// darkening; alpha is averaged as is. Levels use the BMP layout,
+// bottom-up rows padded to 4 bytes. A mapped image is detached first.
+//
+// Level sizes round down like GL's, so odd sizes drop their last row or
+// column. Compressed or already mipmapped images are left alone.
+void generateMipmaps(ImageData & image, SimdLevel level = simdLevel());
+
+#endif
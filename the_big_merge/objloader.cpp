@@ -2,9 +2,15 @@
 #include <stdio.h>
 #include <string>
 #include <cstring>
+#include <cstdlib>
+#include <climits>
+#include <algorithm>
+#include <thread>
+#include <chrono>
 
 #include <glm/glm.hpp>
 
+#include "mappedfile.h"
 #include "objloader.h"
 
 // Very, VERY simple OBJ loader.
@@ -33,7 +39,6 @@ bool loadOBJ(
     FILE * file = fopen(path, "r");
     if( file == NULL ){
         printf("Impossible to open the file ! Are you in the right path ? See Tutorial 1 for details\n");
-        getchar();
         return false;
     }
 
@@ -109,6 +114,521 @@ bool loadOBJ(
 }
 
 
+
+//------------------------------------------------------------
+// Memory-mapped OBJ loader
+//
+// Same output as loadOBJ, but the file is mapped and tokenized in place.
+// Numbers are scanned by hand, there is no per-line allocation and no libc
+// call in the inner loop.
+//------------------------------------------------------------
+
+namespace {
+
+const double pow10_table[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+inline bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char * skipBlanks(const char * p, const char * end)
+{
+    while (p < end && isBlank(*p))
+        p++;
+    return p;
+}
+
+inline const char * skipLine(const char * p, const char * end)
+{
+    const char * nl = (const char *)memchr(p, '\n', end - p);
+    return nl ? nl + 1 : end;
+}
+
+// Slow path for numbers the fast path can't round exactly (very long
+// mantissas, large exponents, inf/nan). Rare in real files.
+const char * parseFloatSlow(const char * p, const char * end, float & out)
+{
+    char buffer[64];
+    size_t n = 0;
+    while (p + n < end && n < sizeof(buffer) - 1 && !isBlank(p[n]) && p[n] != '\n' && p[n] != '/')
+        n++;
+    memcpy(buffer, p, n);
+    buffer[n] = '\0';
+    char * stop;
+    out = strtof(buffer, &stop);
+    if (stop == buffer)
+        return NULL;
+    return p + (stop - buffer);
+}
+
+// Scans a decimal float at p. Returns the position after the number, or
+// NULL if there is no number there.
+const char * parseFloat(const char * p, const char * end, float & out)
+{
+    const char * start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    unsigned long long mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool any = false;
+
+    while (p < end && (unsigned)(*p - '0') < 10) {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa) digits++;
+        } else {
+            exponent++;
+        }
+        any = true;
+        p++;
+    }
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && (unsigned)(*p - '0') < 10) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa) digits++;
+                exponent--;
+            }
+            any = true;
+            p++;
+        }
+    }
+    if (!any)
+        return parseFloatSlow(start, end, out);
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char * e = p + 1;
+        bool exp_negative = false;
+        if (e < end && (*e == '-' || *e == '+')) {
+            exp_negative = *e == '-';
+            e++;
+        }
+        if (e < end && (unsigned)(*e - '0') < 10) {
+            int value = 0;
+            while (e < end && (unsigned)(*e - '0') < 10) {
+                if (value < 10000)
+                    value = value * 10 + (*e - '0');
+                e++;
+            }
+            exponent += exp_negative ? -value : value;
+            p = e;
+        }
+    }
+
+    // Exact as long as the mantissa fits in a double and the power of ten
+    // is exactly representable, which covers everything exporters write.
+    if (digits > 15 || exponent > 22 || exponent < -22)
+        return parseFloatSlow(start, end, out);
+
+    double value = (double)mantissa;
+    if (exponent < 0)
+        value /= pow10_table[-exponent];
+    else
+        value *= pow10_table[exponent];
+    out = (float)(negative ? -value : value);
+    return p;
+}
+
+const char * parseInt(const char * p, const char * end, int & out)
+{
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    if (p >= end || (unsigned)(*p - '0') >= 10)
+        return NULL;
+    // Past INT_MAX (INT_MIN's magnitude when negative) the index can only
+    // be wrong, rejecting it beats wrapping to a valid looking one
+    long long limit = negative ? 0x80000000LL : 0x7fffffffLL;
+    long long value = 0;
+    while (p < end && (unsigned)(*p - '0') < 10) {
+        value = value * 10 + (*p - '0');
+        if (value > limit)
+            return NULL;
+        p++;
+    }
+    out = (int)(negative ? -value : value);
+    return p;
+}
+
+// Face corner as written in the file. Positive indices are stored 0-based
+// and absolute; negative (relative) indices are stored 0-based relative to
+// the start of the chunk, because the number of elements before the chunk
+// isn't known until all chunks are parsed.
+struct FaceCorner
+{
+    int vertex, uv, normal;
+    unsigned char relative; // CORNER_* bits
+};
+
+enum
+{
+    CORNER_VERTEX_RELATIVE = 1,
+    CORNER_UV_RELATIVE = 2,
+    CORNER_NORMAL_RELATIVE = 4,
+    CORNER_NO_UV = 8,
+    CORNER_NO_NORMAL = 16
+};
+
+// Range check of a face index. The serial rule is that an index may only
+// refer to elements defined above it; per chunk we keep the worst case so
+// the check can be finished once the chunk's base offset is known.
+struct IndexBounds
+{
+    long long max_forward; // max(absolute index - local count), must be < base
+    long long min_relative; // min(chunk-relative index), must be >= -base
+    IndexBounds() : max_forward(LLONG_MIN), min_relative(LLONG_MAX) {}
+};
+
+struct ObjChunk
+{
+    std::vector<glm::vec3> vertices;
+    std::vector<glm::vec2> uvs;
+    std::vector<glm::vec3> normals;
+    std::vector<FaceCorner> corners; // 3 per triangle
+    IndexBounds vertex_bounds, uv_bounds, normal_bounds;
+    unsigned int lines;
+    unsigned int error_line; // 0 when the chunk parsed cleanly
+    const char * error;
+};
+
+// Parses one "v", "v/vt", "v//vn" or "v/vt/vn" face corner.
+const char * parseCorner(const char * p, const char * end, int index[3])
+{
+    index[1] = 0;
+    index[2] = 0;
+    p = parseInt(p, end, index[0]);
+    if (!p)
+        return NULL;
+    if (p < end && *p == '/') {
+        p++;
+        if (p < end && *p != '/') {
+            p = parseInt(p, end, index[1]);
+            if (!p)
+                return NULL;
+        }
+        if (p < end && *p == '/') {
+            p = parseInt(p + 1, end, index[2]);
+            if (!p)
+                return NULL;
+        }
+    }
+    return p;
+}
+
+// Converts a file index into the FaceCorner encoding and updates the bounds.
+// Returns false for index 0, which OBJ doesn't allow.
+inline bool encodeIndex(int index, size_t local_count, unsigned char relative_bit,
+    int & out, unsigned char & relative, IndexBounds & bounds)
+{
+    if (index > 0) {
+        out = index - 1;
+        long long forward = (long long)out - (long long)local_count;
+        if (forward > bounds.max_forward) bounds.max_forward = forward;
+    } else if (index < 0) {
+        out = (int)local_count + index;
+        relative |= relative_bit;
+        if (out < bounds.min_relative) bounds.min_relative = out;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Parses the lines in [p, end). The range must start at a line boundary.
+void parseChunk(const char * p, const char * end, ObjChunk & chunk)
+{
+    chunk.lines = 0;
+    chunk.error_line = 0;
+    chunk.error = NULL;
+
+    // Rough guess to avoid most reallocations: ~30 bytes per record
+    size_t estimate = (end - p) / 32;
+    chunk.vertices.reserve(estimate / 2);
+    chunk.corners.reserve(estimate);
+
+    while (p < end) {
+        chunk.lines++;
+        p = skipBlanks(p, end);
+        if (p >= end)
+            break;
+
+        if (p[0] == 'v' && p + 1 < end && isBlank(p[1])) {
+            glm::vec3 vertex;
+            const char * q = p + 1;
+            for (int i = 0; i < 3 && q; i++)
+                q = parseFloat(skipBlanks(q, end), end, vertex[i]);
+            if (!q) {
+                chunk.error = "malformed vertex";
+                chunk.error_line = chunk.lines;
+                return;
+            }
+            chunk.vertices.push_back(vertex);
+        } else if (p[0] == 'v' && p + 2 < end && p[1] == 't' && isBlank(p[2])) {
+            glm::vec2 uv;
+            const char * q = p + 2;
+            for (int i = 0; i < 2 && q; i++)
+                q = parseFloat(skipBlanks(q, end), end, uv[i]);
+            if (!q) {
+                chunk.error = "malformed texture coordinate";
+                chunk.error_line = chunk.lines;
+                return;
+            }
+            uv.y = -uv.y; // Same V inversion as loadOBJ
+            chunk.uvs.push_back(uv);
+        } else if (p[0] == 'v' && p + 2 < end && p[1] == 'n' && isBlank(p[2])) {
+            glm::vec3 normal;
+            const char * q = p + 2;
+            for (int i = 0; i < 3 && q; i++)
+                q = parseFloat(skipBlanks(q, end), end, normal[i]);
+            if (!q) {
+                chunk.error = "malformed normal";
+                chunk.error_line = chunk.lines;
+                return;
+            }
+            chunk.normals.push_back(normal);
+        } else if (p[0] == 'f' && p + 1 < end && isBlank(p[1])) {
+            // Polygons are triangulated as a fan around the first corner
+            FaceCorner first, previous, corner;
+            int count = 0;
+            const char * q = skipBlanks(p + 1, end);
+            while (q < end && *q != '\n') {
+                int index[3];
+                q = parseCorner(q, end, index);
+                corner.relative = 0;
+                bool valid = q != NULL
+                    && encodeIndex(index[0], chunk.vertices.size(), CORNER_VERTEX_RELATIVE,
+                        corner.vertex, corner.relative, chunk.vertex_bounds);
+                if (valid && index[1] == 0) {
+                    corner.uv = 0;
+                    corner.relative |= CORNER_NO_UV;
+                } else if (valid) {
+                    valid = encodeIndex(index[1], chunk.uvs.size(), CORNER_UV_RELATIVE,
+                        corner.uv, corner.relative, chunk.uv_bounds);
+                }
+                if (valid && index[2] == 0) {
+                    corner.normal = 0;
+                    corner.relative |= CORNER_NO_NORMAL;
+                } else if (valid) {
+                    valid = encodeIndex(index[2], chunk.normals.size(), CORNER_NORMAL_RELATIVE,
+                        corner.normal, corner.relative, chunk.normal_bounds);
+                }
+                if (!valid) {
+                    chunk.error = "malformed face";
+                    chunk.error_line = chunk.lines;
+                    return;
+                }
+
+                if (count == 0)
+                    first = corner;
+                if (count >= 2) {
+                    chunk.corners.push_back(first);
+                    chunk.corners.push_back(previous);
+                    chunk.corners.push_back(corner);
+                }
+                previous = corner;
+                count++;
+                q = skipBlanks(q, end);
+            }
+        }
+        // Anything else (comments, groups, materials) is skipped
+
+        p = skipLine(p, end);
+    }
+}
+
+inline bool boundsValid(const IndexBounds & bounds, size_t base)
+{
+    return bounds.max_forward < (long long)base && bounds.min_relative >= -(long long)base;
+}
+
+// Element offsets of one chunk in the merged arrays
+struct ChunkBase
+{
+    size_t vertex, uv, normal, corner;
+};
+
+// Writes the triangles of one chunk into its slot of the output arrays.
+void resolveChunk(const ObjChunk & chunk, const ChunkBase & base,
+    const std::vector<glm::vec3> & vertices,
+    const std::vector<glm::vec2> & uvs,
+    const std::vector<glm::vec3> & normals,
+    glm::vec3 * out_vertices, glm::vec2 * out_uvs, glm::vec3 * out_normals)
+{
+    for (size_t i = 0; i < chunk.corners.size(); i++) {
+        const FaceCorner & c = chunk.corners[i];
+        size_t v = c.relative & CORNER_VERTEX_RELATIVE ? base.vertex + c.vertex : c.vertex;
+        out_vertices[i] = vertices[v];
+
+        if (c.relative & CORNER_NO_UV) {
+            out_uvs[i] = glm::vec2();
+        } else {
+            size_t t = c.relative & CORNER_UV_RELATIVE ? base.uv + c.uv : c.uv;
+            out_uvs[i] = uvs[t];
+        }
+
+        if (c.relative & CORNER_NO_NORMAL) {
+            out_normals[i] = glm::vec3();
+        } else {
+            size_t n = c.relative & CORNER_NORMAL_RELATIVE ? base.normal + c.normal : c.normal;
+            out_normals[i] = normals[n];
+        }
+    }
+}
+
+// Runs fn(0) .. fn(count - 1) on up to count threads; index 0 runs on the
+// calling thread.
+template <typename Fn>
+void runParallel(size_t count, Fn fn)
+{
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < count; i++)
+        threads.push_back(std::thread(fn, i));
+    fn(0);
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+}
+
+// Below this many bytes per chunk, threads cost more than they save
+const size_t min_chunk_size = 1 << 20;
+
+} // namespace
+
+bool loadOBJMapped(
+    const char * path,
+    std::vector<glm::vec3> & out_vertices,
+    std::vector<glm::vec2> & out_uvs,
+    std::vector<glm::vec3> & out_normals,
+    unsigned int thread_count
+){
+    printf("Loading OBJ file %s...\n", path);
+
+    MappedFile file;
+    if (!file.open(path)) {
+        printf("Impossible to open the file %s !\n", path);
+        return false;
+    }
+
+    if (thread_count == 0)
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    size_t chunk_count = std::min<size_t>(thread_count, file.size() / min_chunk_size);
+    if (chunk_count == 0)
+        chunk_count = 1;
+
+    // Split at line boundaries
+    const char * begin = file.data();
+    const char * end = begin + file.size();
+    std::vector<const char *> splits(chunk_count + 1);
+    splits[0] = begin;
+    splits[chunk_count] = end;
+    for (size_t i = 1; i < chunk_count; i++) {
+        const char * p = begin + file.size() / chunk_count * i;
+        if (p < splits[i - 1])
+            p = splits[i - 1];
+        splits[i] = skipLine(p, end);
+    }
+
+    std::vector<ObjChunk> chunks(chunk_count);
+    runParallel(chunk_count, [&](size_t i) {
+        parseChunk(splits[i], splits[i + 1], chunks[i]);
+    });
+
+    // Prefix sums give every chunk its offsets in the merged arrays
+    std::vector<ChunkBase> bases(chunk_count);
+    ChunkBase total = { 0, 0, 0, 0 };
+    unsigned int line_base = 0;
+    for (size_t i = 0; i < chunk_count; i++) {
+        const ObjChunk & chunk = chunks[i];
+        bases[i] = total;
+        if (chunk.error) {
+            printf("%s:%u: %s\n", path, line_base + chunk.error_line, chunk.error);
+            return false;
+        }
+        if (!boundsValid(chunk.vertex_bounds, total.vertex)
+            || !boundsValid(chunk.uv_bounds, total.uv)
+            || !boundsValid(chunk.normal_bounds, total.normal)) {
+            printf("%s: face index out of range\n", path);
+            return false;
+        }
+        total.vertex += chunk.vertices.size();
+        total.uv += chunk.uvs.size();
+        total.normal += chunk.normals.size();
+        total.corner += chunk.corners.size();
+        line_base += chunk.lines;
+    }
+
+    // A single chunk can index its own arrays directly
+    std::vector<glm::vec3> merged_vertices, merged_normals;
+    std::vector<glm::vec2> merged_uvs;
+    if (chunk_count == 1) {
+        merged_vertices.swap(chunks[0].vertices);
+        merged_uvs.swap(chunks[0].uvs);
+        merged_normals.swap(chunks[0].normals);
+    } else {
+        merged_vertices.resize(total.vertex);
+        merged_uvs.resize(total.uv);
+        merged_normals.resize(total.normal);
+        runParallel(chunk_count, [&](size_t i) {
+            std::copy(chunks[i].vertices.begin(), chunks[i].vertices.end(), merged_vertices.begin() + bases[i].vertex);
+            std::copy(chunks[i].uvs.begin(), chunks[i].uvs.end(), merged_uvs.begin() + bases[i].uv);
+            std::copy(chunks[i].normals.begin(), chunks[i].normals.end(), merged_normals.begin() + bases[i].normal);
+        });
+    }
+
+    // No faces, nothing to resolve; the output arrays may still be empty
+    if (total.corner == 0)
+        return true;
+
+    size_t out_base = out_vertices.size();
+    out_vertices.resize(out_base + total.corner);
+    out_uvs.resize(out_base + total.corner);
+    out_normals.resize(out_base + total.corner);
+    runParallel(chunk_count, [&](size_t i) {
+        size_t offset = out_base + bases[i].corner;
+        resolveChunk(chunks[i], bases[i], merged_vertices, merged_uvs, merged_normals,
+            &out_vertices[0] + offset, &out_uvs[0] + offset, &out_normals[0] + offset);
+    });
+
+    return true;
+}
+
+
+bool loadOBJIndexed(
+    const char * path,
+    IndexedMesh & out_mesh,
+    unsigned int thread_count
+){
+    std::vector<glm::vec3> vertices, normals;
+    std::vector<glm::vec2> uvs;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (!loadOBJMapped(path, vertices, uvs, normals, thread_count))
+        return false;
+    std::chrono::steady_clock::time_point parsed = std::chrono::steady_clock::now();
+    buildIndexedMesh(vertices, uvs, normals, out_mesh);
+    std::chrono::steady_clock::time_point indexed = std::chrono::steady_clock::now();
+
+    double parse_ms = std::chrono::duration<double, std::milli>(parsed - start).count();
+    double index_ms = std::chrono::duration<double, std::milli>(indexed - parsed).count();
+    printf("%s: %u corners -> %u unique vertices (%.2fx), parse %.2f ms, dedup %.2f ms\n",
+        path, (unsigned int)vertices.size(), (unsigned int)out_mesh.vertices.size(),
+        out_mesh.vertices.empty() ? 0.0 : (double)vertices.size() / out_mesh.vertices.size(),
+        parse_ms, index_ms);
+
+    return true;
+}
+
+
 #ifdef USE_ASSIMP // don't use this #define, it's only for me (it AssImp fails to compile on your machine, at least all the other tutorials still work)
 
 // Include AssImp
@@ -129,7 +649,6 @@ bool loadAssImp(
     const aiScene* scene = importer.ReadFile(path, 0/*aiProcess_JoinIdenticalVertices | aiProcess_SortByPType*/);
     if( !scene) {
         fprintf( stderr, importer.GetErrorString());
-        getchar();
         return false;
     }
     const aiMesh* mesh = scene->mMeshes[0]; // In this simple example code we always use the 1rst mesh (in OBJ files there is often only one anyway)
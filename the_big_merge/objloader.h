@@ -3,6 +3,8 @@
 
 #include <vector>
 
+#include "mesh.h"
+
 bool loadOBJ(
 	const char * path, 
 	std::vector<glm::vec3> & out_vertices, 
@@ -12,6 +14,26 @@ bool loadOBJ(
 
 
 
+// Same contract as loadOBJ, but memory-maps the file and parses it in place.
+// Also accepts polygons, negative indices and faces without uv/normal.
+// Large files are split at line boundaries and parsed on thread_count
+// threads (0 = one per core); the output is identical for any thread count.
+bool loadOBJMapped(
+	const char * path, 
+	std::vector<glm::vec3> & out_vertices, 
+	std::vector<glm::vec2> & out_uvs, 
+	std::vector<glm::vec3> & out_normals,
+	unsigned int thread_count = 1
+);
+
+// loadOBJMapped followed by buildIndexedMesh; prints the dedup ratio and
+// the time spent in each step.
+bool loadOBJIndexed(
+	const char * path,
+	IndexedMesh & out_mesh,
+	unsigned int thread_count = 1
+);
+
 bool loadAssImp(
 	const char * path, 
 	std::vector<unsigned short> & indices,
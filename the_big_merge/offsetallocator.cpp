@@ -0,0 +1,127 @@
+#include "offsetallocator.h"
+
+OffsetAllocator::OffsetAllocator(size_t capacity)
+    : capacity_(0), used_(0)
+{
+    reset(capacity);
+}
+
+void OffsetAllocator::reset(size_t capacity)
+{
+    capacity_ = capacity;
+    used_ = 0;
+    free_by_offset_.clear();
+    free_by_size_.clear();
+    allocations_.clear();
+    if (capacity > 0)
+        insertFree(0, capacity);
+}
+
+void OffsetAllocator::grow(size_t new_capacity)
+{
+    if (new_capacity <= capacity_)
+        return;
+    size_t offset = capacity_;
+    size_t size = new_capacity - capacity_;
+    capacity_ = new_capacity;
+
+    // Merge with a free block that ends at the old capacity
+    if (!free_by_offset_.empty()) {
+        std::map<size_t, size_t>::iterator last = --free_by_offset_.end();
+        if (last->first + last->second == offset) {
+            offset = last->first;
+            size += last->second;
+            eraseFree(last);
+        }
+    }
+    insertFree(offset, size);
+}
+
+size_t OffsetAllocator::allocate(size_t size, size_t alignment)
+{
+    if (size == 0)
+        return invalid_offset;
+    if (alignment == 0)
+        alignment = 1;
+
+    // Smallest free block that still fits once the offset is aligned
+    for (SizeMap::iterator it = free_by_size_.lower_bound(size); it != free_by_size_.end(); ++it) {
+        size_t block_offset = it->second;
+        size_t block_size = it->first;
+        size_t aligned = (block_offset + alignment - 1) / alignment * alignment;
+        size_t padding = aligned - block_offset;
+        if (padding + size > block_size)
+            continue;
+
+        eraseFree(free_by_offset_.find(block_offset));
+        if (padding > 0)
+            insertFree(block_offset, padding);
+        if (padding + size < block_size)
+            insertFree(aligned + size, block_size - padding - size);
+
+        allocations_[aligned] = size;
+        used_ += size;
+        return aligned;
+    }
+    return invalid_offset;
+}
+
+bool OffsetAllocator::free(size_t offset)
+{
+    std::map<size_t, size_t>::iterator allocation = allocations_.find(offset);
+    if (allocation == allocations_.end())
+        return false;
+    size_t size = allocation->second;
+    allocations_.erase(allocation);
+    used_ -= size;
+
+    // Coalesce with the free blocks directly after and before
+    std::map<size_t, size_t>::iterator next = free_by_offset_.lower_bound(offset);
+    if (next != free_by_offset_.end() && next->first == offset + size) {
+        size += next->second;
+        eraseFree(next);
+        next = free_by_offset_.lower_bound(offset);
+    }
+    if (next != free_by_offset_.begin()) {
+        std::map<size_t, size_t>::iterator previous = next;
+        --previous;
+        if (previous->first + previous->second == offset) {
+            offset = previous->first;
+            size += previous->second;
+            eraseFree(previous);
+        }
+    }
+    insertFree(offset, size);
+    return true;
+}
+
+OffsetAllocatorStats OffsetAllocator::stats() const
+{
+    OffsetAllocatorStats s;
+    s.capacity = capacity_;
+    s.used = used_;
+    s.free = capacity_ - used_;
+    s.largest_free = free_by_size_.empty() ? 0 : (--free_by_size_.end())->first;
+    s.free_blocks = free_by_offset_.size();
+    s.allocations = allocations_.size();
+    s.fragmentation = s.free > 0 ? 1.0f - (float)s.largest_free / (float)s.free : 0.0f;
+    return s;
+}
+
+void OffsetAllocator::insertFree(size_t offset, size_t size)
+{
+    free_by_offset_[offset] = size;
+    free_by_size_.insert(SizeMap::value_type(size, offset));
+}
+
+void OffsetAllocator::eraseFree(std::map<size_t, size_t>::iterator block)
+{
+    std::pair<SizeMap::iterator, SizeMap::iterator> range = free_by_size_.equal_range(block->second);
+    for (SizeMap::iterator it = range.first; it != range.second; ++it) {
+        if (it->second == block->first) {
+            free_by_size_.erase(it);
+            break;
+        }
+    }
+    free_by_offset_.erase(block);
+}
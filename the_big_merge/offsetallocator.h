@@ -0,0 +1,61 @@
+#ifndef OFFSETALLOCATOR_H
+#define OFFSETALLOCATOR_H
+
+#include <cstddef>
+#include <map>
+
+// Fragmentation report of an OffsetAllocator, all sizes in allocator units
+struct OffsetAllocatorStats
+{
+	size_t capacity;
+	size_t used;
+	size_t free;
+	size_t largest_free;        // biggest single allocation that would fit
+	size_t free_blocks;
+	size_t allocations;
+	float fragmentation;        // 1 - largest_free / free, 0 when free is one block
+};
+
+// CPU side bookkeeping of a linear range [0, capacity) of some resource,
+// e.g. a GL buffer. Best fit from a free list, freed blocks coalesce with
+// their neighbours. Doesn't touch GL, so it can be driven headless.
+class OffsetAllocator
+{
+public:
+	static const size_t invalid_offset = (size_t)-1;
+
+	explicit OffsetAllocator(size_t capacity = 0);
+
+	// Forgets all allocations
+	void reset(size_t capacity);
+
+	// Appends [capacity, new_capacity) to the free space, new_capacity must
+	// not be smaller than the current capacity
+	void grow(size_t new_capacity);
+
+	// Returns the offset of size units aligned to alignment, or
+	// invalid_offset when no free block is big enough
+	size_t allocate(size_t size, size_t alignment = 1);
+
+	// Frees an allocation made by allocate, returns false for unknown offsets
+	bool free(size_t offset);
+
+	size_t capacity() const { return capacity_; }
+	size_t used() const { return used_; }
+
+	OffsetAllocatorStats stats() const;
+
+private:
+	typedef std::multimap<size_t, size_t> SizeMap;
+
+	void insertFree(size_t offset, size_t size);
+	void eraseFree(std::map<size_t, size_t>::iterator block);
+
+	size_t capacity_;
+	size_t used_;
+	std::map<size_t, size_t> free_by_offset_;   // offset -> size
+	SizeMap free_by_size_;                      // size -> offset, for best fit
+	std::map<size_t, size_t> allocations_;      // offset -> size
+};
+
+#endif
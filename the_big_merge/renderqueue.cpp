@@ -0,0 +1,134 @@
+#include <algorithm>
+
+#include "renderqueue.h"
+
+namespace {
+
+const unsigned int PROGRAM_BITS = 8, TEXTURE_BITS = 16, VAO_BITS = 8, DEPTH_BITS = 24;
+const unsigned int PROGRAM_SHIFT = 56, TEXTURE_SHIFT = 40, VAO_SHIFT = 32, DEPTH_SHIFT = 8;
+
+} // namespace
+
+RenderCommand::RenderCommand()
+    : type(RENDER_INSTANCED), program(0), vao(0), texture_target(0), texture(0),
+    storage_binding(0), storage_buffer(0),
+    uniform_binding(0), uniform_buffer(0), uniform_offset(0), uniform_size(0),
+    index_type(GL_UNSIGNED_SHORT), indirect_buffer(0), commands(NULL), first(0), count(0),
+    index_count(0), index_offset(0), instance_count(0), base_vertex(0)
+{
+}
+
+RenderQueue::RenderQueue()
+{
+}
+
+void RenderQueue::clear()
+{
+    commands_.clear();
+    items_.clear();
+}
+
+void RenderQueue::record(const RenderCommand & command, float depth)
+{
+    SortItem item;
+    item.key = (unsigned long long)slot(program_slots_, command.program, PROGRAM_BITS) << PROGRAM_SHIFT
+        | (unsigned long long)slot(texture_slots_, command.texture_target ? command.texture : 0, TEXTURE_BITS) << TEXTURE_SHIFT
+        | (unsigned long long)slot(vao_slots_, command.vao, VAO_BITS) << VAO_SHIFT
+        | (unsigned long long)(std::min(std::max(depth, 0.0f), 1.0f) * ((1u << DEPTH_BITS) - 1)) << DEPTH_SHIFT;
+    item.command = (unsigned int)commands_.size();
+    items_.push_back(item);
+    commands_.push_back(command);
+}
+
+unsigned int RenderQueue::submit(GLStateCache & state, bool multi_draw)
+{
+    sort();
+
+    // Uploads, loads and reloads since the last frame have bound things
+    // the cache didn't see
+    state.invalidate();
+
+    unsigned int calls = 0;
+    for (size_t i = 0; i < items_.size(); i++) {
+        const RenderCommand & command = commands_[items_[i].command];
+        state.useProgram(command.program);
+        state.bindVertexArray(command.vao);
+        if (command.texture_target)
+            state.bindTexture(command.texture_target, command.texture);
+        if (command.storage_buffer)
+            state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, command.storage_binding, command.storage_buffer);
+        if (command.uniform_size)
+            state.bindBufferRange(GL_UNIFORM_BUFFER, command.uniform_binding, command.uniform_buffer,
+                command.uniform_offset, command.uniform_size);
+
+        if (command.type == RENDER_INSTANCED) {
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.index_count, command.index_type,
+                (void *)command.index_offset, command.instance_count, command.base_vertex);
+            calls++;
+        }
+        else if (multi_draw) {
+            state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, command.indirect_buffer);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, command.index_type,
+                (void *)(command.first * sizeof(DrawElementsIndirectCommand)), command.count, 0);
+            calls++;
+        }
+        else {
+            for (GLsizei d = 0; d < command.count; d++) {
+                const DrawElementsIndirectCommand & draw = command.commands[command.first + d];
+                glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, draw.count, command.index_type,
+                    (void *)(draw.first_index * indexTypeSize(command.index_type)), draw.instance_count,
+                    draw.base_vertex, draw.base_instance);
+                calls++;
+            }
+        }
+    }
+
+    // Index buffer uploads outside the queue must not land in a vao
+    state.bindVertexArray(0);
+    return calls;
+}
+
+unsigned int RenderQueue::slot(std::map<GLuint, unsigned int> & slots, GLuint name, unsigned int bits)
+{
+    std::map<GLuint, unsigned int>::iterator found = slots.find(name);
+    if (found != slots.end())
+        return found->second;
+    // Out of numbers, start over; the order between states changes once
+    if (slots.size() == (1u << bits))
+        slots.clear();
+    unsigned int number = (unsigned int)slots.size();
+    slots[name] = number;
+    return number;
+}
+
+void RenderQueue::sort()
+{
+    size_t count = items_.size();
+    if (count < 2)
+        return;
+
+    // All eight byte histograms in one pass over the keys
+    static const int BYTES = 8;
+    std::vector<size_t> counts(BYTES * 256, 0);
+    for (size_t i = 0; i < count; i++)
+        for (int b = 0; b < BYTES; b++)
+            counts[b * 256 + ((items_[i].key >> (b * 8)) & 0xff)]++;
+
+    scratch_.resize(count);
+    for (int b = 0; b < BYTES; b++) {
+        size_t * bucket = &counts[b * 256];
+        unsigned int shift = b * 8;
+        if (bucket[(items_[0].key >> shift) & 0xff] == count)
+            continue;
+
+        size_t offset = 0;
+        for (int v = 0; v < 256; v++) {
+            size_t n = bucket[v];
+            bucket[v] = offset;
+            offset += n;
+        }
+        for (size_t i = 0; i < count; i++)
+            scratch_[bucket[(items_[i].key >> shift) & 0xff]++] = items_[i];
+        items_.swap(scratch_);
+    }
+}
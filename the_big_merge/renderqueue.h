@@ -0,0 +1,107 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <map>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "drawbatch.h"
+#include "statecache.h"
+
+enum RenderCommandType
+{
+	RENDER_MULTI_DRAW,          // a run of a DrawBatch's indirect commands
+	RENDER_INSTANCED            // one glDrawElementsInstancedBaseVertex
+};
+
+// A draw and the state it needs, zeroed by the constructor. A zero
+// texture target, storage buffer or uniform size leaves that state alone.
+struct RenderCommand
+{
+	RenderCommand();
+
+	RenderCommandType type;
+	GLuint program;
+	GLuint vao;
+	GLenum texture_target;
+	GLuint texture;
+
+	// Shader storage buffer the draw reads, DrawData or instances
+	GLuint storage_binding;
+	GLuint storage_buffer;
+
+	// Uniform block range, e.g. an object block in the uniform ring
+	GLuint uniform_binding;
+	GLuint uniform_buffer;
+	GLintptr uniform_offset;
+	GLsizeiptr uniform_size;
+
+	GLenum index_type;
+
+	// RENDER_MULTI_DRAW: count commands from first in indirect_buffer, the
+	// same ones in commands for drawing them one by one
+	GLuint indirect_buffer;
+	const DrawElementsIndirectCommand * commands;
+	size_t first;
+	GLsizei count;
+
+	// RENDER_INSTANCED
+	GLsizei index_count;
+	size_t index_offset;        // bytes into the vao's index buffer
+	GLsizei instance_count;
+	GLint base_vertex;
+};
+
+// The draws of a frame, recorded in any order and submitted sorted by a
+// 64 bit key so that draws sharing state follow each other and the
+// GLStateCache drops the bindings they share. From the top bit:
+//   8 bits program, 16 texture, 8 vao, 24 depth, 8 unused
+// Programs, textures and vaos are numbered as the queue first sees them,
+// which keeps the recording order between programs from frame to frame;
+// numbering starts over when a field runs out, which only reorders.
+// Depth orders front to back within the same state. The keys are sorted
+// by a stable LSD radix sort a byte a pass, skipping the bytes every key
+// shares.
+class RenderQueue
+{
+public:
+	RenderQueue();
+
+	void clear();
+
+	// depth is the distance from the camera over the far plane, 0 to 1.
+	// Multi-draw commands point into their DrawBatch and are valid until
+	// it is recorded again.
+	void record(const RenderCommand & command, float depth = 0.0f);
+
+	// Sorts the frame's commands and submits them through state, leaving
+	// no vao bound. Multi-draw runs are drawn one
+	// glDrawElementsInstancedBaseVertexBaseInstance per command when
+	// multi_draw is false. Returns the number of GL draw calls made.
+	unsigned int submit(GLStateCache & state, bool multi_draw = true);
+
+	size_t size() const { return commands_.size(); }
+
+private:
+	RenderQueue(const RenderQueue &);
+	RenderQueue & operator=(const RenderQueue &);
+
+	struct SortItem
+	{
+		unsigned long long key;
+		unsigned int command;
+	};
+
+	static unsigned int slot(std::map<GLuint, unsigned int> & slots, GLuint name, unsigned int bits);
+	void sort();
+
+	std::vector<RenderCommand> commands_;
+	std::vector<SortItem> items_;
+	std::vector<SortItem> scratch_;
+	std::map<GLuint, unsigned int> program_slots_;
+	std::map<GLuint, unsigned int> texture_slots_;
+	std::map<GLuint, unsigned int> vao_slots_;
+};
+
+#endif
@@ -0,0 +1,201 @@
+#include <stdio.h>
+
+#include "meshcache.h"
+#include "resourcecache.h"
+
+void GLResourceBackend::release(const Resource & resource)
+{
+    switch (resource.type) {
+    case RESOURCE_MESH:
+        if (resource.arena)
+            resource.arena->free(resource.mesh.range);
+        break;
+    case RESOURCE_TEXTURE:
+        glDeleteTextures(1, &resource.name);
+        break;
+    case RESOURCE_PROGRAM:
+        glDeleteProgram(resource.name);
+        break;
+    }
+}
+
+ResourceCache::ResourceCache()
+    : backend_(NULL), cpu_budget_(0), gpu_budget_(0),
+    hits_(0), misses_(0), evictions_(0), referenced_(0), cpu_bytes_(0), gpu_bytes_(0)
+{
+}
+
+ResourceCache::~ResourceCache()
+{
+    // Releasing needs the context, that is clear()'s job
+}
+
+void ResourceCache::create(ResourceBackend & backend, size_t cpu_budget, size_t gpu_budget)
+{
+    clear();
+    backend_ = &backend;
+    cpu_budget_ = cpu_budget;
+    gpu_budget_ = gpu_budget;
+    resetCounters();
+}
+
+void ResourceCache::setBudget(size_t cpu_budget, size_t gpu_budget)
+{
+    cpu_budget_ = cpu_budget;
+    gpu_budget_ = gpu_budget;
+    evict(cpu_budget_, gpu_budget_);
+}
+
+ResourceHandle ResourceCache::find(ResourceType type, unsigned long long hash, const char * path)
+{
+    Key key(type, hash);
+    std::map<Key, Entry>::iterator it = entries_.find(key);
+    if (it == entries_.end()) {
+        misses_++;
+        return ResourceHandle();
+    }
+    hits_++;
+    if (path)
+        rememberPath(type, path, hash);
+    return acquire(key, it->second);
+}
+
+ResourceHandle ResourceCache::findPath(ResourceType type, const char * path)
+{
+    std::map<std::pair<ResourceType, std::string>, PathStamp>::iterator stamp =
+        paths_.find(std::make_pair(type, std::string(path)));
+    if (stamp == paths_.end())
+        return ResourceHandle();
+
+    // A changed file is a different resource, its hash has to be taken again
+    unsigned long long size;
+    long long mtime;
+    if (!statFile(path, size, mtime) || size != stamp->second.size || mtime != stamp->second.mtime) {
+        paths_.erase(stamp);
+        return ResourceHandle();
+    }
+
+    Key key(type, stamp->second.hash);
+    std::map<Key, Entry>::iterator it = entries_.find(key);
+    if (it == entries_.end())
+        return ResourceHandle();
+    hits_++;
+    return acquire(key, it->second);
+}
+
+ResourceHandle ResourceCache::insert(const Resource & resource, const char * path)
+{
+    Key key(resource.type, resource.hash);
+    if (path)
+        rememberPath(resource.type, path, resource.hash);
+
+    std::map<Key, Entry>::iterator it = entries_.find(key);
+    if (it != entries_.end()) {
+        // Loaded twice, e.g. by two paths at once; keep the first copy
+        if (backend_)
+            backend_->release(resource);
+        return acquire(key, it->second);
+    }
+
+    Entry & entry = entries_[key];
+    entry.resource.reset(new Resource(resource));
+    entry.lru = lru_.end();
+    cpu_bytes_ += resource.cpu_bytes;
+    gpu_bytes_ += resource.gpu_bytes;
+    ResourceHandle handle = acquire(key, entry);
+
+    // The new entry is referenced, only older unused ones can go
+    evict(cpu_budget_, gpu_budget_);
+    return handle;
+}
+
+ResourceHandle ResourceCache::acquire(const Key & key, Entry & entry)
+{
+    ResourceHandle handle = entry.handle.lock();
+    if (handle)
+        return handle;
+
+    if (entry.lru != lru_.end()) {
+        lru_.erase(entry.lru);
+        entry.lru = lru_.end();
+    }
+    referenced_++;
+    Release release = { this, key, entry.resource };
+    handle = ResourceHandle(entry.resource.get(), release);
+    entry.handle = handle;
+    return handle;
+}
+
+void ResourceCache::released(const Key & key, const Resource * resource)
+{
+    // Gone already when the cache was cleared under live handles
+    std::map<Key, Entry>::iterator it = entries_.find(key);
+    if (it == entries_.end() || it->second.resource.get() != resource)
+        return;
+    referenced_--;
+    it->second.lru = lru_.insert(lru_.end(), key);
+    evict(cpu_budget_, gpu_budget_);
+}
+
+void ResourceCache::rememberPath(ResourceType type, const char * path, unsigned long long hash)
+{
+    PathStamp stamp;
+    stamp.hash = hash;
+    if (statFile(path, stamp.size, stamp.mtime))
+        paths_[std::make_pair(type, std::string(path))] = stamp;
+}
+
+void ResourceCache::evict(size_t cpu_budget, size_t gpu_budget)
+{
+    while ((cpu_bytes_ > cpu_budget || gpu_bytes_ > gpu_budget) && !lru_.empty()) {
+        std::map<Key, Entry>::iterator it = entries_.find(lru_.front());
+        lru_.pop_front();
+        const Resource & resource = *it->second.resource;
+        cpu_bytes_ -= resource.cpu_bytes;
+        gpu_bytes_ -= resource.gpu_bytes;
+        if (backend_)
+            backend_->release(resource);
+        entries_.erase(it);
+        evictions_++;
+    }
+}
+
+void ResourceCache::clear()
+{
+    for (std::map<Key, Entry>::iterator it = entries_.begin(); it != entries_.end(); ++it)
+        if (backend_)
+            backend_->release(*it->second.resource);
+    entries_.clear();
+    lru_.clear();
+    paths_.clear();
+    referenced_ = 0;
+    cpu_bytes_ = gpu_bytes_ = 0;
+}
+
+ResourceCacheStats ResourceCache::stats() const
+{
+    ResourceCacheStats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.evictions = evictions_;
+    stats.entries = (unsigned int)entries_.size();
+    stats.referenced = referenced_;
+    stats.cpu_bytes = cpu_bytes_;
+    stats.gpu_bytes = gpu_bytes_;
+    return stats;
+}
+
+void ResourceCache::resetCounters()
+{
+    hits_ = misses_ = evictions_ = 0;
+}
+
+void ResourceCache::report() const
+{
+    printf("resource cache: %u entries (%u referenced), CPU %u/%u KB, GPU %u/%u KB, "
+        "%u hits, %u misses, %u evictions\n",
+        (unsigned int)entries_.size(), referenced_,
+        (unsigned int)(cpu_bytes_ >> 10), (unsigned int)(cpu_budget_ >> 10),
+        (unsigned int)(gpu_bytes_ >> 10), (unsigned int)(gpu_budget_ >> 10),
+        hits_, misses_, evictions_);
+}
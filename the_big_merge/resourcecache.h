@@ -0,0 +1,157 @@
+#ifndef RESOURCECACHE_H
+#define RESOURCECACHE_H
+
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "bufferarena.h"
+#include "simplify.h"
+#include "vertexformat.h"
+
+enum ResourceType
+{
+	RESOURCE_MESH,
+	RESOURCE_TEXTURE,
+	RESOURCE_PROGRAM
+};
+
+// A mesh living in an arena, what a draw needs of it
+struct MeshAsset
+{
+	ArenaRange range;
+	std::vector<MeshLod> lods;
+	QuantizationRange quantization;
+	glm::vec3 bounds_min, bounds_max;
+};
+
+struct Resource
+{
+	ResourceType type;
+	unsigned long long hash;    // of the source file(s), the cache key with type
+	std::string path;           // first path it was loaded from
+	GLuint name;                // texture or program
+	MeshAsset mesh;             // meshes only
+	BufferArena * arena;        // meshes only, where mesh.range lives
+	size_t cpu_bytes;
+	size_t gpu_bytes;
+};
+
+// Shared, read-only reference to a cached resource. The resource stays
+// resident while any handle to it lives; handles must not outlive the
+// cache.
+typedef std::shared_ptr<const Resource> ResourceHandle;
+
+// Frees what a resource holds, GL objects or arena ranges. Virtual so
+// the cache can run without a context.
+class ResourceBackend
+{
+public:
+	virtual ~ResourceBackend() {}
+	virtual void release(const Resource & resource) = 0;
+};
+
+class GLResourceBackend : public ResourceBackend
+{
+public:
+	virtual void release(const Resource & resource);
+};
+
+struct ResourceCacheStats
+{
+	unsigned int hits;
+	unsigned int misses;
+	unsigned int evictions;
+	unsigned int entries;
+	unsigned int referenced;    // entries with live handles
+	size_t cpu_bytes;
+	size_t gpu_bytes;
+};
+
+// Resources keyed by type and content hash, so the same file, or the same
+// bytes under another path, is loaded once. Entries nobody holds a handle
+// to stay cached in least recently released order and are evicted from
+// the oldest when the CPU or GPU bytes exceed their budget. Referenced
+// entries are never evicted. GL thread only.
+class ResourceCache
+{
+public:
+	ResourceCache();
+	~ResourceCache();
+
+	void create(ResourceBackend & backend, size_t cpu_budget, size_t gpu_budget);
+
+	// Evicts down to the new budget if it is smaller
+	void setBudget(size_t cpu_budget, size_t gpu_budget);
+
+	// Resident resource with this content, counted as a hit or a miss.
+	// path, when given, is remembered for findPath.
+	ResourceHandle find(ResourceType type, unsigned long long hash, const char * path = NULL);
+
+	// Resource last found or inserted under path, if the file's size and
+	// mtime haven't changed since and it is still resident. Counts hits
+	// only, a NULL result is followed by loading and find/insert.
+	ResourceHandle findPath(ResourceType type, const char * path);
+
+	// Adds a loaded resource and returns the first handle to it. An entry
+	// with the same key is returned instead, and resource released.
+	ResourceHandle insert(const Resource & resource, const char * path = NULL);
+
+	// Releases every resource, referenced or not; for shutdown
+	void clear();
+
+	ResourceCacheStats stats() const;
+	void resetCounters();
+	void report() const;
+
+private:
+	ResourceCache(const ResourceCache &);
+	ResourceCache & operator=(const ResourceCache &);
+
+	typedef std::pair<ResourceType, unsigned long long> Key;
+
+	struct Entry
+	{
+		std::shared_ptr<Resource> resource;
+		std::weak_ptr<const Resource> handle;       // shared by all users
+		std::list<Key>::iterator lru;               // valid while unreferenced
+	};
+
+	struct PathStamp
+	{
+		unsigned long long hash;
+		unsigned long long size;
+		long long mtime;
+	};
+
+	// Deleter of the shared handle: runs when its last copy goes away
+	struct Release
+	{
+		ResourceCache * cache;
+		Key key;
+		std::shared_ptr<Resource> resource;
+		void operator()(const Resource * released) const { cache->released(key, released); }
+	};
+
+	ResourceHandle acquire(const Key & key, Entry & entry);
+	void released(const Key & key, const Resource * resource);
+	void rememberPath(ResourceType type, const char * path, unsigned long long hash);
+	void evict(size_t cpu_budget, size_t gpu_budget);
+
+	ResourceBackend * backend_;
+	size_t cpu_budget_, gpu_budget_;
+	std::map<Key, Entry> entries_;
+	std::list<Key> lru_;        // unreferenced entries, oldest release first
+	std::map<std::pair<ResourceType, std::string>, PathStamp> paths_;
+	unsigned int hits_, misses_, evictions_;
+	unsigned int referenced_;
+	size_t cpu_bytes_, gpu_bytes_;
+};
+
+#endif
@@ -0,0 +1,628 @@
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "glsl.h"
+#include "mappedfile.h"
+#include "meshcache.h"
+#include "shadermanager.h"
+
+namespace {
+
+const char PROGRAM_CACHE_MAGIC[4] = { 'P', 'R', 'O', 'G' };
+const unsigned int PROGRAM_CACHE_VERSION = 1;
+
+// Edits are picked up once a file has had no writes for this long
+const double QUIET_MS = 100.0;
+
+struct ProgramCacheHeader
+{
+    char magic[4];
+    unsigned int version;
+    unsigned long long key;         // of the sources and defines
+    unsigned long long driver;      // that produced the binary
+    unsigned int format;
+    unsigned int size;              // of the binary following the header
+};
+
+double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool readSource(const std::string & path, std::string & source)
+{
+    char * contents = glsl::readFile(path.c_str());
+    if (!contents)
+        return false;
+    source = contents;
+    delete[] contents;
+    return true;
+}
+
+unsigned long long programKey(const std::string & vertex_source, const std::string & fragment_source,
+    const std::string & defines)
+{
+    unsigned long long hashes[3] = {
+        hashBytes(vertex_source.data(), vertex_source.size()),
+        hashBytes(fragment_source.data(), fragment_source.size()),
+        hashBytes(defines.data(), defines.size())
+    };
+    return hashBytes(hashes, sizeof(hashes));
+}
+
+void splitPath(const std::string & path, std::string & directory, std::string & file)
+{
+    size_t slash = path.find_last_of("/\\");
+    if (slash == std::string::npos) {
+        directory = ".";
+        file = path;
+        return;
+    }
+    directory = slash ? path.substr(0, slash) : path.substr(0, 1);
+    file = path.substr(slash + 1);
+}
+
+bool programBinary(GLuint program, GLenum & format, std::vector<unsigned char> & binary)
+{
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return false;
+    binary.resize(length);
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &format, &binary[0]);
+    binary.resize(written);
+    return written > 0;
+}
+
+bool isLinked(GLuint program)
+{
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    return linked == GL_TRUE;
+}
+
+// Binds every attribute of from to the location it has there
+void copyAttributeLocations(GLuint from, GLuint to)
+{
+    GLint count = 0, max_length = 0;
+    glGetProgramiv(from, GL_ACTIVE_ATTRIBUTES, &count);
+    glGetProgramiv(from, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &max_length);
+    std::vector<char> name(max_length + 1);
+    for (GLint i = 0; i < count; i++) {
+        GLint size;
+        GLenum type;
+        glGetActiveAttrib(from, i, (GLsizei)name.size(), NULL, &size, &type, &name[0]);
+        if (strncmp(&name[0], "gl_", 3) == 0)
+            continue;
+        GLint location = glGetAttribLocation(from, &name[0]);
+        if (location >= 0)
+            glBindAttribLocation(to, location, &name[0]);
+    }
+}
+
+#ifdef _WIN32
+long long lastWriteTime(const std::string & path)
+{
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &data))
+        return 0;
+    return ((long long)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+}
+#endif
+
+} // namespace
+
+ShaderManager::ShaderManager()
+    : use_binaries_(false), parallel_compile_(false), binary_formats_(0), driver_(0), quit_(false)
+{
+    memset(&stats_, 0, sizeof(stats_));
+#ifdef _WIN32
+    wake_ = NULL;
+#else
+    inotify_ = -1;
+    wake_[0] = wake_[1] = -1;
+#endif
+}
+
+ShaderManager::~ShaderManager()
+{
+    // Deleting programs needs the context, that is destroy()'s job
+    stopWatching();
+}
+
+void ShaderManager::create(bool use_binaries, bool watch)
+{
+    destroy();
+    use_binaries_ = use_binaries;
+    memset(&stats_, 0, sizeof(stats_));
+
+    parallel_compile_ = GLEW_KHR_parallel_shader_compile != 0;
+    if (parallel_compile_)
+        glMaxShaderCompilerThreadsKHR(0xffffffff);     // as many as the driver likes
+
+    binary_formats_ = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binary_formats_);
+    std::string driver;
+    const GLenum strings[3] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+    for (int i = 0; i < 3; i++) {
+        const GLubyte * value = glGetString(strings[i]);
+        driver += value ? (const char *)value : "";
+        driver += '\n';
+    }
+    driver_ = hashBytes(driver.data(), driver.size());
+
+    if (!watch)
+        return;
+    quit_ = false;
+#ifdef _WIN32
+    wake_ = CreateEventA(NULL, FALSE, FALSE, NULL);
+    if (!wake_) {
+        printf("shaders: can't watch for edits\n");
+        return;
+    }
+#else
+    inotify_ = inotify_init1(IN_CLOEXEC);
+    if (inotify_ < 0 || pipe(wake_) != 0) {
+        printf("shaders: can't watch for edits\n");
+        stopWatching();
+        return;
+    }
+#endif
+    watcher_ = std::thread(&ShaderManager::watchLoop, this);
+}
+
+void ShaderManager::destroy()
+{
+    stopWatching();
+    for (size_t i = 0; i < programs_.size(); i++) {
+        deleteBuild(programs_[i].pending);
+        glDeleteProgram(programs_[i].name);
+    }
+    programs_.clear();
+    keys_.clear();
+}
+
+GLuint ShaderManager::load(const char * vertex_path, const char * fragment_path, const char * defines)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    Program program;
+    program.vertex_path = vertex_path;
+    program.fragment_path = fragment_path;
+    program.defines = defines ? defines : "";
+    program.reload_wanted = false;
+    program.pending.program = program.pending.vertex = program.pending.fragment = 0;
+    program.pending_key = 0;
+
+    std::string vertex_source, fragment_source;
+    if (!readSource(program.vertex_path, vertex_source) || !readSource(program.fragment_path, fragment_source)) {
+        printf("%s, %s: could not read shader sources\n", vertex_path, fragment_path);
+        return 0;
+    }
+    program.key = programKey(vertex_source, fragment_source, program.defines);
+    std::map<unsigned long long, size_t>::const_iterator found = keys_.find(program.key);
+    if (found != keys_.end()) {
+        stats_.load_ms += millisecondsSince(start);
+        return programs_[found->second].name;
+    }
+
+    bool from_binary = false;
+    if (use_binaries_) {
+        program.name = glCreateProgram();
+        from_binary = loadBinary(program, program.name);
+        if (!from_binary)
+            glDeleteProgram(program.name);
+    }
+    if (!from_binary) {
+        Build build = startBuild(vertex_source, fragment_source, program.defines, 0);
+        if (!linked(build)) {
+            printf("%s + %s: program not built\n", vertex_path, fragment_path);
+            return 0;
+        }
+        // The program keeps what it needs, the shaders can go
+        program.name = build.program;
+        glDetachShader(build.program, build.vertex);
+        glDetachShader(build.program, build.fragment);
+        build.program = 0;
+        deleteBuild(build);
+        if (use_binaries_)
+            storeBinary(program, program.name);
+    }
+    if (from_binary)
+        stats_.binary_hits++;
+    else
+        stats_.compiled++;
+    stats_.programs++;
+
+    keys_[program.key] = programs_.size();
+    programs_.push_back(program);
+    if (watcher_.joinable()) {
+        watch(program.vertex_path);
+        watch(program.fragment_path);
+    }
+
+    double ms = millisecondsSince(start);
+    stats_.load_ms += ms;
+    printf("%s + %s: %s in %.2f ms\n", vertex_path, fragment_path,
+        from_binary ? "linked from the binary cache" : "compiled", ms);
+    return program.name;
+}
+
+unsigned int ShaderManager::update()
+{
+    takeChanges();
+
+    unsigned int replaced = 0;
+    for (size_t i = 0; i < programs_.size(); i++) {
+        Program & program = programs_[i];
+        if (program.pending.program) {
+            if (!finished(program.pending))
+                continue;
+            if (linked(program.pending)) {
+                replace(i);
+                replaced++;
+            }
+            else {
+                stats_.failed_reloads++;
+                printf("%s + %s: edit doesn't build, keeping the old program\n",
+                    program.vertex_path.c_str(), program.fragment_path.c_str());
+            }
+        }
+
+        if (!program.reload_wanted)
+            continue;
+        program.reload_wanted = false;
+        std::string vertex_source, fragment_source;
+        if (!readSource(program.vertex_path, vertex_source) || !readSource(program.fragment_path, fragment_source))
+            continue;
+        unsigned long long key = programKey(vertex_source, fragment_source, program.defines);
+        if (key == program.key)
+            continue;   // saved without changes
+        program.pending_key = key;
+        program.reload_start = std::chrono::steady_clock::now();
+        program.pending = startBuild(vertex_source, fragment_source, program.defines, program.name);
+    }
+    return replaced;
+}
+
+void ShaderManager::report() const
+{
+    printf("shaders: %u programs in %.2f ms, %u from the binary cache, %u compiled; %u reloads, %u failed, "
+        "slowest %.1f ms (%d binary formats%s)\n", stats_.programs, stats_.load_ms, stats_.binary_hits,
+        stats_.compiled, stats_.reloads, stats_.failed_reloads, stats_.reload_ms_max, binary_formats_,
+        parallel_compile_ ? ", parallel compile" : "");
+}
+
+ShaderManager::Build ShaderManager::startBuild(const std::string & vertex_source,
+    const std::string & fragment_source, const std::string & defines, GLuint layout_from)
+{
+    Build build;
+    build.vertex = glsl::makeShader(GL_VERTEX_SHADER, vertex_source.c_str(), defines.c_str());
+    build.fragment = glsl::makeShader(GL_FRAGMENT_SHADER, fragment_source.c_str(), defines.c_str());
+    build.program = glCreateProgram();
+    glAttachShader(build.program, build.vertex);
+    glAttachShader(build.program, build.fragment);
+    if (layout_from)
+        copyAttributeLocations(layout_from, build.program);
+    glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    // Linking right after compiling lets the driver run both without
+    // waiting here; a failed compile shows as a failed link
+    glLinkProgram(build.program);
+    return build;
+}
+
+bool ShaderManager::finished(const Build & build) const
+{
+    if (!parallel_compile_)
+        return true;
+    GLint done = GL_FALSE;
+    glGetProgramiv(build.program, GL_COMPLETION_STATUS_KHR, &done);
+    return done == GL_TRUE;
+}
+
+bool ShaderManager::linked(Build & build)
+{
+    if (isLinked(build.program))
+        return true;
+    // A shader that didn't compile says more than the link log
+    bool vertex_compiled = glsl::compiledStatus(build.vertex);
+    bool fragment_compiled = glsl::compiledStatus(build.fragment);
+    if (vertex_compiled && fragment_compiled)
+        glsl::linkedStatus(build.program);
+    deleteBuild(build);
+    return false;
+}
+
+void ShaderManager::deleteBuild(Build & build)
+{
+    if (build.program) {
+        glDetachShader(build.program, build.vertex);
+        glDetachShader(build.program, build.fragment);
+        glDeleteProgram(build.program);
+    }
+    if (build.vertex)
+        glDeleteShader(build.vertex);
+    if (build.fragment)
+        glDeleteShader(build.fragment);
+    build.program = build.vertex = build.fragment = 0;
+}
+
+bool ShaderManager::loadBinary(const Program & program, GLuint name)
+{
+    if (binary_formats_ <= 0)
+        return false;
+    std::string path = binaryPath(program);
+    MappedFile file;
+    if (!file.open(path.c_str()) || file.size() < sizeof(ProgramCacheHeader))
+        return false;
+    ProgramCacheHeader header;
+    memcpy(&header, file.data(), sizeof(header));
+    if (memcmp(header.magic, PROGRAM_CACHE_MAGIC, 4) != 0 || header.version != PROGRAM_CACHE_VERSION
+        || header.key != program.key || header.driver != driver_
+        || header.size != file.size() - sizeof(header))
+        return false;
+    glProgramBinary(name, header.format, file.data() + sizeof(header), header.size);
+    // The driver may still refuse a binary it wrote, after an update; the
+    // program is built from source then and the binary replaced
+    return isLinked(name);
+}
+
+void ShaderManager::storeBinary(const Program & program, GLuint name)
+{
+    GLenum format;
+    std::vector<unsigned char> binary;
+    if (binary_formats_ <= 0 || !programBinary(name, format, binary))
+        return;
+
+    ProgramCacheHeader header;
+    memcpy(header.magic, PROGRAM_CACHE_MAGIC, 4);
+    header.version = PROGRAM_CACHE_VERSION;
+    header.key = program.key;
+    header.driver = driver_;
+    header.format = format;
+    header.size = (unsigned int)binary.size();
+
+    // Through a temporary file, so a crash never leaves half a binary
+    std::string path = binaryPath(program);
+    std::string temp_path = tempPath(path.c_str());
+    FILE * file = fopen(temp_path.c_str(), "wb");
+    if (!file) {
+        printf("%s: can't write program binary\n", path.c_str());
+        return;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(&binary[0], 1, binary.size(), file) == binary.size();
+    ok = fclose(file) == 0 && ok;
+    ok = ok && replaceFile(temp_path.c_str(), path.c_str());
+    if (!ok) {
+        remove(temp_path.c_str());
+        printf("%s: can't write program binary\n", path.c_str());
+    }
+}
+
+std::string ShaderManager::binaryPath(const Program & program) const
+{
+    // One file per vertex shader, fragment shader and defines; edits
+    // overwrite it rather than piling up
+    std::string variant = program.fragment_path + '\n' + program.defines;
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%016llx.progcache", hashBytes(variant.data(), variant.size()));
+    return program.vertex_path + suffix;
+}
+
+void ShaderManager::replace(size_t index)
+{
+    Program & program = programs_[index];
+    Build & build = program.pending;
+
+    // The new program goes into the old name, so nothing holding it needs
+    // to know. A binary copy is exact; without binaries the old program is
+    // linked again from the shaders that just linked.
+    GLenum format;
+    std::vector<unsigned char> binary;
+    bool have_binary = binary_formats_ > 0 && programBinary(build.program, format, binary);
+    bool swapped = false;
+    if (have_binary) {
+        glProgramBinary(program.name, format, &binary[0], (GLsizei)binary.size());
+        swapped = isLinked(program.name);
+    }
+    if (!swapped) {
+        copyAttributeLocations(build.program, program.name);
+        glAttachShader(program.name, build.vertex);
+        glAttachShader(program.name, build.fragment);
+        glLinkProgram(program.name);
+        glDetachShader(program.name, build.vertex);
+        glDetachShader(program.name, build.fragment);
+        if (!glsl::linkedStatus(program.name))
+            printf("%s + %s: relinking failed\n", program.vertex_path.c_str(), program.fragment_path.c_str());
+    }
+    deleteBuild(build);
+
+    std::map<unsigned long long, size_t>::iterator old = keys_.find(program.key);
+    if (old != keys_.end() && old->second == index)
+        keys_.erase(old);
+    program.key = program.pending_key;
+    keys_.insert(std::make_pair(program.key, index));
+    if (use_binaries_)
+        storeBinary(program, program.name);
+
+    double ms = millisecondsSince(program.reload_start);
+    stats_.reloads++;
+    if (ms > stats_.reload_ms_max)
+        stats_.reload_ms_max = ms;
+    printf("%s + %s: reloaded in %.1f ms\n", program.vertex_path.c_str(), program.fragment_path.c_str(), ms);
+}
+
+void ShaderManager::takeChanges()
+{
+    std::vector<std::string> paths;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::map<std::string, std::chrono::steady_clock::time_point>::iterator it = changed_.begin();
+        while (it != changed_.end()) {
+            if (millisecondsSince(it->second) < QUIET_MS) {
+                ++it;
+                continue;
+            }
+            paths.push_back(it->first);
+            changed_.erase(it++);
+        }
+    }
+    for (size_t p = 0; p < paths.size(); p++)
+        for (size_t i = 0; i < programs_.size(); i++)
+            if (programs_[i].vertex_path == paths[p] || programs_[i].fragment_path == paths[p])
+                programs_[i].reload_wanted = true;
+}
+
+#ifdef _WIN32
+
+void ShaderManager::watch(const std::string & path)
+{
+    std::string directory, file;
+    splitPath(path, directory, file);
+    std::lock_guard<std::mutex> lock(mutex_);
+    watched_[DirectoryFile(directory, file)] = path;
+    mtimes_[path] = lastWriteTime(path);
+    for (size_t i = 0; i < directories_.size(); i++)
+        if (directories_[i].second == directory)
+            return;
+    HANDLE change = FindFirstChangeNotificationA(directory.c_str(), FALSE,
+        FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+    if (change == INVALID_HANDLE_VALUE) {
+        printf("%s: can't watch for shader edits\n", directory.c_str());
+        return;
+    }
+    directories_.push_back(std::make_pair((void *)change, directory));
+    SetEvent((HANDLE)wake_);
+}
+
+void ShaderManager::stopWatching()
+{
+    if (watcher_.joinable()) {
+        quit_ = true;
+        SetEvent((HANDLE)wake_);
+        watcher_.join();
+    }
+    for (size_t i = 0; i < directories_.size(); i++)
+        FindCloseChangeNotification((HANDLE)directories_[i].first);
+    if (wake_)
+        CloseHandle((HANDLE)wake_);
+    wake_ = NULL;
+    directories_.clear();
+    watched_.clear();
+    changed_.clear();
+    mtimes_.clear();
+}
+
+void ShaderManager::watchLoop()
+{
+    while (!quit_) {
+        // wake_ is set for new directories too, the list is rebuilt then
+        std::vector<HANDLE> handles(1, (HANDLE)wake_);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (size_t i = 0; i < directories_.size() && handles.size() < MAXIMUM_WAIT_OBJECTS; i++)
+                handles.push_back((HANDLE)directories_[i].first);
+        }
+        DWORD result = WaitForMultipleObjects((DWORD)handles.size(), &handles[0], FALSE, INFINITE);
+        if (result == WAIT_FAILED)
+            break;
+        if (result <= WAIT_OBJECT_0 || result >= WAIT_OBJECT_0 + handles.size())
+            continue;
+        FindNextChangeNotification(handles[result - WAIT_OBJECT_0]);
+
+        // The notification doesn't say which file changed
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (std::map<DirectoryFile, std::string>::const_iterator it = watched_.begin(); it != watched_.end(); ++it) {
+            long long mtime = lastWriteTime(it->second);
+            if (mtime && mtime != mtimes_[it->second]) {
+                mtimes_[it->second] = mtime;
+                changed_[it->second] = now;
+            }
+        }
+    }
+}
+
+#else
+
+void ShaderManager::watch(const std::string & path)
+{
+    std::string directory, file;
+    splitPath(path, directory, file);
+    std::lock_guard<std::mutex> lock(mutex_);
+    watched_[DirectoryFile(directory, file)] = path;
+    // Directories, not files: editors often save by renaming a new file
+    // over the old one, which a watch on the file would lose
+    int descriptor = inotify_add_watch(inotify_, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (descriptor < 0) {
+        printf("%s: can't watch for shader edits\n", directory.c_str());
+        return;
+    }
+    directories_[descriptor] = directory;
+}
+
+void ShaderManager::stopWatching()
+{
+    if (watcher_.joinable()) {
+        quit_ = true;
+        char byte = 0;
+        if (write(wake_[1], &byte, 1) != 1)
+            printf("shaders: can't wake the watcher\n");
+        watcher_.join();
+    }
+    if (inotify_ >= 0)
+        close(inotify_);
+    for (int i = 0; i < 2; i++)
+        if (wake_[i] >= 0)
+            close(wake_[i]);
+    inotify_ = wake_[0] = wake_[1] = -1;
+    directories_.clear();
+    watched_.clear();
+    changed_.clear();
+}
+
+void ShaderManager::watchLoop()
+{
+    // Big enough for several events with names of any length
+    alignas(inotify_event) char buffer[16 * (sizeof(inotify_event) + 256)];
+    while (!quit_) {
+        pollfd fds[2] = { { inotify_, POLLIN, 0 }, { wake_[0], POLLIN, 0 } };
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (fds[1].revents)
+            break;
+        ssize_t length = read(inotify_, buffer, sizeof(buffer));
+        if (length <= 0)
+            continue;
+
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (char * p = buffer; p < buffer + length; ) {
+            const inotify_event * event = (const inotify_event *)p;
+            p += sizeof(inotify_event) + event->len;
+            std::map<int, std::string>::const_iterator directory = directories_.find(event->wd);
+            if (event->len == 0 || directory == directories_.end())
+                continue;
+            std::map<DirectoryFile, std::string>::const_iterator path =
+                watched_.find(DirectoryFile(directory->second, event->name));
+            if (path != watched_.end())
+                changed_[path->second] = now;
+        }
+    }
+}
+
+#endif
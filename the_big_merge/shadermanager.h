@@ -0,0 +1,127 @@
+#ifndef SHADERMANAGER_H
+#define SHADERMANAGER_H
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <GL/glew.h>
+
+struct ShaderStats
+{
+	unsigned int programs;
+	unsigned int binary_hits;       // linked from a stored binary
+	unsigned int compiled;          // built from source
+	unsigned int reloads;
+	unsigned int failed_reloads;    // kept the old program
+	double load_ms;                 // spent in load()
+	double reload_ms_max;           // build started to program swapped
+};
+
+// Programs built from a vertex and a fragment shader file plus #defines,
+// keyed by a hash of the sources and defines, so the same ones are built
+// once. Linked programs are stored as driver binaries next to the vertex
+// shader and loaded from there while sources, defines and driver match.
+//
+// When watching, edited shader files are recompiled while frames go on,
+// on the driver's threads where it has KHR_parallel_shader_compile, and
+// swapped in only if they link. A program keeps its GL name and attribute
+// locations across reloads, so VAOs and batches built against it stay
+// valid; its uniforms are back to their defaults and must be set again.
+// GL thread only.
+class ShaderManager
+{
+public:
+	ShaderManager();
+	~ShaderManager();
+
+	// use_binaries false always compiles from source. Without a way to
+	// watch files, programs still load but don't reload.
+	void create(bool use_binaries = true, bool watch = true);
+	void destroy();
+
+	// Program name, 0 if the sources can't be read or don't compile or
+	// link; errors are printed. defines are lines inserted after #version.
+	GLuint load(const char * vertex_path, const char * fragment_path, const char * defines = "");
+
+	// Once a frame: starts builds for edited shader files and swaps in the
+	// finished ones. Returns how many programs were replaced.
+	unsigned int update();
+
+	ShaderStats stats() const { return stats_; }
+	void report() const;
+
+private:
+	ShaderManager(const ShaderManager &);
+	ShaderManager & operator=(const ShaderManager &);
+
+	// A program being compiled and linked, with its shaders for the logs
+	struct Build
+	{
+		GLuint program, vertex, fragment;
+	};
+
+	struct Program
+	{
+		GLuint name;
+		std::string vertex_path, fragment_path, defines;
+		unsigned long long key;         // of sources and defines
+		bool reload_wanted;             // a source changed, build not started
+		Build pending;                  // reload in flight, program 0 if none
+		unsigned long long pending_key;
+		std::chrono::steady_clock::time_point reload_start;
+	};
+
+	// Starts compiling and linking; attribute locations are taken from
+	// layout_from when given
+	Build startBuild(const std::string & vertex_source, const std::string & fragment_source,
+		const std::string & defines, GLuint layout_from);
+	bool finished(const Build & build) const;
+	// Link result, printing the logs and deleting the build on failure
+	bool linked(Build & build);
+	void deleteBuild(Build & build);
+
+	bool loadBinary(const Program & program, GLuint name);
+	void storeBinary(const Program & program, GLuint name);
+	std::string binaryPath(const Program & program) const;
+	void replace(size_t index);
+
+	void watch(const std::string & path);
+	void stopWatching();
+	void watchLoop();
+	void takeChanges();
+
+	bool use_binaries_;
+	bool parallel_compile_;
+	GLint binary_formats_;
+	unsigned long long driver_;     // hash of vendor, renderer and version
+	std::vector<Program> programs_;
+	std::map<unsigned long long, size_t> keys_;
+	ShaderStats stats_;
+
+	// File watching: the watcher thread collects edited paths in changed_,
+	// update() takes them once they have been quiet for a moment, editors
+	// often save in several writes
+	typedef std::pair<std::string, std::string> DirectoryFile;
+	std::thread watcher_;
+	std::atomic<bool> quit_;
+	std::mutex mutex_;
+	std::map<DirectoryFile, std::string> watched_;      // to the path given to load()
+	std::map<std::string, std::chrono::steady_clock::time_point> changed_;
+#ifdef _WIN32
+	void * wake_;                                       // event, rebuilds the wait list
+	std::vector<std::pair<void *, std::string> > directories_;     // change handle and directory
+	std::map<std::string, long long> mtimes_;           // of watched paths
+#else
+	int inotify_;
+	int wake_[2];                                       // pipe, ends the poll
+	std::map<int, std::string> directories_;            // watch descriptor to directory
+#endif
+};
+
+#endif
@@ -0,0 +1,284 @@
+#include <stdio.h>
+#include <math.h>
+
+#include <algorithm>
+#include <chrono>
+#include <unordered_map>
+
+#include "meshopt.h"
+#include "simplify.h"
+
+namespace {
+
+// Symmetric 4x4 error quadric, upper triangle, plus the total weight so
+// errors come out as an average squared distance
+struct Quadric
+{
+    double a00, a01, a02, a03, a11, a12, a13, a22, a23, a33;
+    double weight;
+};
+
+void addPlane(Quadric & q, double nx, double ny, double nz, double d, double w)
+{
+    q.a00 += w * nx * nx; q.a01 += w * nx * ny; q.a02 += w * nx * nz; q.a03 += w * nx * d;
+    q.a11 += w * ny * ny; q.a12 += w * ny * nz; q.a13 += w * ny * d;
+    q.a22 += w * nz * nz; q.a23 += w * nz * d;
+    q.a33 += w * d * d;
+    q.weight += w;
+}
+
+void addQuadric(Quadric & q, const Quadric & r)
+{
+    q.a00 += r.a00; q.a01 += r.a01; q.a02 += r.a02; q.a03 += r.a03;
+    q.a11 += r.a11; q.a12 += r.a12; q.a13 += r.a13;
+    q.a22 += r.a22; q.a23 += r.a23;
+    q.a33 += r.a33;
+    q.weight += r.weight;
+}
+
+double evaluate(const Quadric & q, const Quadric & r, const float * p)
+{
+    double x = p[0], y = p[1], z = p[2];
+    double e = (q.a00 + r.a00) * x * x + 2 * (q.a01 + r.a01) * x * y + 2 * (q.a02 + r.a02) * x * z + 2 * (q.a03 + r.a03) * x
+        + (q.a11 + r.a11) * y * y + 2 * (q.a12 + r.a12) * y * z + 2 * (q.a13 + r.a13) * y
+        + (q.a22 + r.a22) * z * z + 2 * (q.a23 + r.a23) * z
+        + (q.a33 + r.a33);
+    double w = q.weight + r.weight;
+    return w > 0 ? fabs(e) / w : 0.0;
+}
+
+void triangleNormal(const float * a, const float * b, const float * c, double n[3])
+{
+    double e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+    double e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+    n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+struct Collapse
+{
+    float cost;
+    unsigned int from, to;
+    bool operator<(const Collapse & other) const { return cost < other.cost; }
+};
+
+} // namespace
+
+float simplifyMesh(
+    std::vector<unsigned int> & destination,
+    const std::vector<unsigned int> & indices,
+    const float * positions, size_t vertex_count, size_t position_stride,
+    size_t target_index_count, float max_error
+){
+    destination = indices;
+    if (indices.size() <= target_index_count)
+        return 0.0f;
+
+    #define POSITION(v) (positions + (size_t)(v) * position_stride)
+
+    // Quadrics from the area weighted planes of the original triangles
+    Quadric zero = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+    std::vector<Quadric> quadrics(vertex_count, zero);
+    for (size_t t = 0; t < indices.size() / 3; t++) {
+        const float * a = POSITION(indices[t * 3]);
+        double n[3];
+        triangleNormal(a, POSITION(indices[t * 3 + 1]), POSITION(indices[t * 3 + 2]), n);
+        double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length == 0)
+            continue;
+        double nx = n[0] / length, ny = n[1] / length, nz = n[2] / length;
+        double d = -(nx * a[0] + ny * a[1] + nz * a[2]);
+        for (int k = 0; k < 3; k++)
+            addPlane(quadrics[indices[t * 3 + k]], nx, ny, nz, d, length * 0.5);
+    }
+
+    // Vertices on open edges stay where they are
+    std::unordered_map<unsigned long long, unsigned int> edges;
+    for (size_t t = 0; t < indices.size() / 3; t++) {
+        for (int k = 0; k < 3; k++) {
+            unsigned long long a = indices[t * 3 + k], b = indices[t * 3 + (k + 1) % 3];
+            edges[a < b ? (a << 32) | b : (b << 32) | a]++;
+        }
+    }
+    std::vector<bool> locked(vertex_count, false);
+    for (std::unordered_map<unsigned long long, unsigned int>::const_iterator it = edges.begin(); it != edges.end(); ++it) {
+        if (it->second == 1) {
+            locked[it->first >> 32] = true;
+            locked[it->first & 0xffffffffu] = true;
+        }
+    }
+
+    std::vector<unsigned int> remap(vertex_count);
+    std::vector<bool> touched(vertex_count);
+    std::vector<unsigned int> offsets(vertex_count + 1), adjacency, counts(vertex_count);
+    std::vector<Collapse> collapses;
+    double error = 0.0;
+
+    // Collapses run in passes: every pass picks the cheapest collapses that
+    // don't share a vertex, then the index buffer is rewritten
+    while (destination.size() > target_index_count) {
+        size_t triangle_count = destination.size() / 3;
+
+        std::fill(counts.begin(), counts.end(), 0);
+        for (size_t i = 0; i < destination.size(); i++)
+            counts[destination[i]]++;
+        offsets[0] = 0;
+        for (size_t v = 0; v < vertex_count; v++)
+            offsets[v + 1] = offsets[v] + counts[v];
+        adjacency.resize(destination.size());
+        std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t t = 0; t < triangle_count; t++)
+            for (int k = 0; k < 3; k++)
+                adjacency[fill[destination[t * 3 + k]]++] = (unsigned int)t;
+
+        collapses.clear();
+        for (size_t t = 0; t < triangle_count; t++) {
+            for (int k = 0; k < 3; k++) {
+                unsigned int a = destination[t * 3 + k], b = destination[t * 3 + (k + 1) % 3];
+                if (!locked[a]) {
+                    Collapse c = { (float)evaluate(quadrics[a], quadrics[b], POSITION(b)), a, b };
+                    collapses.push_back(c);
+                }
+                if (!locked[b]) {
+                    Collapse c = { (float)evaluate(quadrics[a], quadrics[b], POSITION(a)), b, a };
+                    collapses.push_back(c);
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end());
+
+        for (size_t v = 0; v < vertex_count; v++)
+            remap[v] = (unsigned int)v;
+        std::fill(touched.begin(), touched.end(), false);
+
+        size_t removed = 0, wanted = (destination.size() - target_index_count) / 3;
+        size_t applied = 0;
+        double max_cost = (double)max_error * max_error;
+
+        for (size_t i = 0; i < collapses.size() && removed < wanted; i++) {
+            const Collapse & c = collapses[i];
+            if (c.cost > max_cost)
+                break;
+            if (touched[c.from] || touched[c.to])
+                continue;
+
+            // Reject collapses that flip a triangle around the moving vertex
+            bool flips = false;
+            size_t shared = 0;
+            const float * target = POSITION(c.to);
+            for (unsigned int a = offsets[c.from]; a < offsets[c.from + 1] && !flips; a++) {
+                const unsigned int * tri = &destination[adjacency[a] * 3];
+                if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to) {
+                    shared++;
+                    continue;
+                }
+                const float * p[3], * q[3];
+                for (int k = 0; k < 3; k++) {
+                    p[k] = POSITION(tri[k]);
+                    q[k] = tri[k] == c.from ? target : p[k];
+                }
+                double before[3], after[3];
+                triangleNormal(p[0], p[1], p[2], before);
+                triangleNormal(q[0], q[1], q[2], after);
+                flips = before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0;
+            }
+            if (flips)
+                continue;
+
+            // Neighbours of the moved vertex see changed triangles, keep
+            // them out of this pass too
+            for (unsigned int a = offsets[c.from]; a < offsets[c.from + 1]; a++) {
+                const unsigned int * tri = &destination[adjacency[a] * 3];
+                touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = true;
+            }
+            touched[c.to] = true;
+
+            remap[c.from] = c.to;
+            addQuadric(quadrics[c.to], quadrics[c.from]);
+            error = std::max(error, (double)c.cost);
+            removed += shared;
+            applied++;
+        }
+
+        if (applied == 0)
+            break;
+
+        // Rewrite the triangles and drop the ones that collapsed
+        size_t write = 0;
+        for (size_t t = 0; t < triangle_count; t++) {
+            unsigned int a = remap[destination[t * 3]];
+            unsigned int b = remap[destination[t * 3 + 1]];
+            unsigned int c = remap[destination[t * 3 + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+            destination[write++] = a;
+            destination[write++] = b;
+            destination[write++] = c;
+        }
+        destination.resize(write);
+    }
+
+    #undef POSITION
+
+    return (float)sqrt(error);
+}
+
+void buildLodChain(
+    std::vector<unsigned int> & indices,
+    const float * positions, size_t vertex_count, size_t position_stride,
+    std::vector<MeshLod> & lods, const char * name
+){
+    lods.clear();
+    MeshLod full = { 0, (unsigned int)indices.size(), 0.0f };
+    lods.push_back(full);
+    if (indices.empty())
+        return;
+
+    // Errors are limited to a fraction of the mesh size
+    float low[3] = { positions[0], positions[1], positions[2] };
+    float high[3] = { positions[0], positions[1], positions[2] };
+    for (size_t i = 1; i < vertex_count; i++) {
+        for (int c = 0; c < 3; c++) {
+            low[c] = std::min(low[c], positions[i * position_stride + c]);
+            high[c] = std::max(high[c], positions[i * position_stride + c]);
+        }
+    }
+    float diagonal = sqrtf((high[0] - low[0]) * (high[0] - low[0])
+        + (high[1] - low[1]) * (high[1] - low[1]) + (high[2] - low[2]) * (high[2] - low[2]));
+    float max_error = diagonal * 0.1f;
+
+    std::vector<unsigned int> source(indices.begin(), indices.end()), lod;
+    const float ratios[] = { 0.5f, 0.25f, 0.125f };
+
+    for (int level = 0; level < 3; level++) {
+        size_t target = (size_t)(source.size() * ratios[level]) / 3 * 3;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        float error = simplifyMesh(lod, source, positions, vertex_count, position_stride, target, max_error);
+        optimizeVertexCache(lod, vertex_count);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        // Stop when simplification no longer gets anywhere
+        if (lod.empty() || lod.size() * 10 > (size_t)lods.back().index_count * 9)
+            break;
+
+        MeshLod next = { (unsigned int)indices.size(), (unsigned int)lod.size(), error };
+        lods.push_back(next);
+        indices.insert(indices.end(), lod.begin(), lod.end());
+        printf("%s: LOD %d %u -> %u triangles, error %g, %.2f ms\n", name, level + 1,
+            (unsigned int)(source.size() / 3), (unsigned int)(lod.size() / 3), error, ms);
+    }
+}
+
+unsigned int selectLod(const std::vector<MeshLod> & lods, float view_distance,
+    float scale, float pixels_per_unit, float pixel_threshold)
+{
+    if (view_distance <= 0.0f)
+        return 0;
+    for (size_t i = lods.size(); i-- > 1;) {
+        float projected = lods[i].error * scale * pixels_per_unit / view_distance;
+        if (projected <= pixel_threshold)
+            return (unsigned int)i;
+    }
+    return 0;
+}
@@ -0,0 +1,45 @@
+#ifndef SIMPLIFY_H
+#define SIMPLIFY_H
+
+#include <cstddef>
+#include <vector>
+
+// One level of detail: a range of the shared index buffer
+struct MeshLod
+{
+	unsigned int first_index;
+	unsigned int index_count;
+	float error;  // geometric error in object space units
+};
+
+// Quadric error metric simplification by edge collapse.
+// Vertices are only moved onto other existing vertices, so the result
+// indexes the same vertex buffer. Vertices on open edges (mesh borders and
+// uv/normal seams) are kept in place. Stops at target_index_count or when
+// the next collapse would exceed max_error (object space units).
+// Returns the error of the last collapse.
+float simplifyMesh(
+	std::vector<unsigned int> & destination,
+	const std::vector<unsigned int> & indices,
+	const float * positions, size_t vertex_count, size_t position_stride,
+	size_t target_index_count, float max_error
+);
+
+// Builds LOD levels with roughly 1/2, 1/4 and 1/8 of the triangles.
+// The levels are appended to indices and described in lods; lods[0] is
+// the full mesh. Prints triangle counts, errors and build times.
+void buildLodChain(
+	std::vector<unsigned int> & indices,
+	const float * positions, size_t vertex_count, size_t position_stride,
+	std::vector<MeshLod> & lods, const char * name
+);
+
+// Picks the coarsest level whose error, projected to the screen, stays
+// below pixel_threshold. view_distance is the distance from the eye to the
+// nearest point of the object, scale the largest scale factor of the
+// model-view matrix and pixels_per_unit the projection's y scale times
+// half the viewport height.
+unsigned int selectLod(const std::vector<MeshLod> & lods, float view_distance,
+	float scale, float pixels_per_unit, float pixel_threshold = 1.0f);
+
+#endif
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "stagingbuffer.h"
+
+StagingBuffer::StagingBuffer()
+    : buffer_(0), mapped_(NULL), capacity_(0), head_(0), used_(0), frame_bytes_(0)
+{
+}
+
+bool StagingBuffer::create(size_t capacity)
+{
+    destroy();
+    glGenBuffers(1, &buffer_);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer_);
+    if (GLEW_ARB_buffer_storage) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_READ_BUFFER, (GLsizeiptr)capacity, NULL, flags);
+        mapped_ = (unsigned char *)glMapBufferRange(GL_COPY_READ_BUFFER, 0, (GLsizeiptr)capacity, flags);
+    }
+    else {
+        glBufferData(GL_COPY_READ_BUFFER, (GLsizeiptr)capacity, NULL, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    if (GLEW_ARB_buffer_storage && mapped_ == NULL) {
+        printf("staging buffer: could not map %u bytes\n", (unsigned int)capacity);
+        destroy();
+        return false;
+    }
+    capacity_ = capacity;
+    return true;
+}
+
+void StagingBuffer::destroy()
+{
+    for (size_t i = 0; i < regions_.size(); i++)
+        glDeleteSync(regions_[i].fence);
+    regions_.clear();
+    if (buffer_) {
+        if (mapped_) {
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer_);
+            glUnmapBuffer(GL_COPY_READ_BUFFER);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        }
+        glDeleteBuffers(1, &buffer_);
+    }
+    buffer_ = 0;
+    mapped_ = NULL;
+    capacity_ = head_ = used_ = frame_bytes_ = 0;
+}
+
+bool StagingBuffer::write(const void * data, size_t size, size_t alignment, size_t & offset)
+{
+    if (size > capacity_)
+        return false;
+
+    size_t needed;
+    size_t start = place(size, alignment, needed);
+    if (used_ + needed > capacity_) {
+        retire();
+        // A drained ring starts over at 0, where anything up to the
+        // capacity fits, instead of wrapping from where it stopped
+        if (used_ == 0)
+            head_ = 0;
+        start = place(size, alignment, needed);
+        if (used_ + needed > capacity_)
+            return false;
+    }
+
+    if (mapped_) {
+        memcpy(mapped_ + start, data, size);
+    }
+    else {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer_);
+        glBufferSubData(GL_COPY_READ_BUFFER, (GLintptr)start, (GLsizeiptr)size, data);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+    head_ = start + size;
+    used_ += needed;
+    frame_bytes_ += needed;
+    offset = start;
+    return true;
+}
+
+size_t StagingBuffer::place(size_t size, size_t alignment, size_t & needed) const
+{
+    // Padding up to the alignment, or to the end when it doesn't fit there
+    size_t start = (head_ + alignment - 1) & ~(alignment - 1);
+    needed = start - head_ + size;
+    if (start + size > capacity_) {
+        start = 0;
+        needed = capacity_ - head_ + size;
+    }
+    return start;
+}
+
+void StagingBuffer::endFrame()
+{
+    if (frame_bytes_ == 0)
+        return;
+    Region region;
+    region.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    region.bytes = frame_bytes_;
+    regions_.push_back(region);
+    frame_bytes_ = 0;
+}
+
+void StagingBuffer::retire()
+{
+    // Fences signal in order, stop at the first one still pending
+    while (!regions_.empty()) {
+        GLenum status = glClientWaitSync(regions_.front().fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            break;
+        glDeleteSync(regions_.front().fence);
+        used_ -= regions_.front().bytes;
+        regions_.pop_front();
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef STAGINGBUFFER_H
+#define STAGINGBUFFER_H
+
+#include <deque>
+
+#include <GL/glew.h>
+
+// Ring buffer for streaming data to the GPU. With ARB_buffer_storage the
+// buffer is mapped once, persistently and coherently, and writes are
+// plain memcpys; otherwise they go through glBufferSubData. Data written
+// in a frame is fenced by endFrame() and its space reused once the GPU
+// has passed the fence, so copies out of it never stall.
+class StagingBuffer
+{
+public:
+	StagingBuffer();
+
+	bool create(size_t capacity);
+	void destroy();
+
+	// Copies size bytes in at an offset aligned to alignment (a power of
+	// two). False when the space still in flight leaves no room, try
+	// again next frame.
+	bool write(const void * data, size_t size, size_t alignment, size_t & offset);
+
+	// Fences everything written since the last call; call once per frame
+	// after the commands reading it
+	void endFrame();
+
+	GLuint buffer() const { return buffer_; }
+	size_t capacity() const { return capacity_; }
+	size_t used() const { return used_; }
+	bool persistent() const { return mapped_ != NULL; }
+
+private:
+	StagingBuffer(const StagingBuffer &);
+	StagingBuffer & operator=(const StagingBuffer &);
+
+	// Where a write of size would start and the ring space it takes,
+	// padding or the skipped end included
+	size_t place(size_t size, size_t alignment, size_t & needed) const;
+
+	// Releases the space of every region the GPU is done with
+	void retire();
+
+	struct Region
+	{
+		GLsync fence;
+		size_t bytes;           // including alignment and wrap-around padding
+	};
+
+	GLuint buffer_;
+	unsigned char * mapped_;
+	size_t capacity_;
+	size_t head_;               // next write
+	size_t used_;               // bytes between the oldest region and head_
+	size_t frame_bytes_;        // written since the last endFrame()
+	std::deque<Region> regions_;
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "statecache.h"
+
+namespace {
+
+// Index of the binding points that have no index: the program, the vao,
+// a texture target and the generic binding of a buffer target
+const GLuint NO_INDEX = ~0u;
+
+const char * const KIND_NAMES[STATE_KINDS] = { "program", "vao", "texture", "buffer" };
+
+} // namespace
+
+GLStateCache::GLStateCache()
+{
+    resetStats();
+}
+
+void GLStateCache::invalidate()
+{
+    bindings_.clear();
+}
+
+void GLStateCache::useProgram(GLuint program)
+{
+    if (change(STATE_PROGRAM, GL_CURRENT_PROGRAM, NO_INDEX, program))
+        glUseProgram(program);
+}
+
+void GLStateCache::bindVertexArray(GLuint vao)
+{
+    if (!change(STATE_VERTEX_ARRAY, GL_VERTEX_ARRAY_BINDING, NO_INDEX, vao))
+        return;
+    glBindVertexArray(vao);
+    // The index buffer binding belongs to the vao
+    forget(GL_ELEMENT_ARRAY_BUFFER, NO_INDEX);
+}
+
+void GLStateCache::bindTexture(GLenum target, GLuint texture)
+{
+    if (change(STATE_TEXTURE, target, NO_INDEX, texture))
+        glBindTexture(target, texture);
+}
+
+void GLStateCache::bindBuffer(GLenum target, GLuint buffer)
+{
+    if (change(STATE_BUFFER, target, NO_INDEX, buffer))
+        glBindBuffer(target, buffer);
+}
+
+void GLStateCache::bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+    if (!change(STATE_BUFFER, target, index, buffer))
+        return;
+    glBindBufferBase(target, index, buffer);
+    // Binding an index binds the generic point of the target as well
+    forget(target, NO_INDEX);
+}
+
+void GLStateCache::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+    if (!change(STATE_BUFFER, target, index, buffer, offset, size))
+        return;
+    glBindBufferRange(target, index, buffer, offset, size);
+    forget(target, NO_INDEX);
+}
+
+void GLStateCache::resetStats()
+{
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+void GLStateCache::report(unsigned int frames) const
+{
+    if (frames == 0)
+        return;
+    printf("state changes/frame:");
+    for (int k = 0; k < STATE_KINDS; k++)
+        printf("%s %s %.1f (%.1f skipped)", k ? "," : "", KIND_NAMES[k],
+            (double)stats_.issued[k] / frames, (double)stats_.skipped[k] / frames);
+    printf("\n");
+}
+
+bool GLStateCache::change(GLStateKind kind, GLenum target, GLuint index, GLuint name,
+    GLintptr offset, GLsizeiptr size)
+{
+    for (size_t i = 0; i < bindings_.size(); i++) {
+        Binding & binding = bindings_[i];
+        if (binding.target != target || binding.index != index)
+            continue;
+        if (binding.name == name && binding.offset == offset && binding.size == size) {
+            stats_.skipped[kind]++;
+            return false;
+        }
+        binding.name = name;
+        binding.offset = offset;
+        binding.size = size;
+        stats_.issued[kind]++;
+        return true;
+    }
+
+    Binding binding = { target, index, name, offset, size };
+    bindings_.push_back(binding);
+    stats_.issued[kind]++;
+    return true;
+}
+
+void GLStateCache::forget(GLenum target, GLuint index)
+{
+    for (size_t i = 0; i < bindings_.size(); i++)
+        if (bindings_[i].target == target && bindings_[i].index == index) {
+            bindings_[i] = bindings_.back();
+            bindings_.pop_back();
+            return;
+        }
+}
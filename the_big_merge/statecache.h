@@ -0,0 +1,73 @@
+#ifndef STATECACHE_H
+#define STATECACHE_H
+
+#include <vector>
+
+#include <GL/glew.h>
+
+// Kinds of binding GLStateCache counts
+enum GLStateKind
+{
+	STATE_PROGRAM,
+	STATE_VERTEX_ARRAY,
+	STATE_TEXTURE,
+	STATE_BUFFER,           // glBindBuffer, glBindBufferBase and glBindBufferRange
+	STATE_KINDS
+};
+
+struct GLStateStats
+{
+	unsigned long long issued[STATE_KINDS];     // calls that reached GL
+	unsigned long long skipped[STATE_KINDS];    // calls that would have set what was set
+};
+
+// Shadow of the GL bindings made through it: a call that would set what is
+// already set doesn't reach GL. Only what went through the cache is known,
+// so anything bound behind its back leaves it wrong until invalidate();
+// the RenderQueue invalidates at the start of each submit. Textures are
+// tracked on texture unit 0, the only unit the renderer samples from.
+class GLStateCache
+{
+public:
+	GLStateCache();
+
+	// Forgets every binding, the next call of each goes to GL
+	void invalidate();
+
+	void useProgram(GLuint program);
+	void bindVertexArray(GLuint vao);
+	void bindTexture(GLenum target, GLuint texture);
+	void bindBuffer(GLenum target, GLuint buffer);
+	void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+	void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+	const GLStateStats & stats() const { return stats_; }
+	void resetStats();
+
+	// Calls per frame over the given number of frames, issued and skipped
+	void report(unsigned int frames) const;
+
+private:
+	GLStateCache(const GLStateCache &);
+	GLStateCache & operator=(const GLStateCache &);
+
+	// A binding point and what is bound there; size 0 for a whole buffer
+	struct Binding
+	{
+		GLenum target;
+		GLuint index;
+		GLuint name;
+		GLintptr offset;
+		GLsizeiptr size;
+	};
+
+	// True, with the binding recorded, if the call has to reach GL
+	bool change(GLStateKind kind, GLenum target, GLuint index, GLuint name,
+		GLintptr offset = 0, GLsizeiptr size = 0);
+	void forget(GLenum target, GLuint index);
+
+	GLStateStats stats_;
+	std::vector<Binding> bindings_;     // known ones, few enough to search
+};
+
+#endif
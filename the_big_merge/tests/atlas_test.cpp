@@ -0,0 +1,180 @@
+#include <stdio.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "atlas.h"
+#include "check.h"
+
+namespace {
+
+std::mt19937 random_engine(47);
+
+unsigned int randomSize(unsigned int low, unsigned int high)
+{
+    return std::uniform_int_distribution<unsigned int>(low, high)(random_engine);
+}
+
+unsigned int alignUp(unsigned int value, unsigned int alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// The rectangle an entry takes on its page: border and alignment slack
+// included, the way packAtlas pads it
+struct Taken
+{
+    unsigned int layer, x0, y0, x1, y1;
+};
+
+Taken taken(const AtlasEntry & entry, unsigned int padding)
+{
+    Taken t = { entry.layer, entry.x - padding, entry.y - padding, 0, 0 };
+    t.x1 = t.x0 + alignUp(entry.width + 2 * padding, padding);
+    t.y1 = t.y0 + alignUp(entry.height + 2 * padding, padding);
+    return t;
+}
+
+void checkLayout(const std::vector<glm::uvec2> & sizes, unsigned int levels, const AtlasLayout & layout)
+{
+    unsigned int padding = 1u << (levels > 1 ? levels - 1 : 0);
+    CHECK(layout.padding == padding);
+    CHECK(layout.entries.size() == sizes.size());
+
+    // Pages divide evenly down to the last kept level
+    CHECK(layout.page_width % padding == 0 && layout.page_height % padding == 0);
+
+    bool inside = true, aligned = true, sized = true, rects = true;
+    std::vector<bool> used(layout.pages, false);
+    std::vector<Taken> rectangles;
+    double image_area = 0.0;
+    for (size_t i = 0; i < sizes.size(); i++) {
+        const AtlasEntry & entry = layout.entries[i];
+        sized &= entry.width == sizes[i].x && entry.height == sizes[i].y;
+        aligned &= entry.x % padding == 0 && entry.y % padding == 0;
+        Taken t = taken(entry, padding);
+        inside &= entry.layer < layout.pages && entry.x >= padding && entry.y >= padding
+            && t.x1 <= layout.page_width && t.y1 <= layout.page_height;
+        if (entry.layer < layout.pages)
+            used[entry.layer] = true;
+        rects &= entry.rect.x == entry.x * (1.0f / layout.page_width)
+            && entry.rect.y == entry.y * (1.0f / layout.page_height)
+            && entry.rect.z == entry.width * (1.0f / layout.page_width)
+            && entry.rect.w == entry.height * (1.0f / layout.page_height);
+        rectangles.push_back(t);
+        image_area += (double)sizes[i].x * sizes[i].y;
+    }
+    CHECK(sized);
+    CHECK(aligned);
+    CHECK(inside);
+    CHECK(rects);
+    bool all_used = true;
+    for (size_t page = 0; page < used.size(); page++)
+        all_used &= used[page];
+    CHECK(all_used);
+
+    // No two padded rectangles on a page overlap
+    bool overlap = false;
+    for (size_t a = 0; a < rectangles.size(); a++)
+        for (size_t b = a + 1; b < rectangles.size(); b++) {
+            const Taken & p = rectangles[a];
+            const Taken & q = rectangles[b];
+            overlap |= p.layer == q.layer && p.x0 < q.x1 && q.x0 < p.x1 && p.y0 < q.y1 && q.y0 < p.y1;
+        }
+    CHECK(!overlap);
+
+    // The pages are cut down to the used extent
+    unsigned int right = padding, top = padding;
+    for (size_t i = 0; i < rectangles.size(); i++) {
+        right = std::max(right, rectangles[i].x1);
+        top = std::max(top, rectangles[i].y1);
+    }
+    CHECK(layout.page_width == right && layout.page_height == top);
+
+    double expected = layout.pages ? image_area / ((double)layout.page_width * layout.page_height * layout.pages) : 0.0;
+    CHECK(layout.efficiency == expected);
+    CHECK(layout.efficiency >= 0.0 && layout.efficiency <= 1.0);
+}
+
+std::vector<glm::uvec2> randomSizes(size_t count, unsigned int low, unsigned int high)
+{
+    std::vector<glm::uvec2> sizes;
+    for (size_t i = 0; i < count; i++)
+        sizes.push_back(glm::uvec2(randomSize(low, high), randomSize(low, high)));
+    return sizes;
+}
+
+void testRandom()
+{
+    const unsigned int levels[] = { 0, 1, 3, 5 };
+    const unsigned int page_sizes[] = { 256, 1024, 4096 };
+    for (size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); l++)
+        for (size_t p = 0; p < sizeof(page_sizes) / sizeof(page_sizes[0]); p++) {
+            std::vector<glm::uvec2> sizes = randomSizes(150, 1, 200);
+            AtlasLayout layout;
+            CHECK(packAtlas(sizes, page_sizes[p], levels[l], 16384, layout));
+            checkLayout(sizes, levels[l], layout);
+            // Full pages are no bigger than asked for unless one image needs it
+            CHECK(layout.page_width <= page_sizes[p] && layout.page_height <= page_sizes[p]);
+        }
+}
+
+void testPages()
+{
+    // Small enough for one page: a single one, at most the power of two
+    // that holds everything
+    std::vector<glm::uvec2> few(4, glm::uvec2(60, 60));
+    AtlasLayout layout;
+    CHECK(packAtlas(few, 4096, 3, 16384, layout));
+    checkLayout(few, 3, layout);
+    CHECK(layout.pages == 1);
+    CHECK(layout.page_width <= 256 && layout.page_height <= 256);
+
+    // 64 images of 124 + 2 * 2 = 128 fill 4 pages of 512 exactly
+    std::vector<glm::uvec2> tiles(64, glm::uvec2(124, 124));
+    CHECK(packAtlas(tiles, 512, 2, 16384, layout));
+    checkLayout(tiles, 2, layout);
+    CHECK(layout.pages == 4);
+    CHECK(layout.page_width == 512 && layout.page_height == 512);
+
+    // An image over the page size grows the page rather than failing
+    std::vector<glm::uvec2> large(1, glm::uvec2(700, 300));
+    CHECK(packAtlas(large, 256, 1, 16384, layout));
+    checkLayout(large, 1, layout);
+    CHECK(layout.pages == 1 && layout.page_width == 702 && layout.page_height == 302);
+
+    // Odd sizes with a large padding round up to it
+    std::vector<glm::uvec2> odd;
+    odd.push_back(glm::uvec2(1, 1));
+    odd.push_back(glm::uvec2(17, 3));
+    odd.push_back(glm::uvec2(33, 65));
+    CHECK(packAtlas(odd, 1024, 5, 16384, layout));
+    checkLayout(odd, 5, layout);
+}
+
+void testRejected()
+{
+    // Bigger than the GL allows with its border
+    std::vector<glm::uvec2> huge(1, glm::uvec2(1023, 10));
+    AtlasLayout layout;
+    CHECK(!packAtlas(huge, 4096, 2, 1024, layout));
+    huge[0].x = 1020;
+    CHECK(packAtlas(huge, 4096, 2, 1024, layout));
+    checkLayout(huge, 2, layout);
+
+    // Nothing to pack is no pages
+    std::vector<glm::uvec2> none;
+    CHECK(packAtlas(none, 1024, 3, 16384, layout));
+    CHECK(layout.pages == 0 && layout.entries.empty() && layout.efficiency == 0.0);
+}
+
+} // namespace
+
+int main()
+{
+    testRandom();
+    testPages();
+    testRejected();
+    return testResult("atlas");
+}
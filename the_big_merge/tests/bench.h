@@ -0,0 +1,38 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdlib.h>
+
+#include <chrono>
+
+// Helpers for the benchmark executables. They are built next to the tests
+// but not run by ctest; sizes and counts come from the command line so a
+// quick run and a long one are the same program.
+
+inline double benchSeconds()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Best of repeats runs of body, in seconds
+template <typename Body>
+double benchBest(int repeats, Body body)
+{
+	double best = 1e30;
+	for (int i = 0; i < repeats; i++) {
+		double start = benchSeconds();
+		body();
+		double elapsed = benchSeconds() - start;
+		if (elapsed < best)
+			best = elapsed;
+	}
+	return best;
+}
+
+// argv[index] as a number, or fallback when it isn't given
+inline double benchArg(int argc, char ** argv, int index, double fallback)
+{
+	return index < argc ? atof(argv[index]) : fallback;
+}
+
+#endif
@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#endif
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "blockcompress.h"
+#include "check.h"
+#include "meshcache.h"
+#include "mipmap.h"
+
+namespace {
+
+const char * BMP_PATH = "blockcompress_test.bmp";
+
+std::mt19937 random_engine(43);
+
+typedef std::vector<unsigned char> Bytes;
+
+// Offset of the stamp's mtime in a DDS cache: magic, 7 header words, then
+// the stamp's magic and size
+const size_t STAMP_MTIME_OFFSET = 4 + 28 + 12;
+
+bool writeBytes(const char * path, const Bytes & bytes)
+{
+    FILE * file = fopen(path, "wb");
+    if (!file)
+        return false;
+    bool ok = bytes.empty() || fwrite(&bytes[0], 1, bytes.size(), file) == bytes.size();
+    return fclose(file) == 0 && ok;
+}
+
+bool readBytes(const char * path, Bytes & bytes)
+{
+    FILE * file = fopen(path, "rb");
+    if (!file)
+        return false;
+    bytes.clear();
+    unsigned char buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        bytes.insert(bytes.end(), buffer, buffer + read);
+    fclose(file);
+    return true;
+}
+
+bool setMtime(const char * path, long long mtime)
+{
+    struct utimbuf times;
+    times.actime = (time_t)mtime;
+    times.modtime = (time_t)mtime;
+    return utime(path, &times) == 0;
+}
+
+long long stampMtime(const Bytes & dds)
+{
+    unsigned int words[2];
+    memcpy(words, &dds[STAMP_MTIME_OFFSET], sizeof(words));
+    return (long long)((unsigned long long)words[1] << 32 | words[0]);
+}
+
+// 24 bpp BMP with a gradient shifted by seed
+Bytes makeBMP(unsigned int width, unsigned int height, unsigned int seed)
+{
+    size_t row = (width * 3 + 3) & ~(size_t)3;
+    Bytes bytes(54 + row * height, 0);
+    unsigned int header[] = { (unsigned int)bytes.size(), 0, 54, 40, width, height };
+    bytes[0] = 'B';
+    bytes[1] = 'M';
+    memcpy(&bytes[2], header, sizeof(header));
+    unsigned short planes_bpp[] = { 1, 24 };
+    memcpy(&bytes[0x1A], planes_bpp, sizeof(planes_bpp));
+    for (unsigned int y = 0; y < height; y++)
+        for (unsigned int x = 0; x < width; x++) {
+            unsigned char * p = &bytes[54 + row * y + x * 3];
+            p[0] = (unsigned char)(x * 4 + seed);
+            p[1] = (unsigned char)(y * 4);
+            p[2] = (unsigned char)(x * y + seed);
+        }
+    return bytes;
+}
+
+// Single level image in the BMP layout: smooth gradients with a little
+// noise, the kind of content the compressor is for
+ImageData makeImage(unsigned int width, unsigned int height, GLenum format)
+{
+    unsigned int channels = format == GL_BGRA ? 4 : 3;
+    size_t row = (width * channels + 3) & ~(size_t)3;
+    ImageData image;
+    image.width = width;
+    image.height = height;
+    image.format = format;
+    image.compressed = false;
+    image.mapped = NULL;
+    image.levels.assign(1, ImageLevel());
+    image.levels[0].offset = 0;
+    image.levels[0].size = row * height;
+    image.pixels.assign(image.levels[0].size, 0);
+    for (unsigned int y = 0; y < height; y++)
+        for (unsigned int x = 0; x < width; x++) {
+            unsigned char * p = &image.pixels[row * y + x * channels];
+            int noise = (int)(random_engine() % 9) - 4;
+            p[0] = (unsigned char)std::min(255, std::max(0, (int)(x * 255 / width) + noise));
+            p[1] = (unsigned char)std::min(255, std::max(0, (int)(y * 255 / height) + noise));
+            p[2] = (unsigned char)std::min(255, std::max(0, (int)((x + y) * 127 / (width + height)) + 64 + noise));
+            if (channels == 4)
+                p[3] = (unsigned char)(x * 255 / width);
+        }
+    return image;
+}
+
+void testSimdLevels()
+{
+    // The index selection kernels are integer math, every level gives the
+    // scalar blocks exactly. Odd sizes take the partial block paths.
+    const unsigned int sizes[][2] = { { 64, 64 }, { 37, 19 }, { 1, 7 }, { 5, 1 } };
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+        for (int bgra = 0; bgra < 2; bgra++) {
+            ImageData source = makeImage(sizes[s][0], sizes[s][1], bgra ? GL_BGRA : GL_BGR);
+            generateMipmaps(source);
+            for (int format = BLOCK_BC1; format <= BLOCK_BC3; format++) {
+                ImageData reference;
+                CHECK(compressImage(source, (BlockFormat)format, reference, NULL, SIMD_SCALAR));
+                CHECK(reference.levels.size() == source.levels.size());
+                for (int level = SIMD_SCALAR + 1; level <= simdLevel(); level++) {
+                    ImageData out;
+                    CHECK(compressImage(source, (BlockFormat)format, out, NULL, (SimdLevel)level));
+                    CHECK(out.pixels == reference.pixels);
+                }
+            }
+        }
+}
+
+void testPsnr()
+{
+    // Smooth content must keep its quality, BC3's color is BC1's
+    for (int bgra = 0; bgra < 2; bgra++) {
+        ImageData source = makeImage(256, 128, bgra ? GL_BGRA : GL_BGR);
+        ImageData bc1, bc3;
+        CHECK(compressImage(source, BLOCK_BC1, bc1));
+        CHECK(compressImage(source, BLOCK_BC3, bc3));
+        double psnr = compressionPsnr(source, bc1);
+        CHECK(psnr > 38.0);
+        CHECK(compressionPsnr(source, bc3) == psnr);
+    }
+
+    // A flat color 565 holds exactly comes back exactly
+    ImageData flat = makeImage(16, 16, GL_BGR);
+    for (size_t i = 0; i < flat.pixels.size(); i += 3) {
+        flat.pixels[i] = 24;
+        flat.pixels[i + 1] = 40;
+        flat.pixels[i + 2] = 16;
+    }
+    ImageData out;
+    CHECK(compressImage(flat, BLOCK_BC1, out));
+    CHECK(compressionPsnr(flat, out) == 99.0);
+}
+
+void testCacheRestamp()
+{
+    std::string cache_path = textureCachePath(BMP_PATH);
+    remove(cache_path.c_str());
+    CHECK(writeBytes(BMP_PATH, makeBMP(64, 32, 0)));
+    ImageData image;
+    CHECK(decodeBMPCompressed(BMP_PATH, BLOCK_BC1, image));
+    CHECK(image.compressed && image.width == 64 && image.height == 32);
+    Bytes written;
+    CHECK(readBytes(cache_path.c_str(), written));
+    CHECK(written.size() > 128);
+    // Written through a temporary that doesn't stay behind
+    Bytes temp;
+    CHECK(!readBytes(tempPath(cache_path.c_str()).c_str(), temp));
+
+    // Touched but unchanged: the cache is used and takes the new mtime
+    CHECK(setMtime(BMP_PATH, 1000000000));
+    image = ImageData();
+    CHECK(decodeBMPCompressed(BMP_PATH, BLOCK_BC1, image));
+    CHECK(image.file != NULL);
+    Bytes restamped;
+    CHECK(readBytes(cache_path.c_str(), restamped));
+    CHECK(restamped.size() == written.size());
+    CHECK(stampMtime(restamped) == 1000000000);
+    memcpy(&restamped[STAMP_MTIME_OFFSET], &written[STAMP_MTIME_OFFSET], 8);
+    CHECK(restamped == written);
+
+    // Changed content of the same size under an old mtime is compressed again
+    CHECK(writeBytes(BMP_PATH, makeBMP(64, 32, 100)));
+    CHECK(setMtime(BMP_PATH, 1000000000 + 60));
+    image = ImageData();
+    CHECK(decodeBMPCompressed(BMP_PATH, BLOCK_BC1, image));
+    CHECK(readBytes(cache_path.c_str(), restamped));
+    CHECK(stampMtime(restamped) == 1000000000 + 60);
+    CHECK(memcmp(&restamped[128], &written[128], written.size() - 128) != 0);
+
+    remove(cache_path.c_str());
+}
+
+} // namespace
+
+int main()
+{
+    testSimdLevels();
+    testPsnr();
+    testCacheRestamp();
+    remove(BMP_PATH);
+    // Levels above the machine's can't run here
+    printf("blockcompress: tested up to %s\n", simdLevelName(simdLevel()));
+    return testResult("blockcompress");
+}
@@ -0,0 +1,138 @@
+#include <string.h>
+
+#include <map>
+
+#include "bufferarena.h"
+#include "check.h"
+#include "mockgl.h"
+
+namespace {
+
+// Element buffer each vao was last left with, from the recorded calls
+std::map<GLuint, GLuint> elementBindings()
+{
+    std::map<GLuint, GLuint> bindings;
+    GLuint vao = 0;
+    const std::vector<MockGLCall> & calls = mockGLCalls();
+    for (size_t i = 0; i < calls.size(); i++) {
+        if (strcmp(calls[i].name, "BindVertexArray") == 0)
+            vao = (GLuint)calls[i].args[0];
+        else if (strcmp(calls[i].name, "BindBuffer") == 0 && calls[i].args[0] == GL_ELEMENT_ARRAY_BUFFER && vao)
+            bindings[vao] = (GLuint)calls[i].args[1];
+    }
+    return bindings;
+}
+
+void testAllocate()
+{
+    resetMockGL();
+    BufferArena arena;
+    CHECK(arena.create(primitive_vertex_layout, 1, 100, 1024));
+
+    ArenaRange a, b, c;
+    CHECK(arena.allocate(10, 3, GL_UNSIGNED_SHORT, a));
+    CHECK(arena.allocate(20, 5, GL_UNSIGNED_INT, b));
+    CHECK(arena.allocate(30, 6, GL_UNSIGNED_SHORT, c));
+    CHECK(a.base_vertex == 0 && b.base_vertex == 10 && c.base_vertex == 30);
+    CHECK(a.index_offset == 0);
+    // 32 bit indices start 4 byte aligned after the 6 bytes of a
+    CHECK(b.index_offset == 8);
+    CHECK(c.index_offset == 28);
+    CHECK(b.index_type == GL_UNSIGNED_INT && b.index_count == 5);
+    CHECK((size_t)arena.indexPointer(b, 2) == 16);
+    CHECK((size_t)arena.indexPointer(c, 1) == 30);
+
+    // A freed range is reused
+    arena.free(b);
+    ArenaRange d;
+    CHECK(arena.allocate(20, 5, GL_UNSIGNED_INT, d));
+    CHECK(d.base_vertex == 10 && d.index_offset == 8);
+    CHECK(arena.vertexStats().allocations == 3);
+    arena.destroy();
+}
+
+void testUpload()
+{
+    resetMockGL();
+    BufferArena arena;
+    CHECK(arena.create(primitive_vertex_layout, 1, 100, 1024));
+    ArenaRange range;
+    CHECK(arena.allocate(4, 6, GL_UNSIGNED_SHORT, range));
+    CHECK(arena.allocate(8, 6, GL_UNSIGNED_SHORT, range));
+
+    resetMockGL();
+    PackedPrimitiveVertex vertices[8];
+    unsigned short indices[6] = { 0, 1, 2, 2, 1, 3 };
+    arena.upload(range, vertices, indices);
+
+    // Vertices at their base, indices at their offset, never through the
+    // element binding of whatever vao is bound
+    const std::vector<MockGLCall> & calls = mockGLCalls();
+    CHECK(mockGLCount("BufferSubData") == 2);
+    CHECK(elementBindings().empty());
+    for (size_t i = 0; i < calls.size(); i++) {
+        if (strcmp(calls[i].name, "BindBuffer") == 0)
+            CHECK(calls[i].args[0] != GL_ELEMENT_ARRAY_BUFFER);
+        if (strcmp(calls[i].name, "BufferSubData") != 0)
+            continue;
+        if (calls[i].args[0] == GL_ARRAY_BUFFER) {
+            CHECK(calls[i].args[1] == 4 * (long long)sizeof(PackedPrimitiveVertex));
+            CHECK(calls[i].args[2] == 8 * (long long)sizeof(PackedPrimitiveVertex));
+        }
+        else {
+            CHECK(calls[i].args[0] == GL_COPY_WRITE_BUFFER);
+            CHECK(calls[i].args[1] == 12);
+            CHECK(calls[i].args[2] == 12);
+        }
+    }
+    arena.destroy();
+}
+
+void testGrow()
+{
+    resetMockGL();
+    BufferArena arena;
+    CHECK(arena.create(primitive_vertex_layout, 1, 16, 64));
+    GLuint extra = arena.addVao(2);
+    GLuint old_vertices = arena.vertexBuffer(), old_indices = arena.indexBuffer();
+    ArenaRange first;
+    CHECK(arena.allocate(16, 32, GL_UNSIGNED_SHORT, first));
+
+    // Neither fits: both buffers are replaced, their contents copied over
+    resetMockGL();
+    ArenaRange second;
+    CHECK(arena.allocate(10, 20, GL_UNSIGNED_SHORT, second));
+    CHECK(second.base_vertex == 16);
+    CHECK(second.index_offset == 64);
+    CHECK(arena.vertexBuffer() != old_vertices);
+    CHECK(arena.indexBuffer() != old_indices);
+    CHECK(arena.vertexStats().capacity == 32);
+    CHECK(arena.indexStats().capacity == 128);
+    CHECK(mockGLCount("CopyBufferSubData") == 2);
+    CHECK(mockGLCount("DeleteBuffers") == 2);
+    const std::vector<MockGLCall> & calls = mockGLCalls();
+    bool copied_vertices = false, copied_indices = false;
+    for (size_t i = 0; i < calls.size(); i++)
+        if (strcmp(calls[i].name, "CopyBufferSubData") == 0) {
+            copied_vertices |= calls[i].args[4] == 16 * (long long)sizeof(PackedPrimitiveVertex);
+            copied_indices |= calls[i].args[4] == 64;
+        }
+    CHECK(copied_vertices && copied_indices);
+
+    // Every vao, the extra one too, points at the new index buffer
+    std::map<GLuint, GLuint> bindings = elementBindings();
+    CHECK(bindings.size() == 2);
+    CHECK(bindings[arena.vao()] == arena.indexBuffer());
+    CHECK(bindings[extra] == arena.indexBuffer());
+    arena.destroy();
+}
+
+} // namespace
+
+int main()
+{
+    testAllocate();
+    testUpload();
+    testGrow();
+    return testResult("bufferarena");
+}
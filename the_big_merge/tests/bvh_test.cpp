@@ -0,0 +1,294 @@
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "bvh.h"
+#include "check.h"
+
+namespace {
+
+std::mt19937 random_engine(29);
+
+float randomFloat(float low, float high)
+{
+    return std::uniform_real_distribution<float>(low, high)(random_engine);
+}
+
+glm::vec3 randomVec3(float low, float high)
+{
+    return glm::vec3(randomFloat(low, high), randomFloat(low, high), randomFloat(low, high));
+}
+
+Frustum randomFrustum(float range)
+{
+    glm::vec3 eye = randomVec3(-range, range);
+    glm::vec3 target = eye + randomVec3(-1.0f, 1.0f) + glm::vec3(0.0f, 0.0f, 0.01f);
+    float near_plane = randomFloat(0.05f, 2.0f);
+    glm::mat4 projection = glm::perspective(randomFloat(0.3f, 2.0f), randomFloat(0.5f, 2.5f),
+        near_plane, near_plane + randomFloat(5.0f, range * 4.0f));
+    return extractFrustum(projection * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f)));
+}
+
+// The box of object i as the tree stores it
+void objectBox(const CullTable & table, size_t i, glm::vec3 & bounds_min, glm::vec3 & bounds_max)
+{
+    glm::vec3 center(table.x[i], table.y[i], table.z[i]);
+    glm::vec3 extents(table.ex[i], table.ey[i], table.ez[i]);
+    bounds_min = center - extents;
+    bounds_max = center + extents;
+}
+
+// Linear scans with the same box tests the tree uses
+std::vector<unsigned int> bruteCull(const CullTable & table, const Frustum & frustum)
+{
+    std::vector<unsigned int> visible;
+    for (size_t i = 0; i < table.size(); i++) {
+        glm::vec3 bounds_min, bounds_max;
+        objectBox(table, i, bounds_min, bounds_max);
+        glm::vec3 center = (bounds_min + bounds_max) * 0.5f;
+        glm::vec3 extents = (bounds_max - bounds_min) * 0.5f;
+        bool outside = false;
+        for (int p = 0; p < 6 && !outside; p++) {
+            const float * plane = frustum.planes[p];
+            float distance = plane[0] * center.x + plane[1] * center.y + plane[2] * center.z + plane[3];
+            float radius = fabsf(plane[0]) * extents.x + fabsf(plane[1]) * extents.y + fabsf(plane[2]) * extents.z;
+            outside = distance < -radius;
+        }
+        if (!outside)
+            visible.push_back((unsigned int)i);
+    }
+    return visible;
+}
+
+float rayBox(const glm::vec3 & origin, const glm::vec3 & direction, float max_distance,
+    const glm::vec3 & bounds_min, const glm::vec3 & bounds_max)
+{
+    glm::vec3 inverse_direction(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+    float near_t = 0.0f, far_t = max_distance;
+    for (int axis = 0; axis < 3; axis++) {
+        float t0 = (bounds_min[axis] - origin[axis]) * inverse_direction[axis];
+        float t1 = (bounds_max[axis] - origin[axis]) * inverse_direction[axis];
+        if (t0 > t1)
+            std::swap(t0, t1);
+        near_t = std::max(near_t, t0);
+        far_t = std::min(far_t, t1);
+    }
+    return near_t <= far_t ? near_t : -1.0f;
+}
+
+float bruteRaycast(const CullTable & table, const glm::vec3 & origin, const glm::vec3 & direction,
+    float max_distance)
+{
+    float best = -1.0f;
+    for (size_t i = 0; i < table.size(); i++) {
+        glm::vec3 bounds_min, bounds_max;
+        objectBox(table, i, bounds_min, bounds_max);
+        float t = rayBox(origin, direction, max_distance, bounds_min, bounds_max);
+        if (t >= 0.0f && (best < 0.0f || t < best))
+            best = t;
+    }
+    return best;
+}
+
+size_t visible_total = 0, hits_total = 0;
+
+// The tree answers like the scans: the same visible set, and the nearest
+// hit at the same distance (on a tie any of the nearest objects)
+void compare(const Bvh & bvh, const CullTable & table, float range, int queries)
+{
+    std::vector<unsigned int> visible;
+    for (int q = 0; q < queries; q++) {
+        Frustum frustum = randomFrustum(range);
+        size_t count = bvh.cullFrustum(frustum, visible);
+        CHECK(count == visible.size());
+        std::sort(visible.begin(), visible.end());
+        CHECK(std::adjacent_find(visible.begin(), visible.end()) == visible.end());
+        CHECK(visible == bruteCull(table, frustum));
+        visible_total += count;
+    }
+
+    for (int q = 0; q < queries * 4; q++) {
+        glm::vec3 origin = randomVec3(-range, range);
+        glm::vec3 direction = randomVec3(-1.0f, 1.0f);
+        if (q % 8 == 0)
+            direction = glm::vec3(q % 16 ? 1.0f : -1.0f, 0.0f, 0.0f);
+        float max_distance = q % 3 ? range * 4.0f : range * 0.1f;
+        float expected = bruteRaycast(table, origin, direction, max_distance);
+        float distance = -1.0f;
+        int hit = bvh.raycast(origin, direction, max_distance, distance);
+        CHECK((hit >= 0) == (expected >= 0.0f));
+        if (hit < 0 || expected < 0.0f)
+            continue;
+        hits_total++;
+        CHECK(distance == expected);
+        CHECK(hit < (int)table.size());
+        glm::vec3 bounds_min, bounds_max;
+        objectBox(table, hit, bounds_min, bounds_max);
+        CHECK(rayBox(origin, direction, max_distance, bounds_min, bounds_max) == distance);
+    }
+}
+
+CullTable randomTable(size_t count, float range, float max_extent)
+{
+    CullTable table;
+    table.resize(count);
+    for (size_t i = 0; i < count; i++)
+        table.set(i, randomVec3(-range, range), 1.0f, randomVec3(0.0f, max_extent));
+    return table;
+}
+
+void testRandom()
+{
+    const size_t counts[] = { 0, 1, 2, 5, 100, 3000 };
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        CullTable table = randomTable(counts[c], 50.0f, 3.0f);
+        Bvh bvh;
+        bvh.build(table);
+        CHECK(bvh.size() == counts[c]);
+        compare(bvh, table, 50.0f, 40);
+    }
+}
+
+void testDegenerate()
+{
+    // Points, flat boxes, and every object at the same spot
+    CullTable table;
+    table.resize(300);
+    for (size_t i = 0; i < 300; i++) {
+        glm::vec3 extents(0.0f);
+        if (i % 3 == 1)
+            extents = glm::vec3(randomFloat(0.0f, 2.0f), 0.0f, randomFloat(0.0f, 2.0f));
+        table.set(i, randomVec3(-20.0f, 20.0f), 0.0f, extents);
+    }
+    Bvh bvh;
+    bvh.build(table);
+    compare(bvh, table, 20.0f, 40);
+
+    for (size_t i = 0; i < 300; i++)
+        table.set(i, glm::vec3(1.0f, 2.0f, 3.0f), 1.0f, glm::vec3(0.5f));
+    bvh.build(table);
+    CHECK(bvh.stats().leaves > 1);
+    compare(bvh, table, 5.0f, 40);
+}
+
+void testSkewed()
+{
+    // Clustered in one corner with a few huge boxes spanning everything
+    CullTable table;
+    table.resize(2000);
+    for (size_t i = 0; i < 2000; i++) {
+        if (i % 200 == 0)
+            table.set(i, randomVec3(-5.0f, 5.0f), 1.0f, randomVec3(20.0f, 60.0f));
+        else
+            table.set(i, randomVec3(30.0f, 32.0f), 1.0f, randomVec3(0.0f, 0.1f));
+    }
+    Bvh bvh;
+    bvh.build(table);
+    compare(bvh, table, 40.0f, 60);
+}
+
+void testDeepTree()
+{
+    // Centroids spaced geometrically make a lopsided tree. Built with a
+    // small BVH_MAX_DEPTH it is deeper than the traversal stack, the
+    // subtrees that don't fit are scanned and must give the same answers.
+    CullTable table;
+    table.resize(400);
+    for (size_t i = 0; i < 400; i++) {
+        float x = powf(1.15f, (float)i);
+        table.set(i, glm::vec3(x, randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f)), 1.0f,
+            glm::vec3(x * 0.01f, 0.5f, 0.5f));
+    }
+    Bvh bvh;
+    bvh.build(table);
+    CHECK(bvh.stats().depth > 20);
+#ifdef BVH_MAX_DEPTH
+    CHECK(bvh.stats().depth > 2 * BVH_MAX_DEPTH);
+#endif
+
+    std::vector<unsigned int> visible;
+    Frustum everything;
+    for (int p = 0; p < 6; p++) {
+        for (int c = 0; c < 3; c++)
+            everything.planes[p][c] = 0.0f;
+        everything.planes[p][p / 2] = p % 2 ? -1.0f : 1.0f;
+        everything.planes[p][3] = 1e30f;
+    }
+    CHECK(bvh.cullFrustum(everything, visible) == 400);
+    std::sort(visible.begin(), visible.end());
+    CHECK(visible == bruteCull(table, everything));
+
+    // Rays along the chain from the small end and back from the large one
+    const glm::vec3 origins[] = { glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(1e25f, 0.0f, 0.0f), glm::vec3(1e5f, 0.0f, 0.1f) };
+    const glm::vec3 directions[] = { glm::vec3(1.0f, 0.001f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f) };
+    for (int r = 0; r < 3; r++) {
+        float distance = -1.0f;
+        int hit = bvh.raycast(origins[r], directions[r], 1e30f, distance);
+        float expected = bruteRaycast(table, origins[r], directions[r], 1e30f);
+        CHECK(hit >= 0 && distance == expected);
+    }
+    compare(bvh, table, 1000.0f, 20);
+}
+
+void testRefit()
+{
+    CullTable table = randomTable(1000, 50.0f, 2.0f);
+    Bvh bvh;
+    bvh.build(table);
+    CHECK(!bvh.needsRebuild());
+
+    // Small moves: the refit tree answers right and is still good enough
+    for (size_t i = 0; i < 1000; i++)
+        table.set(i, glm::vec3(table.x[i], table.y[i], table.z[i]) + randomVec3(-0.5f, 0.5f), 1.0f,
+            glm::vec3(table.ex[i], table.ey[i], table.ez[i]));
+    bvh.refit(table);
+    compare(bvh, table, 50.0f, 30);
+    CHECK(!bvh.needsRebuild());
+
+    // Scattered: still right, but worth rebuilding, and the rebuilt tree
+    // gives the same answers
+    for (size_t i = 0; i < 1000; i++)
+        table.set(i, randomVec3(-50.0f, 50.0f), 1.0f, glm::vec3(table.ex[i], table.ey[i], table.ez[i]));
+    bvh.refit(table);
+    compare(bvh, table, 50.0f, 30);
+    CHECK(bvh.needsRebuild());
+    std::vector<unsigned int> refit_visible, rebuilt_visible;
+    Frustum frustum = randomFrustum(50.0f);
+    bvh.cullFrustum(frustum, refit_visible);
+    Bvh rebuilt;
+    rebuilt.build(table);
+    CHECK(!rebuilt.needsRebuild());
+    CHECK(rebuilt.stats().sah_cost < bvh.stats().sah_cost);
+    rebuilt.cullFrustum(frustum, rebuilt_visible);
+    std::sort(refit_visible.begin(), refit_visible.end());
+    std::sort(rebuilt_visible.begin(), rebuilt_visible.end());
+    CHECK(refit_visible == rebuilt_visible);
+    bvh.build(table);
+    CHECK(!bvh.needsRebuild());
+    compare(bvh, table, 50.0f, 10);
+
+    // A different object count rebuilds
+    table = randomTable(10, 50.0f, 2.0f);
+    bvh.refit(table);
+    CHECK(bvh.size() == 10);
+    compare(bvh, table, 50.0f, 10);
+}
+
+} // namespace
+
+int main()
+{
+    testRandom();
+    testDegenerate();
+    testSkewed();
+    testDeepTree();
+    testRefit();
+    // The queries saw something; a tree that finds nothing would pass too
+    CHECK(visible_total > 1000 && hits_total > 200);
+    return testResult("bvh");
+}
@@ -0,0 +1,40 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <math.h>
+#include <stdio.h>
+
+// Checks for the test executables: a failed check prints where and what
+// and the test's main returns non-zero through testResult.
+
+inline int & checkFailures()
+{
+	static int failures = 0;
+	return failures;
+}
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			checkFailures()++; \
+		} \
+	} while (0)
+
+#define CHECK_NEAR(value, expected, tolerance) \
+	do { \
+		double check_value = (double)(value), check_expected = (double)(expected); \
+		if (!(fabs(check_value - check_expected) <= (double)(tolerance))) { \
+			printf("%s:%d: %s is %g, expected %g within %g\n", __FILE__, __LINE__, #value, \
+				check_value, check_expected, (double)(tolerance)); \
+			checkFailures()++; \
+		} \
+	} while (0)
+
+inline int testResult(const char * name)
+{
+	printf("%s: %s\n", name, checkFailures() ? "FAILED" : "passed");
+	return checkFailures() ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,137 @@
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "check.h"
+#include "cull.h"
+
+namespace {
+
+std::mt19937 random_engine(5);
+
+float randomFloat(float low, float high)
+{
+    return std::uniform_real_distribution<float>(low, high)(random_engine);
+}
+
+glm::vec3 randomVec3(float low, float high)
+{
+    return glm::vec3(randomFloat(low, high), randomFloat(low, high), randomFloat(low, high));
+}
+
+Frustum randomFrustum()
+{
+    glm::vec3 eye = randomVec3(-20.0f, 20.0f);
+    glm::vec3 target = eye + randomVec3(-1.0f, 1.0f) + glm::vec3(0.0f, 0.0f, 0.01f);
+    float near_plane = randomFloat(0.05f, 2.0f);
+    glm::mat4 projection = glm::perspective(randomFloat(0.3f, 2.0f), randomFloat(0.5f, 2.5f),
+        near_plane, near_plane + randomFloat(5.0f, 100.0f));
+    return extractFrustum(projection * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f)));
+}
+
+// Smallest margin by which object i passes the planes, in double: the
+// kernels may only disagree on objects that touch a plane
+double margin(const CullTable & t, const Frustum & f, CullShape shape, size_t i)
+{
+    double worst = 1e30;
+    for (int p = 0; p < 6; p++) {
+        const float * plane = f.planes[p];
+        double distance = (double)plane[0] * t.x[i] + (double)plane[1] * t.y[i] + (double)plane[2] * t.z[i] + plane[3];
+        double extent = shape == CULL_SPHERE ? t.radius[i]
+            : fabs(plane[0]) * (double)t.ex[i] + fabs(plane[1]) * (double)t.ey[i] + fabs(plane[2]) * (double)t.ez[i];
+        worst = std::min(worst, distance + extent);
+    }
+    return worst;
+}
+
+size_t visible_total = 0;
+
+void compareLevels(const CullTable & table, const Frustum & frustum, CullShape shape)
+{
+    std::vector<unsigned int> reference;
+    size_t count = cullObjects(table, frustum, shape, reference, SIMD_SCALAR);
+    CHECK(count == reference.size());
+    visible_total += count;
+    CHECK(std::is_sorted(reference.begin(), reference.end()));
+
+    const SimdLevel levels[] = { SIMD_SSE, SIMD_AVX2, SIMD_AVX512 };
+    for (int l = 0; l < 3; l++) {
+        if (levels[l] > simdLevel())
+            continue;
+        std::vector<unsigned int> visible;
+        CHECK(cullObjects(table, frustum, shape, visible, levels[l]) == visible.size());
+        CHECK(std::is_sorted(visible.begin(), visible.end()));
+        if (!visible.empty())
+            CHECK(visible.back() < table.size());
+
+        std::vector<unsigned int> differ;
+        std::set_symmetric_difference(reference.begin(), reference.end(), visible.begin(), visible.end(),
+            std::back_inserter(differ));
+        for (size_t i = 0; i < differ.size(); i++)
+            if (fabs(margin(table, frustum, shape, differ[i])) > 1e-4) {
+                printf("%s disagrees with scalar on object %u\n", simdLevelName(levels[l]), differ[i]);
+                CHECK(false);
+            }
+    }
+}
+
+void testRandom()
+{
+    // Sizes around the 4 and 8 wide groups so the padding is exercised
+    const size_t sizes[] = { 1, 3, 4, 5, 7, 8, 9, 15, 16, 17, 1000, 4099 };
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+        for (int round = 0; round < 20; round++) {
+            CullTable table;
+            table.resize(sizes[s]);
+            for (size_t i = 0; i < sizes[s]; i++)
+                table.set(i, randomVec3(-60.0f, 60.0f), randomFloat(0.0f, 5.0f), randomVec3(0.0f, 4.0f));
+            Frustum frustum = randomFrustum();
+            compareLevels(table, frustum, CULL_SPHERE);
+            compareLevels(table, frustum, CULL_BOX);
+        }
+    // The random frustums see something, or the comparison proves little
+    CHECK(visible_total > 1000);
+}
+
+void testKnown()
+{
+    // Looking down -z from the origin, 10 units deep
+    glm::mat4 view_projection = glm::perspective(1.5f, 1.0f, 0.5f, 10.0f)
+        * glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Frustum frustum = extractFrustum(view_projection);
+    CullTable table;
+    table.resize(5);
+    table.set(0, glm::vec3(0.0f, 0.0f, -5.0f), 0.5f, glm::vec3(0.5f));    // inside
+    table.set(1, glm::vec3(0.0f, 0.0f, 5.0f), 0.5f, glm::vec3(0.5f));     // behind
+    table.set(2, glm::vec3(0.0f, 0.0f, -10.4f), 0.5f, glm::vec3(0.5f));   // straddles far
+    table.set(3, glm::vec3(0.0f, 0.0f, -12.0f), 0.5f, glm::vec3(0.5f));   // past far
+    table.set(4, glm::vec3(50.0f, 0.0f, -5.0f), 0.5f, glm::vec3(0.5f));   // off to the side
+
+    for (int level = SIMD_SCALAR; level <= simdLevel(); level++)
+        for (int shape = CULL_SPHERE; shape <= CULL_BOX; shape++) {
+            std::vector<unsigned int> visible;
+            CHECK(cullObjects(table, frustum, (CullShape)shape, visible, (SimdLevel)level) == 2);
+            CHECK(visible.size() == 2 && visible[0] == 0 && visible[1] == 2);
+        }
+
+    CullTable empty;
+    std::vector<unsigned int> visible(3);
+    CHECK(cullObjects(empty, frustum, CULL_SPHERE, visible) == 0);
+    CHECK(visible.empty());
+}
+
+} // namespace
+
+int main()
+{
+    printf("cull: comparing scalar against up to %s\n", simdLevelName(simdLevel()));
+    testKnown();
+    testRandom();
+    return testResult("cull");
+}
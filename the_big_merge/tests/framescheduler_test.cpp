@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "check.h"
+#include "framescheduler.h"
+
+namespace {
+
+// Powers of two so every sum of them is exact
+const double TICK = 1.0 / 64;
+
+void testAccumulation()
+{
+    FakeClock clock;
+    FrameScheduler scheduler(clock, TICK);
+
+    // The first frame only starts the clock
+    clock.advance(1.0);
+    CHECK(scheduler.beginFrame() == 0);
+    CHECK(scheduler.simulationTime() == 0.0 && scheduler.stats().frames == 0);
+
+    // Half a tick runs nothing and is carried over
+    clock.advance(TICK / 2);
+    CHECK(scheduler.beginFrame() == 0);
+    CHECK(scheduler.alpha() == 0.5);
+    clock.advance(TICK / 2);
+    CHECK(scheduler.beginFrame() == 1);
+    CHECK(scheduler.alpha() == 0.0);
+
+    // One and a half, twice: 1 then 2
+    clock.advance(TICK * 1.5);
+    CHECK(scheduler.beginFrame() == 1);
+    CHECK(scheduler.alpha() == 0.5);
+    clock.advance(TICK * 1.5);
+    CHECK(scheduler.beginFrame() == 2);
+    CHECK(scheduler.alpha() == 0.0);
+
+    // A quarter at a time
+    unsigned int ticks = 0;
+    for (int frame = 0; frame < 10; frame++) {
+        clock.advance(TICK / 4);
+        ticks += scheduler.beginFrame();
+        CHECK(scheduler.alpha() >= 0.0 && scheduler.alpha() < 1.0);
+    }
+    CHECK(ticks == 2);
+    CHECK(scheduler.alpha() == 0.5);
+
+    CHECK(scheduler.simulationTime() == 6 * TICK);
+    CHECK(scheduler.stats().ticks == 6);
+    CHECK(scheduler.stats().frames == 14);
+    CHECK(scheduler.stats().dropped_ticks == 0);
+
+    // No time, no ticks
+    CHECK(scheduler.beginFrame() == 0);
+    CHECK(scheduler.alpha() == 0.5);
+}
+
+void testTickCap()
+{
+    FakeClock clock;
+    FrameScheduler scheduler(clock, TICK);
+    scheduler.beginFrame();
+
+    // A stall of 20.5 ticks runs 8, drops 12 and keeps the half
+    clock.advance(TICK * 20.5);
+    CHECK(scheduler.beginFrame() == 8);
+    CHECK(scheduler.stats().dropped_ticks == 12);
+    CHECK(scheduler.alpha() == 0.5);
+    CHECK(scheduler.simulationTime() == 8 * TICK);
+
+    // The next frame is normal again
+    clock.advance(TICK * 1.5);
+    CHECK(scheduler.beginFrame() == 2);
+    CHECK(scheduler.alpha() == 0.0);
+
+    // Exactly at the cap nothing is dropped
+    clock.advance(TICK * 8);
+    CHECK(scheduler.beginFrame() == 8);
+    CHECK(scheduler.stats().dropped_ticks == 12);
+    clock.advance(TICK * 9);
+    CHECK(scheduler.beginFrame() == 8);
+    CHECK(scheduler.stats().dropped_ticks == 13);
+    CHECK(scheduler.stats().ticks == 8 + 2 + 8 + 8);
+
+    // Another cap
+    FrameScheduler three(clock, TICK, 3);
+    three.beginFrame();
+    clock.advance(TICK * 10.25);
+    CHECK(three.beginFrame() == 3);
+    CHECK(three.stats().dropped_ticks == 7);
+    CHECK(three.alpha() == 0.25);
+}
+
+void testCappedPacing()
+{
+    FakeClock clock;
+    const double interval = 1.0 / 64;
+    FrameScheduler scheduler(clock, TICK);
+    CHECK(scheduler.timeUntilNextFrame() == 0.0);
+    scheduler.setPacing(PACE_CAPPED, 64.0);
+    CHECK(scheduler.pacing() == PACE_CAPPED && scheduler.targetInterval() == interval);
+
+    // The first frame is due one interval after it started
+    scheduler.beginFrame();
+    CHECK(scheduler.timeUntilNextFrame() == interval);
+    clock.advance(interval / 4);
+    CHECK(scheduler.timeUntilNextFrame() == interval * 3 / 4);
+
+    // On time: the next is one interval later
+    clock.advance(interval * 3 / 4);
+    CHECK(scheduler.timeUntilNextFrame() == 0.0);
+    scheduler.beginFrame();
+    CHECK(scheduler.timeUntilNextFrame() == interval);
+
+    // A little late: the schedule holds, the next frame comes sooner
+    clock.advance(interval * 5 / 4);
+    scheduler.beginFrame();
+    CHECK(scheduler.timeUntilNextFrame() == interval * 3 / 4);
+
+    // More than a whole interval late: no catching up, the schedule
+    // starts over from now
+    clock.advance(interval * 3 / 4 + interval * 2);
+    scheduler.beginFrame();
+    CHECK(scheduler.timeUntilNextFrame() == interval);
+
+    // Exactly one interval late is also a restart
+    clock.advance(interval * 2);
+    scheduler.beginFrame();
+    CHECK(scheduler.timeUntilNextFrame() == interval);
+
+    // Vsync and uncapped never wait
+    scheduler.setPacing(PACE_VSYNC, 64.0);
+    scheduler.beginFrame();
+    CHECK(scheduler.timeUntilNextFrame() == 0.0);
+    scheduler.setPacing(PACE_UNCAPPED, 64.0);
+    CHECK(scheduler.targetInterval() == 0.0);
+    scheduler.beginFrame();
+    CHECK(scheduler.timeUntilNextFrame() == 0.0);
+}
+
+void testStats()
+{
+    FakeClock clock;
+    FrameScheduler scheduler(clock, TICK);
+    scheduler.setPacing(PACE_CAPPED, 64.0);
+    scheduler.beginFrame();
+
+    // 90 frames of 7.8125 ms (bucket 15) and 10 of 31.25 ms (bucket 62),
+    // those are over 1.5 intervals of 15.625 ms and missed
+    for (int frame = 0; frame < 100; frame++) {
+        clock.advance(frame % 10 == 9 ? 1.0 / 32 : 1.0 / 128);
+        scheduler.beginFrame();
+    }
+    const FramePacingStats & stats = scheduler.stats();
+    CHECK(stats.frames == 100);
+    CHECK(stats.missed == 10);
+    CHECK(stats.histogram[15] == 90 && stats.histogram[62] == 10);
+    CHECK(stats.mean() == (90 * 7.8125 + 10 * 31.25) / 100);
+    CHECK(stats.max_ms == 31.25);
+
+    // Interpolated within the bucket the percentile falls in
+    CHECK_NEAR(stats.percentile(0.5), (15 + 50.0 / 90) * 0.5, 1e-12);
+    CHECK_NEAR(stats.percentile(0.9), 16 * 0.5, 1e-12);
+    CHECK_NEAR(stats.percentile(0.95), (62 + 5.0 / 10) * 0.5, 1e-12);
+    CHECK_NEAR(stats.percentile(1.0), 63 * 0.5, 1e-12);
+
+    // A frame past the histogram lands in the last bucket, the top
+    // percentile is then the longest frame
+    clock.advance(0.25);
+    scheduler.beginFrame();
+    CHECK(stats.histogram[FramePacingStats::bucket_count] == 1);
+    CHECK(stats.max_ms == 250.0);
+    CHECK(stats.percentile(1.0) == 250.0);
+    CHECK(stats.missed == 11);
+
+    char text[4096];
+    FILE * out = tmpfile();
+    CHECK(out != NULL);
+    if (out) {
+        scheduler.report(out);
+        rewind(out);
+        size_t length = fread(text, 1, sizeof(text) - 1, out);
+        text[length] = 0;
+        fclose(out);
+        CHECK(strstr(text, "101 frames") != NULL && strstr(text, "11 missed") != NULL);
+    }
+
+    scheduler.resetStats();
+    CHECK(stats.frames == 0 && stats.missed == 0 && stats.histogram[15] == 0 && stats.percentile(0.5) == 0.0);
+
+    // Without a target nothing is missed
+    scheduler.setPacing(PACE_UNCAPPED, 0.0);
+    clock.advance(1.0);
+    scheduler.beginFrame();
+    CHECK(stats.frames == 1 && stats.missed == 0);
+}
+
+} // namespace
+
+int main()
+{
+    testAccumulation();
+    testTickCap();
+    testCappedPacing();
+    testStats();
+    return testResult("framescheduler");
+}
@@ -0,0 +1,70 @@
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "jobsystem.h"
+
+// jobsystem_bench [threads [count]]: the same work on 1 to threads
+// threads (every core by default), as a parallelFor over count elements
+// (4M by default) at a few grain sizes, and as that many empty jobs
+// under one parent to show the cost of a job
+
+namespace {
+
+void work(std::vector<float> & values, size_t begin, size_t end)
+{
+    for (size_t i = begin; i < end; i++) {
+        float x = values[i];
+        for (int k = 0; k < 16; k++)
+            x = sqrtf(x * x + 1.0f) * 0.5f;
+        values[i] = x;
+    }
+}
+
+} // namespace
+
+int main(int argc, char ** argv)
+{
+    unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+    unsigned int max_threads = (unsigned int)benchArg(argc, argv, 1, cores);
+    size_t count = (size_t)benchArg(argc, argv, 2, 1 << 22);
+    std::vector<float> values(count, 1.0f);
+
+    double serial = benchBest(3, [&]() { work(values, 0, count); });
+    printf("%zu elements, serial %.2f ms\n", count, serial * 1000);
+    const size_t grains[] = { 256, 4096, 65536 };
+    printf("%8s", "threads");
+    for (size_t g = 0; g < 3; g++)
+        printf("  grain %7zu", grains[g]);
+    printf("   empty jobs/s\n");
+
+    for (unsigned int threads = 1; threads <= max_threads; threads++) {
+        JobSystem jobs(threads - 1);
+        printf("%8u", threads);
+        for (size_t g = 0; g < 3; g++) {
+            double seconds = benchBest(3, [&]() {
+                jobs.parallelFor(count, grains[g], [&values](size_t begin, size_t end) { work(values, begin, end); });
+            });
+            printf("  %6.2fx %4.0f%%", serial / seconds, 100.0 * serial / seconds / threads);
+        }
+
+        // Scheduling only: creating, queueing, stealing and finishing
+        size_t job_count = std::min<size_t>(count, 200000);
+        std::atomic<size_t> ran(0);
+        double seconds = benchBest(3, [&]() {
+            JobHandle root = jobs.create(JobFunction());
+            for (size_t i = 0; i < job_count; i++)
+                jobs.run(jobs.create([&ran]() { ran++; }, root));
+            jobs.run(root);
+            jobs.wait(root);
+        });
+        printf("   %10.0f\n", job_count / seconds);
+    }
+    // Keeps the work from being optimized away
+    return values[count / 2] == 12345.0f;
+}
@@ -0,0 +1,151 @@
+#include <stdio.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "check.h"
+#include "jobsystem.h"
+
+// Stress test, also meant to run under ThreadSanitizer: configure with
+// -DCMAKE_CXX_FLAGS=-fsanitize=thread
+
+namespace {
+
+void testTree(JobSystem & jobs)
+{
+    // Three levels of children under one root, all counted once
+    std::atomic<int> count(0);
+    for (int round = 0; round < 50; round++) {
+        count = 0;
+        JobHandle root = jobs.create([&count]() { count++; });
+        std::vector<JobHandle> created;
+        for (int i = 0; i < 20; i++) {
+            JobHandle middle = jobs.create([&count]() { count++; }, root);
+            for (int j = 0; j < 20; j++) {
+                JobHandle leaf = jobs.create([&count]() { count++; }, middle);
+                for (int k = 0; k < 4; k++)
+                    created.push_back(jobs.create([&count]() { count++; }, leaf));
+                created.push_back(leaf);
+            }
+            created.push_back(middle);
+        }
+        for (size_t i = 0; i < created.size(); i++)
+            jobs.run(created[i]);
+        jobs.run(root);
+        jobs.wait(root);
+        CHECK(JobSystem::finished(root));
+        CHECK(count == 1 + 20 + 20 * 20 + 20 * 20 * 4);
+    }
+}
+
+void testParallelFor(JobSystem & jobs)
+{
+    const size_t sizes[] = { 1, 7, 100, 1000, 100003 };
+    const size_t grains[] = { 0, 1, 3, 64, 100000 };
+    for (size_t s = 0; s < 5; s++)
+        for (size_t g = 0; g < 5; g++) {
+            std::vector<int> touched(sizes[s], 0);
+            jobs.parallelFor(sizes[s], grains[g], [&touched](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++)
+                    touched[i]++;
+            });
+            bool once = true;
+            for (size_t i = 0; i < touched.size(); i++)
+                once &= touched[i] == 1;
+            CHECK(once);
+        }
+}
+
+void testNested(JobSystem & jobs)
+{
+    // Jobs that wait on work of their own, from inside the workers
+    std::atomic<long long> sum(0);
+    jobs.parallelFor(64, 1, [&jobs, &sum](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+            jobs.parallelFor(256, 16, [&sum](size_t b, size_t e) {
+                long long local = 0;
+                for (size_t j = b; j < e; j++)
+                    local += (long long)j;
+                sum += local;
+            });
+    });
+    CHECK(sum == 64LL * (255LL * 256 / 2));
+}
+
+void testOtherThreads(JobSystem & jobs)
+{
+    // Threads that are not workers submit and wait through queue 0 at the
+    // same time as the owner
+    std::atomic<int> count(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 3; t++)
+        threads.push_back(std::thread([&jobs, &count]() {
+            for (int round = 0; round < 100; round++)
+                jobs.parallelFor(100, 10, [&count](size_t begin, size_t end) { count += (int)(end - begin); });
+        }));
+    for (int round = 0; round < 100; round++)
+        jobs.parallelFor(100, 10, [&count](size_t begin, size_t end) { count += (int)(end - begin); });
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+    CHECK(count == 4 * 100 * 100);
+}
+
+void testSleepingWait(JobSystem & jobs)
+{
+    // Long enough for wait() to run out of spins and sleep, it must be
+    // woken by the finish
+    for (int round = 0; round < 5; round++) {
+        std::atomic<bool> ran(false);
+        JobHandle slow = jobs.create([&ran]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            ran = true;
+        });
+        jobs.run(slow);
+        jobs.wait(slow);
+        CHECK(ran);
+    }
+
+    // Jobs queued by another thread while the owner sleeps in wait(),
+    // with no workers only the owner can run them
+    std::atomic<bool> ran(false);
+    JobHandle gate = jobs.create(JobFunction());
+    std::thread other([&jobs, &gate, &ran]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        jobs.run(jobs.create([&ran]() { ran = true; }, gate));
+        jobs.run(gate);
+    });
+    jobs.wait(gate);
+    CHECK(ran && JobSystem::finished(gate));
+    other.join();
+}
+
+void stress(unsigned int workers)
+{
+    JobSystem jobs(workers);
+    CHECK(jobs.threadCount() == workers + 1);
+    testTree(jobs);
+    testParallelFor(jobs);
+    testNested(jobs);
+    testOtherThreads(jobs);
+    testSleepingWait(jobs);
+}
+
+} // namespace
+
+int main()
+{
+    stress(0);
+    stress(1);
+    stress(3);
+    stress(8);
+
+    // Systems come and go with their workers asleep
+    for (int i = 0; i < 50; i++) {
+        JobSystem jobs(4);
+        if (i % 2)
+            jobs.parallelFor(1000, 10, [](size_t, size_t) {});
+    }
+    return testResult("jobsystem");
+}
@@ -0,0 +1,33 @@
+#include <stdio.h>
+
+#include <vector>
+
+#include "bench.h"
+#include "matbatch.h"
+
+// matbatch_bench [count [repeats]]: products per second of each
+// multiplyMatrices overload at every SIMD level this machine runs, over
+// count matrices (100000 by default, 1000 fits in L1/L2)
+
+int main(int argc, char ** argv)
+{
+    size_t count = (size_t)benchArg(argc, argv, 1, 100000);
+    int repeats = (int)benchArg(argc, argv, 2, 20);
+    std::vector<glm::mat4> left(count), right(count), out(count);
+    for (size_t i = 0; i < count; i++) {
+        left[i] = glm::mat4(1.0f + i % 7);
+        right[i] = glm::mat4(2.0f - i % 5);
+    }
+
+    printf("%zu matrices, Mproducts/s\n%-8s %10s %10s %10s\n", count, "", "arrays", "left * []", "[] * right");
+    for (int level = SIMD_SCALAR; level <= simdLevel(); level++) {
+        SimdLevel simd = (SimdLevel)level;
+        double arrays = benchBest(repeats, [&]() { multiplyMatrices(&left[0], &right[0], &out[0], count, simd); });
+        double shared_left = benchBest(repeats, [&]() { multiplyMatrices(left[0], &right[0], &out[0], count, simd); });
+        double shared_right = benchBest(repeats, [&]() { multiplyMatrices(&left[0], right[0], &out[0], count, simd); });
+        printf("%-8s %10.1f %10.1f %10.1f\n", simdLevelName(simd),
+            count / arrays / 1e6, count / shared_left / 1e6, count / shared_right / 1e6);
+    }
+    // Keeps the products from being optimized away
+    return out[count / 2][0][0] == 12345.0f;
+}
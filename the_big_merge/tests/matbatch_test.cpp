@@ -0,0 +1,179 @@
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+
+#include <random>
+#include <vector>
+
+#include "check.h"
+#include "matbatch.h"
+
+namespace {
+
+std::mt19937 random_engine(37);
+
+float randomFloat(float low, float high)
+{
+    return std::uniform_real_distribution<float>(low, high)(random_engine);
+}
+
+glm::mat4 randomMatrix()
+{
+    glm::mat4 m;
+    for (int c = 0; c < 4; c++)
+        for (int r = 0; r < 4; r++)
+            m[c][r] = randomFloat(-100.0f, 100.0f);
+    return m;
+}
+
+// The kernels may fuse multiplies and adds and sum in another order, so
+// each element is allowed a few roundings of the largest term's size
+bool nearProduct(const glm::mat4 & out, const glm::mat4 & a, const glm::mat4 & b)
+{
+    glm::mat4 expected = a * b;
+    for (int c = 0; c < 4; c++)
+        for (int r = 0; r < 4; r++) {
+            float magnitude = 0.0f;
+            for (int k = 0; k < 4; k++)
+                magnitude += fabsf(a[k][r] * b[c][k]);
+            if (fabsf(out[c][r] - expected[c][r]) > 4.0f * FLT_EPSILON * magnitude)
+                return false;
+        }
+    return true;
+}
+
+std::vector<SimdLevel> levels()
+{
+    std::vector<SimdLevel> result;
+    for (int level = SIMD_SCALAR; level <= simdLevel(); level++)
+        result.push_back((SimdLevel)level);
+    return result;
+}
+
+const size_t counts[] = { 1, 2, 3, 7, 16, 33, 100 };
+
+void testArrays(SimdLevel level)
+{
+    for (size_t n = 0; n < sizeof(counts) / sizeof(counts[0]); n++) {
+        size_t count = counts[n];
+        std::vector<glm::mat4> left(count), right(count), out(count);
+        for (size_t i = 0; i < count; i++) {
+            left[i] = randomMatrix();
+            right[i] = randomMatrix();
+        }
+        multiplyMatrices(&left[0], &right[0], &out[0], count, level);
+        bool ok = true;
+        for (size_t i = 0; i < count; i++)
+            ok &= nearProduct(out[i], left[i], right[i]);
+        CHECK(ok);
+
+        // In place over either input gives the same bits
+        std::vector<glm::mat4> in_left = left, in_right = right;
+        multiplyMatrices(&in_left[0], &right[0], &in_left[0], count, level);
+        multiplyMatrices(&left[0], &in_right[0], &in_right[0], count, level);
+        CHECK(in_left == out);
+        CHECK(in_right == out);
+
+        // Squaring in place, out is both inputs
+        std::vector<glm::mat4> squared = left;
+        multiplyMatrices(&squared[0], &squared[0], &squared[0], count, level);
+        ok = true;
+        for (size_t i = 0; i < count; i++)
+            ok &= nearProduct(squared[i], left[i], left[i]);
+        CHECK(ok);
+    }
+}
+
+void testSharedLeft(SimdLevel level)
+{
+    for (size_t n = 0; n < sizeof(counts) / sizeof(counts[0]); n++) {
+        size_t count = counts[n];
+        glm::mat4 left = randomMatrix();
+        std::vector<glm::mat4> right(count), out(count);
+        for (size_t i = 0; i < count; i++)
+            right[i] = randomMatrix();
+        multiplyMatrices(left, &right[0], &out[0], count, level);
+        bool ok = true;
+        for (size_t i = 0; i < count; i++)
+            ok &= nearProduct(out[i], left, right[i]);
+        CHECK(ok);
+
+        std::vector<glm::mat4> in_place = right;
+        multiplyMatrices(left, &in_place[0], &in_place[0], count, level);
+        CHECK(in_place == out);
+    }
+}
+
+void testSharedRight(SimdLevel level)
+{
+    for (size_t n = 0; n < sizeof(counts) / sizeof(counts[0]); n++) {
+        size_t count = counts[n];
+        glm::mat4 right = randomMatrix();
+        std::vector<glm::mat4> left(count), out(count);
+        for (size_t i = 0; i < count; i++)
+            left[i] = randomMatrix();
+        multiplyMatrices(&left[0], right, &out[0], count, level);
+        bool ok = true;
+        for (size_t i = 0; i < count; i++)
+            ok &= nearProduct(out[i], left[i], right);
+        CHECK(ok);
+
+        std::vector<glm::mat4> in_place = left;
+        multiplyMatrices(&in_place[0], right, &in_place[0], count, level);
+        CHECK(in_place == out);
+    }
+}
+
+void testUnaligned(SimdLevel level)
+{
+    // Arrays one float off any vector alignment
+    const size_t count = 9;
+    std::vector<float> storage(3 * count * 16 + 1);
+    glm::mat4 * left = (glm::mat4 *)&storage[1];
+    glm::mat4 * right = left + count;
+    glm::mat4 * out = right + count;
+    for (size_t i = 0; i < count; i++) {
+        left[i] = randomMatrix();
+        right[i] = randomMatrix();
+    }
+    multiplyMatrices(left, right, out, count, level);
+    bool ok = true;
+    for (size_t i = 0; i < count; i++)
+        ok &= nearProduct(out[i], left[i], right[i]);
+    CHECK(ok);
+
+    // Nothing to do touches nothing
+    glm::mat4 untouched = out[0];
+    multiplyMatrices(left, right, out, 0, level);
+    CHECK(out[0] == untouched);
+}
+
+void testIdentity(SimdLevel level)
+{
+    // Products with the identity are exact at every level
+    std::vector<glm::mat4> matrices(5);
+    for (size_t i = 0; i < matrices.size(); i++)
+        matrices[i] = randomMatrix();
+    std::vector<glm::mat4> out(matrices.size());
+    multiplyMatrices(glm::mat4(1.0f), &matrices[0], &out[0], matrices.size(), level);
+    CHECK(out == matrices);
+    multiplyMatrices(&matrices[0], glm::mat4(1.0f), &out[0], matrices.size(), level);
+    CHECK(out == matrices);
+}
+
+} // namespace
+
+int main()
+{
+    std::vector<SimdLevel> tested = levels();
+    for (size_t l = 0; l < tested.size(); l++) {
+        testArrays(tested[l]);
+        testSharedLeft(tested[l]);
+        testSharedRight(tested[l]);
+        testUnaligned(tested[l]);
+        testIdentity(tested[l]);
+    }
+    // Levels above the machine's can't run here
+    printf("matbatch: tested up to %s\n", simdLevelName(simdLevel()));
+    return testResult("matbatch");
+}
@@ -0,0 +1,285 @@
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#endif
+
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "check.h"
+#include "meshcache.h"
+
+namespace {
+
+const char * SOURCE_PATH = "meshcache_test.obj";
+
+std::mt19937 random_engine(11);
+
+float randomFloat(float low, float high)
+{
+    return std::uniform_real_distribution<float>(low, high)(random_engine);
+}
+
+bool writeFile(const char * path, const std::string & contents)
+{
+    FILE * file = fopen(path, "wb");
+    if (!file)
+        return false;
+    bool ok = fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+    return fclose(file) == 0 && ok;
+}
+
+bool readFile(const char * path, std::vector<unsigned char> & contents)
+{
+    FILE * file = fopen(path, "rb");
+    if (!file)
+        return false;
+    contents.clear();
+    unsigned char buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        contents.insert(contents.end(), buffer, buffer + read);
+    fclose(file);
+    return true;
+}
+
+bool writeBytes(const char * path, const std::vector<unsigned char> & contents)
+{
+    return writeFile(path, std::string(contents.begin(), contents.end()));
+}
+
+bool setMtime(const char * path, long long mtime)
+{
+    struct utimbuf times;
+    times.actime = (time_t)mtime;
+    times.modtime = (time_t)mtime;
+    return utime(path, &times) == 0;
+}
+
+IndexedMesh randomMesh(size_t vertex_count, size_t index_count)
+{
+    IndexedMesh mesh;
+    mesh.vertices.resize(vertex_count);
+    for (size_t i = 0; i < vertex_count; i++) {
+        mesh.vertices[i].position = glm::vec3(randomFloat(-1, 1), randomFloat(-2, 2), randomFloat(0, 4));
+        mesh.vertices[i].normal = glm::normalize(glm::vec3(randomFloat(0.1f, 1), randomFloat(-1, 1), randomFloat(-1, 1)));
+        mesh.vertices[i].uv = glm::vec2(randomFloat(0, 1), randomFloat(0, 1));
+    }
+    mesh.indices.resize(index_count);
+    for (size_t i = 0; i < index_count; i++)
+        mesh.indices[i] = (unsigned int)(i * 7919 % vertex_count);
+    return mesh;
+}
+
+std::vector<MeshLod> lodChain(size_t index_count)
+{
+    // Level 0 is the whole mesh, the next levels follow it
+    std::vector<MeshLod> lods(3);
+    lods[0].first_index = 0;
+    lods[0].index_count = (unsigned int)(index_count / 2);
+    lods[0].error = 0.0f;
+    lods[1].first_index = lods[0].index_count;
+    lods[1].index_count = (unsigned int)(index_count / 3);
+    lods[1].error = 0.01f;
+    lods[2].first_index = lods[1].first_index + lods[1].index_count;
+    lods[2].index_count = (unsigned int)(index_count - lods[2].first_index);
+    lods[2].error = 0.1f;
+    return lods;
+}
+
+void testRoundTrip(size_t vertex_count, size_t index_count, unsigned int index_size)
+{
+    std::string cache_path = meshCachePath(SOURCE_PATH);
+    CHECK(writeFile(SOURCE_PATH, "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n"));
+    IndexedMesh mesh = randomMesh(vertex_count, index_count);
+    std::vector<MeshLod> lods = lodChain(index_count);
+    CHECK(writeMeshCache(cache_path.c_str(), SOURCE_PATH, mesh, lods));
+
+    // Written through a temporary that doesn't stay behind
+    FILE * temp = fopen(tempPath(cache_path.c_str()).c_str(), "rb");
+    CHECK(temp == NULL);
+    if (temp)
+        fclose(temp);
+
+    CachedMesh cached;
+    bool opened = cached.open(cache_path.c_str(), SOURCE_PATH);
+    CHECK(opened);
+    if (!opened)
+        return;
+    const MeshCacheHeader & header = cached.header();
+    CHECK(header.vertex_count == vertex_count);
+    CHECK(header.index_count == index_count);
+    CHECK(header.index_size == index_size);
+    CHECK(header.lod_count == lods.size());
+    CHECK(header.vertex_offset % 64 == 0 && header.index_offset % 64 == 0 && header.lod_offset % 64 == 0);
+
+    // Vertices exactly as packTexturedVertices packs them, same range
+    QuantizationRange range = computeQuantizationRange(&mesh.vertices[0], mesh.vertices.size());
+    std::vector<PackedTexturedVertex> packed;
+    packTexturedVertices(&mesh.vertices[0], mesh.vertices.size(), range, packed);
+    CHECK(memcmp(cached.vertices(), &packed[0], packed.size() * sizeof(PackedTexturedVertex)) == 0);
+    QuantizationRange cached_range = cached.quantization();
+    for (int c = 0; c < 3; c++) {
+        CHECK_NEAR(cached_range.position_offset[c], range.position_offset[c], 1e-6f);
+        CHECK_NEAR(cached_range.position_scale[c], range.position_scale[c], 1e-5f);
+    }
+    for (int c = 0; c < 2; c++) {
+        CHECK(cached_range.uv_offset[c] == range.uv_offset[c]);
+        CHECK(cached_range.uv_scale[c] == range.uv_scale[c]);
+    }
+
+    for (size_t i = 0; i < index_count; i++) {
+        unsigned int index = index_size == 2 ? ((const unsigned short *)cached.indices())[i]
+            : ((const unsigned int *)cached.indices())[i];
+        CHECK(index == mesh.indices[i]);
+    }
+    for (size_t i = 0; i < lods.size(); i++) {
+        CHECK(cached.lods()[i].first_index == lods[i].first_index);
+        CHECK(cached.lods()[i].index_count == lods[i].index_count);
+        CHECK(cached.lods()[i].error == lods[i].error);
+    }
+}
+
+void testRejected()
+{
+    std::string cache_path = meshCachePath(SOURCE_PATH);
+    CHECK(writeFile(SOURCE_PATH, "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n"));
+    IndexedMesh mesh = randomMesh(100, 300);
+    CHECK(writeMeshCache(cache_path.c_str(), SOURCE_PATH, mesh, lodChain(300)));
+    std::vector<unsigned char> good;
+    CHECK(readFile(cache_path.c_str(), good));
+    MeshCacheHeader header;
+    memcpy(&header, &good[0], sizeof(header));
+
+    // Truncated anywhere
+    const size_t cuts[] = { 0, sizeof(MeshCacheHeader) - 1, (size_t)header.index_offset + 10, good.size() - 1 };
+    for (size_t i = 0; i < sizeof(cuts) / sizeof(cuts[0]); i++) {
+        std::vector<unsigned char> bytes(good.begin(), good.begin() + cuts[i]);
+        CHECK(writeBytes(cache_path.c_str(), bytes));
+        CachedMesh cached;
+        CHECK(!cached.open(cache_path.c_str(), SOURCE_PATH));
+    }
+
+    // Another version
+    std::vector<unsigned char> bytes = good;
+    ((MeshCacheHeader *)&bytes[0])->version = MESH_CACHE_VERSION + 1;
+    CHECK(writeBytes(cache_path.c_str(), bytes));
+    {
+        CachedMesh cached;
+        CHECK(!cached.open(cache_path.c_str(), SOURCE_PATH));
+    }
+
+    // A level past the indices, by its start or by its count
+    for (int field = 0; field < 2; field++) {
+        bytes = good;
+        MeshLod * lods = (MeshLod *)&bytes[header.lod_offset];
+        if (field == 0)
+            lods[1].first_index = header.index_count + 1;
+        else
+            lods[2].index_count += 1;
+        CHECK(writeBytes(cache_path.c_str(), bytes));
+        CachedMesh cached;
+        CHECK(!cached.open(cache_path.c_str(), SOURCE_PATH));
+    }
+
+    // The intact file still opens, then goes stale with its source
+    CHECK(writeBytes(cache_path.c_str(), good));
+    {
+        CachedMesh cached;
+        CHECK(cached.open(cache_path.c_str(), SOURCE_PATH));
+    }
+    CHECK(writeFile(SOURCE_PATH, "v 0 0 0\nv 2 0 0\nv 0 2 0\nv 0 0 2\nf 1 2 3\n"));
+    {
+        CachedMesh cached;
+        CHECK(!cached.open(cache_path.c_str(), SOURCE_PATH));
+    }
+}
+
+void testRestamp()
+{
+    std::string cache_path = meshCachePath(SOURCE_PATH);
+    CHECK(writeFile(SOURCE_PATH, "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n"));
+    CHECK(writeMeshCache(cache_path.c_str(), SOURCE_PATH, randomMesh(100, 300), lodChain(300)));
+    std::vector<unsigned char> written;
+    CHECK(readFile(cache_path.c_str(), written));
+
+    // Touched but unchanged: the cache is used and takes the new mtime
+    CHECK(setMtime(SOURCE_PATH, 1000000000));
+    {
+        CachedMesh cached;
+        CHECK(cached.open(cache_path.c_str(), SOURCE_PATH));
+        CHECK(cached.header().source_mtime == 1000000000);
+        CHECK(cached.header().vertex_count == 100);
+    }
+    std::vector<unsigned char> restamped;
+    CHECK(readFile(cache_path.c_str(), restamped));
+    CHECK(restamped.size() == written.size());
+    CHECK(((const MeshCacheHeader *)&restamped[0])->source_mtime == 1000000000);
+    // Nothing but the mtime changed
+    ((MeshCacheHeader *)&restamped[0])->source_mtime = ((const MeshCacheHeader *)&written[0])->source_mtime;
+    CHECK(restamped == written);
+
+    // Changed content of the same size under an old mtime is still stale,
+    // and the stamp is left alone
+    CHECK(writeFile(SOURCE_PATH, "v 0 0 0\nv 2 0 0\nv 0 1 0\nf 1 2 3\n"));
+    CHECK(setMtime(SOURCE_PATH, 1000000000 + 60));
+    {
+        CachedMesh cached;
+        CHECK(!cached.open(cache_path.c_str(), SOURCE_PATH));
+    }
+    CHECK(readFile(cache_path.c_str(), restamped));
+    CHECK(((const MeshCacheHeader *)&restamped[0])->source_mtime == 1000000000);
+
+    // Patching never creates a file
+    CHECK(!patchFile("meshcache_test_missing.bin", 0, "x", 1));
+    FILE * missing = fopen("meshcache_test_missing.bin", "rb");
+    CHECK(missing == NULL);
+    if (missing)
+        fclose(missing);
+}
+
+void testReplaceFile()
+{
+    const char * path = "meshcache_test_replaced.bin";
+    std::string temp_path = tempPath(path);
+    CHECK(temp_path.compare(0, strlen(path) + 1, std::string(path) + ".") == 0);
+    CHECK(tempPath(path) == temp_path);
+    std::string other_thread;
+    std::thread([&]() { other_thread = tempPath(path); }).join();
+    CHECK(other_thread != temp_path);
+
+    // Into place whether or not there is a file already, the temporary is gone
+    remove(path);
+    std::vector<unsigned char> contents;
+    CHECK(writeFile(temp_path.c_str(), "first"));
+    CHECK(replaceFile(temp_path.c_str(), path));
+    CHECK(readFile(path, contents) && std::string(contents.begin(), contents.end()) == "first");
+    CHECK(writeFile(temp_path.c_str(), "second"));
+    CHECK(replaceFile(temp_path.c_str(), path));
+    CHECK(readFile(path, contents) && std::string(contents.begin(), contents.end()) == "second");
+    CHECK(!readFile(temp_path.c_str(), contents));
+
+    // Nothing to move leaves the file as it was
+    CHECK(!replaceFile(temp_path.c_str(), path));
+    CHECK(readFile(path, contents) && std::string(contents.begin(), contents.end()) == "second");
+    remove(path);
+}
+
+} // namespace
+
+int main()
+{
+    testRoundTrip(500, 1500, 2);
+    testRoundTrip(70000, 210000, 4);
+    testRejected();
+    testRestamp();
+    testReplaceFile();
+    remove(meshCachePath(SOURCE_PATH).c_str());
+    remove(SOURCE_PATH);
+    return testResult("meshcache");
+}
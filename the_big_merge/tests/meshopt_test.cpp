@@ -0,0 +1,157 @@
+#include <stdio.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "check.h"
+#include "meshopt.h"
+
+namespace {
+
+std::mt19937 random_engine(23);
+
+struct Triangle
+{
+    unsigned int v[3];
+    bool operator<(const Triangle & other) const
+    {
+        return std::lexicographical_compare(v, v + 3, other.v, other.v + 3);
+    }
+    bool operator==(const Triangle & other) const
+    {
+        return v[0] == other.v[0] && v[1] == other.v[1] && v[2] == other.v[2];
+    }
+};
+
+// The triangles of indices, each rotated to start at its smallest index
+// so a reorder that keeps the winding compares equal
+std::vector<Triangle> triangleSet(const std::vector<unsigned int> & indices)
+{
+    std::vector<Triangle> triangles(indices.size() / 3);
+    for (size_t i = 0; i < triangles.size(); i++) {
+        const unsigned int * t = &indices[i * 3];
+        int first = t[0] <= t[1] && t[0] <= t[2] ? 0 : t[1] <= t[2] ? 1 : 2;
+        for (int c = 0; c < 3; c++)
+            triangles[i].v[c] = t[(first + c) % 3];
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+// size x size quads in row order
+std::vector<unsigned int> gridIndices(unsigned int size)
+{
+    std::vector<unsigned int> indices;
+    for (unsigned int y = 0; y < size; y++)
+        for (unsigned int x = 0; x < size; x++) {
+            unsigned int a = y * (size + 1) + x, b = a + 1, c = a + size + 1, d = c + 1;
+            unsigned int quad[6] = { a, c, b, b, c, d };
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    return indices;
+}
+
+void testFifo()
+{
+    VertexCacheStats stats = analyzeVertexCache(std::vector<unsigned int>(), 10);
+    CHECK(stats.transformed == 0 && stats.acmr == 0.0 && stats.atvr == 0.0);
+
+    // The same triangle twice is shaded once
+    unsigned int repeated[] = { 0, 1, 2, 0, 1, 2 };
+    stats = analyzeVertexCache(std::vector<unsigned int>(repeated, repeated + 6), 3, 3);
+    CHECK(stats.transformed == 3);
+    CHECK(stats.acmr == 1.5 && stats.atvr == 1.0);
+
+    // Six new vertices push the first three out of a 3 entry cache, not
+    // out of a 6 entry one
+    unsigned int pushed[] = { 0, 1, 2, 3, 4, 5, 0, 1, 2 };
+    std::vector<unsigned int> indices(pushed, pushed + 9);
+    stats = analyzeVertexCache(indices, 6, 3);
+    CHECK(stats.transformed == 9 && stats.acmr == 3.0 && stats.atvr == 1.5);
+    stats = analyzeVertexCache(indices, 6, 6);
+    CHECK(stats.transformed == 6 && stats.acmr == 2.0 && stats.atvr == 1.0);
+
+    // FIFO, not LRU: the hit on 0 doesn't keep it in, so it is shaded
+    // again in the third triangle where LRU would have 7
+    unsigned int fifo[] = { 0, 1, 2, 0, 3, 4, 0, 5, 6 };
+    stats = analyzeVertexCache(std::vector<unsigned int>(fifo, fifo + 9), 7, 3);
+    CHECK(stats.transformed == 8);
+    CHECK_NEAR(stats.atvr, 8.0 / 7.0, 1e-12);
+
+    // Row order on a wide grid shades every inner vertex twice
+    std::vector<unsigned int> grid = gridIndices(64);
+    stats = analyzeVertexCache(grid, 65 * 65, 16);
+    CHECK(stats.transformed == 65 * 65 + 63 * 65);
+}
+
+void testVertexCache()
+{
+    const unsigned int size = 48;
+    const size_t vertex_count = (size + 1) * (size + 1);
+    std::vector<unsigned int> grid = gridIndices(size);
+
+    // Row order and shuffled triangles both keep their triangles and get
+    // no worse; shuffled gets near what Forsyth gives a grid
+    std::vector<unsigned int> shuffled(grid.size());
+    std::vector<size_t> order(grid.size() / 3);
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::shuffle(order.begin(), order.end(), random_engine);
+    for (size_t i = 0; i < order.size(); i++)
+        for (int c = 0; c < 3; c++)
+            shuffled[i * 3 + c] = grid[order[i] * 3 + c];
+
+    const std::vector<unsigned int> * inputs[] = { &grid, &shuffled };
+    for (int input = 0; input < 2; input++) {
+        std::vector<unsigned int> indices = *inputs[input];
+        double before = analyzeVertexCache(indices, vertex_count).acmr;
+        optimizeVertexCache(indices, vertex_count);
+        CHECK(indices.size() == grid.size());
+        CHECK(triangleSet(indices) == triangleSet(grid));
+        double after = analyzeVertexCache(indices, vertex_count).acmr;
+        CHECK(after <= before);
+        CHECK(after < 0.8);
+    }
+
+    // Unused vertices, degenerate and repeated triangles are kept as they are
+    unsigned int odd[] = { 0, 1, 2, 2, 1, 0, 0, 1, 2, 5, 5, 5, 9, 3, 5 };
+    std::vector<unsigned int> indices(odd, odd + 15);
+    optimizeVertexCache(indices, 12);
+    CHECK(triangleSet(indices) == triangleSet(std::vector<unsigned int>(odd, odd + 15)));
+
+    // Nothing to do
+    indices.clear();
+    optimizeVertexCache(indices, 0);
+    CHECK(indices.empty());
+}
+
+void testOverdrawKeepsTriangles()
+{
+    const unsigned int size = 32;
+    std::vector<float> positions;
+    for (unsigned int y = 0; y <= size; y++)
+        for (unsigned int x = 0; x <= size; x++) {
+            positions.push_back((float)x);
+            positions.push_back((float)((x * y) % 5));
+            positions.push_back((float)y);
+        }
+    std::vector<unsigned int> indices = gridIndices(size);
+    optimizeVertexCache(indices, positions.size() / 3);
+    std::vector<Triangle> expected = triangleSet(indices);
+    double acmr = analyzeVertexCache(indices, positions.size() / 3).acmr;
+    optimizeOverdraw(indices, &positions[0], positions.size() / 3, 3);
+    CHECK(triangleSet(indices) == expected);
+    // Cluster reordering may cost a little at the seams, not much
+    CHECK(analyzeVertexCache(indices, positions.size() / 3).acmr < acmr * 1.1);
+}
+
+} // namespace
+
+int main()
+{
+    testFifo();
+    testVertexCache();
+    testOverdrawKeepsTriangles();
+    return testResult("meshopt");
+}
@@ -0,0 +1,47 @@
+#include <stdio.h>
+
+#include <random>
+
+#include "bench.h"
+#include "mipmap.h"
+
+// mipmap_bench [size [repeats]]: generateMipmaps of a size x size BGRA
+// image (2048 by default) at every SIMD level this machine runs, against
+// the scalar kernel. Only the filtering is vectorized, sRGB decoding and
+// encoding cost the same at every level.
+
+int main(int argc, char ** argv)
+{
+    unsigned int size = (unsigned int)benchArg(argc, argv, 1, 2048);
+    int repeats = (int)benchArg(argc, argv, 2, 5);
+
+    ImageData image;
+    image.width = image.height = size;
+    image.format = GL_BGRA;
+    image.compressed = false;
+    image.mapped = NULL;
+    image.levels.assign(1, ImageLevel());
+    image.levels[0].offset = 0;
+    image.levels[0].size = (size_t)size * size * 4;
+    image.pixels.resize(image.levels[0].size);
+    std::mt19937 random_engine(1);
+    for (size_t i = 0; i < image.pixels.size(); i++)
+        image.pixels[i] = (unsigned char)random_engine();
+
+    printf("%ux%u BGRA\n%-8s %10s %8s\n", size, size, "", "ms", "speedup");
+    double scalar = 0.0;
+    for (int level = SIMD_SCALAR; level <= simdLevel(); level++) {
+        SimdLevel simd = (SimdLevel)level;
+        double seconds = benchBest(repeats, [&]() {
+            // Back to level 0 alone, the capacity for the chain stays
+            image.levels.resize(1);
+            image.pixels.resize(image.levels[0].size);
+            generateMipmaps(image, simd);
+        });
+        if (level == SIMD_SCALAR)
+            scalar = seconds;
+        printf("%-8s %10.2f %7.2fx\n", simdLevelName(simd), seconds * 1000, scalar / seconds);
+    }
+    // Keeps the levels from being optimized away
+    return image.pixels.back() == 123 && image.levels.size() == 1;
+}
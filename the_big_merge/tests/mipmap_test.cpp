@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <random>
+#include <vector>
+
+#include "check.h"
+#include "mipmap.h"
+
+namespace {
+
+std::mt19937 random_engine(41);
+
+size_t rowBytes(unsigned int width, unsigned int channels)
+{
+    return (width * channels + 3) & ~(size_t)3;
+}
+
+// Single level BGR or BGRA image in the BMP layout, all zero
+ImageData makeImage(unsigned int width, unsigned int height, GLenum format)
+{
+    ImageData image;
+    image.width = width;
+    image.height = height;
+    image.format = format;
+    image.compressed = false;
+    image.mapped = NULL;
+    image.levels.assign(1, ImageLevel());
+    image.levels[0].offset = 0;
+    image.levels[0].size = rowBytes(width, format == GL_BGRA ? 4 : 3) * height;
+    image.pixels.assign(image.levels[0].size, 0);
+    return image;
+}
+
+unsigned char * texel(ImageData & image, unsigned int level, unsigned int x, unsigned int y)
+{
+    unsigned int channels = image.format == GL_BGRA ? 4 : 3;
+    unsigned int width = image.width;
+    for (unsigned int l = 0; l < level; l++)
+        width = width > 1 ? width / 2 : 1;
+    return &image.pixels[image.levels[level].offset + rowBytes(width, channels) * y + (size_t)x * channels];
+}
+
+void setGray(ImageData & image, unsigned int x, unsigned int y, unsigned char value)
+{
+    unsigned char * p = texel(image, 0, x, y);
+    p[0] = p[1] = p[2] = value;
+}
+
+// Every color channel of every texel of the level is value
+bool levelIs(ImageData & image, unsigned int level, unsigned int width, unsigned int height, unsigned char value)
+{
+    for (unsigned int y = 0; y < height; y++)
+        for (unsigned int x = 0; x < width; x++) {
+            const unsigned char * p = texel(image, level, x, y);
+            if (p[0] != value || p[1] != value || p[2] != value)
+                return false;
+        }
+    return true;
+}
+
+// Level sizes from width x height down to 1x1, rounding down
+bool checkChain(const ImageData & image, unsigned int channels)
+{
+    unsigned int width = image.width, height = image.height;
+    size_t offset = image.levels[0].offset;
+    for (size_t l = 0; l < image.levels.size(); l++) {
+        if (image.levels[l].offset != offset || image.levels[l].size != rowBytes(width, channels) * height)
+            return false;
+        offset += image.levels[l].size;
+        if (l + 1 == image.levels.size())
+            return width == 1 && height == 1 && image.pixels.size() == offset;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    return false;
+}
+
+void testChecker()
+{
+    // Black and white average to half the light, which is sRGB 188, not
+    // the 128 of averaging the bytes
+    for (int bgra = 0; bgra < 2; bgra++) {
+        ImageData image = makeImage(8, 8, bgra ? GL_BGRA : GL_BGR);
+        for (unsigned int y = 0; y < 8; y++)
+            for (unsigned int x = 0; x < 8; x++)
+                setGray(image, x, y, (x ^ y) & 1 ? 255 : 0);
+        generateMipmaps(image, SIMD_SCALAR);
+        CHECK(image.levels.size() == 4);
+        CHECK(checkChain(image, bgra ? 4 : 3));
+        CHECK(levelIs(image, 1, 4, 4, 188));
+        CHECK(levelIs(image, 2, 2, 2, 188));
+        CHECK(levelIs(image, 3, 1, 1, 188));
+        // Level 0 is untouched
+        CHECK(*texel(image, 0, 0, 0) == 0 && *texel(image, 0, 1, 0) == 255);
+    }
+
+    // Flat colors stay exactly what they were
+    ImageData flat = makeImage(4, 4, GL_BGR);
+    for (unsigned int y = 0; y < 4; y++)
+        for (unsigned int x = 0; x < 4; x++)
+            setGray(flat, x, y, 77);
+    generateMipmaps(flat, SIMD_SCALAR);
+    CHECK(levelIs(flat, 1, 2, 2, 77) && levelIs(flat, 2, 1, 1, 77));
+}
+
+void testOddSizes()
+{
+    // 5x3: 2x1 and 1x1, the last column and row are dropped. They are
+    // white, everything else black, so nothing of them may show.
+    ImageData odd = makeImage(5, 3, GL_BGR);
+    for (unsigned int y = 0; y < 3; y++)
+        for (unsigned int x = 0; x < 5; x++)
+            setGray(odd, x, y, x == 4 || y == 2 ? 255 : 0);
+    generateMipmaps(odd, SIMD_SCALAR);
+    CHECK(odd.levels.size() == 3);
+    CHECK(checkChain(odd, 3));
+    CHECK(levelIs(odd, 1, 2, 1, 0));
+    CHECK(levelIs(odd, 2, 1, 1, 0));
+
+    // 1x4 with rows black, white, white, white: 1x2 of 188 and 255, then
+    // 1x1 of three quarters light, sRGB 225
+    ImageData column = makeImage(1, 4, GL_BGR);
+    setGray(column, 0, 0, 0);
+    setGray(column, 0, 1, 255);
+    setGray(column, 0, 2, 255);
+    setGray(column, 0, 3, 255);
+    generateMipmaps(column, SIMD_SCALAR);
+    CHECK(column.levels.size() == 3);
+    CHECK(checkChain(column, 3));
+    CHECK(*texel(column, 1, 0, 0) == 188 && *texel(column, 1, 0, 1) == 255);
+    CHECK(*texel(column, 2, 0, 0) == 225);
+
+    // The same along a row
+    ImageData row = makeImage(4, 1, GL_BGR);
+    setGray(row, 1, 0, 255);
+    setGray(row, 2, 0, 255);
+    setGray(row, 3, 0, 255);
+    generateMipmaps(row, SIMD_SCALAR);
+    CHECK(row.levels.size() == 3);
+    CHECK(checkChain(row, 3));
+    CHECK(*texel(row, 1, 0, 0) == 188 && *texel(row, 1, 1, 0) == 255);
+    CHECK(*texel(row, 2, 0, 0) == 225);
+
+    // 7x1 and 1x1
+    ImageData thin = makeImage(7, 1, GL_BGRA);
+    generateMipmaps(thin, SIMD_SCALAR);
+    CHECK(thin.levels.size() == 3);
+    CHECK(checkChain(thin, 4));
+    ImageData single = makeImage(1, 1, GL_BGR);
+    generateMipmaps(single, SIMD_SCALAR);
+    CHECK(single.levels.size() == 1 && single.pixels.size() == 4);
+}
+
+void testAlpha()
+{
+    // Alpha is linear: 0 and 255 give 128, a quarter of 255 gives 64
+    ImageData image = makeImage(4, 2, GL_BGRA);
+    texel(image, 0, 0, 0)[3] = 255;
+    texel(image, 0, 1, 0)[3] = 255;
+    texel(image, 0, 2, 0)[3] = 255;
+    for (unsigned int x = 0; x < 4; x++)
+        setGray(image, x, 1, 255);
+    generateMipmaps(image, SIMD_SCALAR);
+    CHECK(image.levels.size() == 3);
+    CHECK(checkChain(image, 4));
+    const unsigned char * left = texel(image, 1, 0, 0);
+    const unsigned char * right = texel(image, 1, 1, 0);
+    CHECK(left[3] == 128 && right[3] == 64);
+    // Color is not weighted by alpha
+    CHECK(left[0] == 188 && left[1] == 188 && left[2] == 188);
+    CHECK(right[0] == 188 && right[2] == 188);
+    CHECK(texel(image, 2, 0, 0)[3] == 96);
+}
+
+void testLeftAlone()
+{
+    ImageData image = makeImage(4, 4, GL_BGR);
+    generateMipmaps(image, SIMD_SCALAR);
+    std::vector<unsigned char> pixels = image.pixels;
+    size_t levels = image.levels.size();
+    generateMipmaps(image, SIMD_SCALAR);
+    CHECK(image.levels.size() == levels && image.pixels == pixels);
+
+    ImageData compressed = makeImage(4, 4, GL_BGR);
+    compressed.compressed = true;
+    generateMipmaps(compressed, SIMD_SCALAR);
+    CHECK(compressed.levels.size() == 1);
+}
+
+void testSimdLevels()
+{
+    // Every kernel gives the bytes of the scalar one, at widths around
+    // their 2 and 4 texel steps
+    const unsigned int widths[] = { 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 33, 100 };
+    const unsigned int heights[] = { 1, 2, 5, 16 };
+    for (int bgra = 0; bgra < 2; bgra++)
+        for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++)
+            for (size_t h = 0; h < sizeof(heights) / sizeof(heights[0]); h++) {
+                ImageData reference = makeImage(widths[w], heights[h], bgra ? GL_BGRA : GL_BGR);
+                for (size_t i = 0; i < reference.pixels.size(); i++)
+                    reference.pixels[i] = (unsigned char)random_engine();
+                ImageData source = reference;
+                generateMipmaps(reference, SIMD_SCALAR);
+                for (int level = SIMD_SCALAR + 1; level <= simdLevel(); level++) {
+                    ImageData image = source;
+                    generateMipmaps(image, (SimdLevel)level);
+                    CHECK(image.levels.size() == reference.levels.size());
+                    CHECK(image.pixels == reference.pixels);
+                }
+            }
+}
+
+} // namespace
+
+int main()
+{
+    testChecker();
+    testOddSizes();
+    testAlpha();
+    testLeftAlone();
+    testSimdLevels();
+    // Levels above the machine's can't run here
+    printf("mipmap: tested up to %s\n", simdLevelName(simdLevel()));
+    return testResult("mipmap");
+}
@@ -0,0 +1,125 @@
+#ifndef MOCKGL_GLEW_H
+#define MOCKGL_GLEW_H
+
+#include <stddef.h>
+
+// Stands in for GLEW when the tests build the renderer's sources: the GL
+// types, the enums and the functions those sources use, with the values
+// of the real headers. Nothing reaches a driver, every call is recorded;
+// see mockgl.h.
+
+#define GLAPIENTRY
+
+typedef unsigned int GLenum;
+typedef unsigned int GLuint;
+typedef int GLint;
+typedef int GLsizei;
+typedef unsigned char GLboolean;
+typedef unsigned char GLubyte;
+typedef float GLfloat;
+typedef char GLchar;
+typedef void GLvoid;
+typedef ptrdiff_t GLintptr;
+typedef ptrdiff_t GLsizeiptr;
+
+#define GL_FALSE 0
+#define GL_TRUE 1
+
+#define GL_TRIANGLES 0x0004
+#define GL_UNSIGNED_BYTE 0x1401
+#define GL_SHORT 0x1402
+#define GL_UNSIGNED_SHORT 0x1403
+#define GL_UNSIGNED_INT 0x1405
+#define GL_FLOAT 0x1406
+#define GL_INT_2_10_10_10_REV 0x8D9F
+
+#define GL_ARRAY_BUFFER 0x8892
+#define GL_ELEMENT_ARRAY_BUFFER 0x8893
+#define GL_COPY_READ_BUFFER 0x8F36
+#define GL_COPY_WRITE_BUFFER 0x8F37
+#define GL_UNIFORM_BUFFER 0x8A11
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#define GL_STATIC_DRAW 0x88E4
+#define GL_STREAM_DRAW 0x88E0
+
+#define GL_CURRENT_PROGRAM 0x8B8D
+#define GL_VERTEX_ARRAY_BINDING 0x85B5
+
+#define GL_TEXTURE_2D 0x0DE1
+#define GL_TEXTURE_2D_ARRAY 0x8C1A
+#define GL_TEXTURE_MAG_FILTER 0x2800
+#define GL_TEXTURE_MIN_FILTER 0x2801
+#define GL_TEXTURE_WRAP_S 0x2802
+#define GL_TEXTURE_WRAP_T 0x2803
+#define GL_TEXTURE_MAX_LEVEL 0x813D
+#define GL_TEXTURE_MAX_ANISOTROPY_EXT 0x84FE
+#define GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT 0x84FF
+#define GL_LINEAR 0x2601
+#define GL_LINEAR_MIPMAP_LINEAR 0x2703
+#define GL_REPEAT 0x2901
+#define GL_CLAMP_TO_EDGE 0x812F
+#define GL_MAX_TEXTURE_SIZE 0x0D33
+#define GL_MAX_ARRAY_TEXTURE_LAYERS 0x88FF
+#define GL_UNPACK_ALIGNMENT 0x0CF5
+
+#define GL_RGB8 0x8051
+#define GL_RGBA8 0x8058
+#define GL_BGR 0x80E0
+#define GL_BGRA 0x80E1
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+
+// Extensions the sources check; settable by the tests
+extern GLboolean GLEW_ARB_texture_storage;
+extern GLboolean GLEW_EXT_texture_filter_anisotropic;
+extern GLboolean GLEW_EXT_texture_compression_s3tc;
+
+void glUseProgram(GLuint program);
+void glDeleteProgram(GLuint program);
+GLint glGetAttribLocation(GLuint program, const GLchar * name);
+
+void glGenVertexArrays(GLsizei n, GLuint * arrays);
+void glDeleteVertexArrays(GLsizei n, const GLuint * arrays);
+void glBindVertexArray(GLuint array);
+void glVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void * pointer);
+void glVertexAttribIPointer(GLuint index, GLint size, GLenum type, GLsizei stride, const void * pointer);
+void glVertexAttribDivisor(GLuint index, GLuint divisor);
+void glEnableVertexAttribArray(GLuint index);
+
+void glGenBuffers(GLsizei n, GLuint * buffers);
+void glDeleteBuffers(GLsizei n, const GLuint * buffers);
+void glBindBuffer(GLenum target, GLuint buffer);
+void glBindBufferBase(GLenum target, GLuint index, GLuint buffer);
+void glBindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+void glBufferData(GLenum target, GLsizeiptr size, const void * data, GLenum usage);
+void glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void * data);
+void glCopyBufferSubData(GLenum read_target, GLenum write_target, GLintptr read_offset, GLintptr write_offset, GLsizeiptr size);
+
+void glGenTextures(GLsizei n, GLuint * textures);
+void glDeleteTextures(GLsizei n, const GLuint * textures);
+void glBindTexture(GLenum target, GLuint texture);
+void glTexParameteri(GLenum target, GLenum name, GLint value);
+void glTexParameterf(GLenum target, GLenum name, GLfloat value);
+void glPixelStorei(GLenum name, GLint value);
+void glTexImage2D(GLenum target, GLint level, GLint internal_format, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void * pixels);
+void glTexSubImage2D(GLenum target, GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, const void * pixels);
+void glTexStorage2D(GLenum target, GLsizei levels, GLenum internal_format, GLsizei width, GLsizei height);
+void glCompressedTexImage2D(GLenum target, GLint level, GLenum internal_format, GLsizei width, GLsizei height, GLint border, GLsizei size, const void * data);
+void glCompressedTexSubImage2D(GLenum target, GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLsizei size, const void * data);
+void glTexImage3D(GLenum target, GLint level, GLint internal_format, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, const void * pixels);
+void glTexSubImage3D(GLenum target, GLint level, GLint x, GLint y, GLint z, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void * pixels);
+void glTexStorage3D(GLenum target, GLsizei levels, GLenum internal_format, GLsizei width, GLsizei height, GLsizei depth);
+void glCompressedTexImage3D(GLenum target, GLint level, GLenum internal_format, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLsizei size, const void * data);
+void glCompressedTexSubImage3D(GLenum target, GLint level, GLint x, GLint y, GLint z, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLsizei size, const void * data);
+void glGenerateMipmap(GLenum target);
+void glGetFloatv(GLenum name, GLfloat * data);
+void glGetIntegerv(GLenum name, GLint * data);
+
+void glDrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void * indices, GLint base_vertex);
+void glDrawElementsInstancedBaseVertex(GLenum mode, GLsizei count, GLenum type, const void * indices, GLsizei instances, GLint base_vertex);
+void glDrawElementsInstancedBaseVertexBaseInstance(GLenum mode, GLsizei count, GLenum type, const void * indices, GLsizei instances, GLint base_vertex, GLuint base_instance);
+void glMultiDrawElementsIndirect(GLenum mode, GLenum type, const void * indirect, GLsizei count, GLsizei stride);
+
+#endif
@@ -0,0 +1,200 @@
+#include <string.h>
+
+#include "mockgl.h"
+
+GLboolean GLEW_ARB_texture_storage = GL_TRUE;
+GLboolean GLEW_EXT_texture_filter_anisotropic = GL_FALSE;
+GLboolean GLEW_EXT_texture_compression_s3tc = GL_TRUE;
+
+namespace {
+
+std::vector<MockGLCall> calls;
+GLuint next_name = 1;
+GLint attrib_location = -1;
+
+void record(const char * name, long long a = 0, long long b = 0, long long c = 0,
+    long long d = 0, long long e = 0)
+{
+    MockGLCall call = { name, { a, b, c, d, e } };
+    calls.push_back(call);
+}
+
+long long address(const void * pointer)
+{
+    return (long long)(size_t)pointer;
+}
+
+void generate(const char * name, GLsizei n, GLuint * names)
+{
+    for (GLsizei i = 0; i < n; i++)
+        names[i] = next_name++;
+    record(name, n, n > 0 ? names[0] : 0);
+}
+
+} // namespace
+
+const std::vector<MockGLCall> & mockGLCalls()
+{
+    return calls;
+}
+
+void resetMockGL()
+{
+    calls.clear();
+}
+
+size_t mockGLCount(const char * name)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < calls.size(); i++)
+        if (strcmp(calls[i].name, name) == 0)
+            count++;
+    return count;
+}
+
+void setMockAttribLocation(GLint location)
+{
+    attrib_location = location;
+}
+
+void glUseProgram(GLuint program) { record("UseProgram", program); }
+void glDeleteProgram(GLuint program) { record("DeleteProgram", program); }
+
+GLint glGetAttribLocation(GLuint program, const GLchar * name)
+{
+    record("GetAttribLocation", program, address(name));
+    return attrib_location;
+}
+
+void glGenVertexArrays(GLsizei n, GLuint * arrays) { generate("GenVertexArrays", n, arrays); }
+void glDeleteVertexArrays(GLsizei n, const GLuint * arrays) { record("DeleteVertexArrays", n, n > 0 ? arrays[0] : 0); }
+void glBindVertexArray(GLuint array) { record("BindVertexArray", array); }
+
+void glVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void * pointer)
+{
+    record("VertexAttribPointer", index, size, type, normalized, address(pointer));
+}
+
+void glVertexAttribIPointer(GLuint index, GLint size, GLenum type, GLsizei stride, const void * pointer)
+{
+    record("VertexAttribIPointer", index, size, type, stride, address(pointer));
+}
+
+void glVertexAttribDivisor(GLuint index, GLuint divisor) { record("VertexAttribDivisor", index, divisor); }
+void glEnableVertexAttribArray(GLuint index) { record("EnableVertexAttribArray", index); }
+
+void glGenBuffers(GLsizei n, GLuint * buffers) { generate("GenBuffers", n, buffers); }
+void glDeleteBuffers(GLsizei n, const GLuint * buffers) { record("DeleteBuffers", n, n > 0 ? buffers[0] : 0); }
+void glBindBuffer(GLenum target, GLuint buffer) { record("BindBuffer", target, buffer); }
+void glBindBufferBase(GLenum target, GLuint index, GLuint buffer) { record("BindBufferBase", target, index, buffer); }
+
+void glBindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+    record("BindBufferRange", target, index, buffer, offset, size);
+}
+
+void glBufferData(GLenum target, GLsizeiptr size, const void * data, GLenum usage)
+{
+    record("BufferData", target, size, address(data), usage);
+}
+
+void glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void * data)
+{
+    record("BufferSubData", target, offset, size, address(data));
+}
+
+void glCopyBufferSubData(GLenum read_target, GLenum write_target, GLintptr read_offset, GLintptr write_offset, GLsizeiptr size)
+{
+    record("CopyBufferSubData", read_target, write_target, read_offset, write_offset, size);
+}
+
+void glGenTextures(GLsizei n, GLuint * textures) { generate("GenTextures", n, textures); }
+void glDeleteTextures(GLsizei n, const GLuint * textures) { record("DeleteTextures", n, n > 0 ? textures[0] : 0); }
+void glBindTexture(GLenum target, GLuint texture) { record("BindTexture", target, texture); }
+void glTexParameteri(GLenum target, GLenum name, GLint value) { record("TexParameteri", target, name, value); }
+void glTexParameterf(GLenum target, GLenum name, GLfloat value) { record("TexParameterf", target, name, (long long)value); }
+void glPixelStorei(GLenum name, GLint value) { record("PixelStorei", name, value); }
+
+void glTexImage2D(GLenum target, GLint level, GLint internal_format, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void * pixels)
+{
+    record("TexImage2D", level, internal_format, width, height, format);
+}
+
+void glTexSubImage2D(GLenum target, GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, const void * pixels)
+{
+    record("TexSubImage2D", level, width, height, format, type);
+}
+
+void glTexStorage2D(GLenum target, GLsizei levels, GLenum internal_format, GLsizei width, GLsizei height)
+{
+    record("TexStorage2D", target, levels, internal_format, width, height);
+}
+
+void glCompressedTexImage2D(GLenum target, GLint level, GLenum internal_format, GLsizei width, GLsizei height, GLint border, GLsizei size, const void * data)
+{
+    record("CompressedTexImage2D", level, internal_format, width, height, size);
+}
+
+void glCompressedTexSubImage2D(GLenum target, GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLsizei size, const void * data)
+{
+    record("CompressedTexSubImage2D", level, width, height, format, size);
+}
+
+void glTexImage3D(GLenum target, GLint level, GLint internal_format, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, const void * pixels)
+{
+    record("TexImage3D", level, internal_format, width, height, depth);
+}
+
+void glTexSubImage3D(GLenum target, GLint level, GLint x, GLint y, GLint z, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void * pixels)
+{
+    record("TexSubImage3D", level, z, width, height, format);
+}
+
+void glTexStorage3D(GLenum target, GLsizei levels, GLenum internal_format, GLsizei width, GLsizei height, GLsizei depth)
+{
+    record("TexStorage3D", levels, internal_format, width, height, depth);
+}
+
+void glCompressedTexImage3D(GLenum target, GLint level, GLenum internal_format, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLsizei size, const void * data)
+{
+    record("CompressedTexImage3D", level, internal_format, width, height, depth);
+}
+
+void glCompressedTexSubImage3D(GLenum target, GLint level, GLint x, GLint y, GLint z, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLsizei size, const void * data)
+{
+    record("CompressedTexSubImage3D", level, z, width, height, size);
+}
+
+void glGenerateMipmap(GLenum target) { record("GenerateMipmap", target); }
+
+void glGetFloatv(GLenum name, GLfloat * data)
+{
+    record("GetFloatv", name);
+    *data = 16.0f;
+}
+
+void glGetIntegerv(GLenum name, GLint * data)
+{
+    record("GetIntegerv", name);
+    *data = name == GL_MAX_ARRAY_TEXTURE_LAYERS ? 2048 : 16384;
+}
+
+void glDrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void * indices, GLint base_vertex)
+{
+    record("DrawElementsBaseVertex", mode, count, type, address(indices), base_vertex);
+}
+
+void glDrawElementsInstancedBaseVertex(GLenum mode, GLsizei count, GLenum type, const void * indices, GLsizei instances, GLint base_vertex)
+{
+    record("DrawElementsInstancedBaseVertex", count, type, address(indices), instances, base_vertex);
+}
+
+void glDrawElementsInstancedBaseVertexBaseInstance(GLenum mode, GLsizei count, GLenum type, const void * indices, GLsizei instances, GLint base_vertex, GLuint base_instance)
+{
+    record("DrawElementsInstancedBaseVertexBaseInstance", count, address(indices), instances, base_vertex, base_instance);
+}
+
+void glMultiDrawElementsIndirect(GLenum mode, GLenum type, const void * indirect, GLsizei count, GLsizei stride)
+{
+    record("MultiDrawElementsIndirect", mode, type, address(indirect), count, stride);
+}
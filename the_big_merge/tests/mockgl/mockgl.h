@@ -0,0 +1,26 @@
+#ifndef MOCKGL_H
+#define MOCKGL_H
+
+#include <vector>
+
+#include <GL/glew.h>
+
+// A GL call as the mock received it: the function without its gl prefix
+// and its integer arguments, pointers as their address
+struct MockGLCall
+{
+	const char * name;
+	long long args[5];
+};
+
+// Calls since the last reset, in order
+const std::vector<MockGLCall> & mockGLCalls();
+void resetMockGL();
+
+// Calls of one function since the last reset
+size_t mockGLCount(const char * name);
+
+// glGetAttribLocation answers location for every name, -1 by default
+void setMockAttribLocation(GLint location);
+
+#endif
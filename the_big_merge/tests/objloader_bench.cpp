@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "objloader.h"
+
+// objloader_bench [MB...]: loadOBJ against loadOBJMapped on generated files
+// of the given sizes, 10, 100 and 1000 MB by default
+// objloader_bench --threads [MB [N]]: loadOBJMapped on 1 to N threads
+// (every core by default) on one file, 100 MB by default
+
+namespace {
+
+const char * OBJ_PATH = "objloader_bench.obj";
+
+// v/vt/vn triangles in blocks of 1000 vertices until the file has bytes bytes
+bool writeObj(size_t bytes)
+{
+    FILE * file = fopen(OBJ_PATH, "wb");
+    if (!file)
+        return false;
+    std::mt19937 random_engine(5);
+    std::uniform_real_distribution<float> coordinate(-100.0f, 100.0f);
+    size_t written = 0;
+    unsigned int base = 1;
+    while (written < bytes) {
+        for (int i = 0; i < 1000; i++) {
+            written += fprintf(file, "v %f %f %f\nvt %f %f\nvn %f %f %f\n",
+                coordinate(random_engine), coordinate(random_engine), coordinate(random_engine),
+                coordinate(random_engine) / 100.0f, coordinate(random_engine) / 100.0f,
+                coordinate(random_engine) / 100.0f, coordinate(random_engine) / 100.0f,
+                coordinate(random_engine) / 100.0f);
+        }
+        for (int i = 0; i < 2000; i++) {
+            unsigned int a = base + random_engine() % 1000, b = base + random_engine() % 1000;
+            unsigned int c = base + random_engine() % 1000;
+            written += fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, c, c, c);
+        }
+        base += 1000;
+    }
+    return fclose(file) == 0;
+}
+
+int threadScaling(double megabytes, unsigned int max_threads)
+{
+    if (!writeObj((size_t)(megabytes * 1024 * 1024))) {
+        printf("Can't write %s\n", OBJ_PATH);
+        return 1;
+    }
+    printf("%.0f MB\n%8s %10s %8s\n", megabytes, "threads", "MB/s", "speedup");
+    double serial = 0;
+    for (unsigned int threads = 1; threads <= max_threads; threads *= 2) {
+        std::vector<glm::vec3> vertices, normals;
+        std::vector<glm::vec2> uvs;
+        double seconds = benchBest(3, [&]() {
+            vertices.clear(); uvs.clear(); normals.clear();
+            loadOBJMapped(OBJ_PATH, vertices, uvs, normals, threads);
+        });
+        if (threads == 1)
+            serial = seconds;
+        printf("%8u %10.1f %7.2fx\n", threads, megabytes / seconds, serial / seconds);
+        if (threads < max_threads && threads * 2 > max_threads)
+            threads = max_threads / 2;
+    }
+    remove(OBJ_PATH);
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char ** argv)
+{
+    if (argc > 1 && strcmp(argv[1], "--threads") == 0) {
+        unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+        return threadScaling(benchArg(argc, argv, 2, 100), (unsigned int)benchArg(argc, argv, 3, cores));
+    }
+
+    std::vector<double> sizes;
+    for (int i = 1; i < argc; i++)
+        sizes.push_back(benchArg(argc, argv, i, 0));
+    if (sizes.empty()) {
+        sizes.push_back(10);
+        sizes.push_back(100);
+        sizes.push_back(1000);
+    }
+
+    printf("%10s %14s %14s %8s\n", "MB", "loadOBJ MB/s", "mapped MB/s", "speedup");
+    for (size_t s = 0; s < sizes.size(); s++) {
+        double megabytes = sizes[s];
+        if (!writeObj((size_t)(megabytes * 1024 * 1024))) {
+            printf("Can't write %s\n", OBJ_PATH);
+            return 1;
+        }
+        std::vector<glm::vec3> vertices, normals;
+        std::vector<glm::vec2> uvs;
+        double scanned = benchBest(1, [&]() {
+            vertices.clear(); uvs.clear(); normals.clear();
+            loadOBJ(OBJ_PATH, vertices, uvs, normals);
+        });
+        double mapped = benchBest(3, [&]() {
+            vertices.clear(); uvs.clear(); normals.clear();
+            loadOBJMapped(OBJ_PATH, vertices, uvs, normals);
+        });
+        printf("%10.0f %14.1f %14.1f %7.1fx\n", megabytes, megabytes / scanned, megabytes / mapped, scanned / mapped);
+    }
+    remove(OBJ_PATH);
+    return 0;
+}
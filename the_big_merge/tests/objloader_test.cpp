@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "objloader.h"
+
+namespace {
+
+const char * OBJ_PATH = "objloader_test.obj";
+
+std::mt19937 random_engine(17);
+
+bool writeFile(const char * path, const std::string & contents)
+{
+    FILE * file = fopen(path, "wb");
+    if (!file)
+        return false;
+    bool ok = fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+    return fclose(file) == 0 && ok;
+}
+
+template <typename T>
+bool sameBits(const std::vector<T> & a, const std::vector<T> & b)
+{
+    return a.size() == b.size() && (a.empty() || memcmp(&a[0], &b[0], a.size() * sizeof(T)) == 0);
+}
+
+// Triangles with v/vt/vn corners only, what loadOBJ reads, with the
+// number formats exporters write
+std::string simpleObj(size_t vertex_count, size_t triangle_count)
+{
+    std::string obj = "# test\nmtllib none.mtl\no thing\n";
+    char line[256];
+    std::uniform_real_distribution<float> coordinate(-100.0f, 100.0f);
+    const char * formats[] = { "%s %f %f %f\n", "%s %.9g %.9g %.9g\n", "%s %e %e %e\n" };
+    for (size_t i = 0; i < vertex_count; i++) {
+        const char * format = formats[i % 3];
+        snprintf(line, sizeof(line), format, "v", coordinate(random_engine), coordinate(random_engine),
+            coordinate(random_engine));
+        obj += line;
+        snprintf(line, sizeof(line), "vt %f %f\n", coordinate(random_engine) / 100.0f, coordinate(random_engine) / 100.0f);
+        obj += line;
+        snprintf(line, sizeof(line), format, "vn", coordinate(random_engine) / 100.0f,
+            coordinate(random_engine) / 100.0f, coordinate(random_engine) / 100.0f);
+        obj += line;
+    }
+    obj += "s off\n";
+    for (size_t i = 0; i < triangle_count; i++) {
+        unsigned int a = 1 + random_engine() % vertex_count, b = 1 + random_engine() % vertex_count;
+        unsigned int c = 1 + random_engine() % vertex_count;
+        snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, c, b, c, b, c);
+        obj += line;
+    }
+    return obj;
+}
+
+void testSameAsLoadOBJ()
+{
+    const size_t sizes[][2] = { { 3, 1 }, { 100, 300 }, { 5000, 20000 } };
+    for (size_t s = 0; s < 3; s++) {
+        CHECK(writeFile(OBJ_PATH, simpleObj(sizes[s][0], sizes[s][1])));
+        std::vector<glm::vec3> vertices, normals, mapped_vertices, mapped_normals;
+        std::vector<glm::vec2> uvs, mapped_uvs;
+        CHECK(loadOBJ(OBJ_PATH, vertices, uvs, normals));
+        CHECK(loadOBJMapped(OBJ_PATH, mapped_vertices, mapped_uvs, mapped_normals));
+        CHECK(vertices.size() == sizes[s][1] * 3);
+        CHECK(sameBits(vertices, mapped_vertices));
+        CHECK(sameBits(uvs, mapped_uvs));
+        CHECK(sameBits(normals, mapped_normals));
+    }
+}
+
+// Mixed face forms on blocks of vertices: absolute and relative indices,
+// quads and pentagons, corners without uv or normal. Relative indices reach
+// back into earlier blocks, across whatever chunk boundary lies between.
+std::string mixedObj(size_t bytes)
+{
+    std::string obj;
+    char line[256];
+    std::uniform_real_distribution<float> coordinate(-10.0f, 10.0f);
+    size_t vertex_count = 0;
+    while (obj.size() < bytes) {
+        for (int i = 0; i < 200; i++) {
+            snprintf(line, sizeof(line), "v %f %f %f\nvt %f %f\nvn %f %f %f\n", coordinate(random_engine),
+                coordinate(random_engine), coordinate(random_engine), coordinate(random_engine),
+                coordinate(random_engine), coordinate(random_engine), coordinate(random_engine),
+                coordinate(random_engine));
+            obj += line;
+        }
+        vertex_count += 200;
+        for (int i = 0; i < 400; i++) {
+            int a = 1 + (int)(random_engine() % vertex_count), b = 1 + (int)(random_engine() % vertex_count);
+            int c = 1 + (int)(random_engine() % vertex_count), d = 1 + (int)(random_engine() % vertex_count);
+            int ra = a - (int)vertex_count - 1, rb = b - (int)vertex_count - 1, rc = c - (int)vertex_count - 1;
+            switch (i % 5) {
+            case 0: snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, b, b, b, c, c, c); break;
+            case 1: snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d\n", ra, ra, ra, rb, rb, rb, rc, rc, rc); break;
+            case 2: snprintf(line, sizeof(line), "f %d %d %d %d\n", ra, b, rc, d); break;
+            case 3: snprintf(line, sizeof(line), "f %d//%d %d//%d %d//%d %d//%d %d//%d\n", a, a, rb, rb, c, c, d, d, ra, ra); break;
+            default: snprintf(line, sizeof(line), "f %d/%d %d/%d %d/%d\n", ra, ra, b, b, rc, rc); break;
+            }
+            obj += line;
+        }
+    }
+    return obj;
+}
+
+void testThreadCounts()
+{
+    // Chunks are at least 1 MB, 8 MB is enough for 7 threads to each get one
+    CHECK(writeFile(OBJ_PATH, mixedObj(8 << 20)));
+    std::vector<glm::vec3> vertices, normals;
+    std::vector<glm::vec2> uvs;
+    CHECK(loadOBJMapped(OBJ_PATH, vertices, uvs, normals, 1));
+    CHECK(vertices.size() > 100000);
+    const unsigned int thread_counts[] = { 2, 3, 7, 64 };
+    for (size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++) {
+        std::vector<glm::vec3> threaded_vertices, threaded_normals;
+        std::vector<glm::vec2> threaded_uvs;
+        CHECK(loadOBJMapped(OBJ_PATH, threaded_vertices, threaded_uvs, threaded_normals, thread_counts[t]));
+        CHECK(sameBits(vertices, threaded_vertices));
+        CHECK(sameBits(uvs, threaded_uvs));
+        CHECK(sameBits(normals, threaded_normals));
+    }
+
+    // A bad index late in the file fails every thread count
+    std::string bad = mixedObj(3 << 20) + "f 1 2 -99999999\n";
+    CHECK(writeFile(OBJ_PATH, bad));
+    for (unsigned int threads = 1; threads <= 4; threads++) {
+        std::vector<glm::vec3> threaded_vertices, threaded_normals;
+        std::vector<glm::vec2> threaded_uvs;
+        CHECK(!loadOBJMapped(OBJ_PATH, threaded_vertices, threaded_uvs, threaded_normals, threads));
+    }
+}
+
+bool loadsMapped(const std::string & obj)
+{
+    CHECK(writeFile(OBJ_PATH, obj));
+    std::vector<glm::vec3> vertices, normals;
+    std::vector<glm::vec2> uvs;
+    return loadOBJMapped(OBJ_PATH, vertices, uvs, normals);
+}
+
+void testIndexRange()
+{
+    const std::string vertices = "v 0 0 0\nv 1 0 0\nv 0 1 0\nv 1 1 0\n";
+    CHECK(loadsMapped(vertices + "f 1 2 4\n"));
+    CHECK(loadsMapped(vertices + "f -1 -2 -4\n"));
+
+    // Past INT_MAX an index must not wrap around to a valid one:
+    // 4294967299 is 3 modulo 2^32
+    const char * faces[] = {
+        "f 1 2 4294967299\n", "f 1 2 2147483648\n", "f 1 2 -2147483649\n",
+        "f 1/99999999999999999999/1 2 3\n", "f 1//18446744073709551619 2 3\n",
+        "f 1 2 2147483647\n", "f 1 2 -2147483648\n", "f 1 2 5\n", "f 0 1 2\n"
+    };
+    for (size_t i = 0; i < sizeof(faces) / sizeof(faces[0]); i++)
+        CHECK(!loadsMapped(vertices + faces[i]));
+}
+
+} // namespace
+
+int main()
+{
+    testSameAsLoadOBJ();
+    testIndexRange();
+    testThreadCounts();
+    remove(OBJ_PATH);
+    return testResult("objloader");
+}
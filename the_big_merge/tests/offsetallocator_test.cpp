@@ -0,0 +1,217 @@
+#include <map>
+#include <random>
+#include <vector>
+
+#include "check.h"
+#include "offsetallocator.h"
+
+namespace {
+
+const size_t INVALID = OffsetAllocator::invalid_offset;
+
+void testAllocateAndExhaust()
+{
+    OffsetAllocator allocator(100);
+    CHECK(allocator.allocate(0) == INVALID);
+    size_t a = allocator.allocate(40);
+    size_t b = allocator.allocate(40);
+    CHECK(a == 0);
+    CHECK(b == 40);
+    CHECK(allocator.allocate(30) == INVALID);
+    size_t c = allocator.allocate(20);
+    CHECK(c == 80);
+    CHECK(allocator.used() == 100);
+    CHECK(allocator.allocate(1) == INVALID);
+
+    OffsetAllocatorStats stats = allocator.stats();
+    CHECK(stats.free == 0 && stats.free_blocks == 0 && stats.largest_free == 0);
+    CHECK(stats.allocations == 3);
+    CHECK(stats.fragmentation == 0.0f);
+}
+
+void testFreeUnknown()
+{
+    OffsetAllocator allocator(64);
+    size_t a = allocator.allocate(16);
+    CHECK(!allocator.free(a + 1));
+    CHECK(!allocator.free(1000));
+    CHECK(allocator.free(a));
+    CHECK(!allocator.free(a));
+    CHECK(allocator.used() == 0);
+}
+
+void testCoalesce()
+{
+    // Freeing the middle last joins it with the blocks on both sides
+    OffsetAllocator allocator(96);
+    size_t a = allocator.allocate(32);
+    size_t b = allocator.allocate(32);
+    size_t c = allocator.allocate(32);
+    CHECK(allocator.free(a));
+    CHECK(allocator.free(c));
+    CHECK(allocator.stats().free_blocks == 2);
+    CHECK(allocator.allocate(64) == INVALID);
+    CHECK(allocator.free(b));
+    OffsetAllocatorStats stats = allocator.stats();
+    CHECK(stats.free_blocks == 1);
+    CHECK(stats.largest_free == 96);
+    CHECK(allocator.allocate(96) == 0);
+
+    // Each order of freeing ends in one block
+    const int orders[6][3] = { { 0, 1, 2 }, { 0, 2, 1 }, { 1, 0, 2 }, { 1, 2, 0 }, { 2, 0, 1 }, { 2, 1, 0 } };
+    for (int o = 0; o < 6; o++) {
+        OffsetAllocator each(90);
+        size_t offsets[3] = { each.allocate(30), each.allocate(30), each.allocate(30) };
+        for (int i = 0; i < 3; i++)
+            CHECK(each.free(offsets[orders[o][i]]));
+        CHECK(each.stats().free_blocks == 1);
+        CHECK(each.stats().largest_free == 90);
+    }
+}
+
+void testBestFit()
+{
+    // Holes of 10, 30 and 20 units between live allocations
+    OffsetAllocator allocator(200);
+    size_t hole10 = allocator.allocate(10);
+    allocator.allocate(5);
+    size_t hole30 = allocator.allocate(30);
+    allocator.allocate(5);
+    size_t hole20 = allocator.allocate(20);
+    allocator.allocate(130);
+    CHECK(allocator.free(hole10));
+    CHECK(allocator.free(hole30));
+    CHECK(allocator.free(hole20));
+
+    CHECK(allocator.allocate(15) == hole20);
+    CHECK(allocator.allocate(10) == hole10);
+    CHECK(allocator.allocate(25) == hole30);
+}
+
+void testAlignment()
+{
+    OffsetAllocator allocator(256);
+    CHECK(allocator.allocate(3) == 0);
+    size_t aligned = allocator.allocate(16, 64);
+    CHECK(aligned == 64);
+    // The padding before it stays free and is used again
+    CHECK(allocator.allocate(61) == 3);
+    CHECK(allocator.allocate(8, 16) == 80);
+    CHECK(allocator.used() == 3 + 16 + 61 + 8);
+
+    // A block too small once aligned is skipped
+    OffsetAllocator tight(100);
+    tight.allocate(1);
+    CHECK(tight.allocate(99, 4) == INVALID);
+    CHECK(tight.allocate(96, 4) == 4);
+}
+
+void testFragmentationStats()
+{
+    // Every other block freed: 8 holes of 16, none can take 32
+    OffsetAllocator allocator(256);
+    std::vector<size_t> offsets;
+    for (int i = 0; i < 16; i++)
+        offsets.push_back(allocator.allocate(16));
+    for (int i = 0; i < 16; i += 2)
+        CHECK(allocator.free(offsets[i]));
+    OffsetAllocatorStats stats = allocator.stats();
+    CHECK(stats.free == 128);
+    CHECK(stats.free_blocks == 8);
+    CHECK(stats.largest_free == 16);
+    CHECK_NEAR(stats.fragmentation, 1.0f - 16.0f / 128.0f, 1e-6f);
+    CHECK(allocator.allocate(32) == INVALID);
+
+    for (int i = 1; i < 16; i += 2)
+        CHECK(allocator.free(offsets[i]));
+    stats = allocator.stats();
+    CHECK(stats.free_blocks == 1);
+    CHECK(stats.fragmentation == 0.0f);
+}
+
+void testGrow()
+{
+    OffsetAllocator allocator(64);
+    size_t a = allocator.allocate(48);
+    CHECK(allocator.allocate(32) == INVALID);
+    allocator.grow(128);
+    CHECK(allocator.capacity() == 128);
+    // The 16 free units at the old end join the new space
+    CHECK(allocator.stats().free_blocks == 1);
+    CHECK(allocator.allocate(80) == 48);
+    CHECK(allocator.free(a));
+
+    // Growing a full allocator adds one block, shrinking is ignored
+    OffsetAllocator full(32);
+    full.allocate(32);
+    full.grow(48);
+    CHECK(full.allocate(16) == 32);
+    full.grow(16);
+    CHECK(full.capacity() == 48);
+
+    allocator.reset(10);
+    CHECK(allocator.used() == 0 && allocator.capacity() == 10 && allocator.stats().allocations == 0);
+}
+
+void testRandomAgainstModel()
+{
+    // Live allocations never overlap or leave the capacity, and freeing
+    // everything gives back one block
+    std::mt19937 engine(3);
+    const size_t capacity = 1 << 16;
+    OffsetAllocator allocator(capacity);
+    std::map<size_t, size_t> live;      // offset -> size
+    size_t used = 0;
+    for (int step = 0; step < 20000; step++) {
+        if (live.empty() || engine() % 3 != 0) {
+            size_t size = 1 + engine() % 700;
+            size_t alignment = (size_t)1 << (engine() % 7);
+            size_t offset = allocator.allocate(size, alignment);
+            if (offset == INVALID)
+                continue;
+            CHECK(offset % alignment == 0);
+            CHECK(offset + size <= capacity);
+            std::map<size_t, size_t>::iterator next = live.lower_bound(offset);
+            if (next != live.end())
+                CHECK(offset + size <= next->first);
+            if (next != live.begin()) {
+                std::map<size_t, size_t>::iterator previous = next;
+                --previous;
+                CHECK(previous->first + previous->second <= offset);
+            }
+            live[offset] = size;
+            used += size;
+        }
+        else {
+            std::map<size_t, size_t>::iterator victim = live.begin();
+            std::advance(victim, engine() % live.size());
+            CHECK(allocator.free(victim->first));
+            used -= victim->second;
+            live.erase(victim);
+        }
+        CHECK(allocator.used() == used);
+    }
+    CHECK(allocator.stats().allocations == live.size());
+
+    for (std::map<size_t, size_t>::iterator it = live.begin(); it != live.end(); ++it)
+        CHECK(allocator.free(it->first));
+    OffsetAllocatorStats stats = allocator.stats();
+    CHECK(stats.used == 0);
+    CHECK(stats.free_blocks == 1);
+    CHECK(stats.largest_free == capacity);
+}
+
+} // namespace
+
+int main()
+{
+    testAllocateAndExhaust();
+    testFreeUnknown();
+    testCoalesce();
+    testBestFit();
+    testAlignment();
+    testFragmentationStats();
+    testGrow();
+    testRandomAgainstModel();
+    return testResult("offsetallocator");
+}
@@ -0,0 +1,333 @@
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "check.h"
+#include "mockgl.h"
+#include "renderqueue.h"
+
+namespace {
+
+std::mt19937 random_engine(13);
+
+unsigned int randomInt(unsigned int count)
+{
+    return (unsigned int)(random_engine() % count);
+}
+
+// Reference of the queue's ordering: the key layout of renderqueue.h
+// built the obvious way, sorted with std::stable_sort
+class KeyModel
+{
+public:
+    unsigned long long key(const RenderCommand & command, float depth)
+    {
+        return (unsigned long long)slot(programs_, command.program, 8) << 56
+            | (unsigned long long)slot(textures_, command.texture_target ? command.texture : 0, 16) << 40
+            | (unsigned long long)slot(vaos_, command.vao, 8) << 32
+            | (unsigned long long)(std::min(std::max(depth, 0.0f), 1.0f) * ((1u << 24) - 1)) << 8;
+    }
+
+private:
+    static unsigned int slot(std::map<GLuint, unsigned int> & slots, GLuint name, unsigned int bits)
+    {
+        if (slots.count(name))
+            return slots[name];
+        if (slots.size() == (1u << bits))
+            slots.clear();
+        unsigned int number = (unsigned int)slots.size();
+        slots[name] = number;
+        return number;
+    }
+
+    std::map<GLuint, unsigned int> programs_, textures_, vaos_;
+};
+
+struct Recorded
+{
+    unsigned long long key;
+    int id;
+};
+
+bool keyLess(const Recorded & a, const Recorded & b)
+{
+    return a.key < b.key;
+}
+
+// Ids of the instanced draws in the order submit made them; each command
+// carries its id in base_vertex
+std::vector<int> submittedIds()
+{
+    std::vector<int> ids;
+    const std::vector<MockGLCall> & calls = mockGLCalls();
+    for (size_t i = 0; i < calls.size(); i++)
+        if (strcmp(calls[i].name, "DrawElementsInstancedBaseVertex") == 0)
+            ids.push_back((int)calls[i].args[4]);
+    return ids;
+}
+
+RenderCommand instanced(GLuint program, GLuint texture, GLuint vao, int id)
+{
+    RenderCommand command;
+    command.program = program;
+    command.texture_target = texture ? GL_TEXTURE_2D : 0;
+    command.texture = texture;
+    command.vao = vao;
+    command.index_count = 3;
+    command.instance_count = 1;
+    command.base_vertex = id;
+    return command;
+}
+
+// Records the commands in queue and model, submits and compares the
+// order with the stable sort of the model's keys
+void checkOrder(RenderQueue & queue, KeyModel & model, const std::vector<RenderCommand> & commands,
+    const std::vector<float> & depths)
+{
+    queue.clear();
+    std::vector<Recorded> expected;
+    for (size_t i = 0; i < commands.size(); i++) {
+        queue.record(commands[i], depths[i]);
+        Recorded recorded = { model.key(commands[i], depths[i]), commands[i].base_vertex };
+        expected.push_back(recorded);
+    }
+    std::stable_sort(expected.begin(), expected.end(), keyLess);
+
+    resetMockGL();
+    GLStateCache state;
+    CHECK(queue.submit(state) == commands.size());
+    std::vector<int> ids = submittedIds();
+    CHECK(ids.size() == expected.size());
+    bool same = ids.size() == expected.size();
+    for (size_t i = 0; same && i < ids.size(); i++)
+        same = ids[i] == expected[i].id;
+    CHECK(same);
+}
+
+void testRandomOrder()
+{
+    // Random state and depth; few distinct values so keys tie often
+    RenderQueue queue;
+    KeyModel model;
+    const size_t sizes[] = { 0, 1, 2, 3, 50, 1000 };
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+        for (int frame = 0; frame < 5; frame++) {
+            std::vector<RenderCommand> commands;
+            std::vector<float> depths;
+            for (size_t i = 0; i < sizes[s]; i++) {
+                commands.push_back(instanced(1 + randomInt(4), randomInt(6), 10 + randomInt(3), (int)i));
+                depths.push_back(randomInt(8) / 7.0f - 0.1f);
+            }
+            checkOrder(queue, model, commands, depths);
+        }
+}
+
+void testSkippedPasses()
+{
+    // Only depth differs: the state bytes are skipped, depth alone sorts
+    RenderQueue queue;
+    KeyModel model;
+    std::vector<RenderCommand> commands;
+    std::vector<float> depths;
+    for (int i = 0; i < 300; i++) {
+        commands.push_back(instanced(1, 2, 3, i));
+        depths.push_back(randomInt(1000) / 999.0f);
+    }
+    checkOrder(queue, model, commands, depths);
+
+    // Depths close enough to differ in the lowest key bytes only
+    for (int i = 0; i < 300; i++)
+        depths[i] = randomInt(1000) / (float)((1u << 24) - 1);
+    checkOrder(queue, model, commands, depths);
+
+    // Every key the same: no pass at all, the recording order stays
+    for (int i = 0; i < 300; i++)
+        depths[i] = 0.5f;
+    checkOrder(queue, model, commands, depths);
+
+    // Only the top byte differs: every other pass is skipped
+    for (int i = 0; i < 300; i++)
+        commands[i].program = 1 + randomInt(7);
+    checkOrder(queue, model, commands, depths);
+
+    // Bytes from the bottom, the middle and the top of the key
+    for (int i = 0; i < 300; i++) {
+        commands[i].vao = 3 + randomInt(2);
+        depths[i] = randomInt(3) / 2.0f;
+    }
+    checkOrder(queue, model, commands, depths);
+}
+
+void testSlotWrap()
+{
+    // The vao field holds 256 numbers; the 257th vao starts the numbering
+    // over, the vaos seen before it are numbered again as they come
+    RenderQueue queue;
+    KeyModel model;
+    std::vector<RenderCommand> commands;
+    std::vector<float> depths;
+    for (int i = 0; i < 257; i++) {
+        commands.push_back(instanced(1, 0, 1000 + i, i));
+        depths.push_back(0.0f);
+    }
+    checkOrder(queue, model, commands, depths);
+    std::vector<int> ids = submittedIds();
+    CHECK(ids.size() == 257 && ids[0] == 0 && ids[1] == 256 && ids[2] == 1 && ids[256] == 255);
+
+    // Next frame in reverse: the last vao kept number 0, the rest are
+    // numbered in the new recording order until the first vao starts the
+    // numbering over again
+    std::reverse(commands.begin(), commands.end());
+    checkOrder(queue, model, commands, depths);
+    ids = submittedIds();
+    CHECK(ids.size() == 257 && ids[0] == 256 && ids[1] == 0 && ids[2] == 255 && ids[256] == 1);
+
+    // Textures wrap at 65536 the same way
+    RenderQueue texture_queue;
+    KeyModel texture_model;
+    commands.clear();
+    depths.clear();
+    for (int i = 0; i < 65537; i++) {
+        commands.push_back(instanced(1, 1 + i, 1, i));
+        depths.push_back(0.0f);
+    }
+    checkOrder(texture_queue, texture_model, commands, depths);
+    ids = submittedIds();
+    CHECK(ids.size() == 65537 && ids[0] == 0 && ids[1] == 65536 && ids[2] == 1);
+}
+
+void testSubmitState()
+{
+    // Two programs, two textures interleaved: sorted, each binding is made
+    // once per run and the rest are skipped
+    RenderQueue queue;
+    for (int i = 0; i < 8; i++)
+        queue.record(instanced(1 + i % 2, 5 + i / 2 % 2, 9, i));
+    resetMockGL();
+    GLStateCache state;
+    CHECK(queue.submit(state) == 8);
+    const GLStateStats & stats = state.stats();
+    CHECK(stats.issued[STATE_PROGRAM] == 2 && stats.skipped[STATE_PROGRAM] == 6);
+    CHECK(stats.issued[STATE_TEXTURE] == 4 && stats.skipped[STATE_TEXTURE] == 4);
+    // The vao once, and unbound at the end
+    CHECK(stats.issued[STATE_VERTEX_ARRAY] == 2 && stats.skipped[STATE_VERTEX_ARRAY] == 7);
+    CHECK(mockGLCount("UseProgram") == 2 && mockGLCount("BindTexture") == 4 && mockGLCount("BindVertexArray") == 2);
+    CHECK(mockGLCalls().back().args[0] == 0);
+
+    // A multi-draw run, as one indirect call and one by one
+    DrawElementsIndirectCommand draws[3] = {
+        { 3, 1, 0, 0, 0 }, { 6, 2, 3, 10, 1 }, { 9, 1, 9, 20, 3 }
+    };
+    RenderCommand multi;
+    multi.type = RENDER_MULTI_DRAW;
+    multi.program = 1;
+    multi.vao = 9;
+    multi.index_type = GL_UNSIGNED_INT;
+    multi.indirect_buffer = 44;
+    multi.commands = draws;
+    multi.first = 1;
+    multi.count = 2;
+    queue.clear();
+    queue.record(multi);
+    resetMockGL();
+    CHECK(queue.submit(state) == 1);
+    CHECK(mockGLCount("MultiDrawElementsIndirect") == 1);
+    const std::vector<MockGLCall> & calls = mockGLCalls();
+    for (size_t i = 0; i < calls.size(); i++)
+        if (strcmp(calls[i].name, "MultiDrawElementsIndirect") == 0)
+            CHECK(calls[i].args[2] == (long long)sizeof(DrawElementsIndirectCommand) && calls[i].args[3] == 2);
+
+    resetMockGL();
+    CHECK(queue.submit(state, false) == 2);
+    CHECK(mockGLCount("DrawElementsInstancedBaseVertexBaseInstance") == 2);
+    for (size_t i = 0; i < calls.size(); i++)
+        if (strcmp(calls[i].name, "DrawElementsInstancedBaseVertexBaseInstance") == 0) {
+            bool second = calls[i].args[0] == 6;
+            CHECK(calls[i].args[1] == (second ? 3 * 4 : 9 * 4));
+            CHECK(calls[i].args[3] == (second ? 10 : 20) && calls[i].args[4] == (second ? 1 : 3));
+        }
+}
+
+void testStateCache()
+{
+    resetMockGL();
+    GLStateCache state;
+    state.useProgram(3);
+    state.useProgram(3);
+    state.useProgram(4);
+    CHECK(state.stats().issued[STATE_PROGRAM] == 2 && state.stats().skipped[STATE_PROGRAM] == 1);
+    CHECK(mockGLCount("UseProgram") == 2);
+
+    // The element buffer belongs to the vao: changing the vao forgets it,
+    // binding the same vao again doesn't
+    state.bindVertexArray(1);
+    state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 5);
+    state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 5);
+    CHECK(mockGLCount("BindBuffer") == 1);
+    state.bindVertexArray(1);
+    state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 5);
+    CHECK(mockGLCount("BindBuffer") == 1);
+    state.bindVertexArray(2);
+    state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 5);
+    CHECK(mockGLCount("BindBuffer") == 2);
+    CHECK(state.stats().issued[STATE_VERTEX_ARRAY] == 2 && state.stats().skipped[STATE_VERTEX_ARRAY] == 1);
+    // Other buffer targets are not the vao's
+    state.bindBuffer(GL_ARRAY_BUFFER, 6);
+    state.bindVertexArray(1);
+    state.bindBuffer(GL_ARRAY_BUFFER, 6);
+    CHECK(mockGLCount("BindBuffer") == 3);
+
+    // An indexed bind moves the generic binding of its target too
+    state.bindBuffer(GL_UNIFORM_BUFFER, 7);
+    state.bindBufferBase(GL_UNIFORM_BUFFER, 0, 8);
+    state.bindBufferBase(GL_UNIFORM_BUFFER, 0, 8);
+    state.bindBuffer(GL_UNIFORM_BUFFER, 7);
+    CHECK(mockGLCount("BindBuffer") == 5 && mockGLCount("BindBufferBase") == 1);
+
+    // Ranges differ by offset and size; a whole buffer isn't a range of it
+    state.bindBufferRange(GL_UNIFORM_BUFFER, 1, 8, 0, 256);
+    state.bindBufferRange(GL_UNIFORM_BUFFER, 1, 8, 0, 256);
+    state.bindBufferRange(GL_UNIFORM_BUFFER, 1, 8, 256, 256);
+    state.bindBufferRange(GL_UNIFORM_BUFFER, 1, 8, 256, 128);
+    state.bindBufferBase(GL_UNIFORM_BUFFER, 1, 8);
+    CHECK(mockGLCount("BindBufferRange") == 3 && mockGLCount("BindBufferBase") == 2);
+
+    // Texture targets are separate
+    state.bindTexture(GL_TEXTURE_2D, 1);
+    state.bindTexture(GL_TEXTURE_2D_ARRAY, 1);
+    state.bindTexture(GL_TEXTURE_2D, 1);
+    CHECK(state.stats().issued[STATE_TEXTURE] == 2 && state.stats().skipped[STATE_TEXTURE] == 1);
+
+    unsigned long long issued = state.stats().issued[STATE_BUFFER];
+    unsigned long long skipped = state.stats().skipped[STATE_BUFFER];
+    CHECK(issued == (unsigned long long)(mockGLCount("BindBuffer") + mockGLCount("BindBufferBase") + mockGLCount("BindBufferRange")));
+    CHECK(skipped == 5);
+
+    // After invalidate everything reaches GL again
+    state.invalidate();
+    resetMockGL();
+    state.useProgram(4);
+    state.bindVertexArray(1);
+    state.bindTexture(GL_TEXTURE_2D, 1);
+    state.bindBuffer(GL_ARRAY_BUFFER, 6);
+    CHECK(mockGLCalls().size() == 4);
+
+    state.resetStats();
+    for (int k = 0; k < STATE_KINDS; k++)
+        CHECK(state.stats().issued[k] == 0 && state.stats().skipped[k] == 0);
+}
+
+} // namespace
+
+int main()
+{
+    testRandomOrder();
+    testSkippedPasses();
+    testSlotWrap();
+    testSubmitState();
+    testStateCache();
+    return testResult("renderqueue");
+}
@@ -0,0 +1,182 @@
+#include <stdio.h>
+
+#include <vector>
+
+#include "check.h"
+#include "resourcecache.h"
+
+namespace {
+
+// Records what the cache releases instead of deleting GL objects
+class MockBackend : public ResourceBackend
+{
+public:
+    virtual void release(const Resource & resource) { released.push_back(resource.hash); }
+    std::vector<unsigned long long> released;
+};
+
+Resource texture(unsigned long long hash, size_t gpu_bytes, size_t cpu_bytes = 10)
+{
+    Resource resource;
+    resource.type = RESOURCE_TEXTURE;
+    resource.hash = hash;
+    resource.name = (GLuint)hash;
+    resource.arena = NULL;
+    resource.cpu_bytes = cpu_bytes;
+    resource.gpu_bytes = gpu_bytes;
+    return resource;
+}
+
+void testRefcount()
+{
+    MockBackend backend;
+    ResourceCache cache;
+    cache.create(backend, 1000, 1000);
+
+    ResourceHandle a = cache.insert(texture(1, 100));
+    CHECK(a && a->hash == 1);
+    CHECK(cache.stats().entries == 1 && cache.stats().referenced == 1);
+
+    // Every handle to an entry is the same one
+    ResourceHandle b = cache.find(RESOURCE_TEXTURE, 1);
+    CHECK(b.get() == a.get());
+    CHECK(cache.stats().referenced == 1);
+    CHECK(!cache.find(RESOURCE_MESH, 1));
+    CHECK(!cache.find(RESOURCE_TEXTURE, 2));
+    CHECK(cache.stats().hits == 1 && cache.stats().misses == 2);
+
+    // Unreferenced, but within budget it stays
+    a.reset();
+    CHECK(cache.stats().referenced == 1);
+    b.reset();
+    CHECK(cache.stats().referenced == 0);
+    CHECK(cache.stats().entries == 1);
+    CHECK(backend.released.empty());
+
+    // And comes back as the same resource
+    ResourceHandle again = cache.find(RESOURCE_TEXTURE, 1);
+    CHECK(again && again->name == 1);
+    CHECK(cache.stats().referenced == 1);
+
+    // The same content inserted again keeps the first copy
+    Resource copy = texture(1, 100);
+    copy.name = 77;
+    ResourceHandle duplicate = cache.insert(copy);
+    CHECK(duplicate.get() == again.get());
+    CHECK(backend.released.size() == 1 && backend.released[0] == 1);
+    CHECK(cache.stats().entries == 1 && cache.stats().gpu_bytes == 100);
+
+    cache.clear();
+}
+
+void testLruOrder()
+{
+    MockBackend backend;
+    ResourceCache cache;
+    cache.create(backend, 1000, 1000);
+    ResourceHandle handles[4];
+    for (int i = 0; i < 4; i++)
+        handles[i] = cache.insert(texture(i + 1, 100));
+
+    // Released 3, 1, 4, 2; 1 is taken again and goes to the back of the line
+    handles[2].reset();
+    handles[0].reset();
+    handles[3].reset();
+    handles[1].reset();
+    ResourceHandle again = cache.find(RESOURCE_TEXTURE, 1);
+    again.reset();
+
+    cache.setBudget(1000, 300);
+    CHECK(backend.released.size() == 1 && backend.released[0] == 3);
+    cache.setBudget(1000, 100);
+    CHECK(backend.released.size() == 3 && backend.released[1] == 4 && backend.released[2] == 2);
+    cache.setBudget(1000, 0);
+    CHECK(backend.released.size() == 4 && backend.released[3] == 1);
+    CHECK(cache.stats().evictions == 4);
+    CHECK(cache.stats().entries == 0 && cache.stats().gpu_bytes == 0 && cache.stats().cpu_bytes == 0);
+}
+
+void testBudget()
+{
+    MockBackend backend;
+    ResourceCache cache;
+    cache.create(backend, 1000, 250);
+
+    // Referenced entries stay even over budget
+    ResourceHandle a = cache.insert(texture(1, 100));
+    ResourceHandle b = cache.insert(texture(2, 100));
+    ResourceHandle c = cache.insert(texture(3, 100));
+    CHECK(cache.stats().gpu_bytes == 300);
+    CHECK(backend.released.empty());
+
+    // Released over budget, evicted on the spot
+    b.reset();
+    CHECK(backend.released.size() == 1 && backend.released[0] == 2);
+    CHECK(cache.stats().gpu_bytes == 200);
+
+    // Released within budget, kept until an insert needs the room
+    a.reset();
+    CHECK(backend.released.size() == 1);
+    ResourceHandle d = cache.insert(texture(4, 100));
+    CHECK(backend.released.size() == 2 && backend.released[1] == 1);
+    CHECK(cache.stats().gpu_bytes == 200);
+
+    // The CPU budget counts as well
+    cache.setBudget(15, 1000);
+    c.reset();
+    CHECK(backend.released.size() == 3 && backend.released[2] == 3);
+    CHECK(cache.stats().cpu_bytes == 10);
+
+    // Evicted content is a miss and loads again
+    CHECK(!cache.find(RESOURCE_TEXTURE, 1));
+    cache.resetCounters();
+    CHECK(cache.stats().misses == 0 && cache.stats().evictions == 0);
+
+    // Clearing under a live handle releases it once, dropping it later is
+    // harmless
+    cache.clear();
+    CHECK(backend.released.size() == 4 && backend.released[3] == 4);
+    d.reset();
+    CHECK(backend.released.size() == 4);
+    CHECK(cache.stats().entries == 0 && cache.stats().referenced == 0);
+}
+
+void testFindPath()
+{
+    const char * path = "resourcecache_test.bin";
+    FILE * file = fopen(path, "wb");
+    CHECK(file != NULL);
+    if (!file)
+        return;
+    fputs("texels", file);
+    fclose(file);
+
+    MockBackend backend;
+    ResourceCache cache;
+    cache.create(backend, 1000, 1000);
+    ResourceHandle a = cache.insert(texture(1, 100), path);
+    CHECK(cache.findPath(RESOURCE_TEXTURE, path).get() == a.get());
+    CHECK(!cache.findPath(RESOURCE_MESH, path));
+
+    // Another size is another file, the path has to be hashed again
+    file = fopen(path, "ab");
+    fputs(" and more", file);
+    fclose(file);
+    CHECK(!cache.findPath(RESOURCE_TEXTURE, path));
+    CHECK(cache.find(RESOURCE_TEXTURE, 1, path).get() == a.get());
+    CHECK(cache.findPath(RESOURCE_TEXTURE, path).get() == a.get());
+
+    cache.clear();
+    remove(path);
+}
+
+} // namespace
+
+int main()
+{
+    testRefcount();
+    testLruOrder();
+    testBudget();
+    testFindPath();
+    return testResult("resourcecache");
+}
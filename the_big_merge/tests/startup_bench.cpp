@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#endif
+
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "blockcompress.h"
+#include "meshcache.h"
+#include "meshopt.h"
+#include "objloader.h"
+
+// startup_bench [grid [texture]]: loading a grid x grid quad OBJ (128 by
+// default) and a texture x texture BMP (1024) the way the asset loader
+// does, cold with no caches, after the sources were touched (the caches
+// are hashed once and restamped) and warm
+
+namespace {
+
+const char * OBJ_PATH = "startup_bench.obj";
+const char * BMP_PATH = "startup_bench.bmp";
+
+bool writeGrid(unsigned int grid)
+{
+    FILE * file = fopen(OBJ_PATH, "wb");
+    if (!file)
+        return false;
+    for (unsigned int y = 0; y <= grid; y++)
+        for (unsigned int x = 0; x <= grid; x++)
+            fprintf(file, "v %f %f %f\nvt %f %f\nvn 0 1 0\n", (float)x, 0.1f * (float)((x * y) % 7), (float)y,
+                (float)x / grid, (float)y / grid);
+    for (unsigned int y = 0; y < grid; y++)
+        for (unsigned int x = 0; x < grid; x++) {
+            unsigned int a = y * (grid + 1) + x + 1, b = a + 1, c = a + grid + 1, d = c + 1;
+            fprintf(file, "f %u/%u/1 %u/%u/1 %u/%u/1\nf %u/%u/1 %u/%u/1 %u/%u/1\n",
+                a, a, c, c, b, b, b, b, c, c, d, d);
+        }
+    return fclose(file) == 0;
+}
+
+bool writeBMP(unsigned int size)
+{
+    size_t row = (size * 3 + 3) & ~(size_t)3;
+    std::vector<unsigned char> bytes(54 + row * size, 0);
+    unsigned int header[] = { (unsigned int)bytes.size(), 0, 54, 40, size, size };
+    bytes[0] = 'B';
+    bytes[1] = 'M';
+    memcpy(&bytes[2], header, sizeof(header));
+    unsigned short planes_bpp[] = { 1, 24 };
+    memcpy(&bytes[0x1A], planes_bpp, sizeof(planes_bpp));
+    for (unsigned int y = 0; y < size; y++)
+        for (unsigned int x = 0; x < size; x++) {
+            unsigned char * p = &bytes[54 + row * y + x * 3];
+            p[0] = (unsigned char)x;
+            p[1] = (unsigned char)(y * 3);
+            p[2] = (unsigned char)((x ^ y) * 5);
+        }
+    FILE * file = fopen(BMP_PATH, "wb");
+    if (!file)
+        return false;
+    bool ok = fwrite(&bytes[0], 1, bytes.size(), file) == bytes.size();
+    return fclose(file) == 0 && ok;
+}
+
+void touch(const char * path)
+{
+    unsigned long long size;
+    long long mtime;
+    statFile(path, size, mtime);
+    struct utimbuf times;
+    times.actime = (time_t)(mtime + 10);
+    times.modtime = (time_t)(mtime + 10);
+    utime(path, &times);
+}
+
+// What the asset loader does for a mesh: the cache, or everything
+bool loadMesh(std::vector<PackedTexturedVertex> & vertices)
+{
+    std::string cache_path = meshCachePath(OBJ_PATH);
+    CachedMesh cached;
+    if (cached.open(cache_path.c_str(), OBJ_PATH)) {
+        vertices.assign(cached.vertices(), cached.vertices() + cached.header().vertex_count);
+        return true;
+    }
+    IndexedMesh mesh;
+    if (!loadOBJIndexed(OBJ_PATH, mesh, 1) || mesh.vertices.empty())
+        return false;
+    optimizeMesh(mesh, OBJ_PATH);
+    std::vector<MeshLod> lods;
+    buildLodChain(mesh.indices, &mesh.vertices[0].position.x, mesh.vertices.size(),
+        sizeof(MeshVertex) / sizeof(float), lods, OBJ_PATH);
+    return writeMeshCache(cache_path.c_str(), OBJ_PATH, mesh, lods);
+}
+
+void measure(const char * name)
+{
+    std::vector<PackedTexturedVertex> vertices;
+    ImageData image;
+    double mesh = benchBest(1, [&]() { loadMesh(vertices); });
+    double texture = benchBest(1, [&]() { decodeBMPCompressed(BMP_PATH, BLOCK_BC1, image); });
+    printf("%-8s %10.2f %12.2f\n", name, mesh * 1000, texture * 1000);
+}
+
+} // namespace
+
+int main(int argc, char ** argv)
+{
+    unsigned int grid = (unsigned int)benchArg(argc, argv, 1, 128);
+    unsigned int texture = (unsigned int)benchArg(argc, argv, 2, 1024);
+    if (!writeGrid(grid) || !writeBMP(texture)) {
+        printf("Can't write the sources\n");
+        return 1;
+    }
+    remove(meshCachePath(OBJ_PATH).c_str());
+    remove(textureCachePath(BMP_PATH).c_str());
+
+    printf("%-8s %10s %12s\n", "", "mesh ms", "texture ms");
+    measure("cold");
+    touch(OBJ_PATH);
+    touch(BMP_PATH);
+    measure("touched");
+    measure("warm");
+
+    remove(meshCachePath(OBJ_PATH).c_str());
+    remove(textureCachePath(BMP_PATH).c_str());
+    remove(OBJ_PATH);
+    remove(BMP_PATH);
+    return 0;
+}
@@ -0,0 +1,276 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "check.h"
+#include "texture.h"
+
+namespace {
+
+const char * IMAGE_PATH = "texture_test.img";
+
+typedef std::vector<unsigned char> Bytes;
+
+void putU32(Bytes & bytes, size_t at, unsigned int value)
+{
+    memcpy(&bytes[at], &value, 4);
+}
+
+void putU16(Bytes & bytes, size_t at, unsigned short value)
+{
+    memcpy(&bytes[at], &value, 2);
+}
+
+bool writeBytes(const Bytes & bytes)
+{
+    FILE * file = fopen(IMAGE_PATH, "wb");
+    if (!file)
+        return false;
+    bool ok = bytes.empty() || fwrite(&bytes[0], 1, bytes.size(), file) == bytes.size();
+    return fclose(file) == 0 && ok;
+}
+
+bool decodeBMPBytes(const Bytes & bytes, ImageData & image)
+{
+    CHECK(writeBytes(bytes));
+    return decodeBMP(IMAGE_PATH, image);
+}
+
+bool decodeDDSBytes(const Bytes & bytes, ImageData & image)
+{
+    CHECK(writeBytes(bytes));
+    return decodeDDS(IMAGE_PATH, image);
+}
+
+// BITMAPINFOHEADER BMP, pixel (x, y) of file row y is (x, y, x + y)
+Bytes makeBMP(int width, int height, unsigned int bpp)
+{
+    unsigned int rows = height < 0 ? -height : height;
+    size_t row = ((size_t)width * (bpp / 8) + 3) & ~(size_t)3;
+    Bytes bytes(54 + row * rows, 0);
+    bytes[0] = 'B';
+    bytes[1] = 'M';
+    putU32(bytes, 0x02, (unsigned int)bytes.size());
+    putU32(bytes, 0x0A, 54);
+    putU32(bytes, 0x0E, 40);
+    putU32(bytes, 0x12, (unsigned int)width);
+    putU32(bytes, 0x16, (unsigned int)height);
+    putU16(bytes, 0x1A, 1);
+    putU16(bytes, 0x1C, (unsigned short)bpp);
+    for (unsigned int y = 0; y < rows; y++)
+        for (int x = 0; x < width; x++) {
+            unsigned char * p = &bytes[54 + row * y + (size_t)x * (bpp / 8)];
+            p[0] = (unsigned char)x;
+            p[1] = (unsigned char)y;
+            p[2] = (unsigned char)(x + y);
+            if (bpp == 32)
+                p[3] = 200;
+        }
+    return bytes;
+}
+
+// DXT1 DDS with levels mip levels, the blocks numbered by byte
+Bytes makeDDS(unsigned int width, unsigned int height, unsigned int levels)
+{
+    size_t total = 0;
+    for (unsigned int l = 0, w = width, h = height; l < levels; l++, w = w > 1 ? w / 2 : 1, h = h > 1 ? h / 2 : 1)
+        total += (size_t)((w + 3) / 4) * ((h + 3) / 4) * 8;
+    Bytes bytes(128 + total, 0);
+    memcpy(&bytes[0], "DDS ", 4);
+    putU32(bytes, 4, 124);
+    putU32(bytes, 4 + 8, height);
+    putU32(bytes, 4 + 12, width);
+    putU32(bytes, 4 + 24, levels);
+    putU32(bytes, 4 + 72, 32);
+    putU32(bytes, 4 + 76, 0x4);
+    memcpy(&bytes[4 + 80], "DXT1", 4);
+    for (size_t i = 128; i < bytes.size(); i++)
+        bytes[i] = (unsigned char)i;
+    return bytes;
+}
+
+void testBMPValid()
+{
+    // Bottom-up 24 bpp is used from the mapping, padding and all
+    ImageData image;
+    Bytes bytes = makeBMP(5, 3, 24);
+    CHECK(decodeBMPBytes(bytes, image));
+    CHECK(image.width == 5 && image.height == 3 && image.format == GL_BGR && !image.compressed);
+    CHECK(image.file && imageBytes(image) == 16 * 3);
+    CHECK(memcmp(imagePixels(image), &bytes[54], 16 * 3) == 0);
+
+    // Top-down rows come out bottom-up
+    image = ImageData();
+    CHECK(decodeBMPBytes(makeBMP(5, -3, 24), image));
+    CHECK(!image.file && image.height == 3);
+    const unsigned char * pixels = imagePixels(image);
+    CHECK(pixels[0] == 0 && pixels[1] == 2 && pixels[16 * 2 + 3] == 1 && pixels[16 * 2 + 4] == 0);
+
+    // 32 bpp without an alpha mask drops the padding byte
+    image = ImageData();
+    CHECK(decodeBMPBytes(makeBMP(3, 2, 32), image));
+    CHECK(image.format == GL_BGR && imageBytes(image) == 12 * 2);
+    pixels = imagePixels(image);
+    CHECK(pixels[3] == 1 && pixels[4] == 0 && pixels[5] == 1);
+
+    // A V3 header with an alpha mask keeps it
+    Bytes masked = makeBMP(3, 2, 32);
+    masked.insert(masked.begin() + 54, 16, 0);
+    putU32(masked, 0x0A, 70);
+    putU32(masked, 0x0E, 56);
+    putU32(masked, 0x1E, 3);
+    putU32(masked, 0x36, 0x00ff0000);
+    putU32(masked, 0x3A, 0x0000ff00);
+    putU32(masked, 0x3E, 0x000000ff);
+    putU32(masked, 0x42, 0xff000000);
+    image = ImageData();
+    CHECK(decodeBMPBytes(masked, image));
+    CHECK(image.format == GL_BGRA && image.file);
+    CHECK(imagePixels(image)[3] == 200);
+}
+
+void testBMPTruncated()
+{
+    Bytes good = makeBMP(7, 5, 24);
+    for (size_t length = 0; length < good.size(); length++) {
+        ImageData image;
+        CHECK(!decodeBMPBytes(Bytes(good.begin(), good.begin() + length), image));
+    }
+    Bytes empty;
+    ImageData image;
+    CHECK(!decodeBMPBytes(empty, image));
+    CHECK(!decodeBMP("texture_test_missing.bmp", image));
+}
+
+void testBMPSizes()
+{
+    const int sizes[][2] = {
+        { 0, 4 }, { 4, 0 }, { -4, 4 }, { 16385, 1 }, { 1, 16385 }, { 1, -16385 },
+        { 16384, 16384 }, { 0x7fffffff, 1 }, { 1, (int)0x80000000 }
+    };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        // The header claims the size, the file holds 4x4 pixels
+        Bytes bytes = makeBMP(4, 4, 24);
+        putU32(bytes, 0x12, (unsigned int)sizes[i][0]);
+        putU32(bytes, 0x16, (unsigned int)sizes[i][1]);
+        ImageData image;
+        CHECK(!decodeBMPBytes(bytes, image));
+    }
+
+    Bytes bytes = makeBMP(4, 4, 24);
+    putU16(bytes, 0x1C, 16);
+    ImageData image;
+    CHECK(!decodeBMPBytes(bytes, image));
+    bytes = makeBMP(4, 4, 24);
+    putU32(bytes, 0x1E, 1);             // RLE8
+    CHECK(!decodeBMPBytes(bytes, image));
+}
+
+void testBMPOffsets()
+{
+    // Pixel data past the end, inside the header, or with too few rows
+    // after it; an info header bigger than the file
+    const unsigned int data_positions[] = { 0xffffffff, 1000, 20, 53, 54 + 16 + 1 };
+    for (size_t i = 0; i < sizeof(data_positions) / sizeof(data_positions[0]); i++) {
+        Bytes bytes = makeBMP(4, 4, 24);
+        putU32(bytes, 0x0A, data_positions[i]);
+        ImageData image;
+        CHECK(!decodeBMPBytes(bytes, image));
+    }
+    const unsigned int info_sizes[] = { 0, 39, 1000, 0xffffffff };
+    for (size_t i = 0; i < sizeof(info_sizes) / sizeof(info_sizes[0]); i++) {
+        Bytes bytes = makeBMP(4, 4, 24);
+        putU32(bytes, 0x0E, info_sizes[i]);
+        ImageData image;
+        CHECK(!decodeBMPBytes(bytes, image));
+    }
+
+    // Bit fields whose masks would be past the end of the file
+    Bytes bytes = makeBMP(1, 1, 32);
+    putU32(bytes, 0x1E, 3);
+    bytes.resize(56);
+    ImageData image;
+    CHECK(!decodeBMPBytes(bytes, image));
+
+    // A missing offset is guessed as right after the header
+    bytes = makeBMP(4, 4, 24);
+    putU32(bytes, 0x0A, 0);
+    CHECK(decodeBMPBytes(bytes, image));
+    CHECK(image.mapped == (const unsigned char *)image.file->data() + 54);
+}
+
+void testDDSValid()
+{
+    ImageData image;
+    Bytes bytes = makeDDS(8, 8, 4);
+    CHECK(decodeDDSBytes(bytes, image));
+    CHECK(image.width == 8 && image.height == 8 && image.compressed);
+    CHECK(image.format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT);
+    CHECK(image.levels.size() == 4);
+    CHECK(image.levels[1].offset == 32 && image.levels[3].offset == 48 && imageBytes(image) == 56);
+    CHECK(image.file && memcmp(imagePixels(image), &bytes[128], 56) == 0);
+
+    // No mip count means one level, extra bytes at the end are ignored
+    bytes = makeDDS(5, 3, 1);
+    putU32(bytes, 4 + 24, 0);
+    bytes.resize(bytes.size() + 100);
+    CHECK(decodeDDSBytes(bytes, image));
+    CHECK(image.levels.size() == 1 && imageBytes(image) == 2 * 1 * 8);
+}
+
+void testDDSTruncated()
+{
+    Bytes good = makeDDS(16, 8, 5);
+    for (size_t length = 0; length < good.size(); length++) {
+        ImageData image;
+        CHECK(!decodeDDSBytes(Bytes(good.begin(), good.begin() + length), image));
+    }
+}
+
+void testDDSHeader()
+{
+    // Sizes: none, past GL's limit, one that needs more bytes than there are
+    const unsigned int sizes[][2] = { { 0, 8 }, { 8, 0 }, { 16385, 8 }, { 8, 16385 }, { 0xffffffff, 8 }, { 16384, 16384 } };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        Bytes bytes = makeDDS(8, 8, 1);
+        putU32(bytes, 4 + 12, sizes[i][0]);
+        putU32(bytes, 4 + 8, sizes[i][1]);
+        ImageData image;
+        CHECK(!decodeDDSBytes(bytes, image));
+    }
+
+    // More levels than 8x8 has, down to a count that would overflow
+    const unsigned int level_counts[] = { 5, 32, 0xffffffff };
+    for (size_t i = 0; i < sizeof(level_counts) / sizeof(level_counts[0]); i++) {
+        Bytes bytes = makeDDS(8, 8, 4);
+        putU32(bytes, 4 + 24, level_counts[i]);
+        ImageData image;
+        CHECK(!decodeDDSBytes(bytes, image));
+    }
+
+    // Wrong magic, header sizes, no fourCC, a format that isn't DXT1/3/5
+    const size_t fields[] = { 0, 4, 4 + 72, 4 + 76, 4 + 80 };
+    const unsigned int values[] = { 0x20534444 + 1, 100, 24, 0x40, 0x32545844 };
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        Bytes bytes = makeDDS(8, 8, 4);
+        putU32(bytes, fields[i], values[i]);
+        ImageData image;
+        CHECK(!decodeDDSBytes(bytes, image));
+    }
+}
+
+} // namespace
+
+int main()
+{
+    testBMPValid();
+    testBMPTruncated();
+    testBMPSizes();
+    testBMPOffsets();
+    testDDSValid();
+    testDDSTruncated();
+    testDDSHeader();
+    remove(IMAGE_PATH);
+    return testResult("texture");
+}
@@ -0,0 +1,282 @@
+#include <math.h>
+#include <stdio.h>
+
+#include <random>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "check.h"
+#include "jobsystem.h"
+#include "transform.h"
+
+namespace {
+
+std::mt19937 random_engine(31);
+
+float randomFloat(float low, float high)
+{
+    return std::uniform_real_distribution<float>(low, high)(random_engine);
+}
+
+glm::mat4 randomLocal()
+{
+    glm::vec3 axis = glm::normalize(glm::vec3(randomFloat(-1, 1), randomFloat(-1, 1), randomFloat(0.1f, 1)));
+    glm::mat4 local = glm::translate(glm::mat4(1.0f), glm::vec3(randomFloat(-5, 5), randomFloat(-5, 5), randomFloat(-5, 5)));
+    local = glm::rotate(local, randomFloat(-3.0f, 3.0f), axis);
+    return glm::scale(local, glm::vec3(randomFloat(0.5f, 1.5f)));
+}
+
+glm::mat4 randomView()
+{
+    return glm::lookAt(glm::vec3(randomFloat(-20, 20), randomFloat(-20, 20), randomFloat(-20, 20)),
+        glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+// World matrix by walking up the parents, with the same products the
+// hierarchy does top down
+glm::mat4 expectedWorld(const TransformHierarchy & transforms, TransformId id)
+{
+    TransformId parent = transforms.parent(id);
+    return parent == NO_TRANSFORM ? transforms.local(id) : expectedWorld(transforms, parent) * transforms.local(id);
+}
+
+bool near(const glm::mat4 & a, const glm::mat4 & b)
+{
+    // Batched products may be fused, so mv only matches to rounding
+    for (int c = 0; c < 4; c++)
+        for (int r = 0; r < 4; r++)
+            if (fabsf(a[c][r] - b[c][r]) > 1e-4f * (1.0f + fabsf(b[c][r])))
+                return false;
+    return true;
+}
+
+void checkMatrices(const TransformHierarchy & transforms, const glm::mat4 & view)
+{
+    bool worlds = true, mvs = true;
+    for (TransformId id = 0; id < transforms.size(); id++) {
+        worlds &= transforms.world(id) == expectedWorld(transforms, id);
+        mvs &= near(transforms.mv(id), view * transforms.world(id));
+    }
+    CHECK(worlds);
+    CHECK(mvs);
+}
+
+void testSortRemap()
+{
+    // Roots and children added in an order that puts shallow nodes after
+    // deep ones; ids and parents must survive the reordering
+    TransformHierarchy transforms;
+    TransformId a = transforms.add(randomLocal());
+    TransformId b = transforms.add(randomLocal(), a);
+    TransformId c = transforms.add(randomLocal(), b);
+    TransformId d = transforms.add(randomLocal(), c);
+    TransformId e = transforms.add(randomLocal());
+    TransformId f = transforms.add(randomLocal(), e);
+    TransformId g = transforms.add(randomLocal(), a);
+    TransformId h = transforms.add(randomLocal(), d);
+    CHECK(transforms.size() == 8);
+
+    // Changed before the first update, while still out of order
+    glm::mat4 c_local = randomLocal();
+    transforms.setLocal(c, c_local);
+
+    glm::mat4 view = randomView();
+    CHECK(transforms.update(view) == 8);
+    CHECK(transforms.parent(a) == NO_TRANSFORM && transforms.parent(e) == NO_TRANSFORM);
+    CHECK(transforms.parent(b) == a && transforms.parent(c) == b && transforms.parent(d) == c);
+    CHECK(transforms.parent(f) == e && transforms.parent(g) == a && transforms.parent(h) == d);
+    CHECK(transforms.local(c) == c_local);
+    checkMatrices(transforms, view);
+
+    // More shallow nodes after a sorted update, under nodes that moved
+    TransformId i = transforms.add(randomLocal(), e);
+    TransformId j = transforms.add(randomLocal());
+    TransformId k = transforms.add(randomLocal(), h);
+    transforms.setLocal(b, randomLocal());
+    CHECK(transforms.update(view) == 3 + 4);    // the new nodes, b, c, d and h
+    CHECK(transforms.parent(i) == e && transforms.parent(j) == NO_TRANSFORM && transforms.parent(k) == h);
+    CHECK(transforms.changed(b) && transforms.changed(k) && !transforms.changed(a) && !transforms.changed(g));
+    checkMatrices(transforms, view);
+
+    transforms.clear();
+    CHECK(transforms.size() == 0);
+    TransformId again = transforms.add(randomLocal());
+    CHECK(again == 0);
+    CHECK(transforms.update(view) == 1);
+}
+
+// root, 4 children, 4 grandchildren each, 4 great grandchildren each
+struct Tree
+{
+    TransformHierarchy transforms;
+    TransformId root;
+    std::vector<TransformId> children, grandchildren, leaves;
+};
+
+void buildTree(Tree & tree)
+{
+    tree.root = tree.transforms.add(randomLocal());
+    for (int a = 0; a < 4; a++) {
+        TransformId child = tree.transforms.add(randomLocal(), tree.root);
+        tree.children.push_back(child);
+        for (int b = 0; b < 4; b++) {
+            TransformId grandchild = tree.transforms.add(randomLocal(), child);
+            tree.grandchildren.push_back(grandchild);
+            for (int c = 0; c < 4; c++)
+                tree.leaves.push_back(tree.transforms.add(randomLocal(), grandchild));
+        }
+    }
+}
+
+void testChanged()
+{
+    Tree tree;
+    buildTree(tree);
+    TransformHierarchy & transforms = tree.transforms;
+    const size_t total = 1 + 4 + 16 + 64;
+    glm::mat4 view = randomView();
+    CHECK(transforms.update(view) == total);
+
+    // Nothing changed, nothing to do
+    CHECK(transforms.update(view) == 0);
+    bool any = false;
+    for (TransformId id = 0; id < total; id++)
+        any |= transforms.changed(id);
+    CHECK(!any);
+
+    // A grandchild deep in the tree: it and its 4 leaves, nothing else
+    TransformId moved = tree.grandchildren[6];
+    transforms.setLocal(moved, randomLocal());
+    CHECK(transforms.update(view) == 5);
+    size_t changed = 0;
+    for (TransformId id = 0; id < total; id++) {
+        if (!transforms.changed(id))
+            continue;
+        changed++;
+        CHECK(id == moved || transforms.parent(id) == moved);
+    }
+    CHECK(changed == 5);
+    checkMatrices(transforms, view);
+
+    // A leaf alone, twice before one update counts once
+    transforms.setLocal(tree.leaves[40], randomLocal());
+    transforms.setLocal(tree.leaves[40], randomLocal());
+    CHECK(transforms.update(view) == 1);
+    CHECK(transforms.changed(tree.leaves[40]) && !transforms.changed(tree.leaves[41]));
+
+    // Two overlapping changes, a child and one of its grandchildren
+    transforms.setLocal(tree.children[1], randomLocal());
+    transforms.setLocal(tree.grandchildren[5], randomLocal());
+    CHECK(transforms.update(view) == 1 + 4 + 16);
+    checkMatrices(transforms, view);
+
+    // The same local again still counts as a change
+    transforms.setLocal(tree.root, transforms.local(tree.root));
+    CHECK(transforms.update(view) == total);
+    CHECK(transforms.update(view) == 0);
+}
+
+void testViewChange()
+{
+    Tree tree;
+    buildTree(tree);
+    TransformHierarchy & transforms = tree.transforms;
+    const size_t total = 1 + 4 + 16 + 64;
+    transforms.update(randomView());
+
+    // Every mv, no world
+    std::vector<glm::mat4> worlds;
+    for (TransformId id = 0; id < total; id++)
+        worlds.push_back(transforms.world(id));
+    glm::mat4 view = randomView();
+    CHECK(transforms.update(view) == total);
+    bool any = false, same_worlds = true;
+    for (TransformId id = 0; id < total; id++) {
+        any |= transforms.changed(id);
+        same_worlds &= transforms.world(id) == worlds[id];
+    }
+    CHECK(!any);
+    CHECK(same_worlds);
+    checkMatrices(transforms, view);
+
+    // View and a local together: still every mv, only the subtree's worlds
+    view = randomView();
+    transforms.setLocal(tree.leaves[3], randomLocal());
+    CHECK(transforms.update(view) == total);
+    size_t changed = 0;
+    for (TransformId id = 0; id < total; id++)
+        changed += transforms.changed(id);
+    CHECK(changed == 1);
+    checkMatrices(transforms, view);
+}
+
+// Random parents among earlier nodes, then a batch of roots and shallow
+// nodes so the hierarchy has to be sorted again
+void buildRandom(TransformHierarchy & transforms, std::vector<glm::mat4> & locals,
+    std::vector<TransformId> & parents, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        TransformId parent = NO_TRANSFORM;
+        if (i >= 10 && i < count * 9 / 10)
+            parent = (TransformId)(random_engine() % i);
+        else if (i >= count * 9 / 10)
+            parent = random_engine() % 2 ? NO_TRANSFORM : (TransformId)(random_engine() % 10);
+        locals.push_back(randomLocal());
+        parents.push_back(parent);
+        transforms.add(locals.back(), parent);
+    }
+}
+
+void testJobs(unsigned int workers)
+{
+    // Large enough for the level by level parallel update
+    const size_t count = 20000;
+    TransformHierarchy serial, parallel;
+    std::vector<glm::mat4> locals;
+    std::vector<TransformId> parents;
+    buildRandom(serial, locals, parents, count);
+    for (size_t i = 0; i < count; i++)
+        parallel.add(locals[i], parents[i]);
+
+    JobSystem jobs(workers);
+    glm::mat4 view = randomView();
+    for (int round = 0; round < 4; round++) {
+        if (round == 2)
+            view = randomView();
+        for (int change = 0; change < 50 * round; change++) {
+            TransformId id = random_engine() % count;
+            glm::mat4 local = randomLocal();
+            serial.setLocal(id, local);
+            parallel.setLocal(id, local);
+        }
+        size_t serial_updated = serial.update(view);
+        size_t parallel_updated = parallel.update(view, &jobs);
+        CHECK(serial_updated == parallel_updated);
+
+        // Worlds are the same products in the same order, mvs use the same
+        // kernel on the same batches up to their split
+        bool worlds = true, mvs = true, changed = true;
+        for (TransformId id = 0; id < count; id++) {
+            worlds &= serial.world(id) == parallel.world(id);
+            mvs &= near(serial.mv(id), parallel.mv(id));
+            changed &= serial.changed(id) == parallel.changed(id);
+        }
+        CHECK(worlds);
+        CHECK(mvs);
+        CHECK(changed);
+    }
+    checkMatrices(parallel, view);
+}
+
+} // namespace
+
+int main()
+{
+    testSortRemap();
+    testChanged();
+    testViewChange();
+    testJobs(0);
+    testJobs(3);
+    return testResult("transform");
+}
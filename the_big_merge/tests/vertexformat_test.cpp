@@ -0,0 +1,175 @@
+#include <math.h>
+
+#include <random>
+#include <vector>
+
+#include "check.h"
+#include "vertexformat.h"
+
+namespace {
+
+// Decoders as the GL spec defines them for normalized attributes
+float decodeUnorm16(unsigned short v)
+{
+    return v / 65535.0f;
+}
+
+float decodeSnorm16(short v)
+{
+    return fmaxf(v / 32767.0f, -1.0f);
+}
+
+float decodeSnorm10(unsigned int packed, int field)
+{
+    int v = (int)(packed << (22 - field * 10)) >> 22;
+    return fmaxf(v / 511.0f, -1.0f);
+}
+
+std::mt19937 random_engine(7);
+
+float randomFloat(float low, float high)
+{
+    return std::uniform_real_distribution<float>(low, high)(random_engine);
+}
+
+glm::vec3 randomUnitVector()
+{
+    for (;;) {
+        glm::vec3 v(randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f));
+        float l = glm::length(v);
+        if (l > 0.01f && l <= 1.0f)
+            return v / l;
+    }
+}
+
+void testUnorm16()
+{
+    for (int i = 0; i < 100000; i++) {
+        float v = randomFloat(0.0f, 1.0f);
+        CHECK_NEAR(decodeUnorm16(quantizeUnorm16(v)), v, 0.5f / 65535.0f + 1e-7f);
+    }
+    CHECK(quantizeUnorm16(0.0f) == 0);
+    CHECK(quantizeUnorm16(1.0f) == 65535);
+    CHECK(quantizeUnorm16(-3.0f) == 0);
+    CHECK(quantizeUnorm16(2.0f) == 65535);
+}
+
+void testSnorm16()
+{
+    for (int i = 0; i < 100000; i++) {
+        float v = randomFloat(-1.0f, 1.0f);
+        CHECK_NEAR(decodeSnorm16(quantizeSnorm16(v)), v, 0.5f / 32767.0f + 1e-7f);
+    }
+    CHECK(quantizeSnorm16(0.0f) == 0);
+    CHECK(quantizeSnorm16(1.0f) == 32767);
+    CHECK(quantizeSnorm16(-1.0f) == -32767);
+    CHECK(quantizeSnorm16(-5.0f) == -32767);
+}
+
+void testSnorm1010102()
+{
+    for (int i = 0; i < 100000; i++) {
+        glm::vec3 v(randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f));
+        unsigned int packed = quantizeSnorm1010102(v);
+        for (int c = 0; c < 3; c++)
+            CHECK_NEAR(decodeSnorm10(packed, c), v[c], 0.5f / 511.0f + 1e-6f);
+        CHECK((packed >> 30) == 0);
+    }
+    unsigned int packed = quantizeSnorm1010102(glm::vec3(1.0f, -1.0f, 0.0f));
+    CHECK(decodeSnorm10(packed, 0) == 1.0f);
+    CHECK(decodeSnorm10(packed, 1) == -1.0f);
+    CHECK(decodeSnorm10(packed, 2) == 0.0f);
+}
+
+void testOctahedral()
+{
+    // Two snorm16 bring every unit vector back within 1e-4 of itself, the
+    // worst case is about 6e-5
+    float worst = 0.0f;
+    for (int i = 0; i < 100000; i++) {
+        glm::vec3 n = randomUnitVector();
+        glm::vec2 e = octEncode(n);
+        glm::vec2 q(decodeSnorm16(quantizeSnorm16(e.x)), decodeSnorm16(quantizeSnorm16(e.y)));
+        glm::vec3 d = octDecode(q);
+        CHECK_NEAR(glm::length(d), 1.0f, 1e-5f);
+        // The chord, acos of a dot this close to 1 is all rounding
+        worst = fmaxf(worst, glm::length(n - d));
+    }
+    CHECK(worst < 1e-4f);
+
+    // The axes sit on the octahedron's vertices and come back exactly
+    const glm::vec3 axes[] = {
+        glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0),
+        glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1)
+    };
+    for (int i = 0; i < 6; i++) {
+        glm::vec3 d = octDecode(octEncode(axes[i]));
+        for (int c = 0; c < 3; c++)
+            CHECK_NEAR(d[c], axes[i][c], 1e-6f);
+    }
+}
+
+void testPackTextured()
+{
+    std::vector<MeshVertex> vertices(1000);
+    for (size_t i = 0; i < vertices.size(); i++) {
+        vertices[i].position = glm::vec3(randomFloat(-5.0f, 3.0f), randomFloat(0.0f, 10.0f), randomFloat(-1.0f, 1.0f));
+        vertices[i].normal = randomUnitVector();
+        vertices[i].uv = glm::vec2(randomFloat(-1.0f, 2.0f), randomFloat(0.0f, 1.0f));
+    }
+    QuantizationRange range = computeQuantizationRange(&vertices[0], vertices.size());
+    std::vector<PackedTexturedVertex> packed;
+    packTexturedVertices(&vertices[0], vertices.size(), range, packed);
+    CHECK(packed.size() == vertices.size());
+    CHECK(sizeof(PackedTexturedVertex) == 16);
+
+    for (size_t i = 0; i < vertices.size(); i++) {
+        for (int c = 0; c < 3; c++)
+            CHECK_NEAR(range.position_offset[c] + decodeUnorm16(packed[i].position[c]) * range.position_scale[c],
+                vertices[i].position[c], range.position_scale[c] * (0.5f / 65535.0f) + 1e-5f);
+        for (int c = 0; c < 2; c++)
+            CHECK_NEAR(range.uv_offset[c] + decodeUnorm16(packed[i].uv[c]) * range.uv_scale[c],
+                vertices[i].uv[c], range.uv_scale[c] * (0.5f / 65535.0f) + 1e-5f);
+        glm::vec3 n = octDecode(glm::vec2(decodeSnorm16(packed[i].normal[0]), decodeSnorm16(packed[i].normal[1])));
+        CHECK(glm::dot(n, vertices[i].normal) > 0.99999f);
+    }
+}
+
+void testPackPrimitive()
+{
+    const size_t count = 1000;
+    std::vector<float> positions(count * 3), normals(count * 3), colors(count * 3);
+    for (size_t i = 0; i < count; i++) {
+        glm::vec3 n = randomUnitVector();
+        for (int c = 0; c < 3; c++) {
+            positions[i * 3 + c] = randomFloat(-2.0f, 2.0f);
+            normals[i * 3 + c] = n[c];
+            colors[i * 3 + c] = randomFloat(0.0f, 1.0f);
+        }
+    }
+    std::vector<PackedPrimitiveVertex> packed;
+    QuantizationRange range = packPrimitiveVertices(&positions[0], &normals[0], &colors[0], count, packed);
+    CHECK(packed.size() == count);
+    CHECK(sizeof(PackedPrimitiveVertex) == 16);
+
+    for (size_t i = 0; i < count; i++)
+        for (int c = 0; c < 3; c++) {
+            CHECK_NEAR(range.position_offset[c] + decodeUnorm16(packed[i].position[c]) * range.position_scale[c],
+                positions[i * 3 + c], range.position_scale[c] * (0.5f / 65535.0f) + 1e-5f);
+            CHECK_NEAR(decodeSnorm10(packed[i].normal, c), normals[i * 3 + c], 0.5f / 511.0f + 1e-6f);
+            CHECK_NEAR(packed[i].color[c] / 255.0f, colors[i * 3 + c], 0.5f / 255.0f + 1e-6f);
+        }
+}
+
+} // namespace
+
+int main()
+{
+    testUnorm16();
+    testSnorm16();
+    testSnorm1010102();
+    testOctahedral();
+    testPackTextured();
+    testPackPrimitive();
+    return testResult("vertexformat");
+}
@@ -4,57 +4,215 @@
 
 #include <GL/glew.h>
 
+#include "mipmap.h"
+#include "texture.h"
 
-GLuint loadBMP(const char * imagepath) {
 
-    printf("Reading image %s\n", imagepath);
+namespace {
+
+const unsigned int MAX_IMAGE_SIZE = 16384;      // texels per side, GL's usual limit
+const unsigned int BI_RGB = 0;
+const unsigned int BI_BITFIELDS = 3;
+const unsigned int DDPF_FOURCC = 0x4;
+
+// Header fields are little endian and not aligned
+inline unsigned int readU32(const unsigned char * p)
+{
+    unsigned int value;
+    memcpy(&value, p, 4);
+    return value;
+}
 
-    // Data read from the header of the BMP file
-    unsigned char header[54];
-    unsigned int dataPos;
-    unsigned int imageSize;
-    unsigned int width, height;
-    // Actual RGB data
-    unsigned char * data;
+inline unsigned short readU16(const unsigned char * p)
+{
+    unsigned short value;
+    memcpy(&value, p, 2);
+    return value;
+}
 
-    // Open the file
-    FILE * file = fopen(imagepath, "rb");
-    if (!file) { printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", imagepath); getchar(); return 0; }
+bool badImage(const char * imagepath, const char * reason)
+{
+    printf("%s: %s\n", imagepath, reason);
+    return false;
+}
 
-    // Read the header, i.e. the 54 first bytes
+} // namespace
 
-    // If less than 54 bytes are read, problem
-    if (fread(header, 1, 54, file) != 54) {
-        printf("Not a correct BMP file\n");
-        return 0;
+bool decodeBMP(const char * imagepath, ImageData & image) {
+
+    printf("Reading image %s\n", imagepath);
+
+    // Map the file, nothing is read that the header hasn't been checked for
+    std::shared_ptr<MappedFile> file(new MappedFile());
+    if (!file->open(imagepath)) { printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", imagepath); return false; }
+    const unsigned char * data = (const unsigned char *)file->data();
+    size_t size = file->size();
+
+    // A BMP file always begins with "BM", a 14 byte file header and at
+    // least a 40 byte BITMAPINFOHEADER
+    if (size < 54 || data[0] != 'B' || data[1] != 'M')
+        return badImage(imagepath, "not a correct BMP file");
+    unsigned int dataPos = readU32(data + 0x0A);
+    unsigned int infoSize = readU32(data + 0x0E);
+    int width = (int)readU32(data + 0x12);
+    int height = (int)readU32(data + 0x16);     // negative for top-down rows
+    unsigned int bpp = readU16(data + 0x1C);
+    unsigned int compression = readU32(data + 0x1E);
+    if (infoSize < 40 || infoSize > size - 14)
+        return badImage(imagepath, "unsupported BMP header");
+    if (readU16(data + 0x1A) != 1 || (bpp != 24 && bpp != 32))
+        return badImage(imagepath, "only 24 and 32 bpp BMPs are supported");
+
+    // 32 bpp files keep their alpha when a V3+ header has a mask for it,
+    // otherwise the fourth byte is padding
+    bool alpha = false;
+    size_t masks_end = 14 + (size_t)infoSize;
+    if (compression == BI_BITFIELDS && bpp == 32) {
+        if (infoSize == 40)
+            masks_end += 12;
+        if (masks_end > size || readU32(data + 0x36) != 0x00ff0000 || readU32(data + 0x3A) != 0x0000ff00
+            || readU32(data + 0x3E) != 0x000000ff)
+            return badImage(imagepath, "only BGRA bit fields are supported");
+        unsigned int alpha_mask = infoSize >= 56 ? readU32(data + 0x42) : 0;
+        if (alpha_mask != 0 && alpha_mask != 0xff000000)
+            return badImage(imagepath, "only BGRA bit fields are supported");
+        alpha = alpha_mask != 0;
     }
-    // A BMP files always begins with "BM"
-    if (header[0] != 'B' || header[1] != 'M') {
-        printf("Not a correct BMP file\n");
-        return 0;
+    else if (compression != BI_RGB) {
+        return badImage(imagepath, "compressed BMPs are not supported");
     }
-    // Make sure this is a 24bpp file
-    if (*(int*)&(header[0x1E]) != 0) { printf("Not a correct BMP file\n");    return 0; }
-    if (*(int*)&(header[0x1C]) != 24) { printf("Not a correct BMP file\n");    return 0; }
 
-    // Read the information about the image
-    dataPos = *(int*)&(header[0x0A]);
-    imageSize = *(int*)&(header[0x22]);
-    width = *(int*)&(header[0x12]);
-    height = *(int*)&(header[0x16]);
+    if (width <= 0 || width > (int)MAX_IMAGE_SIZE || height == 0
+        || height > (int)MAX_IMAGE_SIZE || height < -(int)MAX_IMAGE_SIZE)
+        return badImage(imagepath, "bad image size");
+    bool topDown = height < 0;
+    unsigned int rows = topDown ? (unsigned int)-height : (unsigned int)height;
+
+    // Some BMP files are misformatted, guess missing information. The
+    // image size field is not trusted, rows are padded to 4 bytes.
+    if (dataPos == 0)      dataPos = (unsigned int)masks_end;
+    size_t fileRow = ((size_t)width * (bpp / 8) + 3) & ~(size_t)3;
+    if (dataPos < masks_end || dataPos > size || (size - dataPos) / fileRow < rows)
+        return badImage(imagepath, "truncated BMP file");
+
+    unsigned int channels = alpha ? 4 : 3;
+    size_t row = ((size_t)width * channels + 3) & ~(size_t)3;
+    image.width = width;
+    image.height = rows;
+    image.format = alpha ? GL_BGRA : GL_BGR;
+    image.compressed = false;
+    image.levels.assign(1, ImageLevel());
+    image.levels[0].offset = 0;
+    image.levels[0].size = row * rows;
+
+    // Bottom-up rows of the kept format are used from the mapping as is
+    const unsigned char * pixels = data + dataPos;
+    if (!topDown && bpp / 8 == channels) {
+        image.pixels.clear();
+        image.file = file;
+        image.mapped = pixels;
+        return true;
+    }
 
-    // Some BMP files are misformatted, guess missing information
-    if (imageSize == 0)    imageSize = width*height * 3; // 3 : one byte for each Red, Green and Blue component
-    if (dataPos == 0)      dataPos = 54; // The BMP header is done that way
+    // Otherwise rows are flipped and padding bytes dropped while copying
+    image.file.reset();
+    image.mapped = NULL;
+    image.pixels.assign(image.levels[0].size, 0);
+    for (unsigned int y = 0; y < rows; y++) {
+        const unsigned char * source = pixels + fileRow * (topDown ? rows - 1 - y : y);
+        unsigned char * dest = &image.pixels[row * y];
+        if (bpp / 8 == channels) {
+            memcpy(dest, source, (size_t)width * channels);
+            continue;
+        }
+        for (int x = 0; x < width; x++, source += 4, dest += 3) {
+            dest[0] = source[0];
+            dest[1] = source[1];
+            dest[2] = source[2];
+        }
+    }
+    return true;
+}
 
-    // Create a buffer
-    data = new unsigned char[imageSize];
+void detachImage(ImageData & image, size_t reserve) {
 
-    // Read the actual data from the file into the buffer
-    fread(data, 1, imageSize, file);
+    if (!image.file)
+        return;
+    size_t bytes = imageBytes(image);
+    image.pixels.reserve(reserve > bytes ? reserve : bytes);
+    image.pixels.assign(image.mapped, image.mapped + bytes);
+    image.file.reset();
+    image.mapped = NULL;
+}
 
-    // Everything is in memory now, the file wan be closed
-    fclose(file);
+void makeCheckerImage(ImageData & image) {
+
+    const unsigned int size = 8;
+    image.width = image.height = size;
+    image.format = GL_BGR;
+    image.compressed = false;
+    image.file.reset();
+    image.pixels.resize(size * size * 3);
+    image.levels.assign(1, ImageLevel());
+    image.levels[0].offset = 0;
+    image.levels[0].size = image.pixels.size();
+    for (unsigned int y = 0; y < size; y++) {
+        for (unsigned int x = 0; x < size; x++) {
+            unsigned char * p = &image.pixels[(y * size + x) * 3];
+            bool odd = ((x ^ y) & 1) != 0;
+            p[0] = odd ? 255 : 128;
+            p[1] = odd ? 0 : 128;
+            p[2] = odd ? 255 : 128;
+        }
+    }
+}
+
+void setImageSampling(const ImageData & image, GLenum target) {
+
+    // Trilinear when there are mips, as much anisotropy as the driver allows
+    bool mipmapped = image.levels.size() > 1;
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, mipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, (GLint)image.levels.size() - 1);
+    if (mipmapped && GLEW_EXT_texture_filter_anisotropic) {
+        GLfloat max_anisotropy = 1.0f;
+        glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &max_anisotropy);
+        glTexParameterf(target, GL_TEXTURE_MAX_ANISOTROPY_EXT, max_anisotropy < 16.0f ? max_anisotropy : 16.0f);
+    }
+}
+
+void uploadImageLevels(const ImageData & image, const unsigned char * pixels) {
+
+    // BMP rows are 4 byte aligned, compressed data ignores the setting
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    // Immutable storage for all levels at once, so the driver never has
+    // to check or reallocate the chain
+    GLenum internal_format = image.compressed ? image.format : image.format == GL_BGRA ? GL_RGBA8 : GL_RGB8;
+    bool storage = GLEW_ARB_texture_storage != 0;
+    if (storage)
+        glTexStorage2D(GL_TEXTURE_2D, (GLsizei)image.levels.size(), internal_format, image.width, image.height);
+
+    unsigned int width = image.width, height = image.height;
+    for (size_t level = 0; level < image.levels.size(); level++) {
+        const unsigned char * data = pixels + image.levels[level].offset;
+        if (image.compressed && storage)
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, (GLint)level, 0, 0, width, height, image.format,
+                (GLsizei)image.levels[level].size, data);
+        else if (image.compressed)
+            glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, image.format, width, height,
+                0, (GLsizei)image.levels[level].size, data);
+        else if (storage)
+            glTexSubImage2D(GL_TEXTURE_2D, (GLint)level, 0, 0, width, height, image.format, GL_UNSIGNED_BYTE, data);
+        else
+            glTexImage2D(GL_TEXTURE_2D, (GLint)level, internal_format, width, height, 0, image.format, GL_UNSIGNED_BYTE, data);
+
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+}
+
+GLuint uploadImage(const ImageData & image) {
 
     // Create one OpenGL texture
     GLuint textureID;
@@ -64,18 +222,21 @@ GLuint loadBMP(const char * imagepath) {
     glBindTexture(GL_TEXTURE_2D, textureID);
 
     // Give the image to OpenGL
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data);
-
-    // OpenGL has now copied the data. Free our own version
-    delete[] data;
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    uploadImageLevels(image, imagePixels(image));
+    setImageSampling(image);
 
     // Return the ID of the texture we just created
     return textureID;
 }
 
+GLuint loadBMP(const char * imagepath) {
+    ImageData image;
+    if (!decodeBMP(imagepath, image))
+        return 0;
+    generateMipmaps(image);
+    return uploadImage(image);
+}
+
 // Since GLFW 3, glfwLoadTexture2D() has been removed. You have to use another texture loading library, 
 // or do it yourself (just like loadBMP_custom and loadDDS)
 //GLuint loadTGA_glfw(const char * imagepath){
@@ -107,95 +268,87 @@ GLuint loadBMP(const char * imagepath) {
 #define FOURCC_DXT3 0x33545844 // Equivalent to "DXT3" in ASCII
 #define FOURCC_DXT5 0x35545844 // Equivalent to "DXT5" in ASCII
 
-GLuint loadDDS(const char * imagepath) {
-
-    unsigned char header[124];
-
-    FILE *fp;
-
-    /* try to open the file */
-    fp = fopen(imagepath, "rb");
-    if (fp == NULL) {
-        printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", imagepath); getchar();
-        return 0;
-    }
+bool decodeDDS(const char * imagepath, ImageData & image) {
 
-    /* verify the type of file */
-    char filecode[4];
-    fread(filecode, 1, 4, fp);
-    if (strncmp(filecode, "DDS ", 4) != 0) {
-        fclose(fp);
-        return 0;
+    /* map the file */
+    std::shared_ptr<MappedFile> file(new MappedFile());
+    if (!file->open(imagepath)) {
+        printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", imagepath);
+        return false;
     }
+    const unsigned char * data = (const unsigned char *)file->data();
+    size_t size = file->size();
 
-    /* get the surface desc */
-    fread(&header, 124, 1, fp);
-
-    unsigned int height = *(unsigned int*)&(header[8]);
-    unsigned int width = *(unsigned int*)&(header[12]);
-    unsigned int linearSize = *(unsigned int*)&(header[16]);
-    unsigned int mipMapCount = *(unsigned int*)&(header[24]);
-    unsigned int fourCC = *(unsigned int*)&(header[80]);
+    /* verify the type of file, the surface desc follows the magic */
+    if (size < 128 || memcmp(data, "DDS ", 4) != 0)
+        return badImage(imagepath, "not a DDS file");
+    const unsigned char * header = data + 4;
+    if (readU32(header) != 124 || readU32(header + 72) != 32 || !(readU32(header + 76) & DDPF_FOURCC))
+        return badImage(imagepath, "unsupported DDS header");
 
+    unsigned int height = readU32(header + 8);
+    unsigned int width = readU32(header + 12);
+    unsigned int mipMapCount = readU32(header + 24);
+    unsigned int fourCC = readU32(header + 80);
 
-    unsigned char * buffer;
-    unsigned int bufsize;
-    /* how big is it going to be including all mipmaps? */
-    bufsize = mipMapCount > 1 ? linearSize * 2 : linearSize;
-    buffer = (unsigned char*)malloc(bufsize * sizeof(unsigned char));
-    fread(buffer, 1, bufsize, fp);
-    /* close the file pointer */
-    fclose(fp);
-
-    unsigned int components = (fourCC == FOURCC_DXT1) ? 3 : 4;
-    unsigned int format;
     switch (fourCC)
     {
     case FOURCC_DXT1:
-        format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+        image.format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
         break;
     case FOURCC_DXT3:
-        format = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+        image.format = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
         break;
     case FOURCC_DXT5:
-        format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        image.format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
         break;
     default:
-        free(buffer);
-        return 0;
+        return badImage(imagepath, "only DXT1, DXT3 and DXT5 are supported");
     }
-
-    // Create one OpenGL texture
-    GLuint textureID;
-    glGenTextures(1, &textureID);
-
-    // "Bind" the newly created texture : all future texture functions will modify this texture
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
-    unsigned int blockSize = (format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT) ? 8 : 16;
-    unsigned int offset = 0;
-
-    /* load the mipmaps */
-    for (unsigned int level = 0; level < mipMapCount && (width || height); ++level)
+    if (width == 0 || height == 0 || width > MAX_IMAGE_SIZE || height > MAX_IMAGE_SIZE)
+        return badImage(imagepath, "bad image size");
+
+    // A full chain ends at 1x1
+    unsigned int maxLevels = 1;
+    for (unsigned int extent = width > height ? width : height; extent > 1; extent /= 2)
+        maxLevels++;
+    if (mipMapCount == 0)
+        mipMapCount = 1;
+    if (mipMapCount > maxLevels)
+        return badImage(imagepath, "more mip levels than the size allows");
+
+    image.width = width;
+    image.height = height;
+
+    /* exact size of every level in blocks, all must be in the file */
+    unsigned int blockSize = (image.format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT) ? 8 : 16;
+    size_t total = 0;
+    image.levels.clear();
+    for (unsigned int level = 0; level < mipMapCount; ++level)
     {
-        unsigned int size = ((width + 3) / 4)*((height + 3) / 4)*blockSize;
-        glCompressedTexImage2D(GL_TEXTURE_2D, level, format, width, height,
-            0, size, buffer + offset);
-
-        offset += size;
-        width /= 2;
-        height /= 2;
-
-        // Deal with Non-Power-Of-Two textures. This code is not included in the webpage to reduce clutter.
-        if (width < 1) width = 1;
-        if (height < 1) height = 1;
-
+        ImageLevel l;
+        l.offset = total;
+        l.size = (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+        image.levels.push_back(l);
+        total += l.size;
+
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
     }
+    if (size - 128 < total)
+        return badImage(imagepath, "truncated DDS file");
+
+    /* the levels are uploaded straight from the mapping */
+    image.compressed = true;
+    image.pixels.clear();
+    image.file = file;
+    image.mapped = data + 128;
+    return true;
+}
 
-    free(buffer);
-
-    return textureID;
-
-
-}
\ No newline at end of file
+GLuint loadDDS(const char * imagepath) {
+    ImageData image;
+    if (!decodeDDS(imagepath, image))
+        return 0;
+    return uploadImage(image);
+}
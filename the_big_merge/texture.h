@@ -1,10 +1,81 @@
 #ifndef TEXTURE_HPP
 #define TEXTURE_HPP
 
+#include <stddef.h>
+
+#include <memory>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "mappedfile.h"
+
+struct ImageLevel
+{
+	size_t offset;              // into ImageData::pixels
+	size_t size;
+};
+
+// A decoded image, CPU side only, so it can be produced on any thread.
+// BMPs are one level of bottom-up BGR or BGRA rows padded to 4 bytes,
+// DDS files all their compressed mip levels back to back.
+//
+// When the file already has that layout the levels are read in place
+// from its mapping, which the image keeps open; otherwise they are in
+// pixels. imagePixels() gives the start of level 0 either way.
+struct ImageData
+{
+	unsigned int width, height;
+	GLenum format;              // GL_BGR, GL_BGRA or a compressed internal format
+	bool compressed;
+	std::vector<ImageLevel> levels;
+	std::vector<unsigned char> pixels;
+	std::shared_ptr<const MappedFile> file;     // set when the levels are in the file
+	const unsigned char * mapped;               // where they start in it
+};
+
+inline const unsigned char * imagePixels(const ImageData & image)
+{
+	return image.file ? image.mapped : image.pixels.empty() ? NULL : &image.pixels[0];
+}
+
+// Bytes of all levels
+inline size_t imageBytes(const ImageData & image)
+{
+	return image.levels.empty() ? 0 : image.levels.back().offset + image.levels.back().size;
+}
+
+// Copies mapped levels into pixels, reserving room for reserve bytes, so
+// the image can be changed or outlive the file
+void detachImage(ImageData & image, size_t reserve = 0);
+
+// Read a file into an ImageData, false if it is missing or malformed.
+// Headers are validated against the file size before anything is read:
+// BMPs must be uncompressed 24 or 32 bpp (BI_BITFIELDS only in BGRA
+// order), top-down or bottom-up, DDS files DXT1/3/5 with a mip count
+// that fits their size. 32 bpp BMPs without an alpha mask become BGR.
+bool decodeBMP(const char * imagepath, ImageData & image);
+bool decodeDDS(const char * imagepath, ImageData & image);
+
+// 8x8 magenta and grey checkers, shown where a texture failed or has not
+// loaded yet
+void makeCheckerImage(ImageData & image);
+
+// Creates a texture from an ImageData
+GLuint uploadImage(const ImageData & image);
+
+// glTexImage2D/glCompressedTexImage2D of every level into the bound
+// texture. pixels is where image.pixels starts, which is an offset when
+// a pixel unpack buffer is bound.
+void uploadImageLevels(const ImageData & image, const unsigned char * pixels);
+
+// Filtering and level range of the texture bound to target for an image
+void setImageSampling(const ImageData & image, GLenum target = GL_TEXTURE_2D);
+
 // Load a .BMP file using our custom loader
 GLuint loadBMP(const char * imagepath);
 
-//// Since GLFW 3, glfwLoadTexture2D() has been removed. You have to use another texture loading library, 
+//// Since GLFW 3, glfwLoadTexture2D() has been removed. You have to use another texture loading library,
 //// or do it yourself (just like loadBMP_custom and loadDDS)
 //// Load a .TGA file using GLFW's own loader
 //GLuint loadTGA_glfw(const char * imagepath);
@@ -13,4 +84,4 @@ GLuint loadBMP(const char * imagepath);
 GLuint loadDDS(const char * imagepath);
 
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <atomic>
+
+#include "transform.h"
+#include "matbatch.h"
+#include "jobsystem.h"
+
+namespace {
+
+// Below this many nodes a parallel update costs more than it saves
+const size_t parallel_threshold = 8192;
+const size_t parallel_grain = 2048;
+
+// Reorders values so that values[i] becomes old values[order[i]]
+template <typename T>
+void permute(std::vector<T> & values, const std::vector<unsigned int> & order)
+{
+    std::vector<T> sorted(values.size());
+    for (size_t i = 0; i < order.size(); i++)
+        sorted[i] = values[order[i]];
+    values.swap(sorted);
+}
+
+} // namespace
+
+TransformId TransformHierarchy::add(const glm::mat4 & local, TransformId parent)
+{
+    TransformId id = (TransformId)index_.size();
+    unsigned int position = (unsigned int)ids_.size();
+    unsigned int parent_position = parent == NO_TRANSFORM ? NO_TRANSFORM : index_[parent];
+    unsigned int depth = parent == NO_TRANSFORM ? 0 : depth_[parent_position] + 1;
+
+    // Appending keeps parents first, but a shallower node after deeper
+    // ones breaks the depth order until the next update
+    if (!depth_.empty() && depth < depth_.back())
+        sorted_ = false;
+
+    index_.push_back(position);
+    ids_.push_back(id);
+    parent_.push_back(parent_position);
+    depth_.push_back(depth);
+    local_.push_back(local);
+    world_.push_back(local);
+    mv_.push_back(local);
+    dirty_.push_back(1);
+    changed_.push_back(0);
+    return id;
+}
+
+void TransformHierarchy::clear()
+{
+    index_.clear();
+    ids_.clear();
+    parent_.clear();
+    depth_.clear();
+    local_.clear();
+    world_.clear();
+    mv_.clear();
+    dirty_.clear();
+    changed_.clear();
+    has_view_ = false;
+    sorted_ = true;
+}
+
+void TransformHierarchy::setLocal(TransformId id, const glm::mat4 & local)
+{
+    unsigned int position = index_[id];
+    local_[position] = local;
+    dirty_[position] = 1;
+}
+
+TransformId TransformHierarchy::parent(TransformId id) const
+{
+    unsigned int parent_position = parent_[index_[id]];
+    return parent_position == NO_TRANSFORM ? NO_TRANSFORM : ids_[parent_position];
+}
+
+void TransformHierarchy::sortByDepth()
+{
+    std::vector<unsigned int> order(ids_.size());
+    for (unsigned int i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(),
+        [&](unsigned int a, unsigned int b) { return depth_[a] < depth_[b]; });
+
+    std::vector<unsigned int> new_position(order.size());
+    for (unsigned int i = 0; i < order.size(); i++)
+        new_position[order[i]] = i;
+    for (size_t i = 0; i < parent_.size(); i++)
+        if (parent_[i] != NO_TRANSFORM)
+            parent_[i] = new_position[parent_[i]];
+
+    permute(ids_, order);
+    permute(parent_, order);
+    permute(depth_, order);
+    permute(local_, order);
+    permute(world_, order);
+    permute(mv_, order);
+    permute(dirty_, order);
+    permute(changed_, order);
+    for (unsigned int i = 0; i < ids_.size(); i++)
+        index_[ids_[i]] = i;
+    sorted_ = true;
+}
+
+size_t TransformHierarchy::update(const glm::mat4 & view, JobSystem * jobs)
+{
+    if (!sorted_)
+        sortByDepth();
+
+    bool view_changed = !has_view_ || view != view_;
+    view_ = view;
+    has_view_ = true;
+
+    size_t count = ids_.size();
+    if (!jobs || count < parallel_threshold) {
+        updateWorlds(0, count);
+        return updateMvs(0, count, view_changed);
+    }
+
+    // A level only reads the worlds of the one above, its nodes are independent
+    for (size_t level = 0; level < count; ) {
+        size_t level_end = level;
+        while (level_end < count && depth_[level_end] == depth_[level])
+            level_end++;
+        jobs->parallelFor(level_end - level, parallel_grain, [&](size_t begin, size_t end) {
+            updateWorlds(level + begin, level + end);
+        });
+        level = level_end;
+    }
+    std::atomic<size_t> updated(0);
+    jobs->parallelFor(count, parallel_grain, [&](size_t begin, size_t end) {
+        updated += updateMvs(begin, end, view_changed);
+    });
+    return updated;
+}
+
+void TransformHierarchy::updateWorlds(size_t begin, size_t end)
+{
+    // Parents come first, so their changed flag is final when a child reads it
+    for (size_t i = begin; i < end; i++) {
+        unsigned int parent = parent_[i];
+        bool dirty = dirty_[i] || (parent != NO_TRANSFORM && changed_[parent]);
+        changed_[i] = dirty;
+        dirty_[i] = 0;
+        if (dirty)
+            world_[i] = parent == NO_TRANSFORM ? local_[i] : world_[parent] * local_[i];
+    }
+}
+
+size_t TransformHierarchy::updateMvs(size_t begin, size_t end, bool all)
+{
+    if (begin == end)
+        return 0;
+
+    // view * world in batches: everything, or each run of changed nodes
+    if (all) {
+        multiplyMatrices(view_, &world_[begin], &mv_[begin], end - begin);
+        return end - begin;
+    }
+    size_t updated = 0;
+    for (size_t i = begin; i < end; ) {
+        if (!changed_[i]) {
+            i++;
+            continue;
+        }
+        size_t first = i;
+        while (i < end && changed_[i])
+            i++;
+        multiplyMatrices(view_, &world_[first], &mv_[first], i - first);
+        updated += i - first;
+    }
+    return updated;
+}
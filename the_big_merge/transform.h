@@ -0,0 +1,67 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+class JobSystem;
+
+// Stable handle of a node, unaffected by the hierarchy reordering itself
+typedef unsigned int TransformId;
+
+const TransformId NO_TRANSFORM = ~0u;
+
+// Parent-child transforms stored as structure of arrays sorted by depth,
+// so parents always come before their children and one linear pass
+// computes every world matrix. Only nodes whose local matrix changed, and
+// their subtrees, get a new world matrix; view * world is recomputed for
+// those, or for everything when the view changed.
+class TransformHierarchy
+{
+public:
+	TransformHierarchy() : has_view_(false), sorted_(true) {}
+
+	// Adds a node under parent (NO_TRANSFORM for a root), returns its id
+	TransformId add(const glm::mat4 & local, TransformId parent = NO_TRANSFORM);
+	void clear();
+
+	void setLocal(TransformId id, const glm::mat4 & local);
+
+	const glm::mat4 & local(TransformId id) const { return local_[index_[id]]; }
+	const glm::mat4 & world(TransformId id) const { return world_[index_[id]]; }
+	const glm::mat4 & mv(TransformId id) const { return mv_[index_[id]]; }
+	TransformId parent(TransformId id) const;
+
+	// True when the last update() gave the node a new world matrix
+	bool changed(TransformId id) const { return changed_[index_[id]] != 0; }
+
+	// Propagates local changes to world and mv matrices, returns the
+	// number of mv matrices recomputed. With a job system, large
+	// hierarchies are updated one depth level at a time in parallel.
+	size_t update(const glm::mat4 & view, JobSystem * jobs = NULL);
+
+	size_t size() const { return ids_.size(); }
+
+private:
+	void sortByDepth();
+	void updateWorlds(size_t begin, size_t end);
+	size_t updateMvs(size_t begin, size_t end, bool all);
+
+	// By id
+	std::vector<unsigned int> index_;       // position in the arrays below
+
+	// By position, sorted by depth
+	std::vector<TransformId> ids_;
+	std::vector<unsigned int> parent_;      // position of the parent, or NO_TRANSFORM
+	std::vector<unsigned int> depth_;
+	std::vector<glm::mat4> local_, world_, mv_;
+	std::vector<unsigned char> dirty_;      // local changed since the last update
+	std::vector<unsigned char> changed_;    // world changed by the last update
+
+	glm::mat4 view_;
+	bool has_view_;
+	bool sorted_;
+};
+
+#endif
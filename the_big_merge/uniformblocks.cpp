@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "uniformblocks.h"
+
+namespace {
+
+const unsigned int NO_MATERIAL = ~0u;
+
+struct BlockLayout
+{
+    const char * name;
+    GLuint binding;
+    size_t size;
+};
+
+const BlockLayout SHARED_BLOCKS[] = {
+    { "FrameBlock", FRAME_BLOCK_BINDING, sizeof(FrameUniforms) },
+    { "MaterialBlock", MATERIAL_BLOCK_BINDING, sizeof(MaterialUniforms) },
+    { "ObjectBlock", OBJECT_BLOCK_BINDING, sizeof(ObjectUniforms) }
+};
+
+} // namespace
+
+ProgramInterface::ProgramInterface()
+    : blocks_(0)
+{
+}
+
+bool ProgramInterface::reflect(GLuint program)
+{
+    blocks_ = 0;
+    locations_.clear();
+    bool ok = true;
+
+    GLint block_count = 0, max_length = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &block_count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &max_length);
+    std::vector<char> name(max_length + 1);
+    for (GLint b = 0; b < block_count; b++) {
+        glGetActiveUniformBlockName(program, b, (GLsizei)name.size(), NULL, &name[0]);
+        GLint binding = 0, size = 0;
+        glGetActiveUniformBlockiv(program, b, GL_UNIFORM_BLOCK_BINDING, &binding);
+        glGetActiveUniformBlockiv(program, b, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+
+        const BlockLayout * layout = NULL;
+        for (size_t i = 0; i < sizeof(SHARED_BLOCKS) / sizeof(SHARED_BLOCKS[0]); i++)
+            if (strcmp(&name[0], SHARED_BLOCKS[i].name) == 0)
+                layout = &SHARED_BLOCKS[i];
+        if (!layout) {
+            printf("program %u: uniform block %s is not one of the shared ones\n", program, &name[0]);
+            ok = false;
+        }
+        else if ((GLuint)binding != layout->binding || (size_t)size != layout->size) {
+            printf("program %u: %s is at binding %d with %d bytes, expected %u with %u\n", program, &name[0],
+                binding, size, layout->binding, (unsigned int)layout->size);
+            ok = false;
+        }
+        else {
+            blocks_ |= 1u << binding;
+        }
+    }
+
+    GLint uniform_count = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniform_count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+    name.resize(max_length + 1);
+    for (GLint u = 0; u < uniform_count; u++) {
+        GLuint index = (GLuint)u;
+        GLint block = -1;
+        glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_BLOCK_INDEX, &block);
+        if (block != -1)
+            continue;
+        glGetActiveUniformName(program, index, (GLsizei)name.size(), NULL, &name[0]);
+        locations_[&name[0]] = glGetUniformLocation(program, &name[0]);
+    }
+    return ok;
+}
+
+GLint ProgramInterface::location(const char * name) const
+{
+    std::map<std::string, GLint>::const_iterator found = locations_.find(name);
+    return found != locations_.end() ? found->second : -1;
+}
+
+UniformBlocks::UniformBlocks()
+    : alignment_(256), materials_(0), material_stride_(0), bound_material_(NO_MATERIAL)
+{
+}
+
+bool UniformBlocks::create(size_t ring_capacity)
+{
+    destroy();
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    alignment_ = alignment > 0 ? (size_t)alignment : 256;
+    material_stride_ = (sizeof(MaterialUniforms) + alignment_ - 1) / alignment_ * alignment_;
+    return ring_.create(ring_capacity);
+}
+
+void UniformBlocks::destroy()
+{
+    ring_.destroy();
+    if (materials_)
+        glDeleteBuffers(1, &materials_);
+    materials_ = 0;
+    material_data_.clear();
+    bound_material_ = NO_MATERIAL;
+}
+
+unsigned int UniformBlocks::addMaterial(const MaterialUniforms & material)
+{
+    material_data_.push_back(material);
+
+    // Materials are added at load time, the buffer is simply rebuilt
+    std::vector<unsigned char> bytes(material_data_.size() * material_stride_, 0);
+    for (size_t i = 0; i < material_data_.size(); i++)
+        memcpy(&bytes[i * material_stride_], &material_data_[i], sizeof(MaterialUniforms));
+    if (!materials_)
+        glGenBuffers(1, &materials_);
+    glBindBuffer(GL_UNIFORM_BUFFER, materials_);
+    glBufferData(GL_UNIFORM_BUFFER, (GLsizeiptr)bytes.size(), &bytes[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    bound_material_ = NO_MATERIAL;
+    return (unsigned int)(material_data_.size() - 1);
+}
+
+void UniformBlocks::bindMaterial(unsigned int material)
+{
+    if (material == bound_material_ || material >= material_data_.size())
+        return;
+    glBindBufferRange(GL_UNIFORM_BUFFER, MATERIAL_BLOCK_BINDING, materials_,
+        (GLintptr)(material * material_stride_), sizeof(MaterialUniforms));
+    bound_material_ = material;
+}
+
+bool UniformBlocks::beginFrame(const FrameUniforms & frame)
+{
+    return bindRing(FRAME_BLOCK_BINDING, &frame, sizeof(frame));
+}
+
+bool UniformBlocks::writeObject(const ObjectUniforms & object, GLintptr & offset)
+{
+    size_t written;
+    if (!ring_.write(&object, sizeof(object), alignment_, written))
+        return false;
+    offset = (GLintptr)written;
+    return true;
+}
+
+void UniformBlocks::endFrame()
+{
+    ring_.endFrame();
+}
+
+bool UniformBlocks::bindRing(GLuint binding, const void * data, size_t size)
+{
+    // A full ring keeps the last block bound, drawing a frame with stale
+    // values rather than waiting for the GPU
+    size_t offset;
+    if (!ring_.write(data, size, alignment_, offset))
+        return false;
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, ring_.buffer(), (GLintptr)offset, (GLsizeiptr)size);
+    return true;
+}
@@ -0,0 +1,104 @@
+#ifndef UNIFORMBLOCKS_H
+#define UNIFORMBLOCKS_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "stagingbuffer.h"
+
+// Uniform blocks shared by the programs, std140, at fixed binding points.
+// The shaders declare the same blocks with layout(std140, binding = N).
+const GLuint FRAME_BLOCK_BINDING = 0;
+const GLuint MATERIAL_BLOCK_BINDING = 1;
+const GLuint OBJECT_BLOCK_BINDING = 2;
+
+// "uniform FrameBlock", written once a frame
+struct FrameUniforms
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec4 light_pos;        // xyz
+};
+
+// "uniform MaterialBlock", written when the material is added
+struct MaterialUniforms
+{
+	glm::vec4 mat_ambient;      // rgb
+	glm::vec4 mat_diffuse;      // rgb
+};
+
+// "uniform ObjectBlock", per draw for the draws that don't index a
+// DrawData buffer
+struct ObjectUniforms
+{
+	glm::vec4 pos_offset;       // dequantization range of the positions, xyz
+	glm::vec4 pos_scale;
+};
+
+// What a program uses of the shared blocks, and the locations of its
+// uniforms outside blocks, looked up once per program
+class ProgramInterface
+{
+public:
+	ProgramInterface();
+
+	// False, with the differences printed, when a block of the program
+	// isn't where or the size its struct says
+	bool reflect(GLuint program);
+
+	bool usesBlock(GLuint binding) const { return (blocks_ >> binding) & 1; }
+	GLint location(const char * name) const;     // -1 if not active
+
+private:
+	unsigned int blocks_;                       // bit per binding point
+	std::map<std::string, GLint> locations_;
+};
+
+// Buffers behind the shared blocks. Frame and object blocks are written
+// into a StagingBuffer ring and bound with glBindBufferRange at their
+// offset, object blocks by the RenderQueue, so the next frame never
+// overwrites what the GPU still reads.
+// Materials don't change and live in one buffer, a range each; binding
+// one that is already bound is skipped.
+class UniformBlocks
+{
+public:
+	UniformBlocks();
+
+	bool create(size_t ring_capacity);
+	void destroy();
+
+	// Index of a new material
+	unsigned int addMaterial(const MaterialUniforms & material);
+	void bindMaterial(unsigned int material);
+
+	// Writes and binds the frame block; first thing in a frame
+	bool beginFrame(const FrameUniforms & frame);
+
+	// Writes an object block for a recorded draw, which binds
+	// sizeof(ObjectUniforms) at offset of ringBuffer() when it is drawn
+	bool writeObject(const ObjectUniforms & object, GLintptr & offset);
+	GLuint ringBuffer() const { return ring_.buffer(); }
+
+	// Fences the frame's blocks; after the frame's draws
+	void endFrame();
+
+private:
+	UniformBlocks(const UniformBlocks &);
+	UniformBlocks & operator=(const UniformBlocks &);
+
+	bool bindRing(GLuint binding, const void * data, size_t size);
+
+	StagingBuffer ring_;
+	size_t alignment_;          // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+	GLuint materials_;
+	size_t material_stride_;
+	std::vector<MaterialUniforms> material_data_;
+	unsigned int bound_material_;
+};
+
+#endif
@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <math.h>
+#include <stddef.h>
+
+#include <algorithm>
+
+#include "vertexformat.h"
+
+namespace {
+
+const VertexAttribute textured_attributes[] = {
+    { "position", 3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(PackedTexturedVertex, position) },
+    { "normal", 2, GL_SHORT, GL_TRUE, offsetof(PackedTexturedVertex, normal) },
+    { "uv", 2, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(PackedTexturedVertex, uv) }
+};
+
+const VertexAttribute primitive_attributes[] = {
+    { "position", 3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(PackedPrimitiveVertex, position) },
+    { "normal", 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(PackedPrimitiveVertex, normal) },
+    { "color", 3, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(PackedPrimitiveVertex, color) }
+};
+
+inline float clamp01(float v)
+{
+    return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+}
+
+inline float clampSigned(float v)
+{
+    return v < -1.0f ? -1.0f : (v > 1.0f ? 1.0f : v);
+}
+
+inline float relative(float v, float offset, float scale)
+{
+    return scale > 0.0f ? (v - offset) / scale : 0.0f;
+}
+
+inline float dequantizeUnorm16(unsigned short v)
+{
+    return v / 65535.0f;
+}
+
+inline float dequantizeSnorm16(short v)
+{
+    return std::max(v / 32767.0f, -1.0f);
+}
+
+// Sign extends a 10 bit field
+inline float dequantizeSnorm10(unsigned int bits)
+{
+    int v = (int)(bits << 22) >> 22;
+    return std::max(v / 511.0f, -1.0f);
+}
+
+} // namespace
+
+const VertexLayout textured_vertex_layout = {
+    textured_attributes, 3, sizeof(PackedTexturedVertex)
+};
+
+const VertexLayout primitive_vertex_layout = {
+    primitive_attributes, 3, sizeof(PackedPrimitiveVertex)
+};
+
+void bindVertexLayout(const VertexLayout & layout, GLuint program_id)
+{
+    for (unsigned int i = 0; i < layout.attribute_count; i++) {
+        const VertexAttribute & a = layout.attributes[i];
+        GLint location = glGetAttribLocation(program_id, a.name);
+        if (location < 0)
+            continue;
+        glVertexAttribPointer(location, a.size, a.type, a.normalized, layout.stride, (void *)a.offset);
+        glEnableVertexAttribArray(location);
+    }
+}
+
+unsigned short quantizeUnorm16(float v)
+{
+    return (unsigned short)(clamp01(v) * 65535.0f + 0.5f);
+}
+
+short quantizeSnorm16(float v)
+{
+    return (short)floorf(clampSigned(v) * 32767.0f + 0.5f);
+}
+
+unsigned char quantizeUnorm8(float v)
+{
+    return (unsigned char)(clamp01(v) * 255.0f + 0.5f);
+}
+
+unsigned int quantizeSnorm1010102(const glm::vec3 & v)
+{
+    unsigned int x = (unsigned int)(int)floorf(clampSigned(v.x) * 511.0f + 0.5f) & 0x3ff;
+    unsigned int y = (unsigned int)(int)floorf(clampSigned(v.y) * 511.0f + 0.5f) & 0x3ff;
+    unsigned int z = (unsigned int)(int)floorf(clampSigned(v.z) * 511.0f + 0.5f) & 0x3ff;
+    return x | (y << 10) | (z << 20);
+}
+
+glm::vec2 octEncode(const glm::vec3 & v)
+{
+    float l1 = fabsf(v.x) + fabsf(v.y) + fabsf(v.z);
+    if (l1 == 0.0f)
+        return glm::vec2(0.0f, 0.0f);
+    glm::vec2 e(v.x / l1, v.y / l1);
+    if (v.z < 0.0f) {
+        // Fold the lower hemisphere over the diagonals
+        glm::vec2 folded((1.0f - fabsf(e.y)) * (e.x >= 0.0f ? 1.0f : -1.0f),
+            (1.0f - fabsf(e.x)) * (e.y >= 0.0f ? 1.0f : -1.0f));
+        e = folded;
+    }
+    return e;
+}
+
+glm::vec3 octDecode(const glm::vec2 & e)
+{
+    glm::vec3 v(e.x, e.y, 1.0f - fabsf(e.x) - fabsf(e.y));
+    if (v.z < 0.0f) {
+        float x = (1.0f - fabsf(e.y)) * (e.x >= 0.0f ? 1.0f : -1.0f);
+        float y = (1.0f - fabsf(e.x)) * (e.y >= 0.0f ? 1.0f : -1.0f);
+        v.x = x;
+        v.y = y;
+    }
+    return glm::normalize(v);
+}
+
+QuantizationRange computeQuantizationRange(const MeshVertex * vertices, size_t count)
+{
+    QuantizationRange range;
+    glm::vec3 low(0.0f), high(0.0f);
+    glm::vec2 uv_low(0.0f, 0.0f), uv_high(0.0f, 0.0f);
+    for (size_t i = 0; i < count; i++) {
+        const MeshVertex & v = vertices[i];
+        low = i ? glm::min(low, v.position) : v.position;
+        high = i ? glm::max(high, v.position) : v.position;
+        uv_low = i ? glm::vec2(std::min(uv_low.x, v.uv.x), std::min(uv_low.y, v.uv.y)) : v.uv;
+        uv_high = i ? glm::vec2(std::max(uv_high.x, v.uv.x), std::max(uv_high.y, v.uv.y)) : v.uv;
+    }
+    range.position_offset = low;
+    range.position_scale = high - low;
+    range.uv_offset = uv_low;
+    range.uv_scale = uv_high - uv_low;
+    return range;
+}
+
+void packTexturedVertices(const MeshVertex * vertices, size_t count,
+    const QuantizationRange & range, std::vector<PackedTexturedVertex> & out)
+{
+    out.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        const MeshVertex & v = vertices[i];
+        PackedTexturedVertex & p = out[i];
+        for (int c = 0; c < 3; c++)
+            p.position[c] = quantizeUnorm16(relative(v.position[c], range.position_offset[c], range.position_scale[c]));
+        p.position[3] = 0;
+
+        float length = glm::length(v.normal);
+        glm::vec2 e = octEncode(length > 0.0f ? v.normal / length : glm::vec3(0.0f, 0.0f, 1.0f));
+        p.normal[0] = quantizeSnorm16(e.x);
+        p.normal[1] = quantizeSnorm16(e.y);
+
+        p.uv[0] = quantizeUnorm16(relative(v.uv.x, range.uv_offset.x, range.uv_scale.x));
+        p.uv[1] = quantizeUnorm16(relative(v.uv.y, range.uv_offset.y, range.uv_scale.y));
+    }
+}
+
+QuantizationRange packPrimitiveVertices(const float * positions, const float * normals,
+    const float * colors, size_t count, std::vector<PackedPrimitiveVertex> & out)
+{
+    QuantizationRange range;
+    glm::vec3 low, high;
+    computeBounds(positions, count, 3, low, high);
+    range.position_offset = low;
+    range.position_scale = high - low;
+    range.uv_offset = glm::vec2(0.0f, 0.0f);
+    range.uv_scale = glm::vec2(0.0f, 0.0f);
+
+    out.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        PackedPrimitiveVertex & p = out[i];
+        for (int c = 0; c < 3; c++) {
+            p.position[c] = quantizeUnorm16(relative(positions[i * 3 + c], low[c], range.position_scale[c]));
+            p.color[c] = quantizeUnorm8(colors[i * 3 + c]);
+        }
+        p.position[3] = 0;
+        p.color[3] = 255;
+        p.normal = quantizeSnorm1010102(glm::vec3(normals[i * 3], normals[i * 3 + 1], normals[i * 3 + 2]));
+    }
+    return range;
+}
+
+void reportTexturedFootprint(const char * name, const MeshVertex * vertices, size_t count,
+    const QuantizationRange & range, const std::vector<PackedTexturedVertex> & packed)
+{
+    float position_error = 0.0f, normal_error = 0.0f;
+    for (size_t i = 0; i < count; i++) {
+        const PackedTexturedVertex & p = packed[i];
+        for (int c = 0; c < 3; c++) {
+            float v = range.position_offset[c] + dequantizeUnorm16(p.position[c]) * range.position_scale[c];
+            position_error = std::max(position_error, fabsf(v - vertices[i].position[c]));
+        }
+        float length = glm::length(vertices[i].normal);
+        if (length > 0.0f) {
+            glm::vec3 n = octDecode(glm::vec2(dequantizeSnorm16(p.normal[0]), dequantizeSnorm16(p.normal[1])));
+            float cosine = glm::clamp(glm::dot(n, vertices[i].normal / length), -1.0f, 1.0f);
+            normal_error = std::max(normal_error, acosf(cosine));
+        }
+    }
+    printf("%s: vertices %u -> %u bytes, max position error %g, max normal error %.4f deg\n",
+        name, (unsigned int)(count * sizeof(MeshVertex)), (unsigned int)(count * sizeof(PackedTexturedVertex)),
+        position_error, normal_error * 180.0f / 3.14159265f);
+}
+
+void reportPrimitiveFootprint(const char * name, const float * positions, const float * normals,
+    size_t count, const QuantizationRange & range, const std::vector<PackedPrimitiveVertex> & packed)
+{
+    float position_error = 0.0f, normal_error = 0.0f;
+    for (size_t i = 0; i < count; i++) {
+        const PackedPrimitiveVertex & p = packed[i];
+        for (int c = 0; c < 3; c++) {
+            float v = range.position_offset[c] + dequantizeUnorm16(p.position[c]) * range.position_scale[c];
+            position_error = std::max(position_error, fabsf(v - positions[i * 3 + c]));
+        }
+        glm::vec3 original(normals[i * 3], normals[i * 3 + 1], normals[i * 3 + 2]);
+        glm::vec3 decoded(dequantizeSnorm10(p.normal), dequantizeSnorm10(p.normal >> 10),
+            dequantizeSnorm10(p.normal >> 20));
+        if (glm::length(original) > 0.0f && glm::length(decoded) > 0.0f) {
+            float cosine = glm::clamp(glm::dot(glm::normalize(decoded), glm::normalize(original)), -1.0f, 1.0f);
+            normal_error = std::max(normal_error, acosf(cosine));
+        }
+    }
+    printf("%s: vertices %u -> %u bytes, max position error %g, max normal error %.4f deg\n",
+        name, (unsigned int)(count * 9 * sizeof(GLfloat)), (unsigned int)(count * sizeof(PackedPrimitiveVertex)),
+        position_error, normal_error * 180.0f / 3.14159265f);
+}
@@ -0,0 +1,93 @@
+#ifndef VERTEXFORMAT_H
+#define VERTEXFORMAT_H
+
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+
+// Quantized, interleaved vertex formats.
+//
+// Positions are unorm16 relative to the mesh bounds, uvs unorm16 relative
+// to the uv bounds; the shaders get the ranges as uniforms and dequantize
+// with offset + value * scale. Loaded meshes store octahedral normals in
+// two snorm16, generated primitives 10_10_10_2 normals and unorm8 colors.
+
+// Range the unorm16 positions and uvs are relative to
+struct QuantizationRange
+{
+	glm::vec3 position_offset;
+	glm::vec3 position_scale;
+	glm::vec2 uv_offset;
+	glm::vec2 uv_scale;
+};
+
+// 16 bytes instead of the 32 of MeshVertex
+struct PackedTexturedVertex
+{
+	unsigned short position[4];  // unorm16, w unused
+	short normal[2];             // octahedral snorm16
+	unsigned short uv[2];        // unorm16
+};
+
+// 16 bytes instead of 36 for three float streams
+struct PackedPrimitiveVertex
+{
+	unsigned short position[4];  // unorm16, w unused
+	unsigned int normal;         // snorm 10_10_10_2
+	unsigned char color[4];      // unorm8, a unused
+};
+
+// One attribute of an interleaved layout
+struct VertexAttribute
+{
+	const char * name;
+	GLint size;
+	GLenum type;
+	GLboolean normalized;
+	size_t offset;
+};
+
+struct VertexLayout
+{
+	const VertexAttribute * attributes;
+	unsigned int attribute_count;
+	GLsizei stride;
+};
+
+extern const VertexLayout textured_vertex_layout;
+extern const VertexLayout primitive_vertex_layout;
+
+// Sets up the attribute pointers of layout for the buffer bound to
+// GL_ARRAY_BUFFER, in the currently bound vao
+void bindVertexLayout(const VertexLayout & layout, GLuint program_id);
+
+// Scalar quantizers
+unsigned short quantizeUnorm16(float v);
+short quantizeSnorm16(float v);
+unsigned char quantizeUnorm8(float v);
+unsigned int quantizeSnorm1010102(const glm::vec3 & v);
+
+// Octahedral normal encoding, v must be unit length
+glm::vec2 octEncode(const glm::vec3 & v);
+glm::vec3 octDecode(const glm::vec2 & e);
+
+QuantizationRange computeQuantizationRange(const MeshVertex * vertices, size_t count);
+
+void packTexturedVertices(const MeshVertex * vertices, size_t count,
+	const QuantizationRange & range, std::vector<PackedTexturedVertex> & out);
+
+// positions, normals and colors are xyz float triples
+QuantizationRange packPrimitiveVertices(const float * positions, const float * normals,
+	const float * colors, size_t count, std::vector<PackedPrimitiveVertex> & out);
+
+// Prints the vertex buffer size before/after packing and the worst
+// position and normal error of the packed data
+void reportTexturedFootprint(const char * name, const MeshVertex * vertices, size_t count,
+	const QuantizationRange & range, const std::vector<PackedTexturedVertex> & packed);
+void reportPrimitiveFootprint(const char * name, const float * positions, const float * normals,
+	size_t count, const QuantizationRange & range, const std::vector<PackedPrimitiveVertex> & packed);
+
+#endif